@@ -0,0 +1,313 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of DeskewCorrelator
+ */
+#include "../scopehal/scopehal.h"
+#include "DeskewCorrelator.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+DeskewCorrelator::DeskewCorrelator()
+#ifndef _APPLE_SILICON
+	: m_forwardPlan(nullptr)
+	, m_reversePlan(nullptr)
+	, m_fftLength(0)
+#endif
+{
+}
+
+DeskewCorrelator::~DeskewCorrelator()
+{
+#ifndef _APPLE_SILICON
+	if(m_forwardPlan)
+		ffts_free(m_forwardPlan);
+	if(m_reversePlan)
+		ffts_free(m_reversePlan);
+#endif
+}
+
+#ifndef _APPLE_SILICON
+/**
+	@brief Recreates the FFT plans if the length changed
+ */
+void DeskewCorrelator::UpdatePlans(size_t fftlen)
+{
+	if(fftlen == m_fftLength)
+		return;
+
+	if(m_forwardPlan)
+		ffts_free(m_forwardPlan);
+	if(m_reversePlan)
+		ffts_free(m_reversePlan);
+
+	m_forwardPlan = ffts_init_1d_real(fftlen, FFTS_FORWARD);
+	m_reversePlan = ffts_init_1d_real(fftlen, FFTS_BACKWARD);
+	m_fftLength = fftlen;
+
+	//Real FFT of length N has N/2 + 1 complex outputs
+	m_primarySpectrum.resize(fftlen + 2);
+	m_secondarySpectrum.resize(fftlen + 2);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Resampling
+
+/**
+	@brief Linearly interpolates an analog waveform onto a uniform grid
+
+	Grid points before the first or after the last sample take the value of that sample.
+
+	@param wfm			The waveform to resample
+	@param start		Time of the first grid point, in fs relative to the trigger
+	@param timescale	Spacing of the grid, in fs
+	@param len			Number of grid points
+	@param out			Output buffer
+
+	@return False if the waveform isn't analog or is empty
+ */
+bool DeskewCorrelator::Resample(WaveformBase* wfm, int64_t start, int64_t timescale, size_t len, float* out)
+{
+	auto uadata = dynamic_cast<UniformAnalogWaveform*>(wfm);
+	auto sadata = dynamic_cast<SparseAnalogWaveform*>(wfm);
+	if(!uadata && !sadata)
+		return false;
+	size_t wlen = wfm->size();
+	if(wlen == 0)
+		return false;
+
+	if(uadata)
+	{
+		uadata->m_samples.PrepareForCpuAccess();
+		const float* p = uadata->m_samples.GetCpuPointer();
+
+		//Same sample rate and phase: straight copy, clamped at the ends
+		int64_t phase = start - wfm->m_triggerPhase;
+		if( (wfm->m_timescale == timescale) && ( (phase % timescale) == 0) )
+		{
+			int64_t base = phase / timescale;
+			for(size_t k=0; k<len; k++)
+			{
+				int64_t i = base + k;
+				i = max((int64_t)0, min(i, (int64_t)wlen - 1));
+				out[k] = p[i];
+			}
+			return true;
+		}
+
+		for(size_t k=0; k<len; k++)
+		{
+			double pos = static_cast<double>(phase + (int64_t)k*timescale) / wfm->m_timescale;
+			if(pos <= 0)
+				out[k] = p[0];
+			else if(pos >= wlen - 1)
+				out[k] = p[wlen - 1];
+			else
+			{
+				size_t i = floor(pos);
+				float frac = pos - i;
+				out[k] = p[i] + (p[i+1] - p[i]) * frac;
+			}
+		}
+		return true;
+	}
+
+	//Sparse: walk the samples alongside the grid
+	sadata->m_samples.PrepareForCpuAccess();
+	sadata->m_offsets.PrepareForCpuAccess();
+	const float* p = sadata->m_samples.GetCpuPointer();
+	const int64_t* offs = sadata->m_offsets.GetCpuPointer();
+	size_t j = 0;
+	for(size_t k=0; k<len; k++)
+	{
+		int64_t t = start + (int64_t)k*timescale;
+		while( (j+1 < wlen) && (offs[j+1]*wfm->m_timescale + wfm->m_triggerPhase <= t) )
+			j ++;
+
+		int64_t tj = offs[j]*wfm->m_timescale + wfm->m_triggerPhase;
+		if( (t <= tj) || (j+1 >= wlen) )
+			out[k] = p[j];
+		else
+		{
+			int64_t tnext = offs[j+1]*wfm->m_timescale + wfm->m_triggerPhase;
+			float frac = static_cast<double>(t - tj) / (tnext - tj);
+			out[k] = p[j] + (p[j+1] - p[j]) * frac;
+		}
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Correlation
+
+/**
+	@brief Finds the skew which best lines up the secondary waveform with the primary
+
+	@param primary		Reference waveform
+	@param secondary	Waveform to measure, captured from the same signal
+	@param maxSkew		Largest skew to consider, in fs (either direction)
+	@param skew			Skew in fs: the secondary's sample at time t + skew matches the primary's at t
+	@param peak			Normalized correlation at the peak, 1 for identical waveforms
+	@param decimation	Only use every Nth sample of the primary, for quick checks of long waveforms
+
+	@return False if the waveforms can't be correlated
+ */
+bool DeskewCorrelator::Correlate(
+	WaveformBase* primary,
+	WaveformBase* secondary,
+	int64_t maxSkew,
+	int64_t& skew,
+	double& peak,
+	size_t decimation)
+{
+	if(!primary || !secondary || (primary->size() < 2) || secondary->empty() || (primary->m_timescale <= 0))
+		return false;
+
+	//Grid at the primary's (possibly decimated) sample rate, spanning the primary waveform
+	auto psparse = dynamic_cast<SparseWaveformBase*>(primary);
+	auto puniform = dynamic_cast<UniformWaveformBase*>(primary);
+	if(psparse)
+		psparse->m_offsets.PrepareForCpuAccess();
+	int64_t timescale = primary->m_timescale * max(decimation, (size_t)1);
+	int64_t start = ::GetOffsetScaled(psparse, puniform, 0);
+	int64_t end = ::GetOffsetScaled(psparse, puniform, primary->size() - 1);
+	size_t len = min( (size_t)((end - start) / timescale) + 1, MAX_SAMPLES);
+
+	int64_t maxLag = min(maxSkew / timescale, (int64_t)len / 2);
+	if(maxLag < 1)
+		return false;
+
+	//Zero pad to at least len + maxLag so lags we care about don't wrap around into each other
+	size_t fftlen = 1;
+	while(fftlen < len + maxLag)
+		fftlen *= 2;
+
+	m_primary.resize(fftlen);
+	m_secondary.resize(fftlen);
+	m_correlation.resize(fftlen);
+	if(!Resample(primary, start, timescale, len, &m_primary[0]))
+		return false;
+	if(!Resample(secondary, start, timescale, len, &m_secondary[0]))
+		return false;
+
+	//Remove the mean and scale to unit variance, so the peak is a correlation coefficient
+	for(auto buf : {&m_primary, &m_secondary})
+	{
+		auto& b = *buf;
+		double sum = 0;
+		for(size_t i=0; i<len; i++)
+			sum += b[i];
+		float mean = sum / len;
+
+		double sumsq = 0;
+		for(size_t i=0; i<len; i++)
+		{
+			b[i] -= mean;
+			sumsq += b[i] * b[i];
+		}
+		float scale = (sumsq > 0) ? (1.0 / sqrt(sumsq / len)) : 0;
+		for(size_t i=0; i<len; i++)
+			b[i] *= scale;
+
+		for(size_t i=len; i<fftlen; i++)
+			b[i] = 0;
+	}
+
+#ifndef _APPLE_SILICON
+	//corr[d] = sum(pri[i] * sec[i+d]) = IFFT(conj(PRI) * SEC)[d]
+	UpdatePlans(fftlen);
+	ffts_execute(m_forwardPlan, &m_primary[0], &m_primarySpectrum[0]);
+	ffts_execute(m_forwardPlan, &m_secondary[0], &m_secondarySpectrum[0]);
+
+	size_t nouts = fftlen/2 + 1;
+	float scale = 1.0f / fftlen;
+	for(size_t i=0; i<nouts; i++)
+	{
+		float pr = m_primarySpectrum[i*2];
+		float pi = m_primarySpectrum[i*2 + 1];
+		float sr = m_secondarySpectrum[i*2];
+		float si = m_secondarySpectrum[i*2 + 1];
+
+		m_secondarySpectrum[i*2]		= (pr*sr + pi*si) * scale;
+		m_secondarySpectrum[i*2 + 1]	= (pr*si - pi*sr) * scale;
+	}
+
+	ffts_execute(m_reversePlan, &m_secondarySpectrum[0], &m_correlation[0]);
+#else
+	//No FFTS on this platform, correlate directly
+	#pragma omp parallel for
+	for(int64_t d = -maxLag; d <= maxLag; d++)
+	{
+		size_t istart = (d < 0) ? -d : 0;
+		size_t iend = (d > 0) ? len - d : len;
+		double sum = 0;
+		for(size_t i=istart; i<iend; i++)
+			sum += m_primary[i] * m_secondary[i + d];
+		m_correlation[(d + fftlen) % fftlen] = sum;
+	}
+#endif
+
+	//Find the peak, normalizing each lag by the number of overlapping samples
+	auto corr = [&](int64_t d)
+	{ return m_correlation[(d + fftlen) % fftlen] / (len - llabs(d)); };
+
+	int64_t best = 0;
+	double bestValue = corr(0);
+	for(int64_t d = -maxLag; d <= maxLag; d++)
+	{
+		double v = corr(d);
+		if(v > bestValue)
+		{
+			bestValue = v;
+			best = d;
+		}
+	}
+
+	//Fit a parabola through the peak and its neighbors to get a fractional lag
+	double frac = 0;
+	if( (best > -maxLag) && (best < maxLag) )
+	{
+		double left = corr(best - 1);
+		double right = corr(best + 1);
+		double denom = left - 2*bestValue + right;
+		if(denom < 0)
+			frac = 0.5 * (left - right) / denom;
+	}
+
+	skew = llround( (best + frac) * timescale);
+	peak = bestValue;
+	return true;
+}
@@ -0,0 +1,105 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of DeskewCorrelator
+ */
+#ifndef DeskewCorrelator_h
+#define DeskewCorrelator_h
+
+#ifndef _APPLE_SILICON
+#include <ffts.h>
+#endif
+
+/**
+	@brief Measures the skew between two captures of the same signal by cross-correlation
+
+	Both waveforms are resampled onto a common uniform grid at the primary's sample rate, so mismatched sample rates
+	and sparse waveforms are handled the same way as the simple case. The cross-correlation at every lag is then
+	computed at once with FFTs in O(n log n), rather than one dot product per lag, and the peak is refined to a fraction
+	of a sample by fitting a parabola through it and its neighbors.
+
+	Plans and buffers are kept between calls, so repeated measurements of similar waveforms (averaging, or tracking
+	drift over time) don't reallocate anything.
+
+	Doesn't depend on any GUI code, so it's built into the scopeclientcommon library which both glscopeclient and
+	ngscopeclient link.
+ */
+class DeskewCorrelator
+{
+public:
+	DeskewCorrelator();
+	~DeskewCorrelator();
+
+	bool Correlate(
+		WaveformBase* primary,
+		WaveformBase* secondary,
+		int64_t maxSkew,
+		int64_t& skew,
+		double& peak,
+		size_t decimation = 1);
+
+	///@brief Longest stretch of the primary waveform used for correlation, in samples
+	static const size_t MAX_SAMPLES = 4 * 1024 * 1024;
+
+protected:
+	static bool Resample(WaveformBase* wfm, int64_t start, int64_t timescale, size_t len, float* out);
+
+#ifndef _APPLE_SILICON
+	void UpdatePlans(size_t fftlen);
+
+	///@brief Forward real FFT plan
+	ffts_plan_t* m_forwardPlan;
+
+	///@brief Inverse real FFT plan
+	ffts_plan_t* m_reversePlan;
+
+	///@brief Length the plans were created for
+	size_t m_fftLength;
+
+	///@brief Spectrum of the primary waveform (interleaved complex)
+	std::vector<float, AlignedAllocator<float, 64> > m_primarySpectrum;
+
+	///@brief Spectrum of the secondary waveform (interleaved complex)
+	std::vector<float, AlignedAllocator<float, 64> > m_secondarySpectrum;
+#endif
+
+	///@brief Primary waveform, resampled and zero padded
+	std::vector<float, AlignedAllocator<float, 64> > m_primary;
+
+	///@brief Secondary waveform, resampled onto the primary's grid and zero padded
+	std::vector<float, AlignedAllocator<float, 64> > m_secondary;
+
+	///@brief Cross-correlation at every lag (negative lags wrap around to the end)
+	std::vector<float, AlignedAllocator<float, 64> > m_correlation;
+};
+
+#endif
@@ -35,9 +35,6 @@
 #include "glscopeclient.h"
 #include "ScopeSyncWizard.h"
 #include "OscilloscopeWindow.h"
-#ifdef __x86_64__
-#include <immintrin.h>
-#endif
 
 using namespace std;
 
@@ -187,11 +184,9 @@ ScopeSyncWizard::ScopeSyncWizard(OscilloscopeWindow* parent)
 	, m_parent(parent)
 	, m_activeSetupPage(NULL)
 	, m_activeSecondaryPage(NULL)
-	, m_bestCorrelationOffset(0)
-	, m_bestCorrelation(0)
 	, m_primaryWaveform(0)
 	, m_secondaryWaveform(0)
-	, m_maxSkewSamples(0)
+	, m_maxSkew(0)
 	, m_numAverages(10)
 	, m_shuttingDown(false)
 	, m_waitingForWaveform(false)
@@ -403,14 +398,12 @@ void ScopeSyncWizard::OnWaveformDataReady()
 	m_waitingForWaveform = false;
 
 	//Set up state
-	m_bestCorrelation = -999999;
-	m_bestCorrelationOffset = 0;
 	m_primaryWaveform = pw;
 	m_secondaryWaveform = sw;
 
-	//Max allowed skew between instruments is 10K points for now (arbitrary limit)
-	m_maxSkewSamples = static_cast<int64_t>(pw->size() / 2);
-	m_maxSkewSamples = min(m_maxSkewSamples, static_cast<int64_t>(10000LL));
+	//Allow skew of up to half the primary waveform in either direction.
+	//FFT correlation costs the same no matter how many lags we check, so there's no need for a tighter limit.
+	m_maxSkew = static_cast<int64_t>(pw->size() / 2) * pw->m_timescale;
 
 	//Set the timer
 	Glib::signal_timeout().connect(sigc::mem_fun(*this, &ScopeSyncWizard::OnTimer), 1);
@@ -418,58 +411,18 @@ void ScopeSyncWizard::OnWaveformDataReady()
 
 bool ScopeSyncWizard::OnTimer()
 {
-	auto upri = dynamic_cast<UniformAnalogWaveform*>(m_primaryWaveform);
-	auto usec = dynamic_cast<UniformAnalogWaveform*>(m_secondaryWaveform);
-
-	auto spri = dynamic_cast<SparseAnalogWaveform*>(m_primaryWaveform);
-	auto ssec = dynamic_cast<SparseAnalogWaveform*>(m_secondaryWaveform);
-
-	//Optimized path (if both waveforms are dense packed)
-	if(upri && usec)
-	{
-		//If sample rates are equal we can simplify things a lot
-		if(m_primaryWaveform->m_timescale == m_secondaryWaveform->m_timescale)
-		{
-			#if defined(__x86_64__) && !defined(__clang__)
-			if(g_hasAvx512F)
-				DoProcessWaveformDensePackedEqualRateAVX512F();
-			else
-			#endif
-				DoProcessWaveformDensePackedEqualRateGeneric();
-		}
-
-		//Also special-case 2:1 sample rate ratio (primary 2x speed of secondary)
-		else if((m_primaryWaveform->m_timescale * 2) == m_secondaryWaveform->m_timescale)
-		{
-			#if defined(__x86_64__) && !defined(__clang__)
-			if(g_hasAvx512F)
-				DoProcessWaveformDensePackedDoubleRateAVX512F();
-			else
-			#endif
-				DoProcessWaveformDensePackedDoubleRateGeneric();
-		}
-
-		//Unequal sample rates, more math needed
-		else
-			DoProcessWaveformDensePackedUnequalRate();
-	}
-
-	//Fallback path (if at least one waveform is not dense packed)
-	else if(spri && ssec)
-		DoProcessWaveformSparse();
-
-	else
+	int64_t skew = 0;
+	double peak = 0;
+	if(!m_correlator.Correlate(m_primaryWaveform, m_secondaryWaveform, m_maxSkew, skew, peak))
 	{
-		LogError("Mixed sparse and uniform waveforms not implemented\n");
+		LogError("Couldn't correlate waveforms (both must be analog)\n");
 		return false;
 	}
 
 	//Collect the skew from this round
 	auto scope = m_activeSecondaryPage->GetScope();
-	int64_t skew = m_bestCorrelationOffset * m_primaryWaveform->m_timescale;
 	Unit fs(Unit::UNIT_FS);
-	LogTrace("Best correlation = %f (delta = %ld / %s)\n",
-		m_bestCorrelation, m_bestCorrelationOffset, fs.PrettyPrint(skew).c_str());
+	LogTrace("Best correlation = %f (skew = %s)\n", peak, fs.PrettyPrint(skew).c_str());
 	m_averageSkews.push_back(skew);
 
 	//Do we have additional averages to collect?
@@ -509,396 +462,6 @@ bool ScopeSyncWizard::OnTimer()
 	return false;
 }
 
-void ScopeSyncWizard::DoProcessWaveformSparse()
-{
-	//Calculate cross-correlation between the primary and secondary waveforms at up to +/- half the waveform length
-	int64_t len = m_primaryWaveform->size();
-	size_t slen = m_secondaryWaveform->size();
-
-	std::mutex cmutex;
-
-	auto ppri = dynamic_cast<SparseAnalogWaveform*>(m_primaryWaveform);
-	auto psec = dynamic_cast<SparseAnalogWaveform*>(m_secondaryWaveform);
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Convert delta from samples of the primary waveform to femtoseconds
-		int64_t deltaFs = m_primaryWaveform->m_timescale * d;
-
-		//Loop over samples in the primary waveform
-		//TODO: Can we AVX this?
-		ssize_t samplesProcessed = 0;
-		size_t isecondary = 0;
-		double correlation = 0;
-		for(size_t i=0; i<(size_t)len; i++)
-		{
-			//Timestamp of this sample, in fs
-			int64_t start = ppri->m_offsets[i] * m_primaryWaveform->m_timescale + m_primaryWaveform->m_triggerPhase;
-
-			//Target timestamp in the secondary waveform
-			int64_t target = start + deltaFs;
-
-			//If off the start of the waveform, skip it
-			if(target < 0)
-				continue;
-
-			//Skip secondary samples if the current secondary sample ends before the primary sample starts
-			bool done = false;
-			while( (((psec->m_offsets[isecondary] + psec->m_durations[isecondary]) *
-						psec->m_timescale) + psec->m_triggerPhase) < target)
-			{
-				isecondary ++;
-
-				//If off the end of the waveform, stop
-				if(isecondary >= slen)
-				{
-					done = true;
-					break;
-				}
-			}
-			if(done)
-				break;
-
-			//Do the actual cross-correlation
-			correlation += ppri->m_samples[i] * psec->m_samples[isecondary];
-			samplesProcessed ++;
-		}
-
-		double normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
-}
-
-void ScopeSyncWizard::DoProcessWaveformDensePackedDoubleRateGeneric()
-{
-	size_t len = m_primaryWaveform->size();
-	size_t slen = m_secondaryWaveform->size();
-
-	std::mutex cmutex;
-
-	int64_t phaseshift = (m_primaryWaveform->m_triggerPhase - m_secondaryWaveform->m_triggerPhase)
-		/ m_primaryWaveform->m_timescale;
-
-	float* ppri = dynamic_cast<UniformAnalogWaveform*>(m_primaryWaveform)->m_samples.GetCpuPointer();
-	float* psec = dynamic_cast<UniformAnalogWaveform*>(m_secondaryWaveform)->m_samples.GetCpuPointer();
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Shift by relative trigger phase
-		int64_t delta = d + phaseshift;
-
-		size_t end = 2*(slen - delta);
-		end = min(end, len);
-
-		//Loop over samples in the primary waveform
-		ssize_t samplesProcessed = 0;
-		double correlation = 0;
-		for(size_t i=0; i<end; i++)
-		{
-			//If off the start of the waveform, skip it
-			if(((int64_t)i + delta) < 0)
-				continue;
-
-			uint64_t utarget = ((i  + delta) / 2);
-
-			//Do the actual cross-correlation
-			correlation += ppri[i] * psec[utarget];
-			samplesProcessed ++;
-		}
-
-		double normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
-}
-
-#if defined(__x86_64__) && !defined(__clang__)
-__attribute__((target("avx512f")))
-void ScopeSyncWizard::DoProcessWaveformDensePackedDoubleRateAVX512F()
-{
-	size_t len = m_primaryWaveform->size();
-	size_t slen = m_secondaryWaveform->size();
-
-	//Number of samples actually being processed
-	//(in this application it's OK to truncate w/o a scalar implementation at the end)
-	size_t len_rounded = len - (len % 32);
-	size_t slen_rounded = slen - (slen % 32);
-
-	std::mutex cmutex;
-
-	int64_t phaseshift = (m_primaryWaveform->m_triggerPhase - m_secondaryWaveform->m_triggerPhase)
-		/ m_primaryWaveform->m_timescale;
-
-	m_primaryWaveform->PrepareForCpuAccess();
-	m_secondaryWaveform->PrepareForCpuAccess();
-	float* ppri = dynamic_cast<UniformAnalogWaveform*>(m_primaryWaveform)->m_samples.GetCpuPointer();
-	float* psec = dynamic_cast<UniformAnalogWaveform*>(m_secondaryWaveform)->m_samples.GetCpuPointer();
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Shift by relative trigger phase
-		int64_t delta = d + phaseshift;
-
-		size_t end = 2*(slen_rounded - delta);
-		end = min(end, len_rounded);
-
-		//Loop over samples in the primary waveform
-		ssize_t samplesProcessed = 0;
-		__m512 vcorrelation = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-		__m512i perm0 = _mm512_set_epi32(7, 7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0, 0);
-		__m512i perm1 = _mm512_set_epi32(15, 15, 14, 14, 13, 13, 12, 12, 11, 11, 10, 10, 9, 9, 8, 8);
-		for(size_t i=0; i<end; i+= 32)
-		{
-			//If off the start of the waveform, skip it
-			if(((int64_t)i + delta) < 0)
-				continue;
-
-			//Primary waveform is easy
-			__m512 pri1 = _mm512_loadu_ps(ppri + i);
-			__m512 pri2 = _mm512_loadu_ps(ppri + i + 16);
-
-			uint64_t utarget = ((i  + delta) / 2);
-
-			//Secondary waveform is more work since we have to shuffle the samples
-			__m512 sec = _mm512_loadu_ps(psec + utarget);
-			__m512 sec1 = _mm512_permutexvar_ps(perm0, sec);
-			__m512 sec2 = _mm512_permutexvar_ps(perm1, sec);
-
-			//Do the actual cross-correlation
-			vcorrelation = _mm512_fmadd_ps(pri1, sec1, vcorrelation);
-			vcorrelation = _mm512_fmadd_ps(pri2, sec2, vcorrelation);
-
-			samplesProcessed += 32;
-		}
-
-		//Horizontal add the output
-		//(outside the inner loop, no need to bother vectorizing this)
-		float vec[16];
-		_mm512_storeu_ps(vec, vcorrelation);
-		float correlation = 0;
-		for(int i=0; i<16; i++)
-			correlation += vec[i];
-
-		float normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
-}
-#endif /* __x86_64__ && !__clang__*/
-
-void ScopeSyncWizard::DoProcessWaveformDensePackedEqualRateGeneric()
-{
-	int64_t len = m_primaryWaveform->size();
-	size_t slen = m_secondaryWaveform->size();
-
-	std::mutex cmutex;
-
-	int64_t phaseshift =
-		(m_primaryWaveform->m_triggerPhase - m_secondaryWaveform->m_triggerPhase) /
-		m_primaryWaveform->m_timescale;
-
-	float* ppri = dynamic_cast<UniformAnalogWaveform*>(m_primaryWaveform)->m_samples.GetCpuPointer();
-	float* psec = dynamic_cast<UniformAnalogWaveform*>(m_secondaryWaveform)->m_samples.GetCpuPointer();
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Shift by relative trigger phase
-		int64_t delta = d + phaseshift;
-
-		//Loop over samples in the primary waveform
-		ssize_t samplesProcessed = 0;
-		double correlation = 0;
-		for(size_t i=0; i<(size_t)len; i++)
-		{
-			//Target timestamp in the secondary waveform
-			int64_t target = i + delta;
-
-			//If off the start of the waveform, skip it
-			if(target < 0)
-				continue;
-
-			//If off the end of the waveform, stop
-			uint64_t utarget = target;
-			if(utarget >= slen)
-				break;
-
-			//Do the actual cross-correlation
-			correlation += ppri[i] * psec[utarget];
-			samplesProcessed ++;
-		}
-
-		double normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
-}
-
-#if defined(__x86_64__) && !defined(__clang__)
-__attribute__((target("avx512f")))
-void ScopeSyncWizard::DoProcessWaveformDensePackedEqualRateAVX512F()
-{
-	size_t len = m_primaryWaveform->size();
-	size_t slen = m_secondaryWaveform->size();
-
-	//Number of samples actually being processed
-	//(in this application it's OK to truncate w/o a scalar implementation at the end)
-	size_t len_rounded = len - (len % 16);
-	size_t slen_rounded = slen - (slen % 16);
-
-	std::mutex cmutex;
-
-	int64_t phaseshift =
-		(m_primaryWaveform->m_triggerPhase - m_secondaryWaveform->m_triggerPhase) /
-		m_primaryWaveform->m_timescale;
-
-	m_primaryWaveform->PrepareForCpuAccess();
-	m_secondaryWaveform->PrepareForCpuAccess();
-	float* ppri = dynamic_cast<UniformAnalogWaveform*>(m_primaryWaveform)->m_samples.GetCpuPointer();
-	float* psec = dynamic_cast<UniformAnalogWaveform*>(m_secondaryWaveform)->m_samples.GetCpuPointer();
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Shift by relative trigger phase
-		int64_t delta = d + phaseshift;
-
-		size_t end = slen_rounded - delta;
-		end = min(end, len_rounded);
-
-		//Loop over samples in the primary waveform
-		ssize_t samplesProcessed = 0;
-		__m512 vcorrelation = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-		for(size_t i=0; i<end; i += 16)
-		{
-			//If off the start of the waveform, skip it
-			if((int64_t)i + delta < 0)
-				continue;
-
-			samplesProcessed += 16;
-
-			//Do the actual cross-correlation
-			__m512 pri = _mm512_loadu_ps(ppri + i);
-			__m512 sec = _mm512_loadu_ps(psec + i + delta);
-			vcorrelation = _mm512_fmadd_ps(pri, sec, vcorrelation);
-		}
-
-		//Horizontal add the output
-		//(outside the inner loop, no need to bother vectorizing this)
-		float vec[16];
-		_mm512_storeu_ps(vec, vcorrelation);
-		float correlation = 0;
-		for(int i=0; i<16; i++)
-			correlation += vec[i];
-
-		float normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
-}
-#endif /* __x86_64__ && !__clang__*/
-
-void ScopeSyncWizard::DoProcessWaveformDensePackedUnequalRate()
-{
-	int64_t len = m_primaryWaveform->size();
-	size_t slen = m_secondaryWaveform->size();
-
-	auto ppri = dynamic_cast<UniformAnalogWaveform*>(m_primaryWaveform);
-	auto psec = dynamic_cast<UniformAnalogWaveform*>(m_secondaryWaveform);
-
-	std::mutex cmutex;
-
-	#pragma omp parallel for
-	for(int64_t d = -m_maxSkewSamples; d < m_maxSkewSamples; d ++)
-	{
-		//Convert delta from samples of the primary waveform to femtoseconds
-		int64_t deltaFs = m_primaryWaveform->m_timescale * d;
-
-		//Shift by relative trigger phase
-		deltaFs += (m_primaryWaveform->m_triggerPhase - m_secondaryWaveform->m_triggerPhase);
-
-		//Loop over samples in the primary waveform
-		ssize_t samplesProcessed = 0;
-		size_t isecondary = 0;
-		double correlation = 0;
-		for(size_t i=0; i<(size_t)len; i++)
-		{
-			//Target timestamp in the secondary waveform
-			int64_t target = i * m_primaryWaveform->m_timescale + deltaFs;
-
-			//If off the start of the waveform, skip it
-			if(target < 0)
-				continue;
-
-			uint64_t utarget = target;
-
-			//Skip secondary samples if the current secondary sample ends before the primary sample starts
-			bool done = false;
-			while( ((isecondary + 1) *	m_secondaryWaveform->m_timescale) < utarget)
-			{
-				isecondary ++;
-
-				//If off the end of the waveform, stop
-				if(isecondary >= slen)
-				{
-					done = true;
-					break;
-				}
-			}
-			if(done)
-				break;
-
-			//Do the actual cross-correlation
-			correlation += ppri->m_samples[i] * psec->m_samples[isecondary];
-			samplesProcessed ++;
-		}
-
-		double normalizedCorrelation = correlation / samplesProcessed;
-
-		//Update correlation
-		lock_guard<mutex> lock(cmutex);
-		if(normalizedCorrelation > m_bestCorrelation)
-		{
-			m_bestCorrelation = normalizedCorrelation;
-			m_bestCorrelationOffset = d;
-		}
-	}
-}
-
 bool ScopeSyncWizard::OnWaveformTimeout()
 {
 	if(!m_waitingForWaveform)
@@ -36,6 +36,8 @@
 #ifndef ScopeSyncWizard_h
 #define ScopeSyncWizard_h
 
+#include "../common/DeskewCorrelator.h"
+
 class OscilloscopeWindow;
 
 class ScopeSyncDeskewWelcomePage
@@ -129,25 +131,13 @@ protected:
 
 	bool OnTimer();
 
-	void DoProcessWaveformDensePackedEqualRateGeneric();
-#if defined(__x86_64__) && !defined(__clang__)
-	void DoProcessWaveformDensePackedEqualRateAVX512F();
-#endif
-	void DoProcessWaveformDensePackedDoubleRateGeneric();
-#if defined(__x86_64__) && !defined(__clang__)
-	void DoProcessWaveformDensePackedDoubleRateAVX512F();
-#endif
-	void DoProcessWaveformDensePackedUnequalRate();
-	void DoProcessWaveformSparse();
-
 	//Cross-correlation
 	ScopeSyncDeskewSetupPage* m_activeSetupPage;
 	ScopeSyncDeskewProgressPage* m_activeSecondaryPage;
-	int64_t m_bestCorrelationOffset;
-	double m_bestCorrelation;
 	WaveformBase* m_primaryWaveform;
 	WaveformBase* m_secondaryWaveform;
-	int64_t m_maxSkewSamples;
+	int64_t m_maxSkew;
+	DeskewCorrelator m_correlator;
 	std::vector<int64_t> m_averageSkews;
 	size_t m_numAverages;
 	bool m_shuttingDown;
@@ -0,0 +1,167 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of ComputePipelinePool
+ */
+#include "ngscopeclient.h"
+#include "ComputePipelinePool.h"
+
+using namespace std;
+
+ComputePipelinePool g_computePipelinePool;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+ComputePipelinePool::ComputePipelinePool()
+	: m_state(make_shared<State>())
+{
+}
+
+ComputePipelinePool::~ComputePipelinePool()
+{
+	Clear();
+}
+
+/**
+	@brief Destroys all idle pipelines
+
+	Must be called before the Vulkan device is torn down, once all rendering passes have completed. Pipelines still in
+	use when this is called are destroyed by their owners as usual.
+ */
+void ComputePipelinePool::Clear()
+{
+	lock_guard<mutex> lock(m_state->m_mutex);
+	m_state->m_idle.clear();
+	m_state->m_pending.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Accessors
+
+/**
+	@brief Gets a pipeline for the requested shader variant, reusing an idle one if possible
+
+	The returned pipeline goes back to the pool when the last reference to it is dropped.
+ */
+shared_ptr<ComputePipeline> ComputePipelinePool::Get(const ComputePipelineKey& key)
+{
+	unique_ptr<ComputePipeline> pipe;
+	{
+		lock_guard<mutex> lock(m_state->m_mutex);
+		auto& idle = m_state->m_idle[key];
+		if(!idle.empty())
+		{
+			pipe = move(idle.back());
+			idle.pop_back();
+			m_state->m_reused ++;
+		}
+		else
+			m_state->m_created ++;
+	}
+
+	if(!pipe)
+	{
+		LogTrace("Creating compute pipeline for %s\n", key.m_shaderPath.c_str());
+		pipe = make_unique<ComputePipeline>(
+			key.m_shaderPath, key.m_numSSBOs, key.m_pushConstantSize, key.m_numStorageImages);
+	}
+
+	//Return to the pool when done, unless the pool was destroyed in the meantime
+	weak_ptr<State> wstate = m_state;
+	return shared_ptr<ComputePipeline>(pipe.release(), [wstate, key](ComputePipeline* p)
+		{
+			auto state = wstate.lock();
+			if(!state)
+			{
+				delete p;
+				return;
+			}
+
+			//The pass being recorded (if any) is the one after the last submitted
+			lock_guard<mutex> lock(state->m_mutex);
+			state->m_pending.emplace_back(key, state->m_lastSubmittedPass + 1, p);
+		});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rendering pass tracking
+
+/**
+	@brief Records that a rendering pass was submitted
+
+	Called by WaveformRenderRing.
+
+	@param pass	Sequence number of the pass
+ */
+void ComputePipelinePool::OnPassSubmitted(uint64_t pass)
+{
+	lock_guard<mutex> lock(m_state->m_mutex);
+	m_state->m_lastSubmittedPass = pass;
+}
+
+/**
+	@brief Records that a rendering pass (and every pass before it) has completed, so pipelines returned before it was
+	recorded can be reused
+
+	Called by WaveformRenderRing, which retires passes in order.
+
+	@param pass	Sequence number of the pass
+ */
+void ComputePipelinePool::OnPassRetired(uint64_t pass)
+{
+	lock_guard<mutex> lock(m_state->m_mutex);
+
+	auto& pending = m_state->m_pending;
+	size_t i = 0;
+	for(; (i < pending.size()) && (pending[i].m_pass <= pass); i++)
+		m_state->m_idle[pending[i].m_key].push_back(move(pending[i].m_pipe));
+	pending.erase(pending.begin(), pending.begin() + i);
+}
+
+/**
+	@brief Returns the number of pipelines created since startup
+ */
+size_t ComputePipelinePool::GetCreatedCount()
+{
+	lock_guard<mutex> lock(m_state->m_mutex);
+	return m_state->m_created;
+}
+
+/**
+	@brief Returns the number of pipeline requests satisfied by reusing an idle pipeline since startup
+ */
+size_t ComputePipelinePool::GetReusedCount()
+{
+	lock_guard<mutex> lock(m_state->m_mutex);
+	return m_state->m_reused;
+}
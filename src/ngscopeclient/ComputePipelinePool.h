@@ -0,0 +1,153 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of ComputePipelinePool
+ */
+#ifndef ComputePipelinePool_h
+#define ComputePipelinePool_h
+
+/**
+	@brief Identifies a compute shader variant and the layout of its pipeline
+ */
+class ComputePipelineKey
+{
+public:
+	ComputePipelineKey(
+		const std::string& shaderPath,
+		size_t numSSBOs,
+		size_t pushConstantSize,
+		size_t numStorageImages = 0)
+	: m_shaderPath(shaderPath)
+	, m_numSSBOs(numSSBOs)
+	, m_pushConstantSize(pushConstantSize)
+	, m_numStorageImages(numStorageImages)
+	{}
+
+	bool operator<(const ComputePipelineKey& rhs) const
+	{
+		return
+			std::tie(m_shaderPath, m_numSSBOs, m_pushConstantSize, m_numStorageImages) <
+			std::tie(rhs.m_shaderPath, rhs.m_numSSBOs, rhs.m_pushConstantSize, rhs.m_numStorageImages);
+	}
+
+	std::string m_shaderPath;
+	size_t m_numSSBOs;
+	size_t m_pushConstantSize;
+	size_t m_numStorageImages;
+};
+
+/**
+	@brief Process-wide pool of compute pipelines, so they are built once rather than by every channel that needs them
+
+	A ComputePipeline carries its own descriptor bindings, so it can only be used by one owner at a time. Instead of
+	being destroyed when the owner goes away, pipelines are returned to the pool and handed out again to the next
+	owner asking for the same variant. Adding, removing or re-adding channels then doesn't load or compile anything.
+
+	Pipelines are returned when the last reference is dropped, but rendering passes recorded earlier may still be using
+	them. WaveformRenderRing reports each pass as it's submitted and retired, and returned pipelines are only handed out
+	again once every pass which could have used them has been retired.
+ */
+class ComputePipelinePool
+{
+public:
+	ComputePipelinePool();
+	~ComputePipelinePool();
+
+	std::shared_ptr<ComputePipeline> Get(const ComputePipelineKey& key);
+
+	void Clear();
+
+	size_t GetCreatedCount();
+	size_t GetReusedCount();
+
+	void OnPassSubmitted(uint64_t pass);
+	void OnPassRetired(uint64_t pass);
+
+protected:
+
+	/**
+		@brief A pipeline returned to the pool which rendering passes in flight may still be using
+	 */
+	class PendingPipeline
+	{
+	public:
+		PendingPipeline(const ComputePipelineKey& key, uint64_t pass, ComputePipeline* pipe)
+		: m_key(key)
+		, m_pass(pass)
+		, m_pipe(pipe)
+		{}
+
+		ComputePipelineKey m_key;
+
+		///@brief The last rendering pass which may be using the pipeline
+		uint64_t m_pass;
+
+		std::unique_ptr<ComputePipeline> m_pipe;
+	};
+
+	/**
+		@brief State shared with the deleters of the pipelines we hand out, so they can tell if the pool is gone
+	 */
+	class State
+	{
+	public:
+		State()
+		: m_created(0)
+		, m_reused(0)
+		, m_lastSubmittedPass(0)
+		{}
+
+		///@brief Mutex protecting everything else
+		std::mutex m_mutex;
+
+		///@brief Pipelines not currently owned by anyone, by variant
+		std::map<ComputePipelineKey, std::vector<std::unique_ptr<ComputePipeline> > > m_idle;
+
+		///@brief Number of pipelines created since startup
+		size_t m_created;
+
+		///@brief Number of requests satisfied from m_idle since startup
+		size_t m_reused;
+
+		///@brief Pipelines returned while passes which may use them were in flight, oldest first
+		std::vector<PendingPipeline> m_pending;
+
+		///@brief Sequence number of the last rendering pass submitted
+		uint64_t m_lastSubmittedPass;
+	};
+
+	std::shared_ptr<State> m_state;
+};
+
+extern ComputePipelinePool g_computePipelinePool;
+
+#endif
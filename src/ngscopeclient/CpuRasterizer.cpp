@@ -0,0 +1,444 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of CpuRasterizer
+ */
+#include "ngscopeclient.h"
+#include "CpuRasterizer.h"
+#include "WaveformArea.h"
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//Number of columns each thread draws at a time
+static const size_t COLS_PER_BLOCK = 16;
+
+//Number of samples processed for a column that is entirely before the waveform (same as the shader)
+static const uint32_t EMPTY_COLUMN_SAMPLES = 64;
+
+/**
+	@brief Raw sample data for one waveform, in the same form the shader sees it
+ */
+struct CpuRasterizerInput
+{
+	const float* m_analog;
+	const bool* m_digital;
+	const int64_t* m_offsets;
+	const int64_t* m_durations;
+	bool m_zeroHold;
+};
+
+/**
+	@brief Fetches the X position of a sample, in pixels
+ */
+static inline float FetchX(const CpuRasterizerInput& in, const ConfigPushConstants& config, uint32_t i)
+{
+	int64_t ticks = in.m_offsets ? in.m_offsets[i] : int64_t(i);
+	return float(ticks + config.innerXoff) * config.xscale + config.xoff;
+}
+
+/**
+	@brief Fetches the Y position of a sample, in pixels
+ */
+static inline float FetchY(const CpuRasterizerInput& in, const ConfigPushConstants& config, uint32_t i)
+{
+	if(in.m_analog)
+		return (in.m_analog[i] + config.yoff) * config.yscale + config.ybase;
+	else
+		return in.m_digital[i] * config.yscale + config.ybase;
+}
+
+/**
+	@brief Calculates the vertical span drawn by sample i within the pixel column starting at x
+
+	Same as GetSampleSpan() in waveform-compute.glsl.
+ */
+static inline bool GetSampleSpan(
+	const CpuRasterizerInput& in,
+	const ConfigPushConstants& config,
+	uint32_t i,
+	float x,
+	float& starty,
+	float& endy,
+	bool& last)
+{
+	float leftx = FetchX(in, config, i);
+	float lefty = FetchY(in, config, i);
+	float rightx;
+	float righty;
+	if(in.m_zeroHold)
+	{
+		float duration = in.m_durations ? float(in.m_durations[i]) : 1;
+		rightx = leftx + duration * config.xscale;
+		righty = lefty;
+	}
+	else
+	{
+		rightx = FetchX(in, config, i+1);
+		righty = FetchY(in, config, i+1);
+	}
+
+	//Check if we're at the end of the pixel
+	last = (rightx > x + 1);
+
+	//Skip offscreen samples
+	starty = 0;
+	endy = 0;
+	if( (rightx < x) || (leftx > x + 1) )
+		return false;
+
+	starty = lefty;
+	endy = righty;
+
+	if(in.m_analog)
+	{
+		//Interpolate analog signals if either end is outside our column
+		if(!in.m_zeroHold)
+		{
+			float slope = (righty - lefty) / (rightx - leftx);
+			if(leftx < x)
+				starty = lefty + (x - leftx) * slope;
+			if(rightx > x + 1)
+				endy = lefty + (x + 1 - leftx) * slope;
+		}
+	}
+
+	//Draw a vertical line if we are very near the right edge, otherwise a single pixel
+	else if(fabs(rightx - x) > 1)
+		endy = lefty;
+
+	return true;
+}
+
+/**
+	@brief Adds one hit to every row of a column covered by a span, clipping to the window
+ */
+static inline void DrawSpan(float* col, float starty, float endy, uint32_t height)
+{
+	//If start and end are both off screen, nothing to draw
+	if( ( (starty < 0) && (endy < 0) ) || ( (starty >= height) && (endy >= height) ) )
+		return;
+
+	starty = max(min(starty, height - 1.0f), 0.0f);
+	endy = max(min(endy, height - 1.0f), 0.0f);
+
+	int ymax = int(max(starty, endy));
+	for(int y = int(min(starty, endy)); y <= ymax; y++)
+		col[y] += 1;
+}
+
+/**
+	@brief Draws samples [i, ilimit) into the column starting at x, stopping after the first sample that ends past it
+ */
+static void RasterizeColumnGeneric(
+	const CpuRasterizerInput& in,
+	const ConfigPushConstants& config,
+	float* col,
+	uint32_t x,
+	uint32_t i,
+	uint32_t ilimit)
+{
+	for(; i < ilimit; i++)
+	{
+		float starty;
+		float endy;
+		bool last;
+		if(GetSampleSpan(in, config, i, x, starty, endy, last))
+			DrawSpan(col, starty, endy, config.windowHeight);
+		if(last)
+			break;
+	}
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+/**
+	@brief AVX2 version of RasterizeColumnGeneric() for interpolated dense analog waveforms
+
+	Sample timestamps (i + innerXoff) must fit in an int32.
+ */
+__attribute__((target("avx2")))
+static void RasterizeColumnDenseAnalogAVX2(
+	const CpuRasterizerInput& in,
+	const ConfigPushConstants& config,
+	float* col,
+	uint32_t x,
+	uint32_t i,
+	uint32_t ilimit)
+{
+	float fx = x;
+	__m256 vx = _mm256_set1_ps(fx);
+	__m256 vx1 = _mm256_set1_ps(fx + 1);
+	__m256 xscale = _mm256_set1_ps(config.xscale);
+	__m256 xoff = _mm256_set1_ps(config.xoff);
+	__m256 yscale = _mm256_set1_ps(config.yscale);
+	__m256 yoff = _mm256_set1_ps(config.yoff);
+	__m256 ybase = _mm256_set1_ps(config.ybase);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 height = _mm256_set1_ps(config.windowHeight);
+	__m256 ymaxClip = _mm256_set1_ps(config.windowHeight - 1.0f);
+	__m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i one = _mm256_set1_epi32(1);
+
+	int32_t ymins[8] __attribute__((aligned(32)));
+	int32_t ymaxs[8] __attribute__((aligned(32)));
+
+	for(; (i < ilimit) && (ilimit - i >= 8); i += 8)
+	{
+		//Same arithmetic as GetSampleSpan(), eight samples at a time
+		__m256i ticks = _mm256_add_epi32(_mm256_set1_epi32(int32_t(i + config.innerXoff)), lanes);
+		__m256 leftx = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(ticks), xscale), xoff);
+		__m256 rightx = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(ticks, one)), xscale), xoff);
+		__m256 lefty = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(in.m_analog + i), yoff), yscale), ybase);
+		__m256 righty = _mm256_add_ps(
+			_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(in.m_analog + i + 1), yoff), yscale), ybase);
+
+		__m256 slope = _mm256_div_ps(_mm256_sub_ps(righty, lefty), _mm256_sub_ps(rightx, leftx));
+		__m256 starty = _mm256_blendv_ps(
+			lefty,
+			_mm256_add_ps(lefty, _mm256_mul_ps(_mm256_sub_ps(vx, leftx), slope)),
+			_mm256_cmp_ps(leftx, vx, _CMP_LT_OQ));
+		__m256 lastMask = _mm256_cmp_ps(rightx, vx1, _CMP_GT_OQ);
+		__m256 endy = _mm256_blendv_ps(
+			righty,
+			_mm256_add_ps(lefty, _mm256_mul_ps(_mm256_sub_ps(vx1, leftx), slope)),
+			lastMask);
+
+		//Samples that touch the column and are at least partly on screen
+		__m256 hit = _mm256_and_ps(
+			_mm256_cmp_ps(rightx, vx, _CMP_GE_OQ),
+			_mm256_cmp_ps(leftx, vx1, _CMP_LE_OQ));
+		__m256 below = _mm256_and_ps(_mm256_cmp_ps(starty, zero, _CMP_LT_OQ), _mm256_cmp_ps(endy, zero, _CMP_LT_OQ));
+		__m256 above = _mm256_and_ps(
+			_mm256_cmp_ps(starty, height, _CMP_GE_OQ),
+			_mm256_cmp_ps(endy, height, _CMP_GE_OQ));
+		int drawMask = _mm256_movemask_ps(_mm256_andnot_ps(_mm256_or_ps(below, above), hit));
+		int lastBits = _mm256_movemask_ps(lastMask);
+
+		//Clip to the window and sort
+		starty = _mm256_max_ps(_mm256_min_ps(starty, ymaxClip), zero);
+		endy = _mm256_max_ps(_mm256_min_ps(endy, ymaxClip), zero);
+		_mm256_store_si256((__m256i*)ymins, _mm256_cvttps_epi32(_mm256_min_ps(starty, endy)));
+		_mm256_store_si256((__m256i*)ymaxs, _mm256_cvttps_epi32(_mm256_max_ps(starty, endy)));
+
+		for(int lane=0; lane<8; lane++)
+		{
+			if(drawMask & (1 << lane))
+			{
+				for(int y = ymins[lane]; y <= ymaxs[lane]; y++)
+					col[y] += 1;
+			}
+
+			if(lastBits & (1 << lane))
+				return;
+		}
+	}
+
+	RasterizeColumnGeneric(in, config, col, x, i, ilimit);
+}
+#endif /* __x86_64__ && !__clang__ */
+
+/**
+	@brief Rasterizes an analog or digital waveform into a hit density histogram
+
+	@param out		Output buffer, windowWidth * windowHeight floats, row major
+	@param config	Same configuration as passed to the shader
+	@param data		The waveform to draw. Must be a uniform or sparse analog or digital waveform.
+	@param xind		Index of the first sample in each column (only used for sparse waveforms)
+	@param zeroHold	True to draw analog samples as flat lines rather than interpolating between them
+	@param parallel	True to split the columns across OpenMP threads. False if the caller already runs in parallel
+					with other rendering threads, to avoid nesting parallel regions.
+ */
+void CpuRasterizer::Rasterize(
+	float* out,
+	const ConfigPushConstants& config,
+	WaveformBase* data,
+	const uint32_t* xind,
+	bool zeroHold,
+	bool parallel)
+{
+	auto uadata = dynamic_cast<UniformAnalogWaveform*>(data);
+	auto sadata = dynamic_cast<SparseAnalogWaveform*>(data);
+	auto uddata = dynamic_cast<UniformDigitalWaveform*>(data);
+	auto sddata = dynamic_cast<SparseDigitalWaveform*>(data);
+	auto sdata = dynamic_cast<SparseWaveformBase*>(data);
+
+	//Get CPU-side pointers to everything we need
+	CpuRasterizerInput in;
+	in.m_analog = nullptr;
+	in.m_digital = nullptr;
+	in.m_offsets = nullptr;
+	in.m_durations = nullptr;
+	in.m_zeroHold = zeroHold;
+	if(uadata)
+	{
+		uadata->m_samples.PrepareForCpuAccess();
+		in.m_analog = uadata->m_samples.GetCpuPointer();
+	}
+	else if(sadata)
+	{
+		sadata->m_samples.PrepareForCpuAccess();
+		in.m_analog = sadata->m_samples.GetCpuPointer();
+	}
+	else if(uddata)
+	{
+		uddata->m_samples.PrepareForCpuAccess();
+		in.m_digital = uddata->m_samples.GetCpuPointer();
+	}
+	else if(sddata)
+	{
+		sddata->m_samples.PrepareForCpuAccess();
+		in.m_digital = sddata->m_samples.GetCpuPointer();
+	}
+	else
+		return;
+	if(sdata)
+	{
+		sdata->m_offsets.PrepareForCpuAccess();
+		in.m_offsets = sdata->m_offsets.GetCpuPointer();
+		if(zeroHold)
+		{
+			sdata->m_durations.PrepareForCpuAccess();
+			in.m_durations = sdata->m_durations.GetCpuPointer();
+		}
+	}
+
+	size_t w = config.windowWidth;
+	size_t h = config.windowHeight;
+	if( (w == 0) || (h == 0) )
+		return;
+	uint32_t addtlSamples = zeroHold ? 0 : 1;
+	if(config.memDepth < (1 + addtlSamples))
+	{
+		memset(out, 0, w * h * sizeof(float));
+		return;
+	}
+	uint32_t depthLimit = config.memDepth - addtlSamples;
+
+	//The vector path converts sample timestamps to float as int32s, so everything has to fit in one
+	bool vectorize = false;
+	#if defined(__x86_64__) && !defined(__clang__)
+		vectorize = g_hasAvx2 && uadata && !zeroHold &&
+			(config.innerXoff >= INT32_MIN) && ((config.innerXoff + config.memDepth) <= INT32_MAX);
+	#endif
+
+	size_t nblocks = (w + COLS_PER_BLOCK - 1) / COLS_PER_BLOCK;
+
+	#pragma omp parallel if(parallel)
+	{
+		//Each column is drawn contiguously, then the block is transposed into the output a row at a time
+		vector<float> tile(COLS_PER_BLOCK * h);
+
+		#pragma omp for
+		for(size_t block=0; block<nblocks; block++)
+		{
+			size_t xstart = block * COLS_PER_BLOCK;
+			size_t ncols = min(COLS_PER_BLOCK, w - xstart);
+			memset(&tile[0], 0, tile.size() * sizeof(float));
+
+			for(size_t c=0; c<ncols; c++)
+			{
+				uint32_t x = xstart + c;
+				float* col = &tile[c*h];
+
+				//Find the samples in this column (same as the shader, including unsigned wraparound)
+				uint32_t istart;
+				bool empty = false;
+				if(sdata)
+				{
+					istart = xind[x];
+					if( (x + 1) < w)
+						empty = (xind[x + 1] == 0);
+				}
+				else
+				{
+					istart = uint32_t(floor(float(x) / config.xscale)) + config.offset_samples;
+					empty = (uint32_t(floor(float(x + 1) / config.xscale)) + config.offset_samples) == 0;
+				}
+				uint32_t ilimit = depthLimit;
+				if(empty)
+					ilimit = min(ilimit, istart + EMPTY_COLUMN_SAMPLES);
+
+				#if defined(__x86_64__) && !defined(__clang__)
+					if(vectorize)
+					{
+						RasterizeColumnDenseAnalogAVX2(in, config, col, x, istart, ilimit);
+						continue;
+					}
+				#endif
+				RasterizeColumnGeneric(in, config, col, x, istart, ilimit);
+			}
+
+			for(size_t y=0; y<h; y++)
+			{
+				float* row = out + y*w + xstart;
+				for(size_t c=0; c<ncols; c++)
+					row[c] = tile[c*h + y];
+			}
+		}
+	}
+}
+
+/**
+	@brief Checks that a rasterized histogram matches a reference to within floating point rounding
+
+	Rounding can move the end of a span by one row, which changes one pixel by one hit. The output is accepted if no
+	pixel differs from the reference by more than MAX_HIT_DIFFERENCE hits, and no more than MAX_MISMATCH_PPM parts per
+	million of the pixels differ at all.
+
+	@param out			The output to check
+	@param ref			The reference output
+	@param len			Number of pixels in each
+	@param mismatches	Number of pixels which differ at all
+
+	@return True if the output is within tolerance
+ */
+bool CpuRasterizer::IsWithinTolerance(const float* out, const float* ref, size_t len, size_t& mismatches)
+{
+	bool ok = true;
+	mismatches = 0;
+	for(size_t i=0; i<len; i++)
+	{
+		float delta = fabs(out[i] - ref[i]);
+		if(delta == 0)
+			continue;
+
+		mismatches ++;
+		if(delta > MAX_HIT_DIFFERENCE)
+			ok = false;
+	}
+
+	if(mismatches * 1000000 > len * MAX_MISMATCH_PPM)
+		ok = false;
+	return ok;
+}
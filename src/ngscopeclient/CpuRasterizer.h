@@ -0,0 +1,69 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of CpuRasterizer
+ */
+#ifndef CpuRasterizer_h
+#define CpuRasterizer_h
+
+struct ConfigPushConstants;
+
+/**
+	@brief Native implementation of the analog and digital waveform rasterizers in waveform-compute.glsl
+
+	Used for channels that opt out of GPU rasterization (software Vulkan implementations run the compute shaders very
+	slowly), and as a reference for checking changes to the shaders.
+
+	The output is the same hit density histogram the shader writes to its outval buffer, and should match it to within
+	floating point rounding (which can move the end of a span by one pixel, see IsWithinTolerance()).
+ */
+class CpuRasterizer
+{
+public:
+	static void Rasterize(
+		float* out,
+		const ConfigPushConstants& config,
+		WaveformBase* data,
+		const uint32_t* xind,
+		bool zeroHold,
+		bool parallel);
+
+	static bool IsWithinTolerance(const float* out, const float* ref, size_t len, size_t& mismatches);
+
+	///@brief Most hits a pixel may differ from the reference by (one span end moving by one row)
+	static const uint32_t MAX_HIT_DIFFERENCE = 1;
+
+	///@brief Most pixels which may differ from the reference at all, in parts per million
+	static const size_t MAX_MISMATCH_PPM = 10000;
+};
+
+#endif
@@ -0,0 +1,208 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of DeskewTracker
+ */
+
+#include "ngscopeclient.h"
+#include "DeskewTracker.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+DeskewTracker::DeskewTracker()
+	: m_enabled(false)
+	, m_interval(10)
+	, m_gain(0.25)
+	, m_minPeak(0.5)
+	, m_count(0)
+{
+}
+
+DeskewTracker::~DeskewTracker()
+{
+	Clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Configuration
+
+/**
+	@brief Sets the reference stream of an instrument
+
+	@param scope	The instrument
+	@param stream	Analog stream connected to the shared reference signal, or a null stream to stop using one
+ */
+void DeskewTracker::SetReference(Oscilloscope* scope, StreamDescriptor stream)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	auto it = m_references.find(scope);
+	if(it != m_references.end())
+	{
+		it->second.m_channel->Release();
+		m_references.erase(it);
+	}
+
+	if(stream)
+	{
+		stream.m_channel->AddRef();
+		m_references.emplace(scope, stream);
+	}
+}
+
+/**
+	@brief Gets the reference stream of an instrument, or a null stream if there isn't one
+ */
+StreamDescriptor DeskewTracker::GetReference(Oscilloscope* scope)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	auto it = m_references.find(scope);
+	if(it == m_references.end())
+		return StreamDescriptor(nullptr, 0);
+	return it->second;
+}
+
+/**
+	@brief Drops all reference streams and history
+
+	Must be called before the instruments are deleted.
+ */
+void DeskewTracker::Clear()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		for(auto it : m_references)
+			it.second.m_channel->Release();
+		m_references.clear();
+		m_count = 0;
+	}
+
+	ClearLog();
+}
+
+/**
+	@brief Forgets all past measurements
+ */
+void DeskewTracker::ClearLog()
+{
+	lock_guard<mutex> lock(m_logMutex);
+	m_log.clear();
+}
+
+/**
+	@brief Gets a copy of the measurement history of a secondary instrument
+ */
+vector<DriftSample> DeskewTracker::GetLog(Oscilloscope* scope)
+{
+	lock_guard<mutex> lock(m_logMutex);
+
+	auto it = m_log.find(scope);
+	if(it == m_log.end())
+		return {};
+	return vector<DriftSample>(it->second.begin(), it->second.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tracking
+
+/**
+	@brief Measures and corrects drift if it's time to do so
+
+	Call on WaveformThread once the waveforms from every instrument have been downloaded and deskewed.
+
+	@param scopes	All instruments, primary first
+	@param deskew	Deskew coefficients of the secondary instruments, updated in place
+ */
+void DeskewTracker::Update(const vector<Oscilloscope*>& scopes, map<Oscilloscope*, int64_t>& deskew)
+{
+	if(!m_enabled || (scopes.size() < 2) )
+		return;
+
+	m_count ++;
+	if(m_count < m_interval)
+		return;
+	m_count = 0;
+
+	lock_guard<mutex> lock(m_mutex);
+
+	auto pit = m_references.find(scopes[0]);
+	if(pit == m_references.end())
+		return;
+	auto pdata = pit->second.GetData();
+	if(!pdata || pdata->empty())
+		return;
+
+	//Decimate long waveforms so the FFT stays small
+	size_t decimation = (pdata->size() + TRACKING_SAMPLES - 1) / TRACKING_SAMPLES;
+	int64_t maxDrift = MAX_DRIFT_SAMPLES * pdata->m_timescale * decimation;
+
+	Unit fs(Unit::UNIT_FS);
+	double now = GetTime();
+	for(size_t i=1; i<scopes.size(); i++)
+	{
+		auto scope = scopes[i];
+		auto sit = m_references.find(scope);
+		if(sit == m_references.end())
+			continue;
+		auto sdata = sit->second.GetData();
+		if(!sdata)
+			continue;
+
+		int64_t residual;
+		double peak;
+		if(!m_correlator.Correlate(pdata, sdata, maxDrift, residual, peak, decimation))
+			continue;
+
+		//Ignore weak matches (reference disconnected, signal idle, etc) rather than walking off into the weeds
+		bool accepted = (peak >= m_minPeak);
+		int64_t& skew = deskew[scope];
+		if(accepted)
+			skew += llround(residual * m_gain);
+
+		LogDebug("Deskew drift on %s: residual %s, correlation %.3f, skew now %s%s\n",
+			scope->m_nickname.c_str(),
+			fs.PrettyPrint(residual).c_str(),
+			peak,
+			fs.PrettyPrint(skew).c_str(),
+			accepted ? "" : " (ignored)");
+
+		lock_guard<mutex> lock2(m_logMutex);
+		auto& log = m_log[scope];
+		log.push_back(DriftSample(now, skew, residual, peak, accepted));
+		while(log.size() > MAX_LOG_DEPTH)
+			log.pop_front();
+	}
+}
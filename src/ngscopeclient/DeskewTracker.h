@@ -0,0 +1,176 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of DeskewTracker
+ */
+#ifndef DeskewTracker_h
+#define DeskewTracker_h
+
+#include "../common/DeskewCorrelator.h"
+
+/**
+	@brief One measurement of the skew between a secondary instrument and the primary
+ */
+class DriftSample
+{
+public:
+	DriftSample(double time, int64_t skew, int64_t residual, double peak, bool accepted)
+		: m_time(time)
+		, m_skew(skew)
+		, m_residual(residual)
+		, m_peak(peak)
+		, m_accepted(accepted)
+	{}
+
+	///@brief Wall clock time of the measurement
+	double m_time;
+
+	///@brief Deskew coefficient after the measurement, in fs
+	int64_t m_skew;
+
+	///@brief Skew remaining after the previous correction was applied, in fs
+	int64_t m_residual;
+
+	///@brief Correlation coefficient at the peak
+	double m_peak;
+
+	///@brief False if the measurement was too weak to trust and didn't change the coefficient
+	bool m_accepted;
+};
+
+/**
+	@brief Keeps multi-scope deskew coefficients up to date as the instruments' reference clocks drift
+
+	Each instrument has a reference stream, all connected to the same signal on the DUT. Every Nth acquisition,
+	the reference stream of each secondary instrument is cross-correlated against the primary's. The waveforms have
+	already been deskewed by then, so the result is the drift since the last update. It's fed through a first order
+	low pass filter into the deskew coefficient, and logged.
+
+	Correlation runs on decimated data over a narrow window of lags, so it's cheap enough to run on WaveformThread
+	without holding up the next acquisition. The narrow window also keeps a noisy capture from jumping to some other
+	peak of a periodic reference signal.
+ */
+class DeskewTracker
+{
+public:
+	DeskewTracker();
+	~DeskewTracker();
+
+	void SetReference(Oscilloscope* scope, StreamDescriptor stream);
+	StreamDescriptor GetReference(Oscilloscope* scope);
+
+	/**
+		@brief Turns tracking on or off
+	 */
+	void SetEnabled(bool enabled)
+	{ m_enabled = enabled; }
+
+	bool IsEnabled()
+	{ return m_enabled; }
+
+	/**
+		@brief Sets how many acquisitions to wait between measurements
+	 */
+	void SetInterval(int interval)
+	{ m_interval = std::max(interval, 1); }
+
+	int GetInterval()
+	{ return m_interval; }
+
+	/**
+		@brief Sets the fraction of each measured drift applied to the coefficient (1 = no filtering)
+	 */
+	void SetFilterGain(float gain)
+	{ m_gain = gain; }
+
+	float GetFilterGain()
+	{ return m_gain; }
+
+	/**
+		@brief Sets the lowest correlation coefficient a measurement needs to be used
+	 */
+	void SetMinimumCorrelation(float peak)
+	{ m_minPeak = peak; }
+
+	float GetMinimumCorrelation()
+	{ return m_minPeak; }
+
+	void Clear();
+	void ClearLog();
+
+	void Update(const std::vector<Oscilloscope*>& scopes, std::map<Oscilloscope*, int64_t>& deskew);
+
+	std::vector<DriftSample> GetLog(Oscilloscope* scope);
+
+	///@brief Most points of each reference waveform to correlate
+	static const size_t TRACKING_SAMPLES = 65536;
+
+	///@brief Largest drift to look for in one update, in decimated samples
+	static const int64_t MAX_DRIFT_SAMPLES = 64;
+
+	///@brief Most measurements to keep in the log for each instrument
+	static const size_t MAX_LOG_DEPTH = 4096;
+
+protected:
+
+	///@brief Mutex protecting m_references and m_correlator
+	std::mutex m_mutex;
+
+	///@brief Reference stream of each instrument
+	std::map<Oscilloscope*, StreamDescriptor> m_references;
+
+	///@brief The correlator (keeps its FFT plans between updates)
+	DeskewCorrelator m_correlator;
+
+	///@brief Mutex protecting m_log
+	std::mutex m_logMutex;
+
+	///@brief Measurement history of each secondary instrument
+	std::map<Oscilloscope*, std::deque<DriftSample> > m_log;
+
+	///@brief True if tracking is on
+	std::atomic<bool> m_enabled;
+
+	///@brief Number of acquisitions between measurements
+	std::atomic<int> m_interval;
+
+	///@brief Low pass filter gain
+	std::atomic<float> m_gain;
+
+	///@brief Minimum correlation coefficient
+	std::atomic<float> m_minPeak;
+
+	///@brief Acquisitions since the last measurement
+	int m_count;
+};
+
+#endif
@@ -0,0 +1,183 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of DeskewTrackerDialog
+ */
+
+#include "ngscopeclient.h"
+#include "DeskewTrackerDialog.h"
+#include "Session.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+DeskewTrackerDialog::DeskewTrackerDialog(Session& session)
+	: Dialog("Skew Drift Tracking", ImVec2(500, 400))
+	, m_session(session)
+	, m_tstart(GetTime())
+{
+}
+
+DeskewTrackerDialog::~DeskewTrackerDialog()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rendering
+
+/**
+	@brief Renders the dialog and handles UI events
+
+	@return		True if we should continue showing the dialog
+				False if it's been closed
+ */
+bool DeskewTrackerDialog::DoRender()
+{
+	auto& tracker = m_session.GetDeskewTracker();
+	auto scopes = m_session.GetScopes();
+	float width = ImGui::GetFontSize();
+
+	if(scopes.size() < 2)
+	{
+		ImGui::TextUnformatted("Drift tracking needs at least two instruments.");
+		return true;
+	}
+
+	bool enabled = tracker.IsEnabled();
+	if(ImGui::Checkbox("Track skew drift", &enabled))
+		tracker.SetEnabled(enabled);
+	HelpMarker(
+		"Periodically cross-correlate the reference channel of each secondary instrument against the primary's, "
+		"and adjust the deskew coefficients to follow any drift.\n\n"
+		"All reference channels must be connected to the same signal on the DUT.");
+
+	int interval = tracker.GetInterval();
+	ImGui::SetNextItemWidth(6 * width);
+	if(ImGui::InputInt("Interval", &interval))
+		tracker.SetInterval(interval);
+	HelpMarker("Number of acquisitions between measurements");
+
+	float gain = tracker.GetFilterGain();
+	ImGui::SetNextItemWidth(6 * width);
+	if(ImGui::SliderFloat("Filter gain", &gain, 0.01, 1, "%.2f", ImGuiSliderFlags_AlwaysClamp))
+		tracker.SetFilterGain(gain);
+	HelpMarker(
+		"Fraction of each measured drift applied to the deskew coefficient.\n\n"
+		"Lower values average out noisy measurements but follow fast drift more slowly.");
+
+	float minPeak = tracker.GetMinimumCorrelation();
+	ImGui::SetNextItemWidth(6 * width);
+	if(ImGui::SliderFloat("Minimum correlation", &minPeak, 0, 1, "%.2f", ImGuiSliderFlags_AlwaysClamp))
+		tracker.SetMinimumCorrelation(minPeak);
+	HelpMarker("Measurements with a lower correlation coefficient are logged but not applied");
+
+	if(ImGui::CollapsingHeader("Reference Channels", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for(auto scope : scopes)
+		{
+			//Only analog streams can be correlated
+			vector<StreamDescriptor> streams;
+			vector<string> names;
+			streams.push_back(StreamDescriptor(nullptr, 0));
+			names.push_back("(none)");
+			for(size_t i=0; i<scope->GetChannelCount(); i++)
+			{
+				auto chan = scope->GetChannel(i);
+				for(size_t j=0; j<chan->GetStreamCount(); j++)
+				{
+					StreamDescriptor stream(chan, j);
+					if(stream.GetType() != Stream::STREAM_TYPE_ANALOG)
+						continue;
+					streams.push_back(stream);
+					names.push_back(stream.GetName());
+				}
+			}
+
+			auto ref = tracker.GetReference(scope);
+			int sel = 0;
+			for(size_t i=0; i<streams.size(); i++)
+			{
+				if(streams[i] == ref)
+					sel = i;
+			}
+
+			ImGui::SetNextItemWidth(10 * width);
+			if(Combo(scope->m_nickname, names, sel))
+				tracker.SetReference(scope, streams[sel]);
+		}
+	}
+
+	if(ImGui::CollapsingHeader("Drift History", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		if(ImGui::Button("Clear"))
+			tracker.ClearLog();
+		DriftPlot();
+	}
+
+	return true;
+}
+
+/**
+	@brief Plots the deskew coefficient of each secondary instrument over time
+ */
+void DeskewTrackerDialog::DriftPlot()
+{
+	auto& tracker = m_session.GetDeskewTracker();
+	auto scopes = m_session.GetScopes();
+	auto csize = ImGui::GetContentRegionAvail();
+
+	if(ImPlot::BeginPlot("Skew", ImVec2(csize.x, 200)) )
+	{
+		ImPlot::SetupAxes("Time (s)", "Skew (ps)", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+
+		for(size_t i=1; i<scopes.size(); i++)
+		{
+			auto log = tracker.GetLog(scopes[i]);
+			if(log.empty())
+				continue;
+
+			vector<float> times;
+			vector<float> skews;
+			for(auto& s : log)
+			{
+				times.push_back(s.m_time - m_tstart);
+				skews.push_back(s.m_skew * 1e-3);
+			}
+
+			ImPlot::PlotLine(scopes[i]->m_nickname.c_str(), &times[0], &skews[0], times.size());
+		}
+
+		ImPlot::EndPlot();
+	}
+}
@@ -0,0 +1,370 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of DigitalBatchRenderer
+ */
+#include "ngscopeclient.h"
+#include "DigitalBatchRenderer.h"
+#include "MainWindow.h"
+#include "WaveformArea.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+DigitalBatchRenderer::DigitalBatchRenderer()
+	: m_rasterPipe("shaders/WaveformDigitalBatch.spv", 3, sizeof(DigitalBatchRasterPushConstants))
+	, m_toneMapPipe("shaders/WaveformDigitalBatchToneMap.spv", 2, sizeof(DigitalBatchToneMapPushConstants), 1)
+	, m_packed("DigitalBatchRenderer.m_packed")
+	, m_config("DigitalBatchRenderer.m_config")
+	, m_rasterized("DigitalBatchRenderer.m_rasterized")
+	, m_colors("DigitalBatchRenderer.m_colors")
+	, m_width(0)
+	, m_channelHeight(0)
+	, m_xAxisOffset(0)
+	, m_pixelsPerXUnit(0)
+	, m_toneMapPending(false)
+	, m_textures(make_shared<ToneMappedTexture>("DigitalBatchRenderer.m_texture"))
+	, m_lastRenderPass(0)
+	, m_textureX(0)
+	, m_textureY(0)
+{
+	//Configuration is generated on the CPU and consumed by the GPU
+	m_config.SetCpuAccessHint(AcceleratorBuffer<DigitalBatchChannelConfig>::HINT_LIKELY);
+	m_config.SetGpuAccessHint(AcceleratorBuffer<DigitalBatchChannelConfig>::HINT_LIKELY);
+	m_colors.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+	m_colors.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+
+	//Packed samples and rasterized output never leave the GPU
+	m_packed.SetCpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_UNLIKELY);
+	m_packed.SetGpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_LIKELY);
+	m_rasterized.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_UNLIKELY);
+	m_rasterized.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rasterization
+
+/**
+	@brief Checks if a channel can be drawn as part of a batch
+
+	Only uniform digital waveforms are supported. Persistence needs a separate buffer per channel, so channels with
+	persistence enabled are drawn on their own.
+ */
+bool DigitalBatchRenderer::CanBatch(shared_ptr<DisplayedChannel> channel)
+{
+	if(channel->IsPersistenceEnabled() || channel->IsCpuRasterizerEnabled())
+		return false;
+	return dynamic_cast<UniformDigitalWaveform*>(channel->GetStream().GetData()) != nullptr;
+}
+
+/**
+	@brief Rasterizes all channels of the batch into the shared output buffer
+
+	Called by WaveformThread.
+
+	@param cmdbuf			Command buffer to record rendering commands into
+	@param ring				The ring the pass is being recorded in
+	@param channels			The channels to draw. All must have passed CanBatch().
+	@param width			Width of the image, in pixels (including any render-ahead margins)
+	@param channelHeight	Height of each channel's band, in pixels
+	@param xAxisOffset		X axis position of the left edge of the image
+	@param pixelsPerXUnit	X axis scale
+	@param generation		Current session waveform generation
+
+	@return True if the batch was rasterized, false if it was skipped because nothing changed since last time
+ */
+bool DigitalBatchRenderer::Rasterize(
+	vk::raii::CommandBuffer& cmdbuf,
+	WaveformRenderRing& ring,
+	vector< shared_ptr<DisplayedChannel> >& channels,
+	size_t width,
+	size_t channelHeight,
+	int64_t xAxisOffset,
+	double pixelsPerXUnit,
+	uint64_t generation)
+{
+	size_t nchans = channels.size();
+
+	//See if the set of channels or the output size changed
+	bool changed = (nchans != m_channels.size()) || (width != m_width) || (channelHeight != m_channelHeight);
+	for(size_t i=0; (i<nchans) && !changed; i++)
+	{
+		if(m_channels[i].lock() != channels[i])
+			changed = true;
+	}
+
+	//See if anything about the individual channels changed
+	for(auto& chan : channels)
+	{
+		auto stream = chan->GetStream();
+
+		RasterState state;
+		state.m_data = stream.GetData();
+		state.m_generation = generation;
+		state.m_width = width;
+		state.m_height = channelHeight;
+		state.m_xAxisOffset = xAxisOffset;
+		state.m_pixelsPerXUnit = pixelsPerXUnit;
+		if(chan->UpdateRasterState(state))
+			changed = true;
+	}
+	if(!changed)
+		return false;
+
+	//Passes still in flight may be using our buffers
+	ring.ClaimForPass(m_lastRenderPass);
+
+	m_channels.assign(channels.begin(), channels.end());
+	m_width = width;
+	m_channelHeight = channelHeight;
+	m_xAxisOffset = xAxisOffset;
+	m_pixelsPerXUnit = pixelsPerXUnit;
+	m_toneMapPending = true;
+	if( (nchans == 0) || (width == 0) || (channelHeight == 0) )
+		return true;
+
+	//Lay out the packed buffer. Each channel gets a spare word at the end so the shader can read one sample past the
+	//last without bounds checks.
+	vector<uint32_t> wordOffsets;
+	size_t nwords = 0;
+	for(auto& chan : channels)
+	{
+		wordOffsets.push_back(nwords);
+		nwords += chan->GetStream().GetData()->size()/32 + 2;
+	}
+
+	//Repack everything if the layout changed, otherwise only the channels whose data changed
+	bool repackAll = (nwords != m_packed.size()) || (m_packedData.size() != nchans);
+	m_config.resize(nchans);
+	m_config.PrepareForCpuAccess();
+	if(repackAll)
+	{
+		m_packed.resize(nwords);
+		m_packedData.assign(nchans, nullptr);
+		m_packedGeneration.assign(nchans, 0);
+	}
+	m_samplesPerPixel.resize(nchans);
+	while(m_packPipes.size() < nchans)
+	{
+		m_packPipes.push_back(g_computePipelinePool.Get(ComputePipelineKey(
+			"shaders/WaveformDigitalPack.spv", 2, sizeof(DigitalBatchPackPushConstants))));
+	}
+
+	for(size_t i=0; i<nchans; i++)
+	{
+		auto data = dynamic_cast<UniformDigitalWaveform*>(channels[i]->GetStream().GetData());
+		auto& config = m_config[i];
+
+		if(repackAll || (config.wordOffset != wordOffsets[i]) ||
+			(m_packedData[i] != data) || (m_packedGeneration[i] != generation) )
+		{
+			config.wordOffset = wordOffsets[i];
+			ring.AddWaveformInput(data);
+			Pack(cmdbuf, i, data, wordOffsets[i]);
+			m_packedData[i] = data;
+			m_packedGeneration[i] = generation;
+		}
+
+		//Start from the sample at (or just left of) the left edge of the plot,
+		//so X positions within the shader stay small enough for fp32
+		int64_t startSample = (xAxisOffset - data->m_triggerPhase) / data->m_timescale;
+		startSample = max(startSample, (int64_t)INT32_MIN / 2);
+		startSample = min(startSample, (int64_t)INT32_MAX / 2);
+
+		config.memDepth = data->size();
+		config.startSample = startSample;
+		config.x0 = ((startSample * data->m_timescale + data->m_triggerPhase) - xAxisOffset) * pixelsPerXUnit;
+		config.xscale = data->m_timescale * pixelsPerXUnit;
+
+		m_samplesPerPixel[i] = 1.0 / config.xscale;
+	}
+	m_config.MarkModifiedFromCpu();
+
+	//Wait for packing to finish, then run the shader
+	m_rasterPipe.AddComputeMemoryBarrier(cmdbuf);
+	m_rasterized.resize(width * channelHeight * nchans);
+	m_rasterPipe.BindBufferNonblocking(0, m_rasterized, cmdbuf, true);
+	m_rasterPipe.BindBufferNonblocking(1, m_packed, cmdbuf);
+	m_rasterPipe.BindBufferNonblocking(2, m_config, cmdbuf);
+
+	DigitalBatchRasterPushConstants args;
+	args.windowWidth = width;
+	args.channelHeight = channelHeight;
+	args.channelCount = nchans;
+	m_rasterPipe.Dispatch(cmdbuf, args, GetComputeBlockCount(width, 64), nchans);
+	m_rasterPipe.AddComputeMemoryBarrier(cmdbuf);
+	m_rasterized.MarkModifiedFromGpu();
+
+	return true;
+}
+
+/**
+	@brief Records a dispatch bit packing one channel's samples into m_packed, 32 samples per word with the first sample
+	in the LSB
+
+	The samples are read straight from the waveform's GPU buffer, so nothing is copied back to the CPU.
+
+	@param cmdbuf		Command buffer to record into
+	@param i			Index of the channel within the batch
+	@param data			The channel's waveform
+	@param wordOffset	Index of the channel's first word within m_packed
+ */
+void DigitalBatchRenderer::Pack(
+	vk::raii::CommandBuffer& cmdbuf,
+	size_t i,
+	UniformDigitalWaveform* data,
+	uint32_t wordOffset)
+{
+	DigitalBatchPackPushConstants args;
+	args.memDepth = data->size();
+	args.nwords = args.memDepth/32 + 2;
+	args.wordOffset = wordOffset;
+
+	//After the layout changes every channel is repacked, so the old contents needn't be uploaded
+	auto& pipe = m_packPipes[i];
+	pipe->BindBufferNonblocking(0, data->m_samples, cmdbuf);
+	pipe->BindBufferNonblocking(1, m_packed, cmdbuf, m_packedData[i] == nullptr);
+	pipe->Dispatch(cmdbuf, args, GetComputeBlockCount(args.nwords, 64));
+	m_packed.MarkModifiedFromGpu();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tone mapping
+
+/**
+	@brief Handles a change in size of the batch output
+
+	@param newSize	Size of the texture needed for all channels of the batch
+
+	@return true if size has changed, false otherwise
+ */
+bool DigitalBatchRenderer::UpdateSize(ImVec2 newSize)
+{
+	size_t x = newSize.x;
+	size_t y = newSize.y;
+
+	if( (m_textureX == x) && (m_textureY == y) )
+		return false;
+
+	//Textures of the new size are allocated by the next tone mapping pass
+	LogTrace("Digital batch resized (to %zu x %zu)\n", x, y);
+	m_textureX = x;
+	m_textureY = y;
+	m_toneMapPending = true;
+
+	return true;
+}
+
+/**
+	@brief Tone maps the batch output into our texture
+
+	Called by WaveformThread, after rasterizing.
+
+	@return True if the batch was tone mapped, false if it was skipped because nothing changed since last time
+ */
+bool DigitalBatchRenderer::ToneMap(vk::raii::CommandBuffer& cmdbuf, MainWindow* top)
+{
+	size_t nchans = m_channels.size();
+	size_t height = m_channelHeight * nchans;
+	if( (nchans == 0) || (m_width == 0) || (height == 0) )
+		return false;
+
+	//Wait until the GUI has laid out the bands for this set of channels.
+	//The width doesn't have to match, since the image may extend past either side of the plot.
+	if(m_textureY != height)
+		return false;
+
+	//Figure out the color and intensity of each channel
+	vector<ImU32> colors(nchans, 0);
+	vector<float> gains(nchans, 0);
+	for(size_t i=0; i<nchans; i++)
+	{
+		auto chan = m_channels[i].lock();
+		if(chan)
+			colors[i] = ColorFromString(chan->GetStream().m_channel->m_displaycolor);
+
+		//As we zoom out more, reduce intensity to get proper intensity grading
+		gains[i] = min(1.0f, top->GetTraceAlpha() / sqrt(m_samplesPerPixel[i])) * 2;
+	}
+
+	//Skip if not re-rasterized and the colors and intensities are unchanged
+	bool pending = m_toneMapPending.exchange(false);
+	if(!pending && (colors == m_toneMapColors) && (gains == m_toneMapGains) )
+		return false;
+	m_toneMapColors = colors;
+	m_toneMapGains = gains;
+
+	auto& ring = top->GetSession().GetRenderRing();
+	ring.ClaimForPass(m_lastRenderPass);
+
+	m_colors.resize(nchans * 4);
+	m_colors.PrepareForCpuAccess();
+	for(size_t i=0; i<nchans; i++)
+	{
+		auto color = ImGui::ColorConvertU32ToFloat4(colors[i]);
+		m_colors[i*4 + 0] = color.x;
+		m_colors[i*4 + 1] = color.y;
+		m_colors[i*4 + 2] = color.z;
+		m_colors[i*4 + 3] = gains[i];
+	}
+	m_colors.MarkModifiedFromCpu();
+
+	//Run the shader, writing to a back buffer the GUI picks up once the pass completes.
+	//If there's no texture of the right size yet, try again once the GUI has made one.
+	auto tex = m_textures->GetBackBuffer(m_width, height, m_xAxisOffset, m_pixelsPerXUnit);
+	if(tex == nullptr)
+	{
+		m_toneMapPending = true;
+		return false;
+	}
+	ring.AddToneMapOutput(m_textures);
+	m_toneMapPipe.BindBufferNonblocking(0, m_rasterized, cmdbuf);
+	m_toneMapPipe.BindStorageImage(
+		1,
+		**top->GetTextureManager()->GetSampler(),
+		tex->GetView(),
+		vk::ImageLayout::eGeneral);
+	m_toneMapPipe.BindBufferNonblocking(2, m_colors, cmdbuf);
+
+	DigitalBatchToneMapPushConstants args;
+	args.width = m_width;
+	args.height = height;
+	args.channelHeight = m_channelHeight;
+	m_toneMapPipe.Dispatch(cmdbuf, args, GetComputeBlockCount(m_width, 64), height);
+
+	//Add a barrier before we read from the fragment shader
+	AddToneMapOutputBarrier(cmdbuf, tex);
+
+	return true;
+}
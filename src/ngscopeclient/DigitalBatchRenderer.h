@@ -0,0 +1,187 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of DigitalBatchRenderer
+ */
+#ifndef DigitalBatchRenderer_h
+#define DigitalBatchRenderer_h
+
+class DisplayedChannel;
+class MainWindow;
+class WaveformRenderRing;
+
+struct DigitalBatchRasterPushConstants
+{
+	uint32_t windowWidth;
+	uint32_t channelHeight;
+	uint32_t channelCount;
+};
+
+struct DigitalBatchToneMapPushConstants
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t channelHeight;
+};
+
+struct DigitalBatchPackPushConstants
+{
+	uint32_t memDepth;
+	uint32_t nwords;
+	uint32_t wordOffset;
+};
+
+struct DigitalBatchChannelConfig
+{
+	uint32_t wordOffset;
+	uint32_t memDepth;
+	int32_t startSample;
+	float x0;
+	float xscale;
+};
+
+/**
+	@brief Draws all of the uniform digital waveforms in a WaveformArea with one rasterizing and one tone mapping pass
+
+	Samples from every channel are bit packed (on the GPU) into a single buffer, then rasterized into one shared buffer with one band
+	of rows per channel. This is tone mapped to a single texture, and each channel draws its own band of it.
+
+	Compared to drawing each channel on its own, this saves a dispatch, a tone map pass, a float buffer and a texture per
+	channel, and the bit packed input is 8x smaller than the one byte per sample format used elsewhere.
+ */
+class DigitalBatchRenderer
+{
+public:
+	DigitalBatchRenderer();
+
+	static bool CanBatch(std::shared_ptr<DisplayedChannel> channel);
+
+	bool Rasterize(
+		vk::raii::CommandBuffer& cmdbuf,
+		WaveformRenderRing& ring,
+		std::vector< std::shared_ptr<DisplayedChannel> >& channels,
+		size_t width,
+		size_t channelHeight,
+		int64_t xAxisOffset,
+		double pixelsPerXUnit,
+		uint64_t generation);
+
+	bool ToneMap(vk::raii::CommandBuffer& cmdbuf, MainWindow* top);
+
+	bool UpdateSize(ImVec2 newSize);
+
+	/**
+		@brief Returns the number of channels in the batch as of the last rasterization
+	 */
+	size_t GetChannelCount()
+	{ return m_channels.size(); }
+
+	/**
+		@brief Returns the most recent completely tone mapped image of the batch, for drawing
+	 */
+	std::shared_ptr<Texture> GetTexture()
+	{ return m_textures->GetFrontBuffer(); }
+
+	std::shared_ptr<ToneMappedTexture> GetTextures()
+	{ return m_textures; }
+
+protected:
+	void Pack(vk::raii::CommandBuffer& cmdbuf, size_t i, UniformDigitalWaveform* data, uint32_t wordOffset);
+
+	///@brief Compute pipeline for rasterizing
+	ComputePipeline m_rasterPipe;
+
+	///@brief Compute pipeline for tone mapping
+	ComputePipeline m_toneMapPipe;
+
+	///@brief Compute pipelines for bit packing, one per channel since each binds a different input
+	std::vector< std::shared_ptr<ComputePipeline> > m_packPipes;
+
+	///@brief Bit packed samples of every channel, concatenated
+	AcceleratorBuffer<uint32_t> m_packed;
+
+	///@brief Per-channel rasterizer configuration
+	AcceleratorBuffer<DigitalBatchChannelConfig> m_config;
+
+	///@brief Rasterized waveforms of every channel, prior to tone mapping
+	AcceleratorBuffer<float> m_rasterized;
+
+	///@brief Per-channel color and intensity for tone mapping (four floats per channel)
+	AcceleratorBuffer<float> m_colors;
+
+	///@brief The channels in the batch, in order of their band in the output
+	std::vector< std::weak_ptr<DisplayedChannel> > m_channels;
+
+	///@brief Waveform currently packed for each channel
+	std::vector<WaveformBase*> m_packedData;
+
+	///@brief Session waveform generation currently packed for each channel
+	std::vector<uint64_t> m_packedGeneration;
+
+	///@brief Average number of samples per X axis pixel of each channel, as of the last rasterization
+	std::vector<float> m_samplesPerPixel;
+
+	///@brief Width of the rasterized output
+	size_t m_width;
+
+	///@brief Height of each channel's band of the rasterized output
+	size_t m_channelHeight;
+
+	///@brief X axis position of the left edge of the rasterized output
+	int64_t m_xAxisOffset;
+
+	///@brief X axis scale of the rasterized output
+	double m_pixelsPerXUnit;
+
+	///@brief True if the output was rasterized (or the texture reallocated) since the last tone map
+	std::atomic<bool> m_toneMapPending;
+
+	///@brief Per-channel display color used for the last tone map
+	std::vector<ImU32> m_toneMapColors;
+
+	///@brief Per-channel intensity scale used for the last tone map
+	std::vector<float> m_toneMapGains;
+
+	///@brief The textures storing our final rendered waveforms
+	std::shared_ptr<ToneMappedTexture> m_textures;
+
+	///@brief Sequence number of the last rendering pass which used our buffers (see WaveformRenderRing::ClaimForPass())
+	uint64_t m_lastRenderPass;
+
+	///@brief X axis size of the texture, as requested by the GUI
+	size_t m_textureX;
+
+	///@brief Y axis size of the texture, as requested by the GUI
+	size_t m_textureY;
+};
+
+#endif
@@ -0,0 +1,352 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of HaltConditionEngine
+ */
+
+#include "ngscopeclient.h"
+#include "HaltConditionEngine.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+HaltConditionEngine::HaltConditionEngine()
+	: m_enabled(false)
+	, m_moveToEvent(true)
+	, m_halted(false)
+	, m_haltTimestamp(0)
+{
+}
+
+HaltConditionEngine::~HaltConditionEngine()
+{
+	Clear();
+}
+
+/**
+	@brief Drops all conditions and the references they hold
+ */
+void HaltConditionEngine::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	ReleaseProgram();
+	m_conditions.clear();
+	m_search = nullptr;
+}
+
+/**
+	@brief Releases the channels referenced by the compiled program and empties it
+
+	Must be called with m_mutex held.
+ */
+void HaltConditionEngine::ReleaseProgram()
+{
+	for(auto& group : m_program)
+	{
+		for(auto& cond : group)
+			cond.m_stream.m_channel->Release();
+	}
+	m_program.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Compilation
+
+/**
+	@brief Replaces the conditions and compiles them (GUI thread only)
+
+	Conditions without a stream are ignored.
+ */
+void HaltConditionEngine::SetConditions(const vector<HaltCondition>& conditions)
+{
+	m_conditions = conditions;
+
+	vector< vector<CompiledCondition> > program;
+	for(auto& c : conditions)
+	{
+		if(!c.m_stream)
+			continue;
+
+		CompiledCondition cc;
+		cc.m_stream = c.m_stream;
+		cc.m_condition = c.m_condition;
+		cc.m_lo = c.m_lo;
+		cc.m_hi = c.m_hi;
+		cc.m_width = c.m_width;
+		cc.m_text = c.m_text;
+		switch(c.m_stream.GetType())
+		{
+			case Stream::STREAM_TYPE_ANALOG:
+				cc.m_type = MATCHER_ANALOG;
+				break;
+
+			case Stream::STREAM_TYPE_DIGITAL:
+				cc.m_type = MATCHER_DIGITAL;
+				break;
+
+			case Stream::STREAM_TYPE_PROTOCOL:
+				cc.m_type = MATCHER_PROTOCOL;
+				break;
+
+			default:
+				LogWarning("Halt conditions can't check %s (unsupported stream type)\n", c.m_stream.GetName().c_str());
+				continue;
+		}
+
+		//Start a new group for the first condition and after every OR
+		if(program.empty() || c.m_orWithPrevious)
+			program.push_back(vector<CompiledCondition>());
+
+		cc.m_stream.m_channel->AddRef();
+		program.back().push_back(cc);
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	ReleaseProgram();
+	m_program = move(program);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Evaluation
+
+/**
+	@brief Checks the current acquisition against the conditions
+
+	Runs on WaveformThread with the waveform data mutex held. In roll mode this is before the acquisition is appended
+	to the roll buffers, so only the new samples are searched.
+
+	@param timestamp	Position of the event within the acquisition. For an AND group, this is where the last of
+						its conditions first matched. If several groups match, the earliest is used.
+
+	@return True if the conditions matched
+ */
+bool HaltConditionEngine::Evaluate(int64_t& timestamp)
+{
+	if(!m_enabled)
+		return false;
+
+	lock_guard<mutex> lock(m_mutex);
+
+	bool hit = false;
+	for(auto& group : m_program)
+	{
+		int64_t groupTimestamp = INT64_MIN;
+		bool groupHit = true;
+		for(auto& cond : group)
+		{
+			int64_t t = 0;
+			bool match = false;
+			switch(cond.m_type)
+			{
+				case MATCHER_ANALOG:
+					match = MatchAnalog(cond, t);
+					break;
+
+				case MATCHER_DIGITAL:
+					match = MatchDigital(cond, t);
+					break;
+
+				case MATCHER_PROTOCOL:
+					match = MatchProtocol(cond, t);
+					break;
+			}
+
+			if(!match)
+			{
+				groupHit = false;
+				break;
+			}
+			groupTimestamp = max(groupTimestamp, t);
+		}
+
+		if(groupHit && (!hit || (groupTimestamp < timestamp)) )
+		{
+			timestamp = groupTimestamp;
+			hit = true;
+		}
+	}
+
+	return hit;
+}
+
+/**
+	@brief Checks if halting is on and any condition looks at a filter output, rather than only instrument channels
+ */
+bool HaltConditionEngine::UsesFilterOutputs()
+{
+	if(!m_enabled)
+		return false;
+
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& group : m_program)
+	{
+		for(auto& cond : group)
+		{
+			if(dynamic_cast<Filter*>(cond.m_stream.m_channel) != nullptr)
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+	@brief Finds the first event in an analog stream, using the vectorized search kernels
+ */
+bool HaltConditionEngine::MatchAnalog(CompiledCondition& cond, int64_t& timestamp)
+{
+	if(!m_search)
+		m_search = make_unique<WaveformSearch>();
+
+	vector<SearchHit> hits;
+	m_search->Search(
+		cond.m_stream, static_cast<SearchCondition>(cond.m_condition), cond.m_lo, cond.m_hi, cond.m_width, hits, 1);
+	if(hits.empty())
+		return false;
+
+	timestamp = hits[0].m_timestamp;
+	return true;
+}
+
+/**
+	@brief Finds the first sample or edge of a digital stream matching the condition
+ */
+bool HaltConditionEngine::MatchDigital(CompiledCondition& cond, int64_t& timestamp)
+{
+	auto data = cond.m_stream.GetData();
+	auto uddata = dynamic_cast<UniformDigitalWaveform*>(data);
+	auto sddata = dynamic_cast<SparseDigitalWaveform*>(data);
+	auto udata = dynamic_cast<UniformWaveformBase*>(data);
+	auto sdata = dynamic_cast<SparseWaveformBase*>(data);
+	if(!uddata && !sddata)
+		return false;
+
+	auto& samples = uddata ? uddata->m_samples : sddata->m_samples;
+	samples.PrepareForCpuAccess();
+	if(sdata)
+		sdata->m_offsets.PrepareForCpuAccess();
+
+	size_t len = samples.size();
+	const bool* p = samples.GetCpuPointer();
+	size_t i = 0;
+	switch(cond.m_condition)
+	{
+		case DIGITAL_HIGH:
+			for(; i<len; i++)
+			{
+				if(p[i])
+					break;
+			}
+			break;
+
+		case DIGITAL_LOW:
+			for(; i<len; i++)
+			{
+				if(!p[i])
+					break;
+			}
+			break;
+
+		case DIGITAL_RISING_EDGE:
+			for(i=1; i<len; i++)
+			{
+				if(p[i] && !p[i-1])
+					break;
+			}
+			break;
+
+		case DIGITAL_FALLING_EDGE:
+		default:
+			for(i=1; i<len; i++)
+			{
+				if(!p[i] && p[i-1])
+					break;
+			}
+			break;
+	}
+
+	if(i >= len)
+		return false;
+
+	timestamp = ::GetOffsetScaled(sdata, udata, i);
+	return true;
+}
+
+/**
+	@brief Finds the first protocol symbol whose text matches the condition
+ */
+bool HaltConditionEngine::MatchProtocol(CompiledCondition& cond, int64_t& timestamp)
+{
+	auto data = cond.m_stream.GetData();
+	auto udata = dynamic_cast<UniformWaveformBase*>(data);
+	auto sdata = dynamic_cast<SparseWaveformBase*>(data);
+	if(!data)
+		return false;
+	if(sdata)
+		sdata->m_offsets.PrepareForCpuAccess();
+
+	size_t len = data->size();
+	for(size_t i=0; i<len; i++)
+	{
+		auto text = data->GetText(i);
+
+		bool match;
+		switch(cond.m_condition)
+		{
+			case PROTOCOL_EQUALS:
+				match = (text == cond.m_text);
+				break;
+
+			case PROTOCOL_NOT_EQUALS:
+				match = (text != cond.m_text);
+				break;
+
+			case PROTOCOL_STARTS_WITH:
+				match = (text.compare(0, cond.m_text.length(), cond.m_text) == 0);
+				break;
+
+			case PROTOCOL_CONTAINS:
+			default:
+				match = (text.find(cond.m_text) != string::npos);
+				break;
+		}
+
+		if(match)
+		{
+			timestamp = ::GetOffsetScaled(sdata, udata, i);
+			return true;
+		}
+	}
+
+	return false;
+}
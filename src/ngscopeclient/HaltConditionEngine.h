@@ -0,0 +1,222 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of HaltConditionEngine
+ */
+#ifndef HaltConditionEngine_h
+#define HaltConditionEngine_h
+
+#include "WaveformSearch.h"
+
+/**
+	@brief Conditions for digital streams
+ */
+enum DigitalHaltCondition
+{
+	DIGITAL_HIGH,
+	DIGITAL_LOW,
+	DIGITAL_RISING_EDGE,
+	DIGITAL_FALLING_EDGE
+};
+
+/**
+	@brief Conditions for protocol streams, matched against the decoded text of each symbol
+ */
+enum ProtocolHaltCondition
+{
+	PROTOCOL_EQUALS,
+	PROTOCOL_NOT_EQUALS,
+	PROTOCOL_STARTS_WITH,
+	PROTOCOL_CONTAINS
+};
+
+/**
+	@brief One condition of the halt expression, as configured by the user
+ */
+class HaltCondition
+{
+public:
+	HaltCondition()
+		: m_stream(nullptr, 0)
+		, m_orWithPrevious(false)
+		, m_condition(0)
+		, m_lo(0)
+		, m_hi(0)
+		, m_width(0)
+	{}
+
+	///@brief The stream to check
+	StreamDescriptor m_stream;
+
+	///@brief True to OR with the previous condition, false to AND (AND binds tighter)
+	bool m_orWithPrevious;
+
+	///@brief SearchCondition, DigitalHaltCondition, or ProtocolHaltCondition depending on the stream type
+	int m_condition;
+
+	///@brief Level, or lower level of a window (analog only)
+	double m_lo;
+
+	///@brief Upper level of a window (analog only)
+	double m_hi;
+
+	///@brief Pulse width threshold (analog only)
+	double m_width;
+
+	///@brief Text to match (protocol only)
+	std::string m_text;
+};
+
+/**
+	@brief Stops the trigger as soon as an acquisition matches a set of conditions
+
+	The conditions are compiled once, when they change, into a sum of products: a list of groups which are ORed
+	together, each holding conditions which are ANDed. Compilation resolves each stream's type and picks the matcher
+	for it, so evaluating an acquisition only runs the matchers, stopping at the first failed condition of each group.
+
+	Evaluation runs on WaveformThread right after the filter graph, so the trigger is stopped before the next
+	acquisition is downloaded, without waiting for the GUI.
+ */
+class HaltConditionEngine
+{
+public:
+	HaltConditionEngine();
+	~HaltConditionEngine();
+
+	void SetConditions(const std::vector<HaltCondition>& conditions);
+
+	/**
+		@brief Gets the conditions as configured by the user (GUI thread only)
+	 */
+	const std::vector<HaltCondition>& GetConditions()
+	{ return m_conditions; }
+
+	/**
+		@brief Turns halting on or off
+	 */
+	void SetEnabled(bool enabled)
+	{ m_enabled = enabled; }
+
+	bool IsEnabled()
+	{ return m_enabled; }
+
+	/**
+		@brief Sets whether the view should be moved to the event after halting
+	 */
+	void SetMoveToEvent(bool move)
+	{ m_moveToEvent = move; }
+
+	bool IsMoveToEventEnabled()
+	{ return m_moveToEvent; }
+
+	void Clear();
+
+	bool Evaluate(int64_t& timestamp);
+	bool UsesFilterOutputs();
+
+	/**
+		@brief Reports that the trigger was stopped because of a match, for the GUI to pick up
+	 */
+	void OnHalted(int64_t timestamp)
+	{
+		m_haltTimestamp = timestamp;
+		m_halted = true;
+	}
+
+	/**
+		@brief Checks if the trigger was stopped because of a match since the last call (GUI thread only)
+	 */
+	bool PollHalted(int64_t& timestamp)
+	{
+		if(!m_halted.exchange(false))
+			return false;
+		timestamp = m_haltTimestamp;
+		return true;
+	}
+
+protected:
+
+	///@brief What kind of matcher a compiled condition uses
+	enum MatcherType
+	{
+		MATCHER_ANALOG,
+		MATCHER_DIGITAL,
+		MATCHER_PROTOCOL
+	};
+
+	/**
+		@brief A condition, ready to evaluate
+	 */
+	class CompiledCondition
+	{
+	public:
+		StreamDescriptor m_stream;
+		MatcherType m_type;
+		int m_condition;
+		float m_lo;
+		float m_hi;
+		int64_t m_width;
+		std::string m_text;
+	};
+
+	void ReleaseProgram();
+
+	bool MatchAnalog(CompiledCondition& cond, int64_t& timestamp);
+	bool MatchDigital(CompiledCondition& cond, int64_t& timestamp);
+	bool MatchProtocol(CompiledCondition& cond, int64_t& timestamp);
+
+	///@brief Conditions as configured by the user
+	std::vector<HaltCondition> m_conditions;
+
+	///@brief Mutex protecting m_program and m_search
+	std::mutex m_mutex;
+
+	///@brief Compiled conditions: groups of ANDed conditions, ORed together
+	std::vector< std::vector<CompiledCondition> > m_program;
+
+	///@brief Analog matcher, created on first use so sessions without halt conditions never allocate its queue
+	std::unique_ptr<WaveformSearch> m_search;
+
+	///@brief True if halting is turned on
+	std::atomic<bool> m_enabled;
+
+	///@brief True if the view should be moved to the event after halting
+	std::atomic<bool> m_moveToEvent;
+
+	///@brief Set when the trigger was stopped because of a match
+	std::atomic<bool> m_halted;
+
+	///@brief Position of the matching event within the acquisition
+	std::atomic<int64_t> m_haltTimestamp;
+};
+
+#endif
@@ -0,0 +1,246 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of HaltConditionsDialog
+ */
+
+#include "ngscopeclient.h"
+#include "HaltConditionsDialog.h"
+#include "Session.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+HaltConditionsDialog::HaltConditionsDialog(Session& session)
+	: Dialog("Halt Conditions", ImVec2(500, 250))
+	, m_session(session)
+{
+	m_conditions = m_session.GetHaltConditions().GetConditions();
+	for(auto& c : m_conditions)
+	{
+		Unit yunit = c.m_stream ? c.m_stream.GetYAxisUnits() : Unit(Unit::UNIT_VOLTS);
+		m_loText.push_back(yunit.PrettyPrint(c.m_lo));
+		m_hiText.push_back(yunit.PrettyPrint(c.m_hi));
+		m_widthText.push_back(Unit(Unit::UNIT_FS).PrettyPrint(c.m_width));
+	}
+}
+
+HaltConditionsDialog::~HaltConditionsDialog()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rendering
+
+/**
+	@brief Renders the dialog and handles UI events
+
+	@return		True if we should continue showing the dialog
+				False if it's been closed
+ */
+bool HaltConditionsDialog::DoRender()
+{
+	auto& engine = m_session.GetHaltConditions();
+
+	bool enabled = engine.IsEnabled();
+	if(ImGui::Checkbox("Halt on condition", &enabled))
+		engine.SetEnabled(enabled);
+	HelpMarker(
+		"Stop the trigger as soon as an acquisition matches the conditions below.\n\n"
+		"Conditions are checked right after the filter graph runs, before the next acquisition is downloaded.");
+
+	bool move = engine.IsMoveToEventEnabled();
+	if(ImGui::Checkbox("Move to event", &move))
+		engine.SetMoveToEvent(move);
+	HelpMarker("Scroll the waveform view to the matching event after halting.");
+
+	//Find every stream we could check
+	vector<StreamDescriptor> streams;
+	auto& scopes = m_session.GetScopes();
+	for(auto scope : scopes)
+	{
+		for(size_t i=0; i<scope->GetChannelCount(); i++)
+		{
+			auto chan = scope->GetChannel(i);
+			for(size_t j=0; j<chan->GetStreamCount(); j++)
+				streams.push_back(StreamDescriptor(chan, j));
+		}
+	}
+	auto filters = Filter::GetAllInstances();
+	for(auto f : filters)
+	{
+		for(size_t j=0; j<f->GetStreamCount(); j++)
+			streams.push_back(StreamDescriptor(f, j));
+	}
+	vector<string> names;
+	for(auto& s : streams)
+		names.push_back(s.GetName());
+
+	bool changed = false;
+	for(size_t i=0; i<m_conditions.size(); i++)
+	{
+		ImGui::PushID(i);
+		ImGui::Separator();
+
+		if(DoCondition(i, streams, names))
+			changed = true;
+
+		if(ImGui::Button("Remove"))
+		{
+			m_conditions.erase(m_conditions.begin() + i);
+			m_loText.erase(m_loText.begin() + i);
+			m_hiText.erase(m_hiText.begin() + i);
+			m_widthText.erase(m_widthText.begin() + i);
+			changed = true;
+			ImGui::PopID();
+			break;
+		}
+
+		ImGui::PopID();
+	}
+
+	ImGui::Separator();
+	if(ImGui::Button("Add condition"))
+	{
+		m_conditions.push_back(HaltCondition());
+		m_loText.push_back("");
+		m_hiText.push_back("");
+		m_widthText.push_back(Unit(Unit::UNIT_FS).PrettyPrint(0));
+	}
+
+	if(changed)
+		engine.SetConditions(m_conditions);
+
+	return true;
+}
+
+/**
+	@brief Runs the controls for a single condition
+
+	@return True if the condition was changed
+ */
+bool HaltConditionsDialog::DoCondition(size_t i, const vector<StreamDescriptor>& streams, const vector<string>& names)
+{
+	float width = ImGui::GetFontSize();
+	auto& c = m_conditions[i];
+	bool changed = false;
+
+	if(i > 0)
+	{
+		int op = c.m_orWithPrevious ? 1 : 0;
+		ImGui::SetNextItemWidth(4 * width);
+		if(ImGui::Combo("###op", &op, "AND\0OR\0"))
+		{
+			c.m_orWithPrevious = (op == 1);
+			changed = true;
+		}
+		ImGui::SameLine();
+	}
+
+	int sel = -1;
+	for(size_t j=0; j<streams.size(); j++)
+	{
+		if(streams[j] == c.m_stream)
+			sel = j;
+	}
+	ImGui::SetNextItemWidth(10 * width);
+	if(Combo("###stream", names, sel))
+	{
+		c.m_stream = streams[sel];
+		c.m_condition = 0;
+		Unit yunit = c.m_stream.GetYAxisUnits();
+		m_loText[i] = yunit.PrettyPrint(c.m_lo);
+		m_hiText[i] = yunit.PrettyPrint(c.m_hi);
+		changed = true;
+	}
+	if(!c.m_stream)
+		return changed;
+
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(10 * width);
+	switch(c.m_stream.GetType())
+	{
+		case Stream::STREAM_TYPE_ANALOG:
+			{
+				if(ImGui::Combo(
+					"###cond",
+					&c.m_condition,
+					"Above level\0Below level\0Inside window\0Outside window\0Rising edge\0Falling edge\0"
+					"Pulse wider than\0Pulse narrower than\0"))
+				{
+					changed = true;
+				}
+
+				Unit yunit = c.m_stream.GetYAxisUnits();
+				bool window = (c.m_condition == SEARCH_INSIDE_WINDOW) || (c.m_condition == SEARCH_OUTSIDE_WINDOW);
+				bool pulse = (c.m_condition == SEARCH_PULSE_WIDER) || (c.m_condition == SEARCH_PULSE_NARROWER);
+
+				ImGui::SetNextItemWidth(6 * width);
+				if(UnitInputWithImplicitApply(window ? "Lower" : "Level", m_loText[i], c.m_lo, yunit))
+					changed = true;
+				if(window)
+				{
+					ImGui::SetNextItemWidth(6 * width);
+					if(UnitInputWithImplicitApply("Upper", m_hiText[i], c.m_hi, yunit))
+						changed = true;
+				}
+				if(pulse)
+				{
+					ImGui::SetNextItemWidth(6 * width);
+					if(UnitInputWithImplicitApply("Width", m_widthText[i], c.m_width, Unit(Unit::UNIT_FS)))
+						changed = true;
+				}
+			}
+			break;
+
+		case Stream::STREAM_TYPE_DIGITAL:
+			if(ImGui::Combo("###cond", &c.m_condition, "High\0Low\0Rising edge\0Falling edge\0"))
+				changed = true;
+			break;
+
+		case Stream::STREAM_TYPE_PROTOCOL:
+			if(ImGui::Combo("###cond", &c.m_condition, "Equals\0Not equal to\0Starts with\0Contains\0"))
+				changed = true;
+			ImGui::SetNextItemWidth(10 * width);
+			if(ImGui::InputText("Text", &c.m_text))
+				changed = true;
+			break;
+
+		default:
+			ImGui::TextUnformatted("(unsupported stream type)");
+			break;
+	}
+
+	return changed;
+}
@@ -131,7 +131,30 @@ HistoryManager::~HistoryManager()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // History processing
 
+/**
+	@brief Adds the waveforms currently attached to the instruments as a new history point
+ */
 void HistoryManager::AddHistory(const vector<Oscilloscope*>& scopes)
+{
+	auto pt = CreateHistoryPoint(scopes);
+	if(pt)
+		AddHistory(vector<shared_ptr<HistoryPoint> >{pt});
+}
+
+/**
+	@brief Takes ownership of the waveforms currently attached to the instruments, without adding them to history yet
+
+	Doesn't touch the history itself, so it's safe to call from WaveformThread for segments that will be added later
+	with AddHistory().
+
+	@param scopes	Instruments to take the waveforms of
+	@param exclude	Waveforms owned by someone else, which are left out of the history point
+
+	@return The new history point, or null if there were no waveforms anywhere
+ */
+shared_ptr<HistoryPoint> HistoryManager::CreateHistoryPoint(
+	const vector<Oscilloscope*>& scopes,
+	const set<WaveformBase*>& exclude)
 {
 	bool foundTimestamp = false;
 	TimePoint tp(0,0);
@@ -145,7 +168,7 @@ void HistoryManager::AddHistory(const vector<Oscilloscope*>& scopes)
 			for(size_t j=0; j<chan->GetStreamCount(); j++)
 			{
 				auto wfm = chan->GetData(j);
-				if(wfm)
+				if(wfm && (exclude.find(wfm) == exclude.end()) )
 				{
 					tp.SetSec(wfm->m_startTimestamp);
 					tp.SetFs(wfm->m_startFemtoseconds);
@@ -159,11 +182,10 @@ void HistoryManager::AddHistory(const vector<Oscilloscope*>& scopes)
 	//If we get here, there were no waveforms anywhere!
 	//Nothing for us to do
 	if(!foundTimestamp)
-		return;
+		return nullptr;
 
-	//All good. Generate a new history point and add it
+	//All good. Generate a new history point
 	auto pt = make_shared<HistoryPoint>();
-	m_history.push_back(pt);
 	pt->m_time = tp;
 	pt->m_pinned = false;
 
@@ -176,12 +198,26 @@ void HistoryManager::AddHistory(const vector<Oscilloscope*>& scopes)
 		{
 			auto chan = scope->GetChannel(i);
 			for(size_t j=0; j<chan->GetStreamCount(); j++)
-				hist[StreamDescriptor(chan, j)] = chan->GetData(j);
+			{
+				auto wfm = chan->GetData(j);
+				if(exclude.find(wfm) == exclude.end())
+					hist[StreamDescriptor(chan, j)] = wfm;
+			}
 		}
 
 		pt->m_history[scope] = hist;
 	}
 
+	return pt;
+}
+
+/**
+	@brief Adds a block of history points (in acquisition order), then trims the history once for all of them
+ */
+void HistoryManager::AddHistory(const vector<shared_ptr<HistoryPoint> >& points)
+{
+	m_history.insert(m_history.end(), points.begin(), points.end());
+
 	//TODO: check history size in MB/GB etc
 	//TODO: convert older stuff to disk, free GPU memory, etc?
 	while(m_history.size() > (size_t) m_maxDepth)
@@ -199,6 +235,7 @@ void HistoryManager::AddHistory(const vector<Oscilloscope*>& scopes)
 
 			m_session.RemoveMarkers(point->m_time);
 			m_history.erase(it);
+			deletedSomething = true;
 			break;
 		}
 
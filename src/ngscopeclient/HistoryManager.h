@@ -74,6 +74,10 @@ public:
 	~HistoryManager();
 
 	void AddHistory(const std::vector<Oscilloscope*>& scopes);
+	void AddHistory(const std::vector<std::shared_ptr<HistoryPoint> >& points);
+	static std::shared_ptr<HistoryPoint> CreateHistoryPoint(
+		const std::vector<Oscilloscope*>& scopes,
+		const std::set<WaveformBase*>& exclude = std::set<WaveformBase*>());
 
 	std::shared_ptr<HistoryPoint> GetHistory(TimePoint t);
 
@@ -81,7 +81,14 @@ MainWindow::MainWindow(shared_ptr<QueueHandle> queue)
 	, m_sessionClosing(false)
 	, m_texmgr(queue)
 	, m_needRender(false)
+	, m_needToneMap(false)
+	, m_eyeColorRamp("MainWindow.m_eyeColorRamp")
+	, m_eyeColorRampLoaded(-1)
 	, m_toneMapTime(0)
+	, m_rasterizedChannels(0)
+	, m_rasterizeSkippedChannels(0)
+	, m_toneMappedChannels(0)
+	, m_toneMapSkippedChannels(0)
 {
 	LoadRecentInstrumentList();
 
@@ -156,6 +163,10 @@ void MainWindow::CloseSession()
 	LogTrace("Clearing dialogs\n");
 	m_logViewerDialog = nullptr;
 	m_metricsDialog = nullptr;
+	m_statisticsDialog = nullptr;
+	m_searchDialog = nullptr;
+	m_haltConditionsDialog = nullptr;
+	m_deskewTrackerDialog = nullptr;
 	m_timebaseDialog = nullptr;
 	m_historyDialog = nullptr;
 	m_preferenceDialog = nullptr;
@@ -306,33 +317,148 @@ void MainWindow::DoRender(vk::raii::CommandBuffer& /*cmdBuf*/)
 }
 
 /**
-	@brief Run the tone-mapping shader on all of our waveforms
+	@brief Gets the color ramp for eye patterns, spectrograms, and waterfalls, reloading it if the preference changed
 
-	Called by Session::CheckForWaveforms() at the start of each frame if new data is ready to render
+	Called by WaveformThread while tone mapping.
  */
-void MainWindow::ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf)
+AcceleratorBuffer<float>& MainWindow::GetEyeColorRamp()
 {
-	double start = GetTime();
+	auto ramp = m_session.GetWaveformThreadSettings().m_eyeColorRamp;
+	if(ramp == m_eyeColorRampLoaded)
+		return m_eyeColorRamp;
 
-	m_cmdBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	static const map<int64_t, string> files =
+	{
+		{ EYE_RAMP_CRT,				"crt" },
+		{ EYE_RAMP_IRONBOW,			"ironbow" },
+		{ EYE_RAMP_RAINBOW,			"rainbow" },
+		{ EYE_RAMP_REVERSE_RAINBOW,	"reverse-rainbow" },
+		{ EYE_RAMP_VIRIDIS,			"viridis" },
+		{ EYE_RAMP_GRAYSCALE,		"grayscale" },
+		{ EYE_RAMP_KRAIN,			"krain" }
+	};
+
+	//Fall back to black rather than leaving garbage in the ramp if the file is missing
+	uint8_t rgba[1024] = {0};
+	auto it = files.find(ramp);
+	if(it != files.end())
+	{
+		auto path = FindDataFile("gradients/eye-gradient-" + it->second + ".rgba");
+		FILE* fp = fopen(path.c_str(), "rb");
+		if(!fp)
+			LogError("Failed to open eye gradient \"%s\"\n", path.c_str());
+		else
+		{
+			if(1024 != fread(rgba, 1, 1024, fp))
+				LogError("Eye gradient \"%s\" is truncated\n", path.c_str());
+			fclose(fp);
+		}
+	}
 
-	for(auto group : m_waveformGroups)
-		group->ToneMapAllWaveforms(cmdbuf);
+	//Ramp is small and only changes when the preference does, so keep the CPU copy around
+	m_eyeColorRamp.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+	m_eyeColorRamp.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+	m_eyeColorRamp.resize(1024);
+	m_eyeColorRamp.PrepareForCpuAccess();
+	for(size_t i=0; i<1024; i++)
+		m_eyeColorRamp[i] = rgba[i] / 255.0f;
+	m_eyeColorRamp.MarkModifiedFromCpu();
+
+	m_eyeColorRampLoaded = ramp;
+	return m_eyeColorRamp;
+}
 
-	m_cmdBuffer->end();
-	m_renderQueue->SubmitAndBlock(*m_cmdBuffer);
+/**
+	@brief Run the rasterizing shader on all of our waveforms which changed since the last call, then tone map them
 
-	double dt = GetTime() - start;
-	m_toneMapTime = dt * FS_PER_SECOND;
-}
+	Called by WaveformThread, between WaveformRenderRing::Acquire() and Submit().
 
+	Each plot is recorded into its own lane of the pass (see WaveformArea::GetRenderLane()), rasterizing all of its
+	channels and then tone mapping them. Lanes are recorded in parallel by the ring's worker threads, and are submitted
+	to separate queues if the device has enough of them. Each channel writes to a back buffer, which the GUI thread
+	brings to the front once the pass completes.
+ */
 void MainWindow::RenderWaveformTextures(
-	vk::raii::CommandBuffer& cmdbuf,
+	WaveformRenderRing& ring,
 	vector<shared_ptr<DisplayedChannel> >& channels)
 {
 	bool clear = m_clearPersistence.exchange(false);
+
+	size_t nlanes = ring.GetLaneCount();
+	vector< vector<WaveformRenderJob> > jobs(nlanes);
 	for(auto group : m_waveformGroups)
-		group->RenderWaveformTextures(cmdbuf, channels, clear);
+		group->GetRenderJobs(jobs, clear);
+
+	//Anything used by more than one lane has to be ready before recording starts, so the lanes only ever read its
+	//state. Waveforms shown in several plots are made current on both the CPU and GPU, since some rasterizers read
+	//them on the CPU.
+	GetEyeColorRamp().PrepareForGpuAccess();
+	if(nlanes > 1)
+	{
+		map<WaveformBase*, size_t> uses;
+		for(auto& lane : jobs)
+		{
+			for(auto& job : lane)
+			{
+				for(size_t i=0; i<job.m_area->GetStreamCount(); i++)
+				{
+					auto data = job.m_area->GetStream(i).GetData();
+					if(data)
+						uses[data] ++;
+				}
+			}
+		}
+		for(auto it : uses)
+		{
+			if(it.second > 1)
+			{
+				it.first->PrepareForGpuAccess();
+				it.first->PrepareForCpuAccess();
+			}
+		}
+	}
+
+	vector< vector<shared_ptr<DisplayedChannel> > > laneChannels(nlanes);
+	vector<RenderPassCounts> rasterCounts(nlanes);
+	vector<RenderPassCounts> toneMapCounts(nlanes);
+	vector<double> toneMapTimes(nlanes, 0);
+	auto recordLane = [&](size_t i)
+	{
+		auto& cmdbuf = ring.GetCommandBuffer(i);
+		cmdbuf.begin({});
+
+		for(auto& job : jobs[i])
+			job.m_area->RenderWaveformTextures(cmdbuf, laneChannels[i], job.m_clearPersistence, rasterCounts[i]);
+
+		double start = GetTime();
+		for(auto& job : jobs[i])
+			job.m_area->ToneMapAllWaveforms(cmdbuf, toneMapCounts[i]);
+		toneMapTimes[i] = GetTime() - start;
+
+		cmdbuf.end();
+	};
+
+	ring.RecordLanes(recordLane);
+
+	//Add up the statistics
+	RenderPassCounts rasterTotal;
+	RenderPassCounts toneMapTotal;
+	double toneMapTime = 0;
+	for(size_t i=0; i<nlanes; i++)
+	{
+		channels.insert(channels.end(), laneChannels[i].begin(), laneChannels[i].end());
+		rasterTotal.m_processed += rasterCounts[i].m_processed;
+		rasterTotal.m_skipped += rasterCounts[i].m_skipped;
+		toneMapTotal.m_processed += toneMapCounts[i].m_processed;
+		toneMapTotal.m_skipped += toneMapCounts[i].m_skipped;
+		toneMapTime += toneMapTimes[i];
+	}
+
+	m_rasterizedChannels = rasterTotal.m_processed;
+	m_rasterizeSkippedChannels = rasterTotal.m_skipped;
+	m_toneMapTime = toneMapTime * FS_PER_SECOND;
+	m_toneMappedChannels = toneMapTotal.m_processed;
+	m_toneMapSkippedChannels = toneMapTotal.m_skipped;
 }
 
 void MainWindow::RenderUI()
@@ -355,8 +481,10 @@ void MainWindow::RenderUI()
 
 	m_needRender = false;
 
+	//Hand off any finished rendering passes, then bring their textures to the front.
 	//Keep references to all of our waveform textures until next frame
 	//Any groups we're closing will be destroyed at the start of that frame, once rendering has finished
+	m_session.GetRenderRing().Poll();
 	for(auto g : m_waveformGroups)
 		g->ReferenceWaveformTextures();
 
@@ -370,7 +498,7 @@ void MainWindow::RenderUI()
 
 	//See if we have new waveform data to look at.
 	//If we got one, highlight the new waveform in history
-	if(m_session.CheckForWaveforms(*m_cmdBuffer))
+	if(m_session.CheckForWaveforms())
 	{
 		if(m_historyDialog != nullptr)
 			m_historyDialog->UpdateSelectionToLatest();
@@ -381,6 +509,18 @@ void MainWindow::RenderUI()
 			it.second->OnWaveformLoaded(t);
 	}
 
+	//If the trigger was stopped by a halt condition, show the event
+	int64_t haltTimestamp;
+	auto& halt = m_session.GetHaltConditions();
+	if(halt.PollHalted(haltTimestamp) && halt.IsMoveToEventEnabled())
+		NavigateToTimestamp(haltTimestamp);
+
+	//Changes to trace intensity etc only need the tone mapping pass.
+	//The rendering pass skips rasterizing channels which haven't changed.
+	if(m_needToneMap)
+		m_needRender = true;
+	m_needToneMap = false;
+
 	//Menu for main window
 	MainMenu();
 	Toolbar();
@@ -500,7 +640,7 @@ void MainWindow::Toolbar()
 	ImGui::SetCursorPosY(y + 5);
 	ImGui::SetNextItemWidth(6 * toolbarHeight);
 	if(ImGui::SliderFloat("Intensity", &m_traceAlpha, 0, 0.75, "", ImGuiSliderFlags_Logarithmic))
-		SetNeedRender();
+		SetNeedToneMap();
 	ImGui::SetCursorPosY(y);
 
 	ImGui::End();
@@ -537,20 +677,29 @@ void MainWindow::ToolbarButtons()
 	ImVec2 buttonsize(m_toolbarIconSize, m_toolbarIconSize);
 
 	//Trigger button group
+	bool armFailed = false;
 	if(ImGui::ImageButton("trigger-start", GetTexture("trigger-start"), buttonsize))
-		m_session.ArmTrigger(Session::TRIGGER_TYPE_NORMAL);
+		armFailed = !m_session.ArmTrigger(Session::TRIGGER_TYPE_NORMAL);
 	Dialog::Tooltip("Arm the trigger in normal mode");
 
 	ImGui::SameLine(0.0, 0.0);
 	if(ImGui::ImageButton("trigger-single", GetTexture("trigger-single"), buttonsize))
-		m_session.ArmTrigger(Session::TRIGGER_TYPE_SINGLE);
+		armFailed = !m_session.ArmTrigger(Session::TRIGGER_TYPE_SINGLE);
 	Dialog::Tooltip("Arm the trigger in one-shot mode");
 
 	ImGui::SameLine(0.0, 0.0);
 	if(ImGui::ImageButton("trigger-force", GetTexture("trigger-force"), buttonsize))
-		m_session.ArmTrigger(Session::TRIGGER_TYPE_FORCED);
+		armFailed = !m_session.ArmTrigger(Session::TRIGGER_TYPE_FORCED);
 	Dialog::Tooltip("Acquire a waveform immediately, ignoring the trigger condition");
 
+	if(armFailed)
+	{
+		ShowErrorPopup(
+			"Trigger error",
+			"One or more secondary instruments did not confirm they were armed, so the trigger was not started.\n"
+			"See the log for details.");
+	}
+
 	ImGui::SameLine(0.0, 0.0);
 	if(ImGui::ImageButton("trigger-stop", GetTexture("trigger-stop"), buttonsize))
 		m_session.StopTrigger();
@@ -632,6 +781,14 @@ void MainWindow::OnDialogClosed(const std::shared_ptr<Dialog>& dlg)
 	//Handle single-instance dialogs
 	if(m_logViewerDialog == dlg)
 		m_logViewerDialog = nullptr;
+	if(m_statisticsDialog == dlg)
+		m_statisticsDialog = nullptr;
+	if(m_searchDialog == dlg)
+		m_searchDialog = nullptr;
+	if(m_haltConditionsDialog == dlg)
+		m_haltConditionsDialog = nullptr;
+	if(m_deskewTrackerDialog == dlg)
+		m_deskewTrackerDialog = nullptr;
 	if(m_timebaseDialog == dlg)
 		m_timebaseDialog = nullptr;
 	if(m_preferenceDialog == dlg)
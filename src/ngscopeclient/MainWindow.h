@@ -120,18 +120,26 @@ public:
 			m_timebaseDialog->Refresh();
 	}
 
-	void ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf);
-
 	void RenderWaveformTextures(
-		vk::raii::CommandBuffer& cmdbuf,
+		WaveformRenderRing& ring,
 		std::vector<std::shared_ptr<DisplayedChannel> >& channels);
 
 	void SetNeedRender()
 	{ m_needRender = true; }
 
+	/**
+		@brief Requests a tone mapping pass at the next frame
+
+		Used for changes which only affect the final colors, like trace intensity. Tone mapping runs as part of a
+		rendering pass, but channels whose rasterized output is still valid aren't rasterized again.
+	 */
+	void SetNeedToneMap()
+	{ m_needToneMap = true; }
+
 	void ClearPersistence()
 	{
 		m_clearPersistence = true;
+		m_session.GetStatistics().Clear();
 		SetNeedRender();
 	}
 
@@ -255,6 +263,18 @@ protected:
 	///@brief Performance metrics
 	std::shared_ptr<Dialog> m_metricsDialog;
 
+	///@brief Measurement statistics
+	std::shared_ptr<Dialog> m_statisticsDialog;
+
+	///@brief Waveform search
+	std::shared_ptr<Dialog> m_searchDialog;
+
+	///@brief Halt conditions
+	std::shared_ptr<Dialog> m_haltConditionsDialog;
+
+	///@brief Skew drift tracking
+	std::shared_ptr<Dialog> m_deskewTrackerDialog;
+
 	///@brief Preferences
 	std::shared_ptr<Dialog> m_preferenceDialog;
 
@@ -339,6 +359,9 @@ protected:
 	 */
 	bool m_needRender;
 
+	///@brief True if a tone mapping pass was requested
+	bool m_needToneMap;
+
 	/**
 		@brief True if we should clear persistence on the next render pass
 	 */
@@ -350,7 +373,15 @@ protected:
 	///@brief Command buffer used during rendering operations
 	std::unique_ptr<vk::raii::CommandBuffer> m_cmdBuffer;
 
+	///@brief Color ramp for eye patterns, spectrograms, and waterfalls (256 RGBA entries)
+	AcceleratorBuffer<float> m_eyeColorRamp;
+
+	///@brief Preference value m_eyeColorRamp was loaded for (-1 if not loaded yet)
+	int64_t m_eyeColorRampLoaded;
+
 public:
+	AcceleratorBuffer<float>& GetEyeColorRamp();
+
 
 	/**
 		@brief Returns a font, given the name of a preference setting
@@ -373,11 +404,36 @@ protected:
 	// Performance counters
 
 protected:
-	int64_t m_toneMapTime;
+	///@brief Time spent recording the last tone map pass (total across all lanes)
+	std::atomic<int64_t> m_toneMapTime;
+
+	///@brief Number of channels rasterized during the last render pass
+	std::atomic<size_t> m_rasterizedChannels;
+
+	///@brief Number of channels skipped during the last render pass because nothing had changed
+	std::atomic<size_t> m_rasterizeSkippedChannels;
+
+	///@brief Number of channels tone mapped during the last tone map pass
+	std::atomic<size_t> m_toneMappedChannels;
+
+	///@brief Number of channels skipped during the last tone map pass because nothing had changed
+	std::atomic<size_t> m_toneMapSkippedChannels;
 
 public:
 	int64_t GetToneMapTime()
 	{ return m_toneMapTime; }
+
+	size_t GetRasterizedChannelCount()
+	{ return m_rasterizedChannels; }
+
+	size_t GetRasterizeSkippedChannelCount()
+	{ return m_rasterizeSkippedChannels; }
+
+	size_t GetToneMappedChannelCount()
+	{ return m_toneMappedChannels; }
+
+	size_t GetToneMapSkippedChannelCount()
+	{ return m_toneMapSkippedChannels; }
 };
 
 #endif
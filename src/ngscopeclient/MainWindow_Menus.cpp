@@ -48,6 +48,8 @@
 #include "AddScopeDialog.h"
 #include "FilterGraphEditor.h"
 #include "FunctionGeneratorDialog.h"
+#include "DeskewTrackerDialog.h"
+#include "HaltConditionsDialog.h"
 #include "HistoryDialog.h"
 #include "LogViewerDialog.h"
 #include "MetricsDialog.h"
@@ -57,6 +59,8 @@
 #include "ProtocolAnalyzerDialog.h"
 #include "RFGeneratorDialog.h"
 #include "SCPIConsoleDialog.h"
+#include "StatisticsDialog.h"
+#include "WaveformSearchDialog.h"
 
 using namespace std;
 
@@ -697,6 +701,28 @@ void MainWindow::SetupMenu()
 		if(prefsVisible)
 			ImGui::EndDisabled();
 
+		bool haltVisible = (m_haltConditionsDialog != nullptr);
+		if(haltVisible)
+			ImGui::BeginDisabled();
+		if(ImGui::MenuItem("Halt Conditions..."))
+		{
+			m_haltConditionsDialog = make_shared<HaltConditionsDialog>(m_session);
+			AddDialog(m_haltConditionsDialog);
+		}
+		if(haltVisible)
+			ImGui::EndDisabled();
+
+		bool driftVisible = (m_deskewTrackerDialog != nullptr);
+		if(driftVisible)
+			ImGui::BeginDisabled();
+		if(ImGui::MenuItem("Skew Drift Tracking..."))
+		{
+			m_deskewTrackerDialog = make_shared<DeskewTrackerDialog>(m_session);
+			AddDialog(m_deskewTrackerDialog);
+		}
+		if(driftVisible)
+			ImGui::EndDisabled();
+
 		ImGui::EndMenu();
 	}
 }
@@ -739,6 +765,32 @@ void MainWindow::WindowMenu()
 		if(hasMetrics)
 			ImGui::EndDisabled();
 
+		bool hasStatistics = m_statisticsDialog != nullptr;
+		if(hasStatistics)
+			ImGui::BeginDisabled();
+
+		if(ImGui::MenuItem("Statistics"))
+		{
+			m_statisticsDialog = make_shared<StatisticsDialog>(&m_session);
+			AddDialog(m_statisticsDialog);
+		}
+
+		if(hasStatistics)
+			ImGui::EndDisabled();
+
+		bool hasSearch = m_searchDialog != nullptr;
+		if(hasSearch)
+			ImGui::BeginDisabled();
+
+		if(ImGui::MenuItem("Search"))
+		{
+			m_searchDialog = make_shared<WaveformSearchDialog>(m_session, *this);
+			AddDialog(m_searchDialog);
+		}
+
+		if(hasSearch)
+			ImGui::EndDisabled();
+
 		bool hasHistory = m_historyDialog != nullptr;
 		if(hasHistory)
 			ImGui::BeginDisabled();
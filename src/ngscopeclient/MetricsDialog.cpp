@@ -36,6 +36,7 @@
 #include "ngscopeclient.h"
 #include "MetricsDialog.h"
 #include "Session.h"
+#include "ComputePipelinePool.h"
 
 using namespace std;
 
@@ -121,11 +122,69 @@ bool MetricsDialog::DoRender()
 		ImGui::EndDisabled();
 
 		HelpMarker(
-			"Most recent execution time for the tone mapping compute shader (total across all waveforms).\n\n"
+			"Time spent preparing the tone mapping compute shader (total across all waveforms).\n\n"
 			"This shader runs every time a waveform is re-rasterized or display color ramp settings are changed, and "
-			"does not necessarily execute every frame. When needed, it runs synchronously during frame rendering."
+			"does not necessarily execute every frame. It runs on the GPU right after rasterizing, in the same pass, so "
+			"its execution time is included in the rasterize time. Finished images are shown at the start of the next "
+			"frame, and frame rendering never waits for it."
 			);
 
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(m_session->GetRasterizedChannelCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Channels rasterized", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of channels rasterized during the most recent waveform render pass.\n\n"
+			"Channels are only rasterized if their data, size, zoom, offset, or intensity changed.");
+
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(m_session->GetRasterizeSkippedChannelCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Rasterize skipped", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of channels skipped during the most recent waveform render pass because nothing changed.");
+
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(m_session->GetToneMappedChannelCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Channels tone mapped", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of channels tone mapped during the most recent tone map pass.\n\n"
+			"Channels are only tone mapped if they were rasterized or their color changed.");
+
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(m_session->GetToneMapSkippedChannelCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Tone map skipped", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of channels skipped during the most recent tone map pass because nothing changed.");
+
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(g_computePipelinePool.GetCreatedCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Pipelines created", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of compute pipelines created for waveform rendering since startup.");
+
+		ImGui::BeginDisabled();
+			str = counts.PrettyPrint(g_computePipelinePool.GetReusedCount());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Pipelines reused", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Number of times an idle compute pipeline was reused (e.g. by a newly added channel) "
+			"instead of creating a new one.");
 
 		ImGui::BeginDisabled();
 			str = counts.PrettyPrint(ImGui::GetIO().MetricsRenderVertices);
@@ -146,6 +205,12 @@ bool MetricsDialog::DoRender()
 		HelpMarker(
 			"Total number of index buffer entries in the last frame\n\n"
 			"Waveform samples are drawn by a compute shader and not included in this total");
+
+		if(ImGui::TreeNode("GPU time per channel"))
+		{
+			RenderGpuTimes();
+			ImGui::TreePop();
+		}
 	}
 
 	if(ImGui::CollapsingHeader("Filter graph"))
@@ -172,16 +237,28 @@ bool MetricsDialog::DoRender()
 		ImGui::BeginDisabled();
 			str = hz.PrettyPrint(m_session->GetWaveformDownloadRate());
 			ImGui::SetNextItemWidth(width);
-			ImGui::InputText("Waveform rate", &str);
+			ImGui::InputText("Acquisition rate", &str);
 		ImGui::EndDisabled();
 
 		HelpMarker(
 			"Rate at which waveforms are being retrieved from the queue and processed.\n\n"
-			"This is currently capped at the display framerate.\n"
+			"Unless frame skipping is enabled, this is capped at the display framerate.\n"
 			"If it drops below the framerate, your instrument, filter graph execution, or waveform rendering "
 			"are likely the bottleneck."
 			);
 
+		ImGui::BeginDisabled();
+			str = hz.PrettyPrint(m_session->GetWaveformDisplayRate());
+			ImGui::SetNextItemWidth(width);
+			ImGui::InputText("Display rate", &str);
+		ImGui::EndDisabled();
+
+		HelpMarker(
+			"Rate at which new waveforms are being shown.\n\n"
+			"Equal to the acquisition rate unless frame skipping is enabled, in which case waveforms arriving "
+			"faster than the display can show them are skipped."
+			);
+
 		//Category for each scope
 		auto scopes = m_session->GetScopes();
 		for(auto s : scopes)
@@ -209,5 +286,58 @@ bool MetricsDialog::DoRender()
 	return true;
 }
 
+/**
+	@brief Renders the table of GPU execution time for each analog and digital channel
+ */
+void MetricsDialog::RenderGpuTimes()
+{
+	Unit fs(Unit::UNIT_FS);
+
+	HelpMarker(
+		"Average GPU execution time of the rasterizing and tone mapping shaders for each analog and digital channel, "
+		"over the last " + to_string(RollingAverage::WINDOW_SIZE) + " times each one ran.\n\n"
+		"Measured with timestamps on the GPU, so unlike the rasterize time above, this does not include submission "
+		"or scheduling overhead. Channels drawn as part of a digital batch are not measured, and channels rasterized "
+		"on the CPU show close to zero rasterize time.");
+
+	auto times = m_session->GetRenderRing().GetGpuTimes();
+	if(times.empty())
+	{
+		ImGui::TextUnformatted("No measurements yet");
+		return;
+	}
+
+	static ImGuiTableFlags flags =
+		ImGuiTableFlags_Resizable |
+		ImGuiTableFlags_BordersOuter |
+		ImGuiTableFlags_BordersV |
+		ImGuiTableFlags_RowBg;
+
+	float width = ImGui::GetFontSize();
+	if(ImGui::BeginTable("gputimes", 3, flags))
+	{
+		ImGui::TableSetupColumn("Channel", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Rasterize", ImGuiTableColumnFlags_WidthFixed, 6*width);
+		ImGui::TableSetupColumn("Tone map", ImGuiTableColumnFlags_WidthFixed, 6*width);
+		ImGui::TableHeadersRow();
+
+		for(auto& t : times)
+		{
+			ImGui::TableNextRow();
+
+			ImGui::TableSetColumnIndex(0);
+			ImGui::TextUnformatted(t.m_name.c_str());
+
+			ImGui::TableSetColumnIndex(1);
+			ImGui::TextUnformatted(fs.PrettyPrint(t.m_average[GPU_TIMER_RASTERIZE].Get()).c_str());
+
+			ImGui::TableSetColumnIndex(2);
+			ImGui::TextUnformatted(fs.PrettyPrint(t.m_average[GPU_TIMER_TONE_MAP].Get()).c_str());
+		}
+
+		ImGui::EndTable();
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // UI event handlers
@@ -46,6 +46,8 @@ public:
 	virtual bool DoRender();
 
 protected:
+	void RenderGpuTimes();
+
 	Session* m_session;
 
 	int m_displayRefreshRate;
@@ -168,7 +168,10 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 			{
 				bool b = pref.GetBool();
 				if(ImGui::Checkbox(label.c_str(), &b))
+				{
 					pref.SetBool(b);
+					m_prefs.MarkChanged();
+				}
 			}
 			break;
 
@@ -192,7 +195,10 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 
 				ImGui::SetNextItemWidth(ImGui::GetFontSize() * 15);
 				if(Combo(label.c_str(), names, selection))
+				{
 					pref.SetEnumRaw(map.GetValue(names[selection]));
+					m_prefs.MarkChanged();
+				}
 			}
 			break;
 
@@ -217,6 +223,7 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 						static_cast<uint8_t>(fcolor[2] * 255),
 						static_cast<uint8_t>(fcolor[3] * 255)
 						));
+					m_prefs.MarkChanged();
 				}
 			}
 			break;
@@ -240,6 +247,7 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 					{
 						pref.SetReal(unit.ParseString(m_preferenceTemporaries[id]));
 						m_preferenceTemporaries[id] = unit.PrettyPrint(pref.GetReal());
+						m_prefs.MarkChanged();
 					}
 				}
 
@@ -248,7 +256,10 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 				{
 					float f = pref.GetReal();
 					if(ImGui::InputFloat(label.c_str(), &f))
+					{
 						pref.SetReal(f);
+						m_prefs.MarkChanged();
+					}
 				}
 			}
 			break;
@@ -259,7 +270,10 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 				int i = pref.GetInt();
 				ImGui::SetNextItemWidth(ImGui::GetFontSize() * 10);
 				if(ImGui::InputInt(label.c_str(), &i))
+				{
 					pref.SetReal(i);
+					m_prefs.MarkChanged();
+				}
 			}
 			break;
 
@@ -290,7 +304,10 @@ void PreferenceDialog::ProcessPreference(Preference& pref)
 					changed = true;
 
 				if(changed)
+				{
 					pref.SetFont(FontDescription(path, size));
+					m_prefs.MarkChanged();
+				}
 			}
 			break;
 
@@ -46,6 +46,7 @@ class PreferenceManager
 public:
     PreferenceManager()
         : m_treeRoot{ "" }
+        , m_generation(1)
     {
         DeterminePath();
         InitializeDefaults();
@@ -72,6 +73,20 @@ public:
     std::string GetConfigDirectory()
     { return m_configDir; }
 
+    /**
+        @brief Records that the user changed a preference (GUI thread only)
+     */
+    void MarkChanged()
+    { m_generation++; }
+
+    /**
+        @brief Gets a number which changes every time a preference is changed (GUI thread only)
+
+        Starts at 1, so anything caching preferences can start at 0 to pick up the initial values.
+     */
+    uint64_t GetGeneration() const
+    { return m_generation; }
+
     // Value retrieval methods
     int64_t GetInt(const std::string& path) const;
     int64_t GetEnumRaw(const std::string& path) const;
@@ -99,6 +114,9 @@ private:
     PreferenceCategory m_treeRoot;
     std::string m_filePath;
     std::string m_configDir;
+
+    ///@brief Incremented by MarkChanged()
+    uint64_t m_generation;
 };
 
 #endif // PreferenceManager_h
@@ -33,6 +33,105 @@
 
 void PreferenceManager::InitializeDefaults()
 {
+	auto& acquisition = this->m_treeRoot.AddCategory("Acquisition");
+		auto& display = acquisition.AddCategory("Display Rate");
+			display.AddPreference(
+				Preference::Bool("frame_skip", false)
+				.Label("Frame skipping")
+				.Description(
+					"Acquire waveforms as fast as the instruments can provide them, rather than one per frame.\n\n"
+					"Every waveform is added to history, filtered, and checked against halt conditions, but only the\n"
+					"newest waveform is drawn each time the display is ready for another."
+					));
+			display.AddPreference(
+				Preference::Bool("skipped_persistence", false)
+				.Label("Draw skipped waveforms when idle")
+				.Description(
+					"In frame skipping mode, draw a skipped waveform whenever the GPU has finished drawing\n"
+					"everything before it, so some skipped waveforms accumulate on channels with persistence.\n\n"
+					"Each one takes a full rendering pass, so at high acquisition rates only a sample of the\n"
+					"skipped waveforms is drawn. The acquisition rate never drops to wait for the GPU."
+					));
+		auto& multi = acquisition.AddCategory("Multi-Scope");
+			multi.AddPreference(
+				Preference::Enum("rearm_policy", 0)
+					.Label("Free-run re-arm point")
+					.Description(
+						"Specify when the trigger is re-armed in normal trigger mode with multiple instruments.\n"
+						"\n"
+						"After download re-arms as soon as every instrument's waveform has been received, so the\n"
+						"next acquisition overlaps with running filters and rendering. This gives the highest\n"
+						"trigger rate. If halt conditions are enabled, the trigger is re-armed after filters instead,\n"
+						"so nothing is captured after the acquisition which matches them.\n"
+						"\n"
+						"After filters waits until the filter graph and halt conditions have run.\n"
+						"\n"
+						"After display waits until the GUI has picked up the waveform, tying the trigger rate to\n"
+						"the display frame rate."
+						)
+					.EnumValue("After download", 0)
+					.EnumValue("After filters", 1)
+					.EnumValue("After display", 2)
+				);
+		auto& roll = acquisition.AddCategory("Roll Mode");
+			roll.AddPreference(
+				Preference::Bool("enabled", false)
+				.Label("Roll mode")
+				.Description(
+					"Append each acquisition of an analog channel to the end of the ones before it, and scroll the\n"
+					"display to follow the newest sample, rather than replacing the waveform every time.\n\n"
+					"Intended for slow signals on instruments which stream data, or free run with no dead time\n"
+					"between acquisitions. Rolling channels aren't added to history.\n\n"
+					"Filters, statistics and halt conditions process each acquisition on its own, together with\n"
+					"the end of the one before it (see Filter overlap), and filter outputs on a time axis roll\n"
+					"along with their inputs.\n\n"
+					"Scroll back from the newest sample to stop following it."
+					));
+			roll.AddPreference(
+				Preference::Real("window", 10 * FS_PER_SECOND)
+				.Label("Roll window")
+				.Unit(Unit::UNIT_FS)
+				.Description(
+					"Length of time to keep in roll mode. Older samples are discarded."
+					));
+			roll.AddPreference(
+				Preference::Real("overlap", FS_PER_SECOND / 10)
+				.Label("Filter overlap")
+				.Unit(Unit::UNIT_FS)
+				.Description(
+					"Length of the previous acquisition to run through the filter graph again with each new one,\n"
+					"so that events spanning two acquisitions (such as a protocol packet) are found. Filter output\n"
+					"for the overlap is discarded, since it's already in the roll buffer.\n\n"
+					"Never more than the length of the new acquisition, so filtering takes at most twice as long."
+					));
+		auto& segmented = acquisition.AddCategory("Segmented");
+			segmented.AddPreference(
+				Preference::Bool("batch_ingest", false)
+				.Label("Batch ingestion")
+				.Description(
+					"Download every waveform the instruments have queued in one pass, such as all segments of a\n"
+					"segmented memory capture.\n\n"
+					"Each segment is checked against halt conditions and added to statistics, then all of them\n"
+					"are added to history as a block. Only the last segment is handed to the display, which saves\n"
+					"waiting for the GUI once per segment. Earlier segments only go through the filter graph if\n"
+					"something needs their filter outputs: halt conditions or statistics on a filter, roll mode,\n"
+					"or overlaid segment display."
+					));
+			segmented.AddPreference(
+				Preference::Enum("segment_display", 0)
+					.Label("Segment display")
+					.Description(
+						"Specify which segments of a batch are drawn.\n"
+						"\n"
+						"Latest only draws the last segment, which is fastest.\n"
+						"\n"
+						"Overlay rasterizes every segment. Enable persistence on a channel to see them all\n"
+						"accumulated on top of each other."
+						)
+					.EnumValue("Latest only", 0)
+					.EnumValue("Overlay", 1)
+				);
+
 	auto& appearance = this->m_treeRoot.AddCategory("Appearance");
 		auto& cursors = appearance.AddCategory("Cursors");
 			cursors.AddPreference(
@@ -201,6 +300,18 @@ void PreferenceManager::InitializeDefaults()
 				Preference::Color("top_color", ColorFromString("#202020ff"))
 				.Label("Background color top")
 				.Description("Color for the top side of the background gradient in a waveform graph"));
+			graphs.AddPreference(
+				Preference::Enum("eye_color_ramp", EYE_RAMP_CRT)
+					.Label("Eye color ramp")
+					.Description("Color ramp for eye patterns, spectrograms, and waterfalls")
+					.EnumValue("CRT", EYE_RAMP_CRT)
+					.EnumValue("Ironbow", EYE_RAMP_IRONBOW)
+					.EnumValue("Rainbow", EYE_RAMP_RAINBOW)
+					.EnumValue("Reverse Rainbow", EYE_RAMP_REVERSE_RAINBOW)
+					.EnumValue("Viridis", EYE_RAMP_VIRIDIS)
+					.EnumValue("Grayscale", EYE_RAMP_GRAYSCALE)
+					.EnumValue("KRain", EYE_RAMP_KRAIN)
+				);
 			graphs.AddPreference(
 				Preference::Color("grid_centerline_color", ColorFromString("#c0c0c0ff"))
 				.Label("Grid centerline color")
@@ -377,6 +488,78 @@ void PreferenceManager::InitializeDefaults()
 					"Longer timeout values reduce power consumption, but also slows display updates.\n")
 				);
 
+	auto& rendering = this->m_treeRoot.AddCategory("Rendering");
+		auto& raster = rendering.AddCategory("Rasterizer");
+			raster.AddPreference(
+				Preference::Bool("decimation_pyramid", true)
+				.Label("Decimation pyramid")
+				.Description(
+					"Render deep uniform analog waveforms from a multi-resolution min/max pyramid when zoomed out.\n\n"
+					"The pyramid is built on the GPU once per acquisition. Rendering from it scales with window width\n"
+					"rather than memory depth, at the cost of slightly approximate intensity grading."
+					));
+			raster.AddPreference(
+				Preference::Enum("sparse_index_search", 0)
+					.Label("Sparse waveform indexing")
+					.Description(
+						"Specify where the per-column sample index of sparse waveforms is calculated.\n"
+						"\n"
+						"In GPU mode, the search runs in a compute shader and sample timestamps never need to be\n"
+						"copied back to the CPU when panning or zooming.\n"
+						"\n"
+						"In CPU mode, the search runs on all CPU cores. This may be faster on systems with slow\n"
+						"integrated graphics, but requires a CPU-side copy of the sample timestamps."
+						)
+					.EnumValue("GPU", 0)
+					.EnumValue("CPU", 1)
+				);
+			raster.AddPreference(
+				Preference::Bool("digital_batch", true)
+					.Label("Batch digital channels")
+					.Description(
+						"Draw all uniform digital channels in a plot with a single rasterizing and tone mapping pass.\n"
+						"\n"
+						"This greatly reduces per-channel overhead and GPU memory usage for logic analyzer style views\n"
+						"with many channels. Channels with persistence enabled are always drawn individually."
+						)
+				);
+			raster.AddPreference(
+				Preference::Bool("tiled", false)
+					.Label("Tiled rasterizer")
+					.Description(
+						"Draw analog and digital waveforms with the tiled rasterizer for all plot sizes.\n"
+						"\n"
+						"The tiled rasterizer processes several pixel columns per GPU workgroup and splits tall columns\n"
+						"into tiles. Plots taller than 2048 pixels always use it, since the default rasterizer cannot\n"
+						"draw them."
+						)
+				);
+			raster.AddPreference(
+				Preference::Real("render_ahead", 1)
+					.Label("Render-ahead margin")
+					.Unit(Unit::UNIT_COUNTS)
+					.Description(
+						"Width of waveform to draw beyond each side of the plot, in multiples of the plot width.\n"
+						"\n"
+						"When panning or zooming, the previously drawn image is shifted or scaled to match right away,\n"
+						"while the exact image is drawn in the background. Larger margins keep the plot filled during\n"
+						"bigger pans, but take longer to draw. Set to zero to only draw the visible area."
+						)
+				);
+			raster.AddPreference(
+				Preference::Int("render_queues", 2)
+					.Label("Rendering queues")
+					.Description(
+						"Number of GPU queues to spread waveform rendering across (1 to 8).\n"
+						"\n"
+						"Each plot is always drawn on the same queue, and the plots for each queue are prepared by a\n"
+						"separate CPU thread. Layouts with many plots draw faster if the GPU has enough queues, otherwise\n"
+						"only preparing the work is done in parallel.\n"
+						"\n"
+						"Changes to this setting take effect the next time ngscopeclient is started."
+						)
+				);
+
 
 	/*
 	auto& privacy = this->m_treeRoot.AddCategory("Privacy");
@@ -0,0 +1,177 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of RunRasterBenchmark
+ */
+#include "ngscopeclient.h"
+#include "RasterBenchmark.h"
+#include "CpuRasterizer.h"
+#include "WaveformArea.h"
+#include <random>
+
+using namespace std;
+
+/**
+	@brief Rasterizes the same synthetic waveform with the column and tiled kernels and logs timing for each
+
+	Plots up to WaveformArea::RASTER_COLUMN_MAX_HEIGHT are drawn by both kernels and the output histograms are
+	compared pixel by pixel. Taller plots can only be drawn by the tiled kernel, so only its timing is reported.
+
+	The CPU rasterizer is run on the same input as a reference. Its output may differ from the shaders by floating point
+	rounding, so it only has to match the tiled kernel to within CpuRasterizer::IsWithinTolerance().
+
+	@return True if both kernels produced identical output for every plot height they can both draw, and the CPU
+			output matched the tiled kernel's to within tolerance for every height
+ */
+bool RunRasterBenchmark()
+{
+	const size_t width = 3840;
+	const size_t depth = 8 * 1024 * 1024;
+	const int iterations = 20;
+	const size_t heights[] = {256, 512, 1024, 2048, 4096, 8192};
+
+	LogNotice("Rasterizer benchmark: %zu samples, %zu pixels wide, %d iterations\n", depth, width, iterations);
+	LogIndenter li;
+
+	//Command pool/buffer for the benchmark
+	shared_ptr<QueueHandle> queue(g_vkQueueManager->GetComputeQueue("RasterBenchmark.queue"));
+	vk::CommandPoolCreateInfo poolInfo(
+		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		queue->m_family );
+	vk::raii::CommandPool pool(*g_vkComputeDevice, poolInfo);
+	vk::CommandBufferAllocateInfo bufinfo(*pool, vk::CommandBufferLevel::ePrimary, 1);
+	vk::raii::CommandBuffer cmdbuf(move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+	//Noisy sine with a fixed seed, so every run sees identical input
+	UniformAnalogWaveform wfm;
+	wfm.m_samples.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+	wfm.m_timescale = 1000;
+	wfm.m_triggerPhase = 0;
+	wfm.m_samples.resize(depth);
+	wfm.m_samples.PrepareForCpuAccess();
+	minstd_rand rng(1);
+	normal_distribution<float> noise(0, 0.05);
+	for(size_t i=0; i<depth; i++)
+		wfm.m_samples[i] = sin(i * 2 * M_PI / 65536) + noise(rng);
+	wfm.m_samples.MarkModifiedFromCpu();
+
+	string base = "shaders/waveform-compute.analog";
+	if(g_hasShaderInt64)
+		base += ".int64";
+	ComputePipeline columnPipe(base + ".dense.spv", 2, sizeof(ConfigPushConstants));
+	ComputePipeline tiledPipe(base + ".tiled.dense.spv", 2, sizeof(ConfigPushConstants));
+
+	//Returns the average wall clock time per pass, excluding the first (which includes buffer uploads)
+	auto run = [&](ComputePipeline& pipe, AcceleratorBuffer<float>& out, ConfigPushConstants& config,
+		uint32_t x, uint32_t y)
+	{
+		double total = 0;
+		for(int i=0; i<=iterations; i++)
+		{
+			cmdbuf.begin({});
+			pipe.BindBufferNonblocking(0, out, cmdbuf, true);
+			pipe.BindBufferNonblocking(1, wfm.m_samples, cmdbuf);
+			pipe.Dispatch(cmdbuf, config, x, y);
+			cmdbuf.end();
+
+			double start = GetTime();
+			queue->SubmitAndBlock(cmdbuf);
+			if(i > 0)
+				total += GetTime() - start;
+		}
+		out.MarkModifiedFromGpu();
+		out.PrepareForCpuAccess();
+		return total / iterations;
+	};
+
+	bool ok = true;
+	for(auto h : heights)
+	{
+		ConfigPushConstants config;
+		config.innerXoff = 0;
+		config.windowHeight = h;
+		config.windowWidth = width;
+		config.memDepth = depth;
+		config.offset_samples = 0;
+		config.xoff = 0;
+		config.xscale = width * 1.0f / depth;
+		config.ybase = h * 0.5f;
+		config.yscale = h / 2.5f;
+		config.yoff = 0;
+
+		AcceleratorBuffer<float> tiledOut("RasterBenchmark.tiledOut");
+		tiledOut.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+		tiledOut.resize(width * h);
+		double tiledTime = run(tiledPipe, tiledOut, config,
+			GetComputeBlockCount(width, WaveformArea::RASTER_TILE_COLS),
+			GetComputeBlockCount(h, WaveformArea::RASTER_TILE_HEIGHT));
+
+		//Reference output from the CPU
+		vector<float> cpuOut(width * h);
+		double start = GetTime();
+		for(int i=0; i<iterations; i++)
+			CpuRasterizer::Rasterize(&cpuOut[0], config, &wfm, nullptr, false, true);
+		double cpuTime = (GetTime() - start) / iterations;
+		size_t cpuMismatches;
+		bool cpuOk = CpuRasterizer::IsWithinTolerance(&cpuOut[0], tiledOut.GetCpuPointer(), width*h, cpuMismatches);
+		if(!cpuOk)
+			ok = false;
+		LogNotice("%5zu px: cpu    %7.3f ms, %zu pixels differ from tiled (%s)\n",
+			h, cpuTime * 1000, cpuMismatches, cpuOk ? "within tolerance" : "out of tolerance");
+
+		if(h > WaveformArea::RASTER_COLUMN_MAX_HEIGHT)
+		{
+			LogNotice("%5zu px: column   n/a,      tiled %7.3f ms\n", h, tiledTime * 1000);
+			continue;
+		}
+
+		AcceleratorBuffer<float> columnOut("RasterBenchmark.columnOut");
+		columnOut.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+		columnOut.resize(width * h);
+		double columnTime = run(columnPipe, columnOut, config, width, 1);
+
+		//Both kernels share the per-sample span logic, so the histograms should match exactly
+		size_t mismatches = 0;
+		for(size_t i=0; i<width*h; i++)
+		{
+			if(columnOut[i] != tiledOut[i])
+				mismatches ++;
+		}
+		if(mismatches)
+			ok = false;
+
+		LogNotice("%5zu px: column %7.3f ms, tiled %7.3f ms (%.2fx), %zu pixels differ\n",
+			h, columnTime * 1000, tiledTime * 1000, columnTime / tiledTime, mismatches);
+	}
+
+	return ok;
+}
@@ -0,0 +1,562 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of RollModeEngine
+ */
+
+#include "ngscopeclient.h"
+#include "RollModeEngine.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+RollModeEngine::RollModeEngine()
+	: m_enabled(false)
+	, m_active(false)
+	, m_window(10 * FS_PER_SECOND)
+	, m_overlap(FS_PER_SECOND / 10)
+	, m_newestTime(0)
+	, m_lastEpoch(0)
+	, m_pending(false)
+	, m_pendingTimestamp(0, 0)
+	, m_pendingNewStart(0)
+{
+}
+
+RollModeEngine::~RollModeEngine()
+{
+	Clear();
+}
+
+/**
+	@brief Frees all roll buffers
+
+	Doesn't touch the instruments, so all of their streams must have been detached from the roll buffers already.
+	Filters get their own output waveforms back.
+ */
+void RollModeEngine::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+	FreeBuffers(false);
+	DeleteRetiredBuffers();
+}
+
+/**
+	@brief Frees all roll buffers, giving filters their own output waveforms back
+
+	Must be called with m_mutex held.
+
+	@param detach	True if called during acquisition: instrument streams still displaying a roll buffer are detached,
+					and the buffers are retired rather than deleted, since rendering passes may still be reading them.
+					Must be false if the instruments may have been destroyed already.
+ */
+void RollModeEngine::FreeBuffers(bool detach)
+{
+	for(auto& it : m_streams)
+	{
+		auto stream = it.first;
+		auto& rs = it.second;
+
+		//Drop the reference that kept the filter (and the roll buffer displayed on it) from being deleted
+		if(rs.m_filter)
+		{
+			RestoreFilterOutput(stream, rs);
+			stream.m_channel->Release();
+		}
+
+		//Offline instruments weren't detached by the download
+		else if(detach && (stream.m_channel->GetData(stream.m_stream) == rs.m_wfm) )
+			stream.m_channel->Detach(stream.m_stream);
+
+		if(detach)
+			m_retired.push_back(rs.m_wfm);
+		else
+			delete rs.m_wfm;
+	}
+	m_streams.clear();
+
+	m_active = !m_retired.empty();
+	m_newestTime = 0;
+	m_pending = false;
+}
+
+/**
+	@brief Deletes roll buffers which were replaced, once rendering is done with them
+
+	Must be called with m_mutex held.
+ */
+void RollModeEngine::DeleteRetiredBuffers()
+{
+	for(auto w : m_retired)
+		delete w;
+	m_retired.clear();
+}
+
+/**
+	@brief Puts a filter's own output waveform back in place of the roll buffer, if the roll buffer is displayed
+
+	Must be called with m_mutex held.
+ */
+void RollModeEngine::RestoreFilterOutput(StreamDescriptor stream, RollStream& rs)
+{
+	if(stream.m_channel->GetData(stream.m_stream) == rs.m_wfm)
+	{
+		stream.m_channel->Detach(stream.m_stream);
+		stream.m_channel->SetData(rs.m_chunk, stream.m_stream);
+	}
+	else
+		delete rs.m_chunk;
+	rs.m_chunk = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Acquisition
+
+/**
+	@brief Positions the waveforms just downloaded where they will be appended to the roll buffers
+
+	Called by Session::DownloadWaveforms(), after every instrument's new waveforms have been attached. The new
+	waveforms stay displayed on their own until Ingest(), so the filter graph only has to process the new samples, and
+	anything found in them (e.g. by the halt conditions) is already at its final position on the roll time axis.
+
+	The end of the previous acquisition is copied in front of each new one, up to the overlap length, so filters see
+	events spanning the two. GetNewSampleStart() tells the statistics where the duplicated samples end.
+ */
+void RollModeEngine::Prepare(const vector<Oscilloscope*>& scopes)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	//Turned off? Free the buffers, the instruments just got new waveforms of their own
+	if(!m_enabled)
+	{
+		if(!m_streams.empty())
+			FreeBuffers(true);
+		return;
+	}
+
+	m_pending = false;
+	int64_t overlap = m_overlap;
+	int64_t newStart = INT64_MAX;
+	for(auto scope : scopes)
+	{
+		//Don't touch anything offline
+		if(scope->IsOffline())
+			continue;
+
+		for(size_t i=0; i<scope->GetChannelCount(); i++)
+		{
+			auto chan = scope->GetChannel(i);
+			for(size_t j=0; j<chan->GetStreamCount(); j++)
+			{
+				//Only uniform analog waveforms roll, anything else is displayed as is
+				auto chunk = dynamic_cast<UniformAnalogWaveform*>(chan->GetData(j));
+				if( (chunk == nullptr) || (chunk->m_timescale <= 0) )
+					continue;
+
+				//Samples are contiguous, so the chunk starts where the previous one ended. Keep the phase it came
+				//with, which includes the deskew between instruments.
+				auto& rs = GetBuffer(StreamDescriptor(chan, j), chunk);
+				chunk->m_triggerPhase += rs.m_received;
+				rs.m_received += (int64_t)chunk->size() * chunk->m_timescale;
+				newStart = min(newStart, chunk->m_triggerPhase);
+
+				//Run the end of the previous acquisition through the filter graph again
+				size_t tail = min(rs.m_wfm->size(), chunk->size());
+				tail = min(tail, static_cast<size_t>(overlap / chunk->m_timescale));
+				if(tail > 0)
+					PrependTail(rs, chunk, tail);
+
+				if(!m_pending)
+				{
+					m_pending = true;
+					m_pendingTimestamp = TimePoint(chunk->m_startTimestamp, chunk->m_startFemtoseconds);
+				}
+			}
+		}
+	}
+
+	if(m_pending)
+		m_pendingNewStart = newStart;
+	m_active = !m_streams.empty() || !m_retired.empty();
+}
+
+/**
+	@brief Copies the last samples of a roll buffer in front of an acquisition about to be appended to it
+
+	Must be called with m_mutex held.
+
+	@param stream	The roll buffer
+	@param chunk	The new acquisition
+	@param tail		Number of samples to copy
+ */
+void RollModeEngine::PrependTail(RollStream& stream, UniformAnalogWaveform* chunk, size_t tail)
+{
+	auto wfm = stream.m_wfm;
+	size_t n = chunk->size();
+
+	wfm->m_samples.PrepareForCpuAccess();
+	chunk->m_samples.PrepareForCpuAccess();
+
+	chunk->m_samples.resize(tail + n);
+	float* p = chunk->m_samples.GetCpuPointer();
+	memmove(p + tail, p, n * sizeof(float));
+	memcpy(p, wfm->m_samples.GetCpuPointer() + wfm->size() - tail, tail * sizeof(float));
+	chunk->m_samples.MarkModifiedFromCpu();
+
+	chunk->m_triggerPhase -= (int64_t)tail * chunk->m_timescale;
+}
+
+/**
+	@brief Gives filters their own output waveforms back before the filter graph runs
+
+	Filters write their outputs in place, so they must never see a roll buffer as their output. Must be called with
+	the waveform data mutex held, once rendering passes are done with the roll buffers.
+ */
+void RollModeEngine::RestoreFilterOutputs()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	for(auto& it : m_streams)
+	{
+		if(it.second.m_filter)
+			RestoreFilterOutput(it.first, it.second);
+	}
+}
+
+/**
+	@brief Appends the acquisition which just went through the filter graph to the roll buffers, and displays the
+	roll buffers in its place
+
+	Instrument waveforms go back to the instrument's pool once appended. Filter outputs are only appended if they were
+	computed from this acquisition (i.e. have its timestamp) and are on a time axis, and are kept aside to be given
+	back to the filter before it runs again. Filter outputs start a new roll buffer where their first sample is, so
+	filters which shift or trim their output stay lined up with their inputs.
+
+	Called from WaveformThread, once the filter graph, statistics and halt conditions have seen the acquisition. All
+	waveform users (including rendering passes in flight) have to be done with the previous contents of the roll
+	buffers, and with the buffers retired since the last call (see GetRollWaveforms()).
+ */
+void RollModeEngine::Ingest(const vector<Oscilloscope*>& scopes, const set<Filter*>& filters)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	DeleteRetiredBuffers();
+	if(!m_enabled)
+	{
+		m_active = !m_streams.empty();
+		return;
+	}
+
+	int64_t window = m_window;
+	int64_t newest = m_newestTime;
+	size_t maxDepth = MAX_DEPTH;
+	for(auto scope : scopes)
+	{
+		//Don't touch anything offline
+		if(scope->IsOffline())
+			continue;
+
+		for(size_t i=0; i<scope->GetChannelCount(); i++)
+		{
+			auto chan = scope->GetChannel(i);
+			for(size_t j=0; j<chan->GetStreamCount(); j++)
+			{
+				auto it = m_streams.find(StreamDescriptor(chan, j));
+				if(it == m_streams.end())
+					continue;
+				auto& rs = it->second;
+
+				//Nothing new for this stream? Keep displaying what we have so far
+				auto data = chan->GetData(j);
+				if(data == nullptr)
+				{
+					chan->SetData(rs.m_wfm, j);
+					continue;
+				}
+				auto chunk = dynamic_cast<UniformAnalogWaveform*>(data);
+				if( (chunk == nullptr) || (chunk->m_timescale <= 0) )
+					continue;
+
+				//Keep at least a whole acquisition
+				size_t depth = min(static_cast<size_t>(window / chunk->m_timescale), maxDepth);
+				depth = max(depth, chunk->size());
+
+				Append(rs, chunk, depth);
+
+				chan->Detach(j);
+				chan->SetData(rs.m_wfm, j);
+				scope->AddWaveformToAnalogPool(chunk);
+
+				newest = max(newest, rs.m_wfm->m_triggerPhase + (int64_t)rs.m_wfm->size() * rs.m_wfm->m_timescale);
+			}
+		}
+	}
+
+	if(m_pending)
+	{
+		for(auto f : filters)
+		{
+			if(f->GetXAxisUnits().GetType() != Unit::UNIT_FS)
+				continue;
+
+			for(size_t j=0; j<f->GetStreamCount(); j++)
+			{
+				auto chunk = dynamic_cast<UniformAnalogWaveform*>(f->GetData(j));
+				if( (chunk == nullptr) || (chunk->m_timescale <= 0) )
+					continue;
+				if(TimePoint(chunk->m_startTimestamp, chunk->m_startFemtoseconds) != m_pendingTimestamp)
+					continue;
+
+				auto& rs = GetBuffer(StreamDescriptor(f, j), chunk);
+				size_t depth = min(static_cast<size_t>(window / chunk->m_timescale), maxDepth);
+				depth = max(depth, chunk->size());
+
+				Append(rs, chunk, depth);
+
+				f->Detach(j);
+				f->SetData(rs.m_wfm, j);
+				delete rs.m_chunk;
+				rs.m_chunk = chunk;
+
+				newest = max(newest, rs.m_wfm->m_triggerPhase + (int64_t)rs.m_wfm->size() * rs.m_wfm->m_timescale);
+			}
+		}
+	}
+
+	m_pending = false;
+	m_newestTime = newest;
+	m_active = !m_streams.empty() || !m_retired.empty();
+}
+
+/**
+	@brief Gets the roll buffer of a stream, starting a new one if there isn't one yet or the sample rate changed
+
+	Must be called with m_mutex held.
+
+	@param stream	The stream
+	@param chunk	Waveform about to be appended to the buffer
+ */
+RollStream& RollModeEngine::GetBuffer(StreamDescriptor stream, UniformAnalogWaveform* chunk)
+{
+	auto& rs = m_streams[stream];
+
+	//Start over if the sample rate changed, since the samples wouldn't be evenly spaced any more.
+	//The old buffer may still be displayed until the new one replaces it.
+	if( (rs.m_wfm != nullptr) && (rs.m_wfm->m_timescale != chunk->m_timescale) )
+	{
+		if(rs.m_filter)
+			RestoreFilterOutput(stream, rs);
+		m_retired.push_back(rs.m_wfm);
+		rs.m_wfm = nullptr;
+	}
+	if(rs.m_wfm == nullptr)
+	{
+		//Empty until the first Append(), which sets the start of the buffer
+		rs.m_wfm = new UniformAnalogWaveform;
+		rs.m_wfm->m_timescale = chunk->m_timescale;
+		rs.m_wfm->m_triggerPhase = 0;
+		rs.m_wfm->m_startTimestamp = chunk->m_startTimestamp;
+		rs.m_wfm->m_startFemtoseconds = chunk->m_startFemtoseconds;
+		rs.m_epoch = ++m_lastEpoch;
+		rs.m_received = 0;
+	}
+
+	//Hold a reference to filters, so deleting one can't free a roll buffer displayed on it
+	if(!rs.m_filter && (dynamic_cast<Filter*>(stream.m_channel) != nullptr) )
+	{
+		rs.m_filter = true;
+		stream.m_channel->AddRef();
+	}
+
+	return rs;
+}
+
+/**
+	@brief Appends one acquisition to a roll buffer
+
+	The chunk goes where its own trigger phase puts it, rounded to the nearest sample. Any part of it before the end of
+	the buffer (such as the overlap added by Prepare()) is already there and is discarded. A gap between the end of
+	the buffer and the chunk is filled by repeating the last sample, unless it's longer than the depth, in which case
+	the buffer starts over at the chunk.
+
+	The buffer grows to twice the depth before old samples are dropped, then shrinks back to the depth in a single
+	move. This way each sample is only moved once on average, no matter how short the acquisitions are.
+
+	The buffer takes the chunk's timestamp, so consumers which skip waveforms they've already seen (such as the
+	statistics) can tell the buffer has new samples.
+
+	@param stream	The roll buffer
+	@param chunk	Waveform to append, with the same timescale as the buffer
+	@param depth	Number of samples to keep (at least the size of the chunk)
+ */
+void RollModeEngine::Append(RollStream& stream, UniformAnalogWaveform* chunk, size_t depth)
+{
+	auto wfm = stream.m_wfm;
+	int64_t timescale = wfm->m_timescale;
+	size_t len = wfm->size();
+	size_t n = chunk->size();
+
+	wfm->m_samples.PrepareForCpuAccess();
+	chunk->m_samples.PrepareForCpuAccess();
+
+	//Find where the chunk goes in the buffer
+	if(len == 0)
+		wfm->m_triggerPhase = chunk->m_triggerPhase;
+	int64_t delta = chunk->m_triggerPhase - wfm->m_triggerPhase;
+	int64_t start;
+	if(delta >= 0)
+		start = (delta + timescale/2) / timescale;
+	else
+		start = -((-delta + timescale/2) / timescale);
+
+	//Skip whatever we already have
+	size_t skip = 0;
+	if(start < (int64_t)len)
+		skip = static_cast<size_t>(min((int64_t)len - start, (int64_t)n));
+	n -= skip;
+
+	//Fill any gap by holding the last sample, or start over if it's too long to bother
+	size_t pad = 0;
+	if(start > (int64_t)len)
+		pad = start - len;
+	if(pad >= depth)
+	{
+		wfm->m_triggerPhase += start * timescale;
+		stream.m_epoch = ++m_lastEpoch;
+		len = 0;
+		pad = 0;
+	}
+	float hold = 0;
+	if(len > 0)
+		hold = wfm->m_samples[len - 1];
+
+	//Drop the oldest samples once there's no room left
+	size_t add = pad + n;
+	if(len + add > 2*depth)
+	{
+		size_t keep = 0;
+		if(add < depth)
+			keep = depth - add;
+		size_t drop = len - keep;
+
+		float* p = wfm->m_samples.GetCpuPointer();
+		memmove(p, p + drop, keep * sizeof(float));
+
+		wfm->m_triggerPhase += (int64_t)drop * timescale;
+		len = keep;
+	}
+
+	if(wfm->m_samples.capacity() < 2*depth)
+		wfm->m_samples.reserve(2*depth);
+	wfm->m_samples.resize(len + add);
+	float* p = wfm->m_samples.GetCpuPointer() + len;
+	for(size_t i=0; i<pad; i++)
+		p[i] = hold;
+	memcpy(p + pad, chunk->m_samples.GetCpuPointer() + skip, n * sizeof(float));
+	wfm->m_samples.MarkModifiedFromCpu();
+
+	wfm->m_startTimestamp = chunk->m_startTimestamp;
+	wfm->m_startFemtoseconds = chunk->m_startFemtoseconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Accessors
+
+/**
+	@brief Checks if a waveform is one of our roll buffers
+
+	@param wfm		The waveform
+	@param epoch	Set to the roll buffer's epoch. Samples may only have been appended to, or dropped from the start
+					of, a roll buffer since the last time it had the same epoch.
+
+	@return True if wfm is a roll buffer
+ */
+bool RollModeEngine::IsRollWaveform(WaveformBase* wfm, uint64_t& epoch)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	for(auto& it : m_streams)
+	{
+		if(it.second.m_wfm == wfm)
+		{
+			epoch = it.second.m_epoch;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+	@brief Gets all of the roll buffers, including ones retired but not deleted yet
+
+	These are owned by us, and must not be added to history. Rendering passes reading any of them must be done before
+	the next Ingest().
+ */
+set<WaveformBase*> RollModeEngine::GetRollWaveforms()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	set<WaveformBase*> ret;
+	for(auto& it : m_streams)
+		ret.emplace(it.second.m_wfm);
+	for(auto w : m_retired)
+		ret.emplace(w);
+	return ret;
+}
+
+/**
+	@brief Gets the X axis position where the new samples of the acquisition going through the filter graph start
+
+	Anything before this in the stream's current waveform is overlap with the previous acquisition, which is already
+	in the roll buffer and shouldn't be counted again. For streams without a roll buffer, the start of the new samples
+	of the instruments is used.
+
+	@return The position in fs, or INT64_MIN if there is no overlap (roll mode is off, or the filter graph is running
+			on data which is already in the roll buffers)
+ */
+int64_t RollModeEngine::GetNewSampleStart(StreamDescriptor stream)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if(!m_pending)
+		return INT64_MIN;
+
+	auto it = m_streams.find(stream);
+	if( (it != m_streams.end()) && (it->second.m_wfm->size() > 0) )
+	{
+		auto wfm = it->second.m_wfm;
+		return wfm->m_triggerPhase + (int64_t)wfm->size() * wfm->m_timescale;
+	}
+	return m_pendingNewStart;
+}
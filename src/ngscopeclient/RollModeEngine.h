@@ -0,0 +1,198 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of RollModeEngine
+ */
+#ifndef RollModeEngine_h
+#define RollModeEngine_h
+
+#include "Marker.h"
+
+/**
+	@brief Roll buffer for a single stream
+ */
+class RollStream
+{
+public:
+	RollStream()
+		: m_wfm(nullptr)
+		, m_epoch(0)
+		, m_received(0)
+		, m_filter(false)
+		, m_chunk(nullptr)
+	{}
+
+	///@brief The waveform displayed on the stream, oldest sample first
+	UniformAnalogWaveform* m_wfm;
+
+	///@brief Changes every time m_wfm is restarted from scratch, rather than appended to
+	uint64_t m_epoch;
+
+	///@brief Length of time received on the stream since m_wfm was restarted, in fs (instrument streams only)
+	int64_t m_received;
+
+	///@brief True if the stream is a filter output (and we hold a reference to the filter)
+	bool m_filter;
+
+	///@brief The filter's own output waveform, put aside while m_wfm is displayed in its place
+	UniformAnalogWaveform* m_chunk;
+};
+
+/**
+	@brief Turns a stream of short acquisitions into a continuously scrolling roll mode display
+
+	Each acquisition from a uniform analog stream is appended to the end of a long waveform covering the last several
+	seconds, which is then displayed in place of the acquisition. The acquisition itself goes straight back to the
+	instrument's waveform pool. Samples are treated as contiguous, so the instrument should be streaming or free
+	running with no dead time between acquisitions.
+
+	The time axis starts at zero at the first sample received, and the start of the roll waveform moves forward as old
+	samples are dropped. Samples which are still in the buffer never change time, or value, so consumers which have
+	already processed the start of the waveform only need to look at what was added since.
+
+	Each acquisition goes through the filter graph, statistics and halt conditions on its own, positioned on the roll
+	time axis by Prepare(), so the cost of processing it doesn't depend on the window length. Prepare() also puts the
+	last few samples of the previous acquisition in front of it, so filters which need some history (such as protocol
+	decoders, or anything with a delay line) see events spanning the two. Ingest() then appends the acquisition, and
+	every filter output computed from it, to the roll buffers. Each waveform is placed by its own time base, so the
+	samples duplicated by the overlap are discarded. The timestamp of a roll buffer is that of the newest acquisition
+	appended to it.
+
+	Runs on WaveformThread. Appending waits for the previous rendering pass to finish reading the waveforms.
+ */
+class RollModeEngine
+{
+public:
+	RollModeEngine();
+	~RollModeEngine();
+
+	/**
+		@brief Turns roll mode on or off
+
+		The roll buffers are freed by the next Ingest() call after roll mode is turned off.
+	 */
+	void SetEnabled(bool enabled)
+	{ m_enabled = enabled; }
+
+	bool IsEnabled()
+	{ return m_enabled; }
+
+	/**
+		@brief Returns true if roll mode is on, or roll buffers still need to be freed
+	 */
+	bool IsActive()
+	{ return m_enabled || m_active; }
+
+	/**
+		@brief Sets the length of time to keep in the roll buffer, in fs
+	 */
+	void SetWindow(int64_t window)
+	{ m_window = window; }
+
+	int64_t GetWindow()
+	{ return m_window; }
+
+	/**
+		@brief Sets how much of the previous acquisition to run through the filter graph again with each new one, in fs
+
+		Capped at the length of the new acquisition, so the filter graph never does more than twice the work.
+	 */
+	void SetOverlap(int64_t overlap)
+	{ m_overlap = overlap; }
+
+	int64_t GetOverlap()
+	{ return m_overlap; }
+
+	/**
+		@brief Gets the X axis position of the end of the newest sample in any roll buffer
+	 */
+	int64_t GetNewestTime()
+	{ return m_newestTime; }
+
+	void Prepare(const std::vector<Oscilloscope*>& scopes);
+	void RestoreFilterOutputs();
+	void Ingest(const std::vector<Oscilloscope*>& scopes, const std::set<Filter*>& filters);
+	void Clear();
+
+	bool IsRollWaveform(WaveformBase* wfm, uint64_t& epoch);
+	std::set<WaveformBase*> GetRollWaveforms();
+	int64_t GetNewSampleStart(StreamDescriptor stream);
+
+	///@brief Most samples to keep in a single roll buffer, regardless of the window length
+	static const size_t MAX_DEPTH = 64 * 1024 * 1024;
+
+protected:
+	RollStream& GetBuffer(StreamDescriptor stream, UniformAnalogWaveform* chunk);
+	void Append(RollStream& stream, UniformAnalogWaveform* chunk, size_t depth);
+	void PrependTail(RollStream& stream, UniformAnalogWaveform* chunk, size_t tail);
+	void RestoreFilterOutput(StreamDescriptor stream, RollStream& rs);
+	void FreeBuffers(bool detach);
+	void DeleteRetiredBuffers();
+
+	///@brief Mutex protecting m_streams
+	std::mutex m_mutex;
+
+	///@brief Roll buffer of each stream
+	std::map<StreamDescriptor, RollStream> m_streams;
+
+	///@brief True if roll mode is on
+	std::atomic<bool> m_enabled;
+
+	///@brief Roll buffers replaced since the last Ingest(), which rendering passes may still be reading
+	std::vector<UniformAnalogWaveform*> m_retired;
+
+	///@brief True if m_streams or m_retired is not empty
+	std::atomic<bool> m_active;
+
+	///@brief Length of time to keep, in fs
+	int64_t m_window;
+
+	///@brief Length of the previous acquisition to put in front of each new one, in fs
+	int64_t m_overlap;
+
+	///@brief End of the newest sample in any roll buffer, in fs
+	std::atomic<int64_t> m_newestTime;
+
+	///@brief Epoch of the most recently restarted roll buffer
+	uint64_t m_lastEpoch;
+
+	///@brief True if Prepare() found a new acquisition that Ingest() hasn't appended yet
+	bool m_pending;
+
+	///@brief Timestamp of that acquisition, which filter outputs computed from it inherit
+	TimePoint m_pendingTimestamp;
+
+	///@brief X axis position where that acquisition's samples stop duplicating ones already in the roll buffers
+	int64_t m_pendingNewStart;
+};
+
+#endif
@@ -42,6 +42,8 @@
 
 #include "../scopehal/LeCroyOscilloscope.h"
 
+#include <future>
+
 extern Event g_waveformReadyEvent;
 extern Event g_waveformProcessedEvent;
 extern Event g_rerenderDoneEvent;
@@ -64,7 +66,12 @@ Session::Session(MainWindow* wnd)
 	, m_triggerArmed(false)
 	, m_triggerOneShot(false)
 	, m_multiScopeFreeRun(false)
+	, m_rearmAfterDisplay(false)
+	, m_stopRequests(0)
+	, m_waveformThreadSettingsGeneration(0)
 	, m_lastFilterGraphExecTime(0)
+	, m_waveformGeneration(0)
+	, m_filterUpdateCount(0)
 	, m_history(*this)
 	, m_nextMarkerNum(1)
 {
@@ -136,6 +143,16 @@ void Session::Clear()
 	//This ordering is important since waveforms removed from history get pushed into the WaveformPool of the scopes,
 	//so the scopes must not have been destroyed yet.
 	m_history.clear();
+	{
+		lock_guard<mutex> lock3(m_pendingHistoryMutex);
+		m_pendingHistory.clear();
+	}
+
+	//Drop our references to any channels we were collecting statistics on, checking for halt conditions,
+	//or tracking skew drift with
+	m_statistics.DisableAll();
+	m_haltConditions.Clear();
+	m_deskewTracker.Clear();
 
 	//Delete scopes once we've terminated the threads
 	//Detach waveforms before we destroy the scope, since history owns them
@@ -150,6 +167,9 @@ void Session::Clear()
 		delete scope;
 	}
 	m_oscilloscopes.clear();
+
+	//Free the roll buffers now that nothing is displaying them
+	m_rollMode.Clear();
 	m_psus.clear();
 	m_rfgenerators.clear();
 	m_meters.clear();
@@ -182,7 +202,11 @@ void Session::ApplyPreferences(Oscilloscope* scope)
 void Session::StartWaveformThreadIfNeeded()
 {
 	if(m_waveformThread == nullptr)
-		m_waveformThread = make_unique<thread>(WaveformThread, this, &m_shuttingDown);
+	{
+		//Preferences are only safe to read on the GUI thread, so look up the queue count here
+		int64_t nqueues = m_preferences.GetInt("Rendering.Rasterizer.render_queues");
+		m_waveformThread = make_unique<thread>(WaveformThread, this, &m_shuttingDown, nqueues);
+	}
 }
 
 void Session::AddOscilloscope(Oscilloscope* scope)
@@ -362,11 +386,60 @@ set<SCPIInstrument*> Session::GetSCPIInstruments()
 
 /**
 	@brief Arms the trigger on all scopes
+
+	@return False if a secondary instrument could not be armed, in which case the trigger is left stopped
  */
-void Session::ArmTrigger(TriggerType type)
+bool Session::ArmTrigger(TriggerType type)
 {
 	lock_guard<mutex> lock(m_scopeMutex);
+	return DoArmTrigger(type);
+}
+
+/**
+	@brief Re-arms the trigger in multi-scope free-run mode, if the re-arm policy says to do it at this point
+
+	The policy comes from WaveformThread's settings. When it says to wait for the GUI, WaveformThread leaves a note
+	for the GUI thread after filtering, so both threads go by the same policy even if the preference just changed.
+
+	@param point	Which stage of the waveform pipeline we're calling from
+ */
+void Session::RearmIfFreeRunning(RearmPolicy point)
+{
+	//GUI thread
+	if(point == REARM_AFTER_DISPLAY)
+	{
+		if(!m_rearmAfterDisplay.exchange(false))
+			return;
+	}
+
+	//WaveformThread
+	else
+	{
+		//Re-arming before the halt conditions are checked would capture another acquisition behind the one that
+		//halts, so wait until they've been checked if there are any
+		auto policy = static_cast<RearmPolicy>(GetWaveformThreadSettings().m_rearmPolicy);
+		if( (policy == REARM_AFTER_DOWNLOAD) && m_haltConditions.IsEnabled() )
+			policy = REARM_AFTER_FILTERS;
+
+		if( (policy == REARM_AFTER_DISPLAY) && (point == REARM_AFTER_FILTERS) )
+			m_rearmAfterDisplay = true;
+		if(policy != point)
+			return;
+	}
+
+	//Check under the lock so we can't race StopTrigger() from the GUI
+	lock_guard<mutex> lock(m_scopeMutex);
+	if(m_multiScopeFreeRun)
+		DoArmTrigger(TRIGGER_TYPE_NORMAL);
+}
+
+/**
+	@brief Arms the trigger on all scopes (caller must hold m_scopeMutex)
 
+	@return False if a secondary instrument could not be armed, in which case the trigger is left stopped
+ */
+bool Session::DoArmTrigger(TriggerType type)
+{
 	bool oneshot = (type == TRIGGER_TYPE_FORCED) || (type == TRIGGER_TYPE_SINGLE);
 	m_triggerOneShot = oneshot;
 
@@ -374,7 +447,7 @@ void Session::ArmTrigger(TriggerType type)
 	{
 		m_tArm = GetTime();
 		m_triggerArmed = true;
-		return;
+		return true;
 	}
 
 	/*
@@ -407,73 +480,138 @@ void Session::ArmTrigger(TriggerType type)
 		}
 	}
 
-	for(ssize_t i=m_oscilloscopes.size()-1; i >= 0; i--)
+	//If we have >1 scope, all secondaries always use single trigger synced to the primary's trigger output.
+	//Arm them all at once, so the time this takes doesn't grow with the number of instruments.
+	//Instruments which time out are retried until the overall deadline.
+	//StopTrigger() can't get the lock until we're done, so give up if it's waiting.
+	double overallDeadline = GetTime() + 10;
+	vector<Oscilloscope*> pending(m_oscilloscopes.begin() + 1, m_oscilloscopes.end());
+	while(!pending.empty() && !IsArmingCanceled() && (GetTime() < overallDeadline) )
 	{
-		//If we have >1 scope, all secondaries always use single trigger synced to the primary's trigger output
-		if(i > 0)
-			m_oscilloscopes[i]->StartSingleTrigger();
+		//All instruments share one deadline per attempt
+		//(must be longer than the default 2 sec socket timeout)
+		double deadline = min(GetTime() + 3, overallDeadline);
 
-		else
+		vector<future<bool> > armed;
+		for(auto scope : pending)
+			armed.push_back(async(launch::async, &Session::ArmSecondary, this, scope, deadline));
+
+		//Retry any that timed out
+		vector<Oscilloscope*> failed;
+		for(size_t i=0; i<pending.size(); i++)
 		{
-			switch(type)
+			if(!armed[i].get())
 			{
-				//Normal trigger: all scopes lock-step for multi scope
-				//for single scope, use normal trigger
-				case TRIGGER_TYPE_NORMAL:
-					if(m_oscilloscopes.size() > 1)
-						m_oscilloscopes[i]->StartSingleTrigger();
-					else
-						m_oscilloscopes[i]->Start();
-					break;
+				LogWarning("Timeout waiting for scope %s to arm\n", pending[i]->m_nickname.c_str());
+				pending[i]->Stop();
+				failed.push_back(pending[i]);
+			}
+		}
+		pending = failed;
+	}
 
-				case TRIGGER_TYPE_AUTO:
-					LogError("ArmTrigger(TRIGGER_TYPE_AUTO) not implemented\n");
-					break;
+	//Never start the primary unless every secondary is ready for the event, or they'd miss it.
+	//Stop the ones we did arm, so nothing is left waiting for a trigger that will never come.
+	if(!pending.empty())
+	{
+		if(IsArmingCanceled())
+			LogTrace("Trigger stopped while arming\n");
+		else
+		{
+			for(auto scope : pending)
+				LogError("Scope %s did not arm, trigger not started\n", scope->m_nickname.c_str());
+		}
 
-				case TRIGGER_TYPE_SINGLE:
-					m_oscilloscopes[i]->StartSingleTrigger();
-					break;
+		for(size_t i=1; i<m_oscilloscopes.size(); i++)
+			m_oscilloscopes[i]->Stop();
+		m_multiScopeFreeRun = false;
+		m_triggerArmed = false;
+		return false;
+	}
 
-				case TRIGGER_TYPE_FORCED:
-					m_oscilloscopes[i]->ForceTrigger();
-					break;
+	//Every secondary is ready for the event, now the primary can go
+	auto prim = m_oscilloscopes[0];
+	switch(type)
+	{
+		//Normal trigger: all scopes lock-step for multi scope
+		//for single scope, use normal trigger
+		case TRIGGER_TYPE_NORMAL:
+			if(m_oscilloscopes.size() > 1)
+				prim->StartSingleTrigger();
+			else
+				prim->Start();
+			break;
 
-				default:
-					break;
-			}
-		}
+		case TRIGGER_TYPE_AUTO:
+			LogError("ArmTrigger(TRIGGER_TYPE_AUTO) not implemented\n");
+			break;
 
-		//If we have multiple scopes, ping the secondaries to make sure the arm command went through
-		if(i != 0)
-		{
-			double start = GetTime();
+		case TRIGGER_TYPE_SINGLE:
+			prim->StartSingleTrigger();
+			break;
 
-			while(!m_oscilloscopes[i]->PeekTriggerArmed())
-			{
-				//After 3 sec of no activity, time out
-				//(must be longer than the default 2 sec socket timeout)
-				double now = GetTime();
-				if( (now - start) > 3)
-				{
-					LogWarning("Timeout waiting for scope %s to arm\n",  m_oscilloscopes[i]->m_nickname.c_str());
-					m_oscilloscopes[i]->Stop();
-					m_oscilloscopes[i]->StartSingleTrigger();
-					start = now;
-				}
-			}
+		case TRIGGER_TYPE_FORCED:
+			prim->ForceTrigger();
+			break;
 
-			//Scope is armed. Clear any garbage in the pending queue
-			m_oscilloscopes[i]->ClearPendingWaveforms();
-		}
+		default:
+			break;
 	}
+
 	m_tArm = GetTime();
 	m_triggerArmed = true;
+	return true;
+}
+
+/**
+	@brief Arms a secondary instrument and waits for it to confirm
+
+	Runs on its own thread, one per secondary, while ArmTrigger() holds m_scopeMutex.
+
+	@param scope	The instrument
+	@param deadline	Time to give up at, as returned by GetTime()
+
+	@return True if the instrument is armed, false if it timed out or arming was canceled
+ */
+bool Session::ArmSecondary(Oscilloscope* scope, double deadline)
+{
+	scope->StartSingleTrigger();
+
+	//Poll with exponential backoff: quick to notice an instrument that arms right away,
+	//without burning a core on one that takes a while
+	auto delay = chrono::microseconds(50);
+	while(!scope->PeekTriggerArmed())
+	{
+		if( (GetTime() > deadline) || IsArmingCanceled() )
+			return false;
+
+		this_thread::sleep_for(delay);
+		delay = min(delay * 2, chrono::microseconds(5000));
+	}
+
+	//Scope is armed. Clear any garbage in the pending queue
+	scope->ClearPendingWaveforms();
+	return true;
 }
 
 /**
 	@brief Stop the trigger on all scopes
  */
 void Session::StopTrigger()
+{
+	//Arming several instruments can take a while, and holds the lock the whole time. Tell it to give up.
+	m_stopRequests ++;
+	{
+		lock_guard<mutex> lock(m_scopeMutex);
+		DoStopTrigger();
+	}
+	m_stopRequests --;
+}
+
+/**
+	@brief Stop the trigger on all scopes (caller must hold m_scopeMutex)
+ */
+void Session::DoStopTrigger()
 {
 	m_multiScopeFreeRun = false;
 	m_triggerArmed = false;
@@ -533,7 +671,7 @@ bool Session::CheckForPendingWaveforms()
 				twait*1000);
 
 			//Cancel any pending triggers
-			StopTrigger();
+			DoStopTrigger();
 
 			//Discard all pending waveform data
 			for(auto scope : m_oscilloscopes)
@@ -547,7 +685,7 @@ bool Session::CheckForPendingWaveforms()
 			}
 
 			//Re-arm the trigger and get back to polling
-			ArmTrigger(TRIGGER_TYPE_NORMAL);
+			DoArmTrigger(TRIGGER_TYPE_NORMAL);
 			return false;
 		}
 	}
@@ -568,6 +706,7 @@ void Session::DownloadWaveforms()
 
 	lock_guard<recursive_mutex> lock(m_waveformDataMutex);
 	lock_guard<mutex> lock2(m_scopeMutex);
+	m_waveformGeneration ++;
 
 	//Process the waveform data from each instrument
 	for(auto scope : m_oscilloscopes)
@@ -643,9 +782,124 @@ void Session::DownloadWaveforms()
 				}
 			}
 		}
+
+		//Correct for any drift since the coefficients were last updated
+		m_deskewTracker.Update(m_oscilloscopes, m_scopeDeskewCal);
+	}
+
+	//In roll mode, put the new data where it will go at the end of what we already had
+	if(m_rollMode.IsActive())
+		m_rollMode.Prepare(m_oscilloscopes);
+}
+
+/**
+	@brief Appends the acquisition that just went through the filter graph to the roll buffers, and displays them
+
+	Runs in WaveformThread once the filter graph, statistics and halt conditions have all seen the new samples on
+	their own, and rendering is done with the roll buffers.
+ */
+void Session::AppendToRollBuffers()
+{
+	if(!m_rollMode.IsActive())
+		return;
+
+	lock_guard<recursive_mutex> lock(m_waveformDataMutex);
+	lock_guard<mutex> lock2(m_scopeMutex);
+
+	set<Filter*> filters;
+	{
+		lock_guard<mutex> lock3(m_filterUpdatingMutex);
+		filters = Filter::GetAllInstances();
+	}
+	m_rollMode.Ingest(m_oscilloscopes, filters);
+}
+
+/**
+	@brief Gets the number of segments to download in this pass of WaveformThread
+
+	In batch mode this is every waveform that all instruments have queued (typically a whole segmented capture),
+	otherwise always one.
+ */
+size_t Session::GetBatchSegmentCount()
+{
+	if(!GetWaveformThreadSettings().m_batchIngest)
+		return 1;
+
+	lock_guard<mutex> lock(m_scopeMutex);
+
+	size_t count = SIZE_MAX;
+	for(auto scope : m_oscilloscopes)
+	{
+		if(scope->IsOffline())
+			continue;
+		count = min(count, scope->GetPendingWaveformCount());
+	}
+	if( (count == SIZE_MAX) || (count == 0) )
+		return 1;
+	return count;
+}
+
+/**
+	@brief Checks if a segment of a batch which won't be displayed has to go through the filter graph
+
+	Filter outputs aren't kept in history, so they're only needed if something looks at them before the next segment
+	is downloaded: the segment overlay, roll mode, or halt conditions or statistics on a filter output. Otherwise only
+	the last segment of the batch is filtered.
+ */
+bool Session::SegmentNeedsFilterGraph()
+{
+	if(GetWaveformThreadSettings().m_overlaySegments || m_rollMode.IsActive())
+		return true;
+	return m_haltConditions.UsesFilterOutputs() || m_statistics.UsesFilterOutputs();
+}
+
+/**
+	@brief Merges the current acquisition into the statistics, for segments which skip the filter graph
+
+	RefreshAllFilters() does this itself after running the graph.
+ */
+void Session::UpdateStatistics()
+{
+	lock_guard<recursive_mutex> lock(m_waveformDataMutex);
+	m_statistics.Update(m_rollMode);
+}
+
+/**
+	@brief Moves the waveform just downloaded aside for the GUI to add to history
+
+	Called on WaveformThread for every acquisition, once it has been through the filter graph, including segments of a
+	batch and waveforms which are never displayed in frame skip mode. The next DownloadWaveforms() call detaches the
+	waveforms from the instruments, leaving the pending history point as their owner.
+ */
+void Session::SaveSegmentToHistory()
+{
+	lock_guard<recursive_mutex> lock(m_waveformDataMutex);
+
+	//Roll buffers aren't ours to give away, they're appended to in place
+	auto pt = HistoryManager::CreateHistoryPoint(GetScopes(), m_rollMode.GetRollWaveforms());
+	if(pt)
+	{
+		lock_guard<mutex> lock2(m_pendingHistoryMutex);
+		m_pendingHistory.push_back(pt);
 	}
 }
 
+/**
+	@brief Picks up the latest preferences published by the GUI thread (WaveformThread only)
+
+	The roll mode settings are applied to the roll mode engine here, so they only change between passes.
+ */
+void Session::UpdateWaveformThreadSettings()
+{
+	if(!m_waveformThreadSettings.Update())
+		return;
+
+	auto& settings = m_waveformThreadSettings.GetFrontBuffer();
+	m_rollMode.SetEnabled(settings.m_rollEnabled);
+	m_rollMode.SetWindow(settings.m_rollWindow);
+	m_rollMode.SetOverlap(settings.m_rollOverlap);
+}
+
 /**
 	@brief Check if new waveform data has arrived
 
@@ -655,41 +909,94 @@ void Session::DownloadWaveforms()
 
 	@return True if a new waveform came in, false if not
  */
-bool Session::CheckForWaveforms(vk::raii::CommandBuffer& cmdbuf)
+bool Session::CheckForWaveforms()
 {
 	bool hadNewWaveforms = false;
 
+	//Preferences aren't thread safe, so WaveformThread gets a copy of its settings from here whenever they change
+	if(m_preferences.GetGeneration() != m_waveformThreadSettingsGeneration)
+	{
+		WaveformThreadSettings settings;
+		settings.m_cpuSparseIndexSearch =
+			(m_preferences.GetEnumRaw("Rendering.Rasterizer.sparse_index_search") == 1);
+		settings.m_decimationPyramid = m_preferences.GetBool("Rendering.Rasterizer.decimation_pyramid");
+		settings.m_digitalBatch = m_preferences.GetBool("Rendering.Rasterizer.digital_batch");
+		settings.m_eyeColorRamp = m_preferences.GetEnumRaw("Appearance.Graphs.eye_color_ramp");
+		settings.m_tiledRasterizer = m_preferences.GetBool("Rendering.Rasterizer.tiled");
+		settings.m_renderAhead = m_preferences.GetReal("Rendering.Rasterizer.render_ahead");
+		settings.m_rearmPolicy = m_preferences.GetEnumRaw("Acquisition.Multi-Scope.rearm_policy");
+		settings.m_batchIngest = m_preferences.GetBool("Acquisition.Segmented.batch_ingest");
+		settings.m_overlaySegments = (m_preferences.GetEnumRaw("Acquisition.Segmented.segment_display") == 1);
+		settings.m_frameSkip = m_preferences.GetBool("Acquisition.Display Rate.frame_skip");
+		settings.m_skippedPersistence = m_preferences.GetBool("Acquisition.Display Rate.skipped_persistence");
+		settings.m_rollEnabled = m_preferences.GetBool("Acquisition.Roll Mode.enabled");
+		settings.m_rollWindow = m_preferences.GetReal("Acquisition.Roll Mode.window");
+		settings.m_rollOverlap = m_preferences.GetReal("Acquisition.Roll Mode.overlap");
+
+		m_waveformThreadSettings.GetBackBuffer() = settings;
+		m_waveformThreadSettings.Publish();
+		m_waveformThreadSettingsGeneration = m_preferences.GetGeneration();
+	}
+
 	if(g_waveformReadyEvent.Peek())
 	{
 		LogTrace("Waveform is ready\n");
 
-		//Add to history
-		auto scopes = GetScopes();
 		{
-			lock_guard<recursive_mutex> lock2(m_waveformDataMutex);
-			m_history.AddHistory(scopes);
+			lock_guard<mutex> lock(m_perfClockMutex);
+			m_waveformDisplayRate.Tick();
 		}
 
-		//Tone-map all of our waveforms
-		//(does not need waveform data locked since it only works on *rendered* data)
-		hadNewWaveforms = true;
-		m_mainWindow->ToneMapAllWaveforms(cmdbuf);
+		//Make sure the waveform we're about to show is in history
+		AddPendingHistory(true);
 
-		//Release the waveform processing thread
+		//Release the waveform processing thread so it can start downloading the next waveform.
+		//It already tone mapped this one, the textures come to the front once rendering completes.
 		g_waveformProcessedEvent.Signal();
+		hadNewWaveforms = true;
 
-		//In multi-scope free-run mode, re-arm every instrument's trigger after we've processed all data
-		if(m_multiScopeFreeRun)
-			ArmTrigger(TRIGGER_TYPE_NORMAL);
+		//In multi-scope free-run mode, re-arm every instrument's trigger now if we didn't do it earlier
+		RearmIfFreeRunning(REARM_AFTER_DISPLAY);
 	}
 
-	//If a re-render operation completed, tone map everything again
-	if((g_rerenderDoneEvent.Peek() || g_refilterDoneEvent.Peek()) && !hadNewWaveforms)
-		m_mainWindow->ToneMapAllWaveforms(cmdbuf);
+	//Waveforms we skipped displaying still go in history, but don't hold up the GUI for them
+	else
+		AddPendingHistory(false);
 
 	return hadNewWaveforms;
 }
 
+/**
+	@brief Moves waveforms queued by WaveformThread into history
+
+	This runs in the main GUI thread.
+
+	@param block	If false, and WaveformThread is busy with the waveform data, leave them for the next frame
+ */
+void Session::AddPendingHistory(bool block)
+{
+	vector<shared_ptr<HistoryPoint> > points;
+	{
+		lock_guard<mutex> lock(m_pendingHistoryMutex);
+		if(m_pendingHistory.empty())
+			return;
+		points.swap(m_pendingHistory);
+	}
+
+	unique_lock<recursive_mutex> lock(m_waveformDataMutex, defer_lock);
+	if(block)
+		lock.lock();
+	else if(!lock.try_lock())
+	{
+		//Put them back in front of anything that arrived in the meantime
+		lock_guard<mutex> lock2(m_pendingHistoryMutex);
+		m_pendingHistory.insert(m_pendingHistory.begin(), points.begin(), points.end());
+		return;
+	}
+
+	m_history.AddHistory(points);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Filter processing
 
@@ -711,6 +1018,35 @@ void Session::RefreshAllFiltersNonblocking()
 	g_refilterRequestedEvent.Signal();
 }
 
+/**
+	@brief Gets the waveforms the filter graph will overwrite in place the next time it runs
+
+	Roll buffers displayed on filters aren't included, since each filter gets its own output back before it runs.
+ */
+set<WaveformBase*> Session::GetFilterOutputs()
+{
+	lock_guard<recursive_mutex> lock(m_waveformDataMutex);
+
+	set<Filter*> filters;
+	{
+		lock_guard<mutex> lock2(m_filterUpdatingMutex);
+		filters = Filter::GetAllInstances();
+	}
+
+	auto roll = m_rollMode.GetRollWaveforms();
+	set<WaveformBase*> ret;
+	for(auto f : filters)
+	{
+		for(size_t i=0; i<f->GetStreamCount(); i++)
+		{
+			auto data = f->GetData(i);
+			if(data && (roll.find(data) == roll.end()) )
+				ret.emplace(data);
+		}
+	}
+	return ret;
+}
+
 void Session::RefreshAllFilters()
 {
 	double tstart = GetTime();
@@ -723,20 +1059,46 @@ void Session::RefreshAllFilters()
 		filters = Filter::GetAllInstances();
 	}
 
+	//Filters must never write to a roll buffer
+	m_rollMode.RestoreFilterOutputs();
+
 	{
 		shared_lock<shared_mutex> lock3(g_vulkanActivityMutex);
 		m_graphExecutor.RunBlocking(filters);
 	}
+	m_waveformGeneration ++;
+	m_filterUpdateCount ++;
 	UpdatePacketManagers(filters);
 
-	//Update statistic displays after the filter graph update is complete
-	//for(auto g : m_waveformGroups)
-	//	g->RefreshMeasurements();
-	LogTrace("TODO: refresh statistics\n");
+	//Update statistics after the filter graph update is complete
+	m_statistics.Update(m_rollMode);
 
 	m_lastFilterGraphExecTime = (GetTime() - tstart) * FS_PER_SECOND;
 }
 
+/**
+	@brief Stops the trigger if the acquisition that just went through the filter graph matches the halt conditions
+
+	Runs in WaveformThread, before the GUI sees the acquisition, so the trigger is stopped before anything else is
+	downloaded and the matching acquisition stays current.
+
+	@return True if the trigger was stopped
+ */
+bool Session::CheckHaltConditions()
+{
+	int64_t timestamp;
+	{
+		lock_guard<recursive_mutex> lock(m_waveformDataMutex);
+		if(!m_haltConditions.Evaluate(timestamp))
+			return false;
+	}
+
+	LogTrace("Halt condition matched\n");
+	StopTrigger();
+	m_haltConditions.OnHalted(timestamp);
+	return true;
+}
+
 /**
 	@brief Update all of the packet managers when new data arrives
  */
@@ -785,9 +1147,29 @@ int64_t Session::GetToneMapTime()
 	return m_mainWindow->GetToneMapTime();
 }
 
-void Session::RenderWaveformTextures(vk::raii::CommandBuffer& cmdbuf, vector<shared_ptr<DisplayedChannel> >& channels)
+size_t Session::GetRasterizedChannelCount()
+{
+	return m_mainWindow->GetRasterizedChannelCount();
+}
+
+size_t Session::GetRasterizeSkippedChannelCount()
+{
+	return m_mainWindow->GetRasterizeSkippedChannelCount();
+}
+
+size_t Session::GetToneMappedChannelCount()
+{
+	return m_mainWindow->GetToneMappedChannelCount();
+}
+
+size_t Session::GetToneMapSkippedChannelCount()
+{
+	return m_mainWindow->GetToneMapSkippedChannelCount();
+}
+
+void Session::RenderWaveformTextures(WaveformRenderRing& ring, vector<shared_ptr<DisplayedChannel> >& channels)
 {
-	m_mainWindow->RenderWaveformTextures(cmdbuf, channels);
+	m_mainWindow->RenderWaveformTextures(ring, channels);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -44,6 +44,12 @@ class DisplayedChannel;
 #include "PacketManager.h"
 #include "PreferenceManager.h"
 #include "Marker.h"
+#include "DeskewTracker.h"
+#include "RollModeEngine.h"
+#include "HaltConditionEngine.h"
+#include "StatisticsEngine.h"
+#include "WaveformRenderRing.h"
+#include "TripleBuffer.h"
 
 extern std::atomic<int64_t> g_lastWaveformRenderTime;
 
@@ -150,6 +156,76 @@ public:
 	std::unique_ptr<std::thread> m_thread;
 };
 
+/**
+	@brief Preferences used by WaveformThread and the render lanes
+
+	Preferences aren't thread safe, so the GUI thread copies these out whenever they change (see
+	Session::CheckForWaveforms()). WaveformThread picks up the latest copy at the start of each pass, so they don't
+	change partway through rendering.
+ */
+class WaveformThreadSettings
+{
+public:
+	WaveformThreadSettings()
+		: m_cpuSparseIndexSearch(false)
+		, m_decimationPyramid(false)
+		, m_digitalBatch(true)
+		, m_eyeColorRamp(0)
+		, m_tiledRasterizer(false)
+		, m_renderAhead(0)
+		, m_rearmPolicy(0)
+		, m_batchIngest(false)
+		, m_overlaySegments(false)
+		, m_frameSkip(false)
+		, m_skippedPersistence(false)
+		, m_rollEnabled(false)
+		, m_rollWindow(10 * FS_PER_SECOND)
+		, m_rollOverlap(FS_PER_SECOND / 10)
+	{}
+
+	///@brief True to calculate X axis indexes of sparse waveforms on the CPU
+	bool m_cpuSparseIndexSearch;
+
+	///@brief True to draw zoomed out uniform analog waveforms from decimation pyramids
+	bool m_decimationPyramid;
+
+	///@brief True to draw the uniform digital channels of each plot as one batch
+	bool m_digitalBatch;
+
+	///@brief Color ramp for eye patterns, spectrograms, and waterfalls (an EyeColorRamp value)
+	int64_t m_eyeColorRamp;
+
+	///@brief True to always use the tiled rasterizer
+	bool m_tiledRasterizer;
+
+	///@brief Render-ahead margin on each side of a plot, as a fraction of its width
+	double m_renderAhead;
+
+	///@brief When to re-arm in multi-scope free-run mode (a Session::RearmPolicy value)
+	int64_t m_rearmPolicy;
+
+	///@brief True to download everything the instruments have queued at once
+	bool m_batchIngest;
+
+	///@brief True to draw every segment of a batch
+	bool m_overlaySegments;
+
+	///@brief True to only draw waveforms when the GUI is ready for them
+	bool m_frameSkip;
+
+	///@brief True to draw skipped waveforms into persistence when the GPU is idle
+	bool m_skippedPersistence;
+
+	///@brief True if roll mode is on
+	bool m_rollEnabled;
+
+	///@brief Length of time to keep in the roll buffers, in fs
+	int64_t m_rollWindow;
+
+	///@brief Length of the previous acquisition to filter again with each new one in roll mode, in fs
+	int64_t m_rollOverlap;
+};
+
 /**
 	@brief A Session stores all of the instrument configuration and other state the user has open.
 
@@ -169,16 +245,47 @@ public:
 		TRIGGER_TYPE_AUTO,
 		TRIGGER_TYPE_NORMAL
 	};
-	void ArmTrigger(TriggerType type);
+	bool ArmTrigger(TriggerType type);
 	void StopTrigger();
+
+	/**
+		@brief When to re-arm the trigger in multi-scope free-run mode
+	 */
+	enum RearmPolicy
+	{
+		///@brief As soon as every instrument's waveform has been downloaded, before running filters
+		REARM_AFTER_DOWNLOAD,
+
+		///@brief Once the filter graph and halt conditions have been run
+		REARM_AFTER_FILTERS,
+
+		///@brief Once the GUI has picked up the waveform
+		REARM_AFTER_DISPLAY
+	};
+	void RearmIfFreeRunning(RearmPolicy point);
 	bool HasOnlineScopes();
 	void DownloadWaveforms();
-	bool CheckForWaveforms(vk::raii::CommandBuffer& cmdbuf);
+	void AppendToRollBuffers();
+	size_t GetBatchSegmentCount();
+	void SaveSegmentToHistory();
+	bool SegmentNeedsFilterGraph();
+	void UpdateStatistics();
+	bool CheckForWaveforms();
+
+	void UpdateWaveformThreadSettings();
+
+	/**
+		@brief Gets the preferences WaveformThread is currently using (WaveformThread and render lanes only)
+	 */
+	const WaveformThreadSettings& GetWaveformThreadSettings()
+	{ return m_waveformThreadSettings.GetFrontBuffer(); }
 	void RefreshAllFilters();
 	void RefreshAllFiltersNonblocking();
+	std::set<WaveformBase*> GetFilterOutputs();
+	bool CheckHaltConditions();
 
 	void RenderWaveformTextures(
-		vk::raii::CommandBuffer& cmdbuf,
+		WaveformRenderRing& ring,
 		std::vector<std::shared_ptr<DisplayedChannel> >& channels);
 
 	void Clear();
@@ -211,6 +318,10 @@ public:
 	bool IsChannelBeingDragged();
 
 	int64_t GetToneMapTime();
+	size_t GetRasterizedChannelCount();
+	size_t GetRasterizeSkippedChannelCount();
+	size_t GetToneMappedChannelCount();
+	size_t GetToneMapSkippedChannelCount();
 
 	/**
 		@brief Gets the last execution time of the filter graph
@@ -224,6 +335,29 @@ public:
 	int64_t GetLastWaveformRenderTime()
 	{ return g_lastWaveformRenderTime.load(); }
 
+	/**
+		@brief Gets a counter which is incremented every time waveform data may have changed
+
+		Used to invalidate state cached from waveform contents (new acquisitions, filter graph updates, etc.)
+	 */
+	uint64_t GetWaveformGeneration()
+	{ return m_waveformGeneration.load(); }
+
+	/**
+		@brief Gets the number of times the filter graph has been run
+
+		Every filter is refreshed on each run, so this also counts how many times each filter has updated its output.
+		Unlike GetWaveformGeneration(), it doesn't change when new waveforms are downloaded but not yet processed.
+	 */
+	uint64_t GetFilterUpdateCount()
+	{ return m_filterUpdateCount.load(); }
+
+	/**
+		@brief Gets the ring of command buffers used by WaveformThread to submit rendering passes
+	 */
+	WaveformRenderRing& GetRenderRing()
+	{ return m_renderRing; }
+
 	/**
 		@brief Gets the average rate at which we are pulling waveforms off the scope, in Hz
 	 */
@@ -233,6 +367,12 @@ public:
 		return m_waveformDownloadRate.GetAverageHz();
 	}
 
+	double GetWaveformDisplayRate()
+	{
+		std::lock_guard<std::mutex> lock(m_perfClockMutex);
+		return m_waveformDisplayRate.GetAverageHz();
+	}
+
 	/**
 		@brief Get the set of scopes we're currently connected to
 	 */
@@ -264,6 +404,30 @@ public:
 	HistoryManager& GetHistory()
 	{ return m_history; }
 
+	/**
+		@brief Get our measurement statistics
+	 */
+	StatisticsEngine& GetStatistics()
+	{ return m_statistics; }
+
+	/**
+		@brief Get our halt conditions
+	 */
+	HaltConditionEngine& GetHaltConditions()
+	{ return m_haltConditions; }
+
+	/**
+		@brief Get our multi-scope skew drift tracker
+	 */
+	DeskewTracker& GetDeskewTracker()
+	{ return m_deskewTracker; }
+
+	/**
+		@brief Get our roll mode engine
+	 */
+	RollModeEngine& GetRollMode()
+	{ return m_rollMode; }
+
 	/**
 		@brief Adds a marker
 	 */
@@ -274,6 +438,16 @@ public:
 
 protected:
 	void UpdatePacketManagers(const std::set<Filter*>& filters);
+	bool DoArmTrigger(TriggerType type);
+	void DoStopTrigger();
+	void AddPendingHistory(bool block);
+	bool ArmSecondary(Oscilloscope* scope, double deadline);
+
+	/**
+		@brief Returns true if arming the trigger should give up, because it's being stopped or we're shutting down
+	 */
+	bool IsArmingCanceled()
+	{ return m_shuttingDown || (m_stopRequests > 0); }
 
 	///@brief Mutex for controlling access to scope vectors
 	std::mutex m_scopeMutex;
@@ -299,6 +473,12 @@ protected:
 	///@brief Deskew correction coefficients for multi-scope
 	std::map<Oscilloscope*, int64_t> m_scopeDeskewCal;
 
+	///@brief Keeps m_scopeDeskewCal up to date as the instruments drift
+	DeskewTracker m_deskewTracker;
+
+	///@brief Appends incoming waveforms to the roll buffers in roll mode
+	RollModeEngine m_rollMode;
+
 	///@brief Power supplies we are currently connected to
 	std::map<PowerSupply*, std::unique_ptr<PowerSupplyConnectionState> > m_psus;
 
@@ -317,6 +497,9 @@ protected:
 	///@brief Processing thread for waveform data
 	std::unique_ptr<std::thread> m_waveformThread;
 
+	///@brief Rendering passes submitted by m_waveformThread which may still be executing
+	WaveformRenderRing m_renderRing;
+
 	///@brief Time we last armed the global trigger
 	double m_tArm;
 
@@ -330,7 +513,19 @@ protected:
 	bool m_triggerOneShot;
 
 	///@brief True if we have multiple scopes and are in normal trigger mode
-	bool m_multiScopeFreeRun;
+	std::atomic<bool> m_multiScopeFreeRun;
+
+	///@brief Set by WaveformThread when the GUI should re-arm in multi-scope free-run mode once it shows the waveform
+	std::atomic<bool> m_rearmAfterDisplay;
+
+	///@brief Number of StopTrigger() calls waiting for m_scopeMutex, so an arm in progress knows to give up
+	std::atomic<int> m_stopRequests;
+
+	///@brief Preferences used by WaveformThread, published by the GUI thread
+	TripleBuffer<WaveformThreadSettings> m_waveformThreadSettings;
+
+	///@brief Preference generation m_waveformThreadSettings was last published for (GUI thread only)
+	uint64_t m_waveformThreadSettingsGeneration;
 
 	///@brief Context for filter graph evaluation
 	FilterGraphExecutor m_graphExecutor;
@@ -338,15 +533,34 @@ protected:
 	///@brief Time spent on the last filter graph execution
 	std::atomic<int64_t> m_lastFilterGraphExecTime;
 
+	///@brief Incremented every time waveform data may have changed
+	std::atomic<uint64_t> m_waveformGeneration;
+
+	///@brief Number of times the filter graph has been run
+	std::atomic<uint64_t> m_filterUpdateCount;
+
 	///@brief Mutex for controlling access to performance counters
 	std::mutex m_perfClockMutex;
 
 	///@brief Frequency at which we are pulling waveforms off of scopes
 	HzClock m_waveformDownloadRate;
+	HzClock m_waveformDisplayRate;
 
 	///@brief Historical waveform data
 	HistoryManager m_history;
 
+	///@brief Mutex for controlling access to m_pendingHistory
+	std::mutex m_pendingHistoryMutex;
+
+	///@brief Waveforms waiting to be added to history by the GUI thread
+	std::vector<std::shared_ptr<HistoryPoint> > m_pendingHistory;
+
+	///@brief Running statistics on selected streams
+	StatisticsEngine m_statistics;
+
+	///@brief Conditions for stopping the trigger
+	HaltConditionEngine m_haltConditions;
+
 	///@brief Mutex for controlling access to m_packetmgrs
 	std::mutex m_packetMgrMutex;
 
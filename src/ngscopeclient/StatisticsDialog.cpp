@@ -0,0 +1,154 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of StatisticsDialog
+ */
+
+#include "ngscopeclient.h"
+#include "StatisticsDialog.h"
+#include "Session.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+StatisticsDialog::StatisticsDialog(Session* session)
+	: Dialog("Statistics", ImVec2(600, 300))
+	, m_session(session)
+{
+}
+
+StatisticsDialog::~StatisticsDialog()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rendering
+
+/**
+	@brief Renders the dialog and handles UI events
+
+	@return		True if we should continue showing the dialog
+				False if it's been closed
+ */
+bool StatisticsDialog::DoRender()
+{
+	auto& stats = m_session->GetStatistics();
+
+	//Never blocks, so we can redraw at full rate even during heavy acquisition
+	auto& snaps = stats.GetSnapshot();
+	if(snaps.empty())
+	{
+		ImGui::TextUnformatted("No streams selected");
+		HelpMarker("Select \"Statistics\" from the context menu of an analog channel to start collecting statistics on it.");
+		return true;
+	}
+
+	if(ImGui::Button("Clear"))
+		stats.Clear();
+	Dialog::Tooltip("Reset all running totals");
+
+	static ImGuiTableFlags flags =
+		ImGuiTableFlags_Resizable |
+		ImGuiTableFlags_BordersOuter |
+		ImGuiTableFlags_BordersV |
+		ImGuiTableFlags_RowBg;
+
+	Unit counts(Unit::UNIT_COUNTS);
+	float width = ImGui::GetFontSize();
+	float height = ImGui::GetTextLineHeightWithSpacing() * 2;
+	if(ImGui::BeginTable("statistics", 8, flags))
+	{
+		ImGui::TableSetupColumn("Channel", ImGuiTableColumnFlags_WidthFixed, 8*width);
+		ImGui::TableSetupColumn("Samples", ImGuiTableColumnFlags_WidthFixed, 5*width);
+		ImGui::TableSetupColumn("Min", ImGuiTableColumnFlags_WidthFixed, 5*width);
+		ImGui::TableSetupColumn("Max", ImGuiTableColumnFlags_WidthFixed, 5*width);
+		ImGui::TableSetupColumn("Mean", ImGuiTableColumnFlags_WidthFixed, 5*width);
+		ImGui::TableSetupColumn("Std dev", ImGuiTableColumnFlags_WidthFixed, 5*width);
+		ImGui::TableSetupColumn("Histogram", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 4*width);
+		ImGui::TableHeadersRow();
+
+		for(auto& s : snaps)
+		{
+			ImGui::PushID(s.m_name.c_str());
+			ImGui::TableNextRow();
+
+			ImGui::TableSetColumnIndex(0);
+			ImGui::TextUnformatted(s.m_name.c_str());
+
+			ImGui::TableSetColumnIndex(1);
+			ImGui::TextUnformatted(counts.PrettyPrint(s.m_count).c_str());
+			Dialog::Tooltip(to_string(s.m_acquisitions) + " acquisitions");
+
+			if(s.m_count > 0)
+			{
+				ImGui::TableSetColumnIndex(2);
+				ImGui::TextUnformatted(s.m_unit.PrettyPrint(s.m_min).c_str());
+
+				ImGui::TableSetColumnIndex(3);
+				ImGui::TextUnformatted(s.m_unit.PrettyPrint(s.m_max).c_str());
+
+				ImGui::TableSetColumnIndex(4);
+				ImGui::TextUnformatted(s.m_unit.PrettyPrint(s.m_mean).c_str());
+
+				ImGui::TableSetColumnIndex(5);
+				ImGui::TextUnformatted(s.m_unit.PrettyPrint(s.m_stddev).c_str());
+
+				ImGui::TableSetColumnIndex(6);
+				ImGui::PlotHistogram(
+					"###histogram",
+					s.m_histogram.data(),
+					s.m_histogram.size(),
+					0,
+					nullptr,
+					0,
+					FLT_MAX,
+					ImVec2(ImGui::GetContentRegionAvail().x, height));
+				Dialog::Tooltip(
+					s.m_unit.PrettyPrint(s.m_histogramMin) + " to " +
+					s.m_unit.PrettyPrint(s.m_histogramMin + s.m_histogramBinWidth*s.m_histogram.size()));
+			}
+
+			ImGui::TableSetColumnIndex(7);
+			if(ImGui::Button("Remove"))
+				stats.Disable(s.m_stream);
+
+			ImGui::PopID();
+		}
+
+		ImGui::EndTable();
+	}
+
+	return true;
+}
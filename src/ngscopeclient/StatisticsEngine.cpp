@@ -0,0 +1,415 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of StatisticsEngine
+ */
+
+#include "ngscopeclient.h"
+#include "StatisticsEngine.h"
+#include "RollModeEngine.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamingHistogram
+
+StreamingHistogram::StreamingHistogram()
+{
+	Clear();
+}
+
+void StreamingHistogram::Clear()
+{
+	m_min = 0;
+	m_binWidth = 0;
+	for(size_t i=0; i<NUM_BINS; i++)
+		m_bins[i] = 0;
+}
+
+/**
+	@brief Grows the range of the histogram, if needed, to cover [vmin, vmax]
+
+	Each doubling merges adjacent bins pairwise and keeps the edge opposite the new values fixed, so existing counts
+	stay in the right place. The number of doublings is logarithmic in the dynamic range of the data.
+ */
+void StreamingHistogram::Extend(double vmin, double vmax)
+{
+	//First data: start with a range just covering it
+	if(m_binWidth == 0)
+	{
+		double range = vmax - vmin;
+		if(range <= 0)
+			range = max(fabs(vmin) * 1e-6, 1e-12);
+
+		m_min = vmin;
+		m_binWidth = range / NUM_BINS;
+
+		//Make sure the largest value isn't sitting right on the upper edge
+		m_binWidth *= 1.0001;
+		return;
+	}
+
+	const size_t half = NUM_BINS / 2;
+	while(vmax >= m_min + m_binWidth*NUM_BINS)
+	{
+		for(size_t i=0; i<half; i++)
+			m_bins[i] = m_bins[i*2] + m_bins[i*2 + 1];
+		for(size_t i=half; i<NUM_BINS; i++)
+			m_bins[i] = 0;
+		m_binWidth *= 2;
+	}
+
+	while(vmin < m_min)
+	{
+		for(size_t i=NUM_BINS-1; i>=half; i--)
+			m_bins[i] = m_bins[(i-half)*2] + m_bins[(i-half)*2 + 1];
+		for(size_t i=0; i<half; i++)
+			m_bins[i] = 0;
+		m_min -= m_binWidth*NUM_BINS;
+		m_binWidth *= 2;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// StreamAccumulator
+
+StreamAccumulator::StreamAccumulator()
+	: m_lastWaveform(nullptr)
+	, m_lastTimestamp(0, 0)
+{
+	Clear();
+}
+
+void StreamAccumulator::Clear()
+{
+	m_count = 0;
+	m_mean = 0;
+	m_m2 = 0;
+	m_min = FLT_MAX;
+	m_max = -FLT_MAX;
+	m_acquisitions = 0;
+	m_histogram.Clear();
+
+	//Leave m_lastWaveform alone so the waveform currently on screen isn't counted again after a clear
+}
+
+/**
+	@brief Merges the samples of a new waveform into the running totals
+
+	The new samples are reduced to a count, mean, and M2 in two passes (which is more accurate than Welford's
+	single-sample update over a large block), then combined with the running totals using the parallel form of
+	Welford's algorithm. The merge costs the same regardless of how many acquisitions came before.
+
+	@param data	The waveform
+	@param from	X axis position of the first sample to merge, in fs. Earlier samples were merged with the previous
+				acquisition (see RollModeEngine::GetNewSampleStart()).
+ */
+void StreamAccumulator::Update(WaveformBase* data, int64_t from)
+{
+	//Skip if we've already merged this acquisition
+	TimePoint stamp(data->m_startTimestamp, data->m_startFemtoseconds);
+	if( (data == m_lastWaveform) && (stamp == m_lastTimestamp) )
+		return;
+	m_lastWaveform = data;
+	m_lastTimestamp = stamp;
+
+	AcceleratorBuffer<float>* samples = nullptr;
+	auto udata = dynamic_cast<UniformAnalogWaveform*>(data);
+	auto sdata = dynamic_cast<SparseAnalogWaveform*>(data);
+	if(udata)
+		samples = &udata->m_samples;
+	else if(sdata)
+		samples = &sdata->m_samples;
+	else
+		return;
+
+	//Skip samples we've already seen, rounding to the nearest sample the same way roll buffers do
+	size_t first = 0;
+	if(from != INT64_MIN)
+	{
+		int64_t timescale = data->m_timescale;
+		if(udata)
+		{
+			int64_t delta = from - udata->m_triggerPhase;
+			if(delta > 0)
+				first = (delta + timescale/2) / timescale;
+		}
+		else
+		{
+			sdata->m_offsets.PrepareForCpuAccess();
+			while( (first < sdata->size()) && (::GetOffsetScaled(sdata, udata, first) + timescale/2 < from) )
+				first ++;
+		}
+	}
+
+	samples->PrepareForCpuAccess();
+	size_t len = samples->size();
+	float* p = samples->GetCpuPointer();
+	first = min(first, len);
+
+	//First pass: count, sum, and range of the finite samples
+	uint64_t n = 0;
+	double sum = 0;
+	float vmin = FLT_MAX;
+	float vmax = -FLT_MAX;
+	for(size_t i=first; i<len; i++)
+	{
+		float v = p[i];
+		if(!isfinite(v))
+			continue;
+		n ++;
+		sum += v;
+		vmin = min(vmin, v);
+		vmax = max(vmax, v);
+	}
+	if(n == 0)
+		return;
+	double mean = sum / n;
+
+	//Second pass: squared deviations, and histogram the samples now that we know the range
+	m_histogram.Extend(vmin, vmax);
+	double m2 = 0;
+	for(size_t i=first; i<len; i++)
+	{
+		float v = p[i];
+		if(!isfinite(v))
+			continue;
+		double d = v - mean;
+		m2 += d*d;
+		m_histogram.Add(v);
+	}
+
+	//Merge into the running totals
+	double total = m_count + n;
+	double delta = mean - m_mean;
+	m_mean += delta * n / total;
+	m_m2 += m2 + delta*delta * m_count * n / total;
+	m_count += n;
+	m_min = min(m_min, (double)vmin);
+	m_max = max(m_max, (double)vmax);
+	m_acquisitions ++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+StatisticsEngine::StatisticsEngine()
+	: m_clearRequested(false)
+{
+}
+
+StatisticsEngine::~StatisticsEngine()
+{
+	DisableAll();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stream selection
+
+/**
+	@brief Starts collecting statistics on a stream
+ */
+void StatisticsEngine::Enable(StreamDescriptor stream)
+{
+	lock_guard<mutex> lock(m_mutex);
+	if(m_accumulators.find(stream) != m_accumulators.end())
+		return;
+
+	stream.m_channel->AddRef();
+	m_accumulators[stream];
+	Publish();
+}
+
+/**
+	@brief Stops collecting statistics on a stream and discards its totals
+ */
+void StatisticsEngine::Disable(StreamDescriptor stream)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto it = m_accumulators.find(stream);
+	if(it == m_accumulators.end())
+		return;
+
+	m_accumulators.erase(it);
+	stream.m_channel->Release();
+	Publish();
+}
+
+/**
+	@brief Checks if statistics are being collected on a stream (GUI thread only)
+
+	Looks at the published snapshot rather than taking the lock, so it never waits for an update in progress.
+ */
+bool StatisticsEngine::IsEnabled(StreamDescriptor stream)
+{
+	for(auto& s : GetSnapshot())
+	{
+		if(s.m_stream == stream)
+			return true;
+	}
+	return false;
+}
+
+/**
+	@brief Stops collecting statistics on all streams
+ */
+void StatisticsEngine::DisableAll()
+{
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& it : m_accumulators)
+	{
+		auto chan = it.first.m_channel;
+		chan->Release();
+	}
+	m_accumulators.clear();
+	Publish();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Updating
+
+/**
+	@brief Resets the running totals of all tracked streams
+
+	If an update is in progress, the reset is deferred to the next update rather than waiting for it.
+ */
+void StatisticsEngine::Clear()
+{
+	unique_lock<mutex> lock(m_mutex, try_to_lock);
+	if(!lock.owns_lock())
+	{
+		m_clearRequested = true;
+		return;
+	}
+
+	for(auto& it : m_accumulators)
+		it.second.Clear();
+	Publish();
+}
+
+/**
+	@brief Merges the current waveform of each tracked stream into its running totals
+
+	Called after every filter graph run, with the waveform data mutex held.
+
+	@param roll	Roll mode state. Roll buffers are skipped since their samples were merged as they arrived, and so is
+				the overlap that acquisitions in roll mode share with the previous one.
+ */
+void StatisticsEngine::Update(RollModeEngine& roll)
+{
+	lock_guard<mutex> lock(m_mutex);
+	bool clear = m_clearRequested.exchange(false);
+	if(m_accumulators.empty())
+		return;
+	auto rollWaveforms = roll.GetRollWaveforms();
+
+	for(auto& it : m_accumulators)
+	{
+		if(clear)
+			it.second.Clear();
+
+		auto data = it.first.GetData();
+		if(!data || (rollWaveforms.find(data) != rollWaveforms.end()) )
+			continue;
+
+		int64_t from = INT64_MIN;
+		if(it.first.m_channel->GetXAxisUnits().GetType() == Unit::UNIT_FS)
+			from = roll.GetNewSampleStart(it.first);
+		it.second.Update(data, from);
+	}
+
+	Publish();
+}
+
+/**
+	@brief Checks if statistics are being collected on any filter output, rather than only instrument channels
+ */
+bool StatisticsEngine::UsesFilterOutputs()
+{
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& it : m_accumulators)
+	{
+		if(dynamic_cast<Filter*>(it.first.m_channel) != nullptr)
+			return true;
+	}
+	return false;
+}
+
+/**
+	@brief Copies the running totals into the back buffer and hands it to the GUI
+
+	Must be called with m_mutex held, since that is what keeps us down to a single writer.
+ */
+void StatisticsEngine::Publish()
+{
+	auto& snaps = m_snapshots.GetBackBuffer();
+	snaps.resize(m_accumulators.size());
+
+	size_t i = 0;
+	for(auto& it : m_accumulators)
+	{
+		auto& acc = it.second;
+		auto& snap = snaps[i++];
+
+		snap.m_stream = it.first;
+		snap.m_name = it.first.GetName();
+		snap.m_unit = it.first.GetYAxisUnits();
+		snap.m_count = acc.m_count;
+		snap.m_acquisitions = acc.m_acquisitions;
+		snap.m_min = acc.m_min;
+		snap.m_max = acc.m_max;
+		snap.m_mean = acc.m_mean;
+		if(acc.m_count > 1)
+			snap.m_stddev = sqrt(acc.m_m2 / (acc.m_count - 1));
+		else
+			snap.m_stddev = 0;
+
+		snap.m_histogramMin = acc.m_histogram.m_min;
+		snap.m_histogramBinWidth = acc.m_histogram.m_binWidth;
+		snap.m_histogram.resize(StreamingHistogram::NUM_BINS);
+		for(size_t j=0; j<StreamingHistogram::NUM_BINS; j++)
+			snap.m_histogram[j] = acc.m_histogram.m_bins[j];
+	}
+
+	m_snapshots.Publish();
+}
+
+/**
+	@brief Gets the most recently published statistics (GUI thread only)
+
+	Never blocks. The returned reference stays valid until the next call.
+ */
+const vector<StreamStatisticsSnapshot>& StatisticsEngine::GetSnapshot()
+{
+	m_snapshots.Update();
+	return m_snapshots.GetFrontBuffer();
+}
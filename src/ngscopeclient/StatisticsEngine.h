@@ -0,0 +1,191 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of StatisticsEngine
+ */
+#ifndef StatisticsEngine_h
+#define StatisticsEngine_h
+
+#include "Marker.h"
+#include "TripleBuffer.h"
+
+class RollModeEngine;
+
+/**
+	@brief Histogram of a stream of values whose range is not known in advance
+
+	The bin count is fixed. When a value falls outside the current range, the range is doubled and adjacent bins are
+	merged pairwise, so memory and per-update cost stay constant no matter how long the run has been going.
+ */
+class StreamingHistogram
+{
+public:
+	StreamingHistogram();
+
+	void Clear();
+	void Extend(double vmin, double vmax);
+
+	/**
+		@brief Adds a value, which must already be within the range covered by Extend()
+	 */
+	void Add(double v)
+	{
+		size_t bin = (v - m_min) / m_binWidth;
+		if(bin >= NUM_BINS)
+			bin = NUM_BINS - 1;
+		m_bins[bin] ++;
+	}
+
+	static const size_t NUM_BINS = 64;
+
+	///@brief Lower edge of the first bin
+	double m_min;
+
+	///@brief Width of each bin (zero if the histogram is empty)
+	double m_binWidth;
+
+	///@brief Number of values in each bin
+	uint64_t m_bins[NUM_BINS];
+};
+
+/**
+	@brief Running statistics for a single stream
+ */
+class StreamAccumulator
+{
+public:
+	StreamAccumulator();
+
+	void Clear();
+	void Update(WaveformBase* data, int64_t from);
+
+	///@brief Total number of samples seen
+	uint64_t m_count;
+
+	///@brief Mean of all samples seen
+	double m_mean;
+
+	///@brief Sum of squared deviations from the mean (Welford's M2)
+	double m_m2;
+
+	///@brief Smallest sample seen
+	double m_min;
+
+	///@brief Largest sample seen
+	double m_max;
+
+	///@brief Number of acquisitions merged
+	uint64_t m_acquisitions;
+
+	///@brief Distribution of all samples seen
+	StreamingHistogram m_histogram;
+
+	///@brief The waveform we last merged, so re-running the filter graph on the same data doesn't count it twice
+	WaveformBase* m_lastWaveform;
+
+	///@brief Timestamp of the waveform we last merged
+	TimePoint m_lastTimestamp;
+};
+
+/**
+	@brief Point-in-time copy of the statistics for one stream, for display
+ */
+class StreamStatisticsSnapshot
+{
+public:
+	StreamDescriptor m_stream;
+	std::string m_name;
+	Unit m_unit;
+	uint64_t m_count;
+	uint64_t m_acquisitions;
+	double m_min;
+	double m_max;
+	double m_mean;
+	double m_stddev;
+	double m_histogramMin;
+	double m_histogramBinWidth;
+	std::vector<float> m_histogram;
+
+	StreamStatisticsSnapshot()
+		: m_unit(Unit::UNIT_COUNTS)
+		, m_count(0)
+		, m_acquisitions(0)
+		, m_min(0)
+		, m_max(0)
+		, m_mean(0)
+		, m_stddev(0)
+		, m_histogramMin(0)
+		, m_histogramBinWidth(0)
+	{}
+};
+
+/**
+	@brief Accumulates statistics on selected streams as each acquisition's filter outputs arrive
+
+	Update() runs on the filter graph thread and does one pass over the new samples of each tracked stream, then merges
+	the result into the running totals in constant time. The GUI reads the totals through a triple buffer and never
+	blocks the filter graph.
+ */
+class StatisticsEngine
+{
+public:
+	StatisticsEngine();
+	~StatisticsEngine();
+
+	void Enable(StreamDescriptor stream);
+	void Disable(StreamDescriptor stream);
+	bool IsEnabled(StreamDescriptor stream);
+	void DisableAll();
+
+	void Clear();
+	void Update(RollModeEngine& roll);
+	bool UsesFilterOutputs();
+
+	const std::vector<StreamStatisticsSnapshot>& GetSnapshot();
+
+protected:
+	void Publish();
+
+	///@brief Mutex protecting m_accumulators
+	std::mutex m_mutex;
+
+	///@brief Running totals for each tracked stream
+	std::map<StreamDescriptor, StreamAccumulator> m_accumulators;
+
+	///@brief Set when the GUI asks for the totals to be reset
+	std::atomic<bool> m_clearRequested;
+
+	///@brief Snapshots published to the GUI
+	TripleBuffer< std::vector<StreamStatisticsSnapshot> > m_snapshots;
+};
+
+#endif
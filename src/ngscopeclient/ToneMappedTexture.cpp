@@ -0,0 +1,159 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of ToneMappedTexture
+ */
+#include "ngscopeclient.h"
+#include "ToneMappedTexture.h"
+#include "WaveformArea.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+ToneMappedTexture::ToneMappedTexture(const string& name)
+	: m_name(name)
+	, m_width(0)
+	, m_height(0)
+	, m_allocPending(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Buffer management
+
+/**
+	@brief Gets a free texture to tone map into
+
+	Called by WaveformThread while recording a rendering pass. Every texture returned must be matched by one call to
+	OnToneMapComplete() once the pass has completed (see WaveformRenderRing::AddToneMapOutput()).
+
+	@param width			Width of the tone mapped image
+	@param height			Height of the tone mapped image
+	@param xAxisOffset		X axis position of the left edge of the image
+	@param pixelsPerXUnit	X axis scale of the image, or zero if it always fills the plot (eye patterns etc)
+
+	@return The texture, or null if there is no free texture of that size yet. The GUI thread will allocate one.
+ */
+shared_ptr<Texture> ToneMappedTexture::GetBackBuffer(
+	size_t width,
+	size_t height,
+	int64_t xAxisOffset,
+	double pixelsPerXUnit)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_width = width;
+	m_height = height;
+
+	for(size_t i=0; i<m_free.size(); i++)
+	{
+		if( (m_free[i].m_width == width) && (m_free[i].m_height == height) )
+		{
+			auto buf = m_free[i];
+			buf.m_xAxisOffset = xAxisOffset;
+			buf.m_pixelsPerXUnit = pixelsPerXUnit;
+			m_free.erase(m_free.begin() + i);
+			m_inFlight.push_back(buf);
+			return buf.m_texture;
+		}
+	}
+
+	m_allocPending = true;
+	return nullptr;
+}
+
+/**
+	@brief Marks the oldest texture returned by GetBackBuffer() as completely tone mapped
+
+	Called by WaveformRenderRing when the rendering pass that wrote it has completed.
+ */
+void ToneMappedTexture::OnToneMapComplete()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if(m_inFlight.empty())
+		return;
+
+	//If the previous ready texture was never drawn, it was never touched by the GUI either
+	if(m_ready.m_texture)
+		m_free.push_back(m_ready);
+
+	m_ready = m_inFlight.front();
+	m_inFlight.pop_front();
+}
+
+/**
+	@brief Brings the newest ready texture (if any) to the front, and allocates any texture WaveformThread asked for
+
+	Called by the GUI thread at the start of each frame, before anything is drawn.
+
+	@param top	Main window (for the texture manager)
+
+	@return True if a new texture was allocated, and the waveform needs to be rendered again to use it
+ */
+bool ToneMappedTexture::Flip(MainWindow* top)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	//The frame which last used the retiring texture completed before the previous frame was submitted
+	if(m_retiring.m_texture)
+	{
+		m_free.push_back(m_retiring);
+		m_retiring = ToneMapBuffer();
+	}
+
+	if(m_ready.m_texture)
+	{
+		m_retiring = m_front;
+		m_front = m_ready;
+		m_ready = ToneMapBuffer();
+	}
+
+	//Free textures of any other size are left over from before a resize and can go away
+	vector<ToneMapBuffer> keep;
+	for(auto& f : m_free)
+	{
+		if( (f.m_width == m_width) && (f.m_height == m_height) )
+			keep.push_back(f);
+	}
+	m_free.swap(keep);
+
+	if(!m_allocPending)
+		return false;
+
+	LogTrace("Allocating %zu x %zu texture for %s\n", m_width, m_height, m_name.c_str());
+	m_free.push_back(ToneMapBuffer(MakeWaveformTexture(m_width, m_height, top, m_name), m_width, m_height));
+	m_allocPending = false;
+	return true;
+}
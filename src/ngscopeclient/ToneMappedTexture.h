@@ -0,0 +1,141 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of ToneMappedTexture
+ */
+#ifndef ToneMappedTexture_h
+#define ToneMappedTexture_h
+
+#include <deque>
+
+class MainWindow;
+
+/**
+	@brief A texture, its size, and the X axis range of the image in it
+ */
+class ToneMapBuffer
+{
+public:
+	ToneMapBuffer(std::shared_ptr<Texture> tex = nullptr, size_t width = 0, size_t height = 0)
+	: m_texture(tex)
+	, m_width(width)
+	, m_height(height)
+	, m_xAxisOffset(0)
+	, m_pixelsPerXUnit(0)
+	{}
+
+	std::shared_ptr<Texture> m_texture;
+	size_t m_width;
+	size_t m_height;
+
+	///@brief X axis position of the left edge of the image
+	int64_t m_xAxisOffset;
+
+	///@brief X axis scale of the image, or zero if the image is not tied to the X axis and fills the plot
+	double m_pixelsPerXUnit;
+};
+
+/**
+	@brief The chain of textures a waveform is tone mapped into
+
+	WaveformThread tone maps into a back buffer as part of each rendering pass. When the pass completes, the back buffer
+	becomes ready, and the GUI thread flips it to the front at the start of its next frame. The GUI always samples a
+	complete image and never waits for tone mapping to finish.
+
+	The old front buffer may still be sampled by the frame in flight, so it's only reused after one more frame.
+
+	Textures are only created and destroyed by the GUI thread, since that registers them with ImGui. If WaveformThread
+	finds no free texture of the size it needs, it skips the channel and asks for one; the GUI thread allocates it
+	during the next Flip() and requests another rendering pass.
+ */
+class ToneMappedTexture
+{
+public:
+	ToneMappedTexture(const std::string& name);
+
+	std::shared_ptr<Texture> GetBackBuffer(
+		size_t width,
+		size_t height,
+		int64_t xAxisOffset = 0,
+		double pixelsPerXUnit = 0);
+	void OnToneMapComplete();
+	bool Flip(MainWindow* top);
+
+	/**
+		@brief Returns the texture the GUI should draw
+	 */
+	std::shared_ptr<Texture> GetFrontBuffer()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_front.m_texture;
+	}
+
+	/**
+		@brief Returns the texture the GUI should draw, along with the X axis range of its image
+	 */
+	ToneMapBuffer GetFront()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_front;
+	}
+
+protected:
+	///@brief Mutex protecting all of the buffers
+	std::mutex m_mutex;
+
+	///@brief Name for the textures, for debugging
+	std::string m_name;
+
+	///@brief Texture currently drawn by the GUI
+	ToneMapBuffer m_front;
+
+	///@brief Completely tone mapped texture which has not been drawn yet
+	ToneMapBuffer m_ready;
+
+	///@brief Previous front buffer, which may still be in use by the frame in flight
+	ToneMapBuffer m_retiring;
+
+	///@brief Textures being written by rendering passes which have not completed yet, oldest first
+	std::deque<ToneMapBuffer> m_inFlight;
+
+	///@brief Textures which aren't used by anything and can be written to
+	std::vector<ToneMapBuffer> m_free;
+
+	///@brief Size of the image WaveformThread last tone mapped, or tried to
+	size_t m_width;
+	size_t m_height;
+
+	///@brief True if WaveformThread found no free texture of the current size
+	bool m_allocPending;
+};
+
+#endif
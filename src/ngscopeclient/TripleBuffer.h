@@ -0,0 +1,109 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of TripleBuffer
+ */
+#ifndef TripleBuffer_h
+#define TripleBuffer_h
+
+/**
+	@brief Wait-free exchange of a value from one writer thread to one reader thread
+
+	The writer fills the back buffer and publishes it, the reader picks up the most recently published buffer. Neither
+	side ever blocks the other: the only shared state is the index of the middle buffer, which is swapped atomically.
+
+	Buffers are recycled, so the writer must fully overwrite the back buffer before each publish.
+ */
+template<class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+		: m_back(0)
+		, m_middle(1)
+		, m_front(2)
+	{}
+
+	/**
+		@brief Gets the buffer the writer should fill in next (writer thread only)
+	 */
+	T& GetBackBuffer()
+	{ return m_buffers[m_back]; }
+
+	/**
+		@brief Makes the back buffer visible to the reader (writer thread only)
+	 */
+	void Publish()
+	{ m_back = m_middle.exchange(m_back | FRESH_FLAG) & INDEX_MASK; }
+
+	/**
+		@brief Picks up the most recently published buffer, if any (reader thread only)
+
+		@return True if a new buffer was published since the last call
+	 */
+	bool Update()
+	{
+		if( (m_middle.load() & FRESH_FLAG) == 0)
+			return false;
+
+		m_front = m_middle.exchange(m_front) & INDEX_MASK;
+		return true;
+	}
+
+	/**
+		@brief Gets the buffer most recently picked up by Update() (reader thread only)
+	 */
+	const T& GetFrontBuffer() const
+	{ return m_buffers[m_front]; }
+
+protected:
+
+	///@brief Set in m_middle when it holds a buffer the reader has not seen yet
+	static const uint32_t FRESH_FLAG = 0x4;
+
+	///@brief Mask for the buffer index in m_middle
+	static const uint32_t INDEX_MASK = 0x3;
+
+	///@brief The buffers themselves
+	T m_buffers[3];
+
+	///@brief Index of the buffer owned by the writer
+	uint32_t m_back;
+
+	///@brief Index of the buffer in transit between writer and reader, plus FRESH_FLAG
+	std::atomic<uint32_t> m_middle;
+
+	///@brief Index of the buffer owned by the reader
+	uint32_t m_front;
+};
+
+#endif
@@ -34,27 +34,128 @@
  */
 #include "ngscopeclient.h"
 #include "WaveformArea.h"
+#include "CpuRasterizer.h"
 #include "MainWindow.h"
 #include "../../scopehal/TwoLevelTrigger.h"
+#include "../scopeprotocols/SpectrogramFilter.h"
+#include "../scopeprotocols/Waterfall.h"
 
 #include "imgui_internal.h"	//for SetItemUsingMouseWheel
 
 using namespace std;
 
+///@brief Lane sequence number for the next WaveformArea (plots are assigned to lanes round robin)
+static atomic<size_t> g_nextRenderLane(0);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Texture helpers
+
+/**
+	@brief Creates a texture for tone mapped waveform output, and transitions it to the general layout
+
+	Called by the GUI thread (see ToneMappedTexture).
+ */
+shared_ptr<Texture> MakeWaveformTexture(size_t x, size_t y, MainWindow* top, const string& name)
+{
+	//NOTE: Assumes the render queue is also capable of transfers (see QueueManager)
+	vk::ImageCreateInfo imageInfo(
+		{},
+		vk::ImageType::e2D,
+		vk::Format::eR32G32B32A32Sfloat,
+		vk::Extent3D(x, y, 1),
+		1,
+		1,
+		VULKAN_HPP_NAMESPACE::SampleCountFlagBits::e1,
+		VULKAN_HPP_NAMESPACE::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+		vk::SharingMode::eExclusive,
+		{},
+		vk::ImageLayout::eUndefined
+		);
+
+	auto tex = make_shared<Texture>(*g_vkComputeDevice, imageInfo, top->GetTextureManager(), name);
+
+	//Add a barrier to convert the image format to "general"
+	lock_guard<mutex> lock(g_vkTransferMutex);
+	vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+	vk::ImageMemoryBarrier barrier(
+		vk::AccessFlagBits::eNone,
+		vk::AccessFlagBits::eShaderWrite,
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eGeneral,
+		VK_QUEUE_FAMILY_IGNORED,
+		VK_QUEUE_FAMILY_IGNORED,
+		tex->GetImage(),
+		range);
+	g_vkTransferCommandBuffer->begin({});
+	g_vkTransferCommandBuffer->pipelineBarrier(
+			vk::PipelineStageFlagBits::eTopOfPipe,
+			vk::PipelineStageFlagBits::eComputeShader,
+			{},
+			{},
+			{},
+			barrier);
+	g_vkTransferCommandBuffer->end();
+	g_vkTransferQueue->SubmitAndBlock(*g_vkTransferCommandBuffer);
+
+	return tex;
+}
+
+/**
+	@brief Adds a barrier so tone mapped output written by a compute shader can be read by the fragment shader
+ */
+void AddToneMapOutputBarrier(vk::raii::CommandBuffer& cmdbuf, shared_ptr<Texture> tex)
+{
+	vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+	vk::ImageMemoryBarrier barrier(
+		vk::AccessFlagBits::eShaderWrite,
+		vk::AccessFlagBits::eShaderRead,
+		vk::ImageLayout::eGeneral,
+		vk::ImageLayout::eGeneral,
+		VK_QUEUE_FAMILY_IGNORED,
+		VK_QUEUE_FAMILY_IGNORED,
+		tex->GetImage(),
+		range);
+	cmdbuf.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eFragmentShader,
+			{},
+			{},
+			{},
+			barrier);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // DisplayedChannel
 
 DisplayedChannel::DisplayedChannel(StreamDescriptor stream)
 		: m_stream(stream)
 		, m_rasterizedWaveform("DisplayedChannel.m_rasterizedWaveform")
+		, m_persistenceBuffer("DisplayedChannel.m_persistenceBuffer")
 		, m_indexBuffer("DisplayedChannel.m_indexBuffer")
 		, m_rasterizedX(0)
 		, m_rasterizedY(0)
+		, m_textures(make_shared<ToneMappedTexture>("DisplayedChannel.m_texture"))
 		, m_cachedX(0)
 		, m_cachedY(0)
 		, m_persistenceEnabled(false)
-		, m_toneMapPipe("shaders/WaveformToneMap.spv", 1, sizeof(ToneMapArgs), 1)
+		, m_cpuRasterizerEnabled(false)
+		, m_digitalBatchRow(0)
+		, m_captureLengthWaveform(nullptr)
+		, m_captureLengthGeneration(0)
+		, m_captureLength(0)
 		, m_yButtonPos(0)
+		, m_waterfallPixelsPerXUnit(0)
+		, m_waterfallXAxisOffset(0)
+		, m_toneMapPending(false)
+		, m_toneMapColor(0)
+		, m_toneMapGain(0)
+		, m_toneMapRamp(-1)
+		, m_samplesPerPixel(1)
+		, m_newFrame(false)
+		, m_persistenceClearPending(false)
+		, m_persistenceActive(false)
+		, m_lastRenderPass(0)
 {
 	stream.m_channel->AddRef();
 
@@ -63,9 +164,13 @@ DisplayedChannel::DisplayedChannel(StreamDescriptor stream)
 	m_rasterizedWaveform.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
 	m_rasterizedWaveform.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
 
-	//Use pinned memory for index buffer since it should only be read once
-	m_indexBuffer.SetCpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_LIKELY);
-	m_indexBuffer.SetGpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_UNLIKELY);
+	//Index buffer is normally generated by a shader, so keep it GPU-side
+	m_indexBuffer.SetCpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_UNLIKELY);
+	m_indexBuffer.SetGpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_LIKELY);
+
+	//Persistence buffer is only ever touched by the tone mapping shader
+	m_persistenceBuffer.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_UNLIKELY);
+	m_persistenceBuffer.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
 }
 
 /**
@@ -75,7 +180,7 @@ DisplayedChannel::DisplayedChannel(StreamDescriptor stream)
 
 	@return true if size has changed, false otherwose
  */
-bool DisplayedChannel::UpdateSize(ImVec2 newSize, MainWindow* top)
+bool DisplayedChannel::UpdateSize(ImVec2 newSize)
 {
 	size_t x = newSize.x;
 	size_t y = newSize.y;
@@ -85,59 +190,9 @@ bool DisplayedChannel::UpdateSize(ImVec2 newSize, MainWindow* top)
 		m_cachedX = x;
 		m_cachedY = y;
 
-		//Don't actually create an image object if the image is degenerate (zero pixels)
-		if( (x == 0) || (y == 0) )
-			return true;
-
-		LogTrace("Displayed channel resized (to %zu x %zu), reallocating texture\n", x, y);
-
-		//NOTE: Assumes the render queue is also capable of transfers (see QueueManager)
-		vk::ImageCreateInfo imageInfo(
-			{},
-			vk::ImageType::e2D,
-			vk::Format::eR32G32B32A32Sfloat,
-			vk::Extent3D(x, y, 1),
-			1,
-			1,
-			VULKAN_HPP_NAMESPACE::SampleCountFlagBits::e1,
-			VULKAN_HPP_NAMESPACE::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
-			vk::SharingMode::eExclusive,
-			{},
-			vk::ImageLayout::eUndefined
-			);
-
-		//Keep a reference to the old texture around for one more frame
-		//in case the previous frame hasn't fully completed rendering yet
-		top->AddTextureUsedThisFrame(m_texture);
-
-		//Make the new texture and mark that as in use too
-		m_texture = make_shared<Texture>(
-			*g_vkComputeDevice, imageInfo, top->GetTextureManager(), "DisplayedChannel.m_texture");
-		top->AddTextureUsedThisFrame(m_texture);
-
-		//Add a barrier to convert the image format to "general"
-		lock_guard<mutex> lock(g_vkTransferMutex);
-		vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
-		vk::ImageMemoryBarrier barrier(
-			vk::AccessFlagBits::eNone,
-			vk::AccessFlagBits::eShaderWrite,
-			vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eGeneral,
-			VK_QUEUE_FAMILY_IGNORED,
-			VK_QUEUE_FAMILY_IGNORED,
-			m_texture->GetImage(),
-			range);
-		g_vkTransferCommandBuffer->begin({});
-		g_vkTransferCommandBuffer->pipelineBarrier(
-				vk::PipelineStageFlagBits::eTopOfPipe,
-				vk::PipelineStageFlagBits::eComputeShader,
-				{},
-				{},
-				{},
-				barrier);
-		g_vkTransferCommandBuffer->end();
-		g_vkTransferQueue->SubmitAndBlock(*g_vkTransferCommandBuffer);
+		//Textures of the new size are allocated by the next tone mapping pass
+		LogTrace("Displayed channel resized (to %zu x %zu)\n", x, y);
+		m_toneMapPending = true;
 
 		return true;
 	}
@@ -171,6 +226,72 @@ void DisplayedChannel::PrepareToRasterize(size_t x, size_t y)
 		m_indexBuffer.resize(x);
 }
 
+/**
+	@brief Figures out how the next tone map pass should use the persistence buffer, and clears the new frame flags
+
+	@param npixels	Size of the rasterized waveform
+
+	@return Persistence mode for the tone mapping shader
+ */
+ToneMapPersistMode DisplayedChannel::PrepareToToneMap(size_t npixels)
+{
+	bool newFrame = m_newFrame;
+	bool clear = m_persistenceClearPending;
+	m_newFrame = false;
+	m_persistenceClearPending = false;
+
+	if(!m_persistenceEnabled)
+	{
+		m_persistenceActive = false;
+		return TONEMAP_PERSIST_OFF;
+	}
+
+	//Start over if persistence was just turned on or the waveform was resized
+	if(!m_persistenceActive || (m_persistenceBuffer.size() != npixels) )
+	{
+		m_persistenceBuffer.resize(npixels);
+		m_persistenceActive = true;
+		clear = true;
+	}
+
+	if(clear)
+		return TONEMAP_PERSIST_RESET;
+	else if(newFrame)
+		return TONEMAP_PERSIST_ACCUMULATE;
+	else
+		return TONEMAP_PERSIST_DISPLAY;
+}
+
+/**
+	@brief Gets the offset of the last sample in a waveform, in X axis units
+
+	The result is cached until the waveform or the session's waveform generation changes, so that panning and zooming
+	a sparse waveform does not need a CPU-side copy of its offsets. If the offsets are only current on the GPU, just
+	the last one is read back.
+ */
+int64_t DisplayedChannel::GetCaptureLength(WaveformBase* data, uint64_t generation, WaveformRenderRing& ring)
+{
+	if( (data != m_captureLengthWaveform) || (generation != m_captureLengthGeneration) )
+	{
+		m_captureLengthWaveform = data;
+		m_captureLengthGeneration = generation;
+
+		if(data->empty())
+			m_captureLength = 0;
+		else
+		{
+			size_t last = data->size() - 1;
+			auto sdata = dynamic_cast<SparseWaveformBase*>(data);
+			if(sdata)
+				m_captureLength = ring.ReadBackElement(sdata->m_offsets, last) * data->m_timescale + data->m_triggerPhase;
+			else
+				m_captureLength = last * data->m_timescale + data->m_triggerPhase;
+		}
+	}
+
+	return m_captureLength;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
@@ -183,6 +304,7 @@ WaveformArea::WaveformArea(StreamDescriptor stream, shared_ptr<WaveformGroup> gr
 	, m_yAxisUnit(stream.GetYAxisUnits())
 	, m_dragState(DRAG_STATE_NONE)
 	, m_lastDragState(DRAG_STATE_NONE)
+	, m_digitalBatch(make_shared<DigitalBatchRenderer>())
 	, m_group(group)
 	, m_parent(parent)
 	, m_tLastMouseMove(GetTime())
@@ -192,6 +314,7 @@ WaveformArea::WaveformArea(StreamDescriptor stream, shared_ptr<WaveformGroup> gr
 	, m_lastRightClickOffset(0)
 	, m_channelButtonHeight(0)
 	, m_dragPeakLabel(nullptr)
+	, m_renderLane(g_nextRenderLane ++)
 {
 	m_displayedChannels.push_back(make_shared<DisplayedChannel>(stream));
 }
@@ -239,9 +362,9 @@ StreamDescriptor WaveformArea::GetFirstAnalogStream()
 }
 
 /**
-	@brief Returns the first analog stream or eye pattern displayed in this area.
+	@brief Returns the first analog stream, eye pattern, or spectrogram displayed in this area.
 
-	If no analog waveforms or eye patterns are visible, returns a null stream.
+	If no analog waveforms, eye patterns, or spectrograms are visible, returns a null stream.
  */
 StreamDescriptor WaveformArea::GetFirstAnalogOrEyeStream()
 {
@@ -252,18 +375,30 @@ StreamDescriptor WaveformArea::GetFirstAnalogOrEyeStream()
 			return stream;
 		if(stream.GetType() == Stream::STREAM_TYPE_EYE)
 			return stream;
+		if(stream.GetType() == Stream::STREAM_TYPE_SPECTROGRAM)
+			return stream;
 	}
 
 	return StreamDescriptor(nullptr, 0);
 }
 
 /**
-	@brief Marks all of our waveform textures as being used this frame
+	@brief Brings newly tone mapped textures to the front, then marks them as being used this frame
+
+	Called by the GUI thread at the start of each frame.
  */
 void WaveformArea::ReferenceWaveformTextures()
 {
+	//If a texture had to be allocated, render again so it gets used
 	for(auto chan : m_displayedChannels)
+	{
+		if(chan->GetTextures()->Flip(m_parent))
+			m_parent->SetNeedRender();
 		m_parent->AddTextureUsedThisFrame(chan->GetTexture());
+	}
+	if(m_digitalBatch->GetTextures()->Flip(m_parent))
+		m_parent->SetNeedRender();
+	m_parent->AddTextureUsedThisFrame(m_digitalBatch->GetTexture());
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -336,6 +471,29 @@ StreamDescriptor WaveformArea::GetChannelBeingDragged()
 		return m_dragStream;
 }
 
+/**
+	@brief Keeps the X axis of any waterfall filters we display in sync with our group
+
+	Waterfall filters resample their input to the X axis of the plot. The filter is only changed when the X axis does,
+	with the waveform data mutex held so the filter graph isn't running at the time.
+ */
+void WaveformArea::UpdateWaterfallTimebases()
+{
+	double pixelsPerXUnit = m_group->GetPixelsPerXUnit();
+	int64_t xAxisOffset = m_group->GetXAxisOffset();
+
+	for(auto& chan : m_displayedChannels)
+	{
+		auto fall = dynamic_cast<Waterfall*>(chan->GetStream().m_channel);
+		if(!fall || !chan->UpdateWaterfallTimebase(pixelsPerXUnit, xAxisOffset))
+			continue;
+
+		lock_guard<recursive_mutex> lock(m_parent->GetSession().GetWaveformDataMutex());
+		fall->SetTimeScale(pixelsPerXUnit);
+		fall->SetTimeOffset(xAxisOffset);
+	}
+}
+
 /**
 	@brief Renders a waveform area
 
@@ -385,6 +543,7 @@ bool WaveformArea::Render(int iArea, int numAreas, ImVec2 clientArea)
 		m_pixelsPerYAxisUnit = unspacedHeightPerArea / first.GetVoltageRange();
 		m_yAxisUnit = first.GetYAxisUnits();
 	}
+	UpdateWaterfallTimebases();
 
 	//Size of the Y axis view at the right of the plot
 	float yAxisWidth = m_group->GetYAxisWidth();
@@ -554,6 +713,12 @@ void WaveformArea::RenderWaveforms(ImVec2 start, ImVec2 size)
 				RenderProtocolWaveform(chan, start, size);
 				break;
 
+			case Stream::STREAM_TYPE_EYE:
+			case Stream::STREAM_TYPE_SPECTROGRAM:
+			case Stream::STREAM_TYPE_WATERFALL:
+				RenderDensityWaveform(chan, start, size);
+				break;
+
 			default:
 				LogWarning("Unimplemented stream type %d, don't know how to render it\n", stream.GetType());
 				break;
@@ -574,13 +739,11 @@ void WaveformArea::RenderAnalogWaveform(shared_ptr<DisplayedChannel> channel, Im
 	auto list = ImGui::GetWindowDrawList();
 
 	//Mark the waveform as resized
-	if(channel->UpdateSize(size, m_parent))
+	if(channel->UpdateSize(size))
 		m_parent->SetNeedRender();
 
 	//Render the tone mapped output (if we have it)
-	auto tex = channel->GetTexture();
-	if(tex != nullptr)
-		list->AddImage(tex->GetTexture(), start, ImVec2(start.x+size.x, start.y+size.y), ImVec2(0, 1), ImVec2(1, 0) );
+	RenderToneMappedImage(list, channel->GetTextures()->GetFront(), start, size);
 
 	//If it's a peak detection filter, draw the peaks and annotations
 	auto pf = dynamic_cast<PeakDetectionFilter*>(stream.m_channel);
@@ -588,6 +751,74 @@ void WaveformArea::RenderAnalogWaveform(shared_ptr<DisplayedChannel> channel, Im
 		RenderSpectrumPeaks(list, channel);
 }
 
+/**
+	@brief Renders a single eye pattern, spectrogram, or waterfall
+ */
+void WaveformArea::RenderDensityWaveform(shared_ptr<DisplayedChannel> channel, ImVec2 start, ImVec2 size)
+{
+	auto data = channel->GetStream().GetData();
+	if(data == nullptr)
+		return;
+
+	auto list = ImGui::GetWindowDrawList();
+
+	//Mark the waveform as resized
+	if(channel->UpdateSize(size))
+		m_parent->SetNeedRender();
+
+	//Render the tone mapped output (if we have it)
+	RenderToneMappedImage(list, channel->GetTextures()->GetFront(), start, size);
+}
+
+/**
+	@brief Draws the most recent tone mapped image of a waveform
+
+	Images of analog and digital waveforms cover a range of the X axis, which may include render-ahead margins beyond
+	either side of the plot. They're positioned according to the current X axis offset and scale, so panning and
+	zooming move the last image immediately, while the new one is rendered in the background.
+
+	@param list		Draw list to add the image to
+	@param buf		The image
+	@param start	Top left corner of the area to draw in
+	@param size		Size of the area to draw in
+	@param vtop		Texture coordinate of the top of the area
+	@param vbot		Texture coordinate of the bottom of the area
+ */
+void WaveformArea::RenderToneMappedImage(
+	ImDrawList* list,
+	const ToneMapBuffer& buf,
+	ImVec2 start,
+	ImVec2 size,
+	float vtop,
+	float vbot)
+{
+	if(buf.m_texture == nullptr)
+		return;
+
+	ImVec2 end(start.x + size.x, start.y + size.y);
+
+	//Images not tied to the X axis always fill the plot
+	if( (buf.m_pixelsPerXUnit == 0) || (buf.m_width == 0) )
+	{
+		list->AddImage(buf.m_texture->GetTexture(), start, end, ImVec2(0, vtop), ImVec2(1, vbot));
+		return;
+	}
+
+	//Find where the image lies at the current X axis offset and scale
+	double pixelsPerX = m_group->GetPixelsPerXUnit();
+	double left = start.x + (buf.m_xAxisOffset - m_group->GetXAxisOffset()) * pixelsPerX;
+	double right = left + buf.m_width * pixelsPerX / buf.m_pixelsPerXUnit;
+
+	//Clip to the plot, and only draw the matching part of the image
+	float x0 = max(left, (double)start.x);
+	float x1 = min(right, (double)end.x);
+	if(x1 <= x0)
+		return;
+	float u0 = (x0 - left) / (right - left);
+	float u1 = (x1 - left) / (right - left);
+	list->AddImage(buf.m_texture->GetTexture(), ImVec2(x0, start.y), ImVec2(x1, end.y), ImVec2(u0, vtop), ImVec2(u1, vbot));
+}
+
 /**
 	@brief Computes the closest point on a line segment (given the endpoints) to a given point.
 
@@ -910,23 +1141,41 @@ void WaveformArea::RenderDigitalWaveform(shared_ptr<DisplayedChannel> channel, I
 		return;
 
 	auto list = ImGui::GetWindowDrawList();
+	auto ypos = (channel->GetYButtonPos() * ImGui::GetWindowDpiScale()) + start.y;
+
+	//If drawn as part of a batch, our output is one band of the batch texture
+	auto batch = channel->GetDigitalBatch();
+	if(batch)
+	{
+		size_t height = m_channelButtonHeight;
+		size_t nchans = batch->GetChannelCount();
+		if(batch->UpdateSize(ImVec2(size.x, height * nchans)))
+			m_parent->SetNeedRender();
+
+		if(nchans != 0)
+		{
+			float row = channel->GetDigitalBatchRow();
+			RenderToneMappedImage(
+				list,
+				batch->GetTextures()->GetFront(),
+				ImVec2(start.x, ypos - m_channelButtonHeight),
+				ImVec2(size.x, m_channelButtonHeight),
+				(row + 1) / nchans,
+				row / nchans);
+		}
+		return;
+	}
 
 	//Mark the waveform as resized
-	if(channel->UpdateSize(ImVec2(size.x, m_channelButtonHeight), m_parent))
+	if(channel->UpdateSize(ImVec2(size.x, m_channelButtonHeight)))
 		m_parent->SetNeedRender();
 
 	//Render the tone mapped output (if we have it)
-	auto tex = channel->GetTexture();
-	if(tex != nullptr)
-	{
-		auto ypos = (channel->GetYButtonPos() * ImGui::GetWindowDpiScale()) + start.y;
-		list->AddImage(
-			tex->GetTexture(),
-			ImVec2(start.x, ypos - m_channelButtonHeight),
-			ImVec2(start.x+size.x, ypos),
-			ImVec2(0, 1),
-			ImVec2(1, 0) );
-	}
+	RenderToneMappedImage(
+		list,
+		channel->GetTextures()->GetFront(),
+		ImVec2(start.x, ypos - m_channelButtonHeight),
+		ImVec2(size.x, m_channelButtonHeight));
 }
 
 /**
@@ -943,57 +1192,127 @@ void WaveformArea::RenderProtocolWaveform(std::shared_ptr<DisplayedChannel> chan
 
 	auto list = ImGui::GetWindowDrawList();
 
-	//Calculate a bunch of constants
+	auto& cache = channel->GetProtocolRenderCache();
+	UpdateProtocolRenderCache(cache, data, size.x);
+
+	float ybot = (channel->GetYButtonPos() * ImGui::GetWindowDpiScale()) + start.y;
+	float ytop = ybot - m_channelButtonHeight;
+	float ymid = ybot - m_channelButtonHeight/2;
+
+	//Draw the actual stuff
+	float xorigin = m_group->XAxisUnitsToXPosition(cache.m_origin);
+	size_t xend = start.x + size.x;
+	for(auto& span : cache.m_spans)
+	{
+		float xs = xorigin + span.m_xs;
+		float xe = xorigin + span.m_xe;
+
+		if(xe < start.x)
+			continue;
+		if(xs > xend)
+			break;
+
+		RenderComplexSignal(
+			list,
+			start.x, xend,
+			xs, xe, 5,
+			ybot, ymid, ytop,
+			span.m_text,
+			span.m_textSize,
+			span.m_color);
+	}
+}
+
+/**
+	@brief Rebuilds the render list for a protocol waveform, if the waveform or view changed since it was last built
+
+	@param cache	The render list
+	@param data		The waveform being drawn
+	@param width	Width of the plot area, in pixels
+ */
+void WaveformArea::UpdateProtocolRenderCache(ProtocolRenderCache& cache, SparseWaveformBase* data, float width)
+{
+	auto font = m_parent->GetFontPref("Appearance.Decodes.protocol_font");
+	double pixelsPerX = m_group->GetPixelsPerXUnit();
+	uint64_t generation = m_parent->GetSession().GetWaveformGeneration();
+
+	//Split the X axis into chunks one window wide, and figure out which one the view starts in
+	int64_t bucketWidth = max(static_cast<int64_t>(width / pixelsPerX), (int64_t)1);
 	int64_t offset = m_group->GetXAxisOffset();
-	int64_t offset_samples = (offset - data->m_triggerPhase) / data->m_timescale;
+	int64_t bucket = offset / bucketWidth;
+	if( (offset < 0) && (offset % bucketWidth) )
+		bucket --;
+
+	if( (cache.m_data == data) &&
+		(cache.m_generation == generation) &&
+		(cache.m_pixelsPerXUnit == pixelsPerX) &&
+		(cache.m_width == width) &&
+		(cache.m_font == font) &&
+		(cache.m_bucket == bucket) )
+	{
+		return;
+	}
 
-	//Find the index of the first sample visible on screen
+	cache.m_data = data;
+	cache.m_generation = generation;
+	cache.m_pixelsPerXUnit = pixelsPerX;
+	cache.m_width = width;
+	cache.m_font = font;
+	cache.m_bucket = bucket;
+	cache.m_spans.clear();
+
+	//Cover the view's chunk plus one more on either side
+	int64_t rangeStart = (bucket - 1) * bucketWidth;
+	int64_t rangeEnd = (bucket + 2) * bucketWidth;
+	cache.m_origin = rangeStart;
+	double xrangeEnd = (rangeEnd - rangeStart) * pixelsPerX;
+
+	//Find the index of the first sample in range
 	data->PrepareForCpuAccess();
 	auto ifirst = BinarySearchForGequal(
 		data->m_offsets.GetCpuPointer(),
 		data->size(),
-		offset_samples);
+		(rangeStart - data->m_triggerPhase) / data->m_timescale);
 
 	//Go left by one sample
-	//The last sample BEFORE the left side of our view might extend into the visible space
+	//The last sample BEFORE the start of the range might extend into it
 	if(ifirst > 0)
 		ifirst --;
 
-	float ybot = (channel->GetYButtonPos() * ImGui::GetWindowDpiScale()) + start.y;
-	float ytop = ybot - m_channelButtonHeight;
-	float ymid = ybot - m_channelButtonHeight/2;
-
-	//Draw the actual stuff
 	size_t len = data->size();
-	size_t xend = start.x + size.x;
 	for(size_t i=ifirst; i<len; i++)
 	{
 		int64_t tstart = (data->m_offsets[i] * data->m_timescale) + data->m_triggerPhase;
 		int64_t end = tstart + (data->m_durations[i] * data->m_timescale);
 
-		double xs = m_group->XAxisUnitsToXPosition(tstart);
-		double xe = m_group->XAxisUnitsToXPosition(end);
+		double xs = (tstart - rangeStart) * pixelsPerX;
+		double xe = (end - rangeStart) * pixelsPerX;
 
-		if(xe < start.x)
+		if(xe < 0)
 			continue;
-		if(xs > xend)
+		if(xs > xrangeEnd)
 			break;
 
+		ProtocolRenderSpan span;
+		span.m_xs = xs;
+		span.m_xe = xe;
+		span.m_color = ColorFromString(data->GetColor(i));
+		span.m_textSize = ImVec2(0, 0);
+
 		double cellwidth = xe - xs;
-		auto color = ColorFromString(data->GetColor(i));
 		if(cellwidth < 2)
 		{
 			//This sample is really skinny. There's no text to render so don't waste time with that.
 
 			//Average the color of all samples touching this pixel
 			size_t nmerged = 1;
-			float sum_red = (color >> IM_COL32_R_SHIFT) & 0xff;
-			float sum_green = (color >> IM_COL32_G_SHIFT) & 0xff;
-			float sum_blue = (color >> IM_COL32_B_SHIFT) & 0xff;
+			float sum_red = (span.m_color >> IM_COL32_R_SHIFT) & 0xff;
+			float sum_green = (span.m_color >> IM_COL32_G_SHIFT) & 0xff;
+			float sum_blue = (span.m_color >> IM_COL32_B_SHIFT) & 0xff;
 			for(size_t j=i+1; j<len; j++)
 			{
 				int64_t cellstart = (data->m_offsets[j] * data->m_timescale) + data->m_triggerPhase;
-				double cellxs = m_group->XAxisUnitsToXPosition(cellstart);
+				double cellxs = (cellstart - rangeStart) * pixelsPerX;
 
 				if(cellxs > xs+2)
 					break;
@@ -1013,40 +1332,46 @@ void WaveformArea::RenderProtocolWaveform(std::shared_ptr<DisplayedChannel> chan
 			sum_red /= nmerged;
 			sum_green /= nmerged;
 			sum_blue /= nmerged;
-			color =
+			span.m_color =
 				((static_cast<int>(sum_red) & 0xff) << IM_COL32_R_SHIFT) |
 				((static_cast<int>(sum_green) & 0xff) << IM_COL32_G_SHIFT) |
 				((static_cast<int>(sum_blue) & 0xff) << IM_COL32_B_SHIFT) |
 				(0xff << IM_COL32_A_SHIFT);
-
-
-			RenderComplexSignal(
-				list,
-				start.x, xend,
-				xs, xe, 5,
-				ybot, ymid, ytop,
-				"",
-				color);
 		}
-		else
+
+		//RenderComplexSignal() only draws text if there's more than 15 pixels of space inside the outline.
+		//Smaller boxes don't need their text looked up at all.
+		else if( (cellwidth - 2*5) > 15)
 		{
-			RenderComplexSignal(
-				list,
-				start.x, xend,
-				xs, xe, 5,
-				ybot, ymid, ytop,
-				data->GetText(i),
-				color);
+			span.m_text = data->GetText(i);
+
+			//Convert all whitespace in text to spaces
+			for(size_t k=0; k<span.m_text.length(); k++)
+			{
+				if(isspace(span.m_text[k]))
+					span.m_text[k] = ' ';
+			}
+
+			span.m_textSize = font->CalcTextSizeA(font->FontSize, FLT_MAX, 0, span.m_text.c_str());
 		}
+
+		cache.m_spans.push_back(span);
 	}
 }
 
+/**
+	@brief Draws one box of a protocol waveform, with as much of its label as fits
+
+	@param str		Label text, with whitespace already converted to spaces
+	@param textsize	Size of str in the protocol font
+ */
 void WaveformArea::RenderComplexSignal(
 		ImDrawList* list,
 		int visleft, int visright,
 		float xstart, float xend, float xoff,
 		float ybot, float ymid, float ytop,
-		string str,
+		const string& str,
+		ImVec2 textsize,
 		ImU32 color)
 {
 	//Clamp start point to left side of display
@@ -1059,21 +1384,12 @@ void WaveformArea::RenderComplexSignal(
 	//Width within this signal outline
 	float available_width = xend - xstart - 2*xoff;
 
-	//Convert all whitespace in text to spaces
-	for(size_t i=0; i<str.length(); i++)
-	{
-		if(isspace(str[i]))
-			str[i] = ' ';
-	}
-
 	//If the space is tiny, don't even attempt to render it.
-	//Figuring out text size is expensive when we have hundreds or thousands of packets on screen, but in this case
-	//we *know* it won't fit.
 	bool drew_text = false;
 	if(available_width > 15)
 	{
 		auto font = m_parent->GetFontPref("Appearance.Decodes.protocol_font");
-		auto textsize = font->CalcTextSizeA(font->FontSize, FLT_MAX, 0, str.c_str());
+		bool fits = true;
 
 		//Minimum width (if outline ends up being smaller than this, just fill)
 		float min_width = 40;
@@ -1082,7 +1398,7 @@ void WaveformArea::RenderComplexSignal(
 
 		//Does the string fit at all? If not, skip all of the messy math
 		if(available_width < min_width)
-			str = "";
+			fits = false;
 		else
 		{
 			//Center the text by moving it left half a width
@@ -1115,11 +1431,11 @@ void WaveformArea::RenderComplexSignal(
 
 			//If we don't fit under the new constraints, give up
 			if(available_width < min_width)
-				str = "";
+				fits = false;
 		}
 
 		//Draw the text
-		if(str != "")
+		if(fits && (str != ""))
 		{
 			//If we need to trim, decide which way to do it.
 			//If the text is all caps and includes an underscore, it's probably a macro with a prefix.
@@ -1214,28 +1530,64 @@ void WaveformArea::MakePathSignalBody(ImDrawList* list, float xstart, float xend
 
 /**
 	@brief Tone map our waveforms
+
+	Called by WaveformThread, after rasterizing into the same command buffer.
  */
-void WaveformArea::ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf)
+void WaveformArea::ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf, RenderPassCounts& counts)
 {
 	for(auto& chan : m_displayedChannels)
 	{
 		auto stream = chan->GetStream();
 		switch(stream.GetType())
 		{
-			case Stream::STREAM_TYPE_ANALOG:
 			case Stream::STREAM_TYPE_DIGITAL:
-				ToneMapAnalogOrDigitalWaveform(chan, cmdbuf);
+
+				//Batched channels are tone mapped all at once, below
+				if(chan->GetDigitalBatch())
+					break;
+
+				//fall through
+			case Stream::STREAM_TYPE_ANALOG:
+				{
+					auto& ring = m_parent->GetSession().GetRenderRing();
+					auto start = ring.WriteTimestamp(cmdbuf);
+					if(ToneMapAnalogOrDigitalWaveform(chan, cmdbuf))
+					{
+						ring.AddGpuTimer(chan, GPU_TIMER_TONE_MAP, start, ring.WriteTimestamp(cmdbuf));
+						counts.m_processed ++;
+					}
+					else
+						counts.m_skipped ++;
+				}
 				break;
 
 			//no tone mapping required
 			case Stream::STREAM_TYPE_PROTOCOL:
 				break;
 
+			case Stream::STREAM_TYPE_EYE:
+			case Stream::STREAM_TYPE_SPECTROGRAM:
+			case Stream::STREAM_TYPE_WATERFALL:
+				if(ToneMapDensityWaveform(chan, cmdbuf))
+					counts.m_processed ++;
+				else
+					counts.m_skipped ++;
+				break;
+
 			default:
 				LogWarning("Unimplemented stream type %d, don't know how to tone map it\n", stream.GetType());
 				break;
 		}
 	}
+
+	size_t nbatched = m_digitalBatch->GetChannelCount();
+	if(nbatched)
+	{
+		if(m_digitalBatch->ToneMap(cmdbuf, m_parent))
+			counts.m_processed += nbatched;
+		else
+			counts.m_skipped += nbatched;
+	}
 }
 
 /**
@@ -1247,39 +1599,229 @@ void WaveformArea::ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf)
 	@param chans				Set of channels we rendered into
 								Used to keep references active until rendering completes if we close them this frame
 	@param clearPersistence		True if persistence maps should be erased before rendering
+	@param counts				Incremented for each channel we rasterized or skipped because nothing changed
  */
 void WaveformArea::RenderWaveformTextures(
 	vk::raii::CommandBuffer& cmdbuf,
 	vector<shared_ptr<DisplayedChannel> >& chans,
-	bool clearPersistence)
+	bool clearPersistence,
+	RenderPassCounts& counts)
 {
-	chans = m_displayedChannels;
+	chans.insert(chans.end(), m_displayedChannels.begin(), m_displayedChannels.end());
 
 	bool clearThisAreaOnly = m_clearPersistence.exchange(false);
 	bool clearing = clearThisAreaOnly || clearPersistence;
 
-	for(auto& chan : chans)
+	bool batching = m_parent->GetSession().GetWaveformThreadSettings().m_digitalBatch;
+	vector<shared_ptr<DisplayedChannel> > batched;
+
+	for(auto& chan : m_displayedChannels)
 	{
 		auto stream = chan->GetStream();
 		switch(stream.GetType())
 		{
-			case Stream::STREAM_TYPE_ANALOG:
 			case Stream::STREAM_TYPE_DIGITAL:
-				RasterizeAnalogOrDigitalWaveform(chan, cmdbuf, clearing);
+
+				//Uniform digital channels are drawn together, later
+				if(batching && DigitalBatchRenderer::CanBatch(chan))
+				{
+					batched.push_back(chan);
+					break;
+				}
+
+				//Leaving the batch? Make sure we draw it next time
+				if(chan->GetDigitalBatch())
+				{
+					chan->SetDigitalBatch(nullptr, 0);
+					chan->InvalidateRasterState();
+				}
+
+				//fall through
+			case Stream::STREAM_TYPE_ANALOG:
+				{
+					auto& ring = m_parent->GetSession().GetRenderRing();
+					auto start = ring.WriteTimestamp(cmdbuf);
+					if(RasterizeAnalogOrDigitalWaveform(chan, cmdbuf, clearing))
+					{
+						ring.AddGpuTimer(chan, GPU_TIMER_RASTERIZE, start, ring.WriteTimestamp(cmdbuf));
+						counts.m_processed ++;
+					}
+					else
+						counts.m_skipped ++;
+				}
 				break;
 
 			//no background rendering required
 			case Stream::STREAM_TYPE_PROTOCOL:
 				break;
 
+			//already a density map, just needs tone mapping
+			case Stream::STREAM_TYPE_EYE:
+			case Stream::STREAM_TYPE_SPECTROGRAM:
+			case Stream::STREAM_TYPE_WATERFALL:
+				if(UpdateDensityWaveform(chan, cmdbuf))
+					counts.m_processed ++;
+				else
+					counts.m_skipped ++;
+				break;
+
 			default:
 				LogWarning("Unimplemented stream type %d, don't know how to rasterize it\n", stream.GetType());
 				break;
 		}
 	}
+
+	//Draw the batched digital channels (or note that there aren't any anymore)
+	if(!batched.empty() || m_digitalBatch->GetChannelCount())
+	{
+		size_t width;
+		int64_t xAxisOffset;
+		GetRasterWindow(width, xAxisOffset);
+
+		bool rasterized = m_digitalBatch->Rasterize(
+			cmdbuf,
+			m_parent->GetSession().GetRenderRing(),
+			batched,
+			width,
+			m_channelButtonHeight,
+			xAxisOffset,
+			m_group->GetPixelsPerXUnit(),
+			m_parent->GetSession().GetWaveformGeneration());
+
+		for(size_t i=0; i<batched.size(); i++)
+		{
+			//Free the channel's own buffer since it's not needed anymore
+			if(batched[i]->GetDigitalBatch() == nullptr)
+			{
+				m_parent->GetSession().GetRenderRing().ClaimForPass(batched[i]->GetLastRenderPass());
+				batched[i]->PrepareToRasterize(0, 0);
+			}
+			batched[i]->SetDigitalBatch(m_digitalBatch, i);
+
+			if(rasterized)
+				counts.m_processed ++;
+			else
+				counts.m_skipped ++;
+		}
+	}
+}
+
+/**
+	@brief Gets the width of a pixel column in X axis ticks, as 32.32 fixed point
+
+	Column start times are calculated in integer math from this, on both the CPU and GPU, so the two index searches
+	agree and stay exact however far the view is from the start of the waveform.
+
+	@param xscale	Pixels per X axis tick
+	@param ticks	Integer part of the column width
+	@param frac		Fractional part of the column width, in units of 2^-32 ticks
+ */
+static void GetColumnTicks(double xscale, int64_t& ticks, uint32_t& frac)
+{
+	double width = 1.0 / xscale;
+	ticks = floor(width);
+	frac = (width - ticks) * 4294967296.0;
+}
+
+/**
+	@brief Calculates the index of the first sample in each pixel column of a sparse waveform, on the CPU
+
+	Column start times increase monotonically, so each block of columns only needs one full search for its first column.
+	Every following column gallops forward from the previous result.
+
+	Blocks are only split across OpenMP threads if parallel is set. Render lanes recorded in parallel pass false, so
+	each of them doesn't start a parallel region of its own.
+ */
+static void CalculateSparseIndexes(
+	uint32_t* ibuf,
+	const int64_t* offsets,
+	size_t len,
+	size_t w,
+	int64_t offset_samples,
+	double xscale,
+	bool parallel)
+{
+	const size_t blocksize = 64;
+	size_t nblocks = (w + blocksize - 1) / blocksize;
+
+	int64_t ticks;
+	uint32_t frac;
+	GetColumnTicks(xscale, ticks, frac);
+
+	#pragma omp parallel for if(parallel)
+	for(size_t block=0; block<nblocks; block++)
+	{
+		size_t start = block * blocksize;
+		size_t end = min(start + blocksize, w);
+		size_t hint = 0;
+
+		for(size_t i=start; i<end; i++)
+		{
+			//Same math as waveform-index.glsl
+			int64_t target = (int64_t)i*ticks + (int64_t)( ((uint64_t)i * frac) >> 32) + offset_samples;
+
+			//Clip if out of range
+			if( (len == 0) || (offsets[0] >= target) )
+			{
+				ibuf[i] = 0;
+				continue;
+			}
+			if(offsets[len-1] < target)
+			{
+				ibuf[i] = len;
+				continue;
+			}
+
+			//offsets[hint] is known to be <= target.
+			//Take exponentially growing steps until we overshoot, then binary search the last step
+			size_t step = 1;
+			while( (hint + step < len) && (offsets[hint + step] <= target) )
+			{
+				hint += step;
+				step *= 2;
+			}
+			auto last = offsets + min(hint + step, len);
+			hint = (upper_bound(offsets + hint, last, target) - offsets) - 1;
+
+			ibuf[i] = hint;
+		}
+	}
+}
+
+/**
+	@brief Gets the width and X axis position of the image to rasterize
+
+	The image extends past each side of the plot by the render-ahead margin, so small pans are already drawn when they
+	happen (see RenderToneMappedImage()).
+
+	Called by WaveformThread.
+
+	@param width		Width of the image, in pixels
+	@param xAxisOffset	X axis position of the left edge of the image
+ */
+void WaveformArea::GetRasterWindow(size_t& width, int64_t& xAxisOffset)
+{
+	size_t plotWidth = m_width;
+	double margin = m_parent->GetSession().GetWaveformThreadSettings().m_renderAhead;
+
+	//Stay within the largest image we're willing to allocate
+	size_t maxWidth = RASTER_MAX_WIDTH;
+	size_t marginPixels = 0;
+	if(margin > 0)
+		marginPixels = plotWidth * margin;
+	if(plotWidth + 2*marginPixels > maxWidth)
+		marginPixels = (maxWidth - min(plotWidth, maxWidth)) / 2;
+
+	width = plotWidth + 2*marginPixels;
+	xAxisOffset = m_group->GetXAxisOffset() - m_group->PixelsToXAxisUnits(marginPixels);
 }
 
-void WaveformArea::RasterizeAnalogOrDigitalWaveform(
+/**
+	@brief Rasterizes an analog or digital waveform into the fp32 working buffer
+
+	@return True if the waveform was rasterized, false if it was skipped because nothing changed since last time
+ */
+bool WaveformArea::RasterizeAnalogOrDigitalWaveform(
 	shared_ptr<DisplayedChannel> channel,
 	vk::raii::CommandBuffer& cmdbuf,
 	bool clearPersistence
@@ -1288,52 +1830,173 @@ void WaveformArea::RasterizeAnalogOrDigitalWaveform(
 	auto stream = channel->GetStream();
 	auto data = stream.GetData();
 
+	size_t w;
+	int64_t xAxisOffset;
+	GetRasterWindow(w, xAxisOffset);
+	size_t h = m_height;
+	if(channel->GetStream().GetType() == Stream::STREAM_TYPE_DIGITAL)
+		h = m_channelButtonHeight;
+
+	//Skip the channel if nothing affecting the output changed since last time.
+	//Clearing persistence doesn't need a re-render, since the persistence buffer is managed by the tone mapping pass.
+	RasterState prev = channel->GetRasterState();
+	RasterState state;
+	state.m_data = data;
+	state.m_generation = m_parent->GetSession().GetWaveformGeneration();
+	state.m_width = w;
+	state.m_height = h;
+	state.m_xAxisOffset = xAxisOffset;
+	state.m_pixelsPerXUnit = m_group->GetPixelsPerXUnit();
+	state.m_pixelsPerYAxisUnit = m_pixelsPerYAxisUnit;
+	state.m_yAxisOffset = stream.GetOffset();
+	auto& settings = m_parent->GetSession().GetWaveformThreadSettings();
+	state.m_pyramid = settings.m_decimationPyramid;
+	state.m_tiled = settings.m_tiledRasterizer || (h > RASTER_COLUMN_MAX_HEIGHT);
+	state.m_cpu = channel->IsCpuRasterizerEnabled();
+	if(!channel->UpdateRasterState(state))
+	{
+		if(clearPersistence)
+			channel->ResetPersistence();
+		return false;
+	}
+
+	//Passes still in flight may be using our buffers
+	m_parent->GetSession().GetRenderRing().ClaimForPass(channel->GetLastRenderPass());
+
+	//In roll mode, usually only the last few columns need to be drawn
+	if(ScrollRollWaveform(channel, cmdbuf, prev, state, clearPersistence))
+		return true;
+
+	//Anything else redraws the whole image, in order
+	auto& ring = channel->GetColumnRing();
+	ring.m_head = 0;
+	ring.m_valid = false;
+
 	//Prepare the memory so we can rasterize it
 	//If no data, set to 0x0 pixels and return
 	if(data == nullptr)
 	{
 		channel->PrepareToRasterize(0, 0);
-		return;
+		channel->SetToneMapPending();
+		return true;
 	}
-	size_t w = m_width;
-	size_t h = m_height;
-	if(channel->GetStream().GetType() == Stream::STREAM_TYPE_DIGITAL)
-		h = m_channelButtonHeight;
 	channel->PrepareToRasterize(w, h);
 
 	shared_ptr<ComputePipeline> comp;
 
 	//Calculate a bunch of constants
-	int64_t offset = m_group->GetXAxisOffset();
+	int64_t offset = xAxisOffset;
 	int64_t innerxoff = offset / data->m_timescale;
-	int64_t fractional_offset = offset % data->m_timescale;
 	int64_t offset_samples = (offset - data->m_triggerPhase) / data->m_timescale;
 	double pixelsPerX = m_group->GetPixelsPerXUnit();
 	double xscale = data->m_timescale * pixelsPerX;
+	uint64_t generation = state.m_generation;
+
+	//Lanes are already recorded on parallel threads, so only use OpenMP for CPU work if this is the only lane
+	bool parallel = (m_parent->GetSession().GetRenderRing().GetLaneCount() == 1);
 
 	//Figure out which shader to use
-	auto udata = dynamic_cast<UniformWaveformBase*>(data);
 	auto sdata = dynamic_cast<SparseWaveformBase*>(data);
 	auto uadata = dynamic_cast<UniformAnalogWaveform*>(data);
 	auto sadata = dynamic_cast<SparseAnalogWaveform*>(data);
 	auto uddata = dynamic_cast<UniformDigitalWaveform*>(data);
 	auto sddata = dynamic_cast<SparseDigitalWaveform*>(data);
-	if(uadata)
-		comp = channel->GetUniformAnalogPipeline();
+
+	//Remember where a roll mode waveform was drawn up to, so the next pass can carry on from there
+	if(uadata && !state.m_cpu && m_parent->GetSession().GetRollMode().IsRollWaveform(data, ring.m_epoch))
+	{
+		ring.m_valid = true;
+		ring.m_data = data;
+		ring.m_firstSample = data->m_triggerPhase;
+		ring.m_drawnEnd = min(
+			data->m_triggerPhase + (int64_t)(data->size() - 1) * data->m_timescale,
+			xAxisOffset + (int64_t)(w / pixelsPerX));
+	}
+
+	//The rasterizers output raw hit density, intensity grading is applied during tone mapping.
+	//Save the zoom level so the tone mapping pass can scale intensity to match.
+	float capture_len = channel->GetCaptureLength(data, generation, m_parent->GetSession().GetRenderRing());
+	float avg_sample_len = capture_len / data->size();
+	float samplesPerPixel = 1.0 / (pixelsPerX * avg_sample_len);
+	channel->SetRasterized(samplesPerPixel, clearPersistence);
+
+	//Fill rasterizer configuration (also used by the CPU rasterizer)
+	auto config = GetRasterConfig(stream, data, xAxisOffset, w, h);
+
+	//Draw on the CPU if requested for this channel
+	if(state.m_cpu)
+	{
+		auto& imgOut = channel->GetRasterizedWaveform();
+		if(imgOut.empty())
+			return true;
+
+		uint32_t* xind = nullptr;
+		if(sdata)
+		{
+			auto& ibuf = channel->GetIndexBuffer();
+			ibuf.PrepareForCpuAccess();
+			sdata->m_offsets.PrepareForCpuAccess();
+			CalculateSparseIndexes(
+				ibuf.GetCpuPointer(),
+				sdata->m_offsets.GetCpuPointer(),
+				data->size(),
+				w,
+				offset_samples,
+				xscale,
+				parallel);
+			ibuf.MarkModifiedFromCpu();
+			xind = ibuf.GetCpuPointer();
+		}
+
+		imgOut.PrepareForCpuAccess();
+		CpuRasterizer::Rasterize(
+			imgOut.GetCpuPointer(),
+			config,
+			data,
+			xind,
+			(uadata || sadata) && channel->ZeroHoldFlagSet(),
+			parallel);
+		imgOut.MarkModifiedFromCpu();
+		return true;
+	}
+
+	//Deep uniform analog waveforms zoomed out far enough are drawn from the decimation pyramid instead
+	int pyramidLevel = -1;
+	if(uadata && state.m_pyramid)
+		pyramidLevel = WaveformPyramid::GetLevelForZoom(data->size(), 1.0 / xscale);
+
+	bool tiled = state.m_tiled;
+	if(pyramidLevel >= 0)
+		comp = channel->GetPyramidRasterPipeline();
+	else if(uadata)
+		comp = channel->GetUniformAnalogPipeline(tiled);
 	else if(uddata)
-		comp = channel->GetUniformDigitalPipeline();
+		comp = channel->GetUniformDigitalPipeline(tiled);
 	else if(sadata)
-		comp = channel->GetSparseAnalogPipeline();
+		comp = channel->GetSparseAnalogPipeline(tiled);
 	else if(sddata)
-		comp = channel->GetSparseDigitalPipeline();
+		comp = channel->GetSparseDigitalPipeline(tiled);
 	if(!comp)
 	{
 		LogWarning("no pipeline found\n");
-		return;
+		return true;
 	}
 
-	//Bind input buffers
-	if(uadata)
+	//Bind output texture and bail if there's nothing there
+	auto& imgOut = channel->GetRasterizedWaveform();
+	if(imgOut.empty())
+		return true;
+	comp->BindBufferNonblocking(0, imgOut, cmdbuf);
+
+	//Bind input buffers, which must be left alone until the pass completes
+	m_parent->GetSession().GetRenderRing().AddWaveformInput(data);
+	auto& pyramid = channel->GetPyramid();
+	if(pyramidLevel >= 0)
+	{
+		pyramid.Update(cmdbuf, uadata, generation);
+		comp->BindBufferNonblocking(1, pyramid.GetBuffer(), cmdbuf);
+	}
+	else if(uadata)
 		comp->BindBufferNonblocking(1, uadata->m_samples, cmdbuf);
 	if(uddata)
 		comp->BindBufferNonblocking(1, uddata->m_samples, cmdbuf);
@@ -1351,50 +2014,107 @@ void WaveformArea::RasterizeAnalogOrDigitalWaveform(
 
 		//Calculate indexes for X axis
 		auto& ibuf = channel->GetIndexBuffer();
-		ibuf.PrepareForCpuAccess();
-		sdata->m_offsets.PrepareForCpuAccess();
-		for(size_t i=0; i<w; i++)
+		if(!m_parent->GetSession().GetWaveformThreadSettings().m_cpuSparseIndexSearch)
+		{
+			IndexSearchPushConstants iconfig;
+			iconfig.offset_samples = offset_samples;
+			iconfig.memDepth = data->size();
+			iconfig.windowWidth = w;
+			GetColumnTicks(xscale, iconfig.columnTicks, iconfig.columnTicksFrac);
+
+			auto ipipe = channel->GetIndexSearchPipeline();
+			ipipe->BindBufferNonblocking(0, sdata->m_offsets, cmdbuf);
+			ipipe->BindBufferNonblocking(1, ibuf, cmdbuf, true);
+			ipipe->Dispatch(cmdbuf, iconfig, GetComputeBlockCount(w, 64));
+			ipipe->AddComputeMemoryBarrier(cmdbuf);
+			ibuf.MarkModifiedFromGpu();
+		}
+		else
 		{
-			int64_t target = floor(i / xscale) + offset_samples;
-			ibuf[i] = BinarySearchForGequal(
+			ibuf.PrepareForCpuAccess();
+			sdata->m_offsets.PrepareForCpuAccess();
+			CalculateSparseIndexes(
+				ibuf.GetCpuPointer(),
 				sdata->m_offsets.GetCpuPointer(),
 				data->size(),
-				target);
+				w,
+				offset_samples,
+				xscale,
+				parallel);
+			ibuf.MarkModifiedFromCpu();
 		}
-		ibuf.MarkModifiedFromCpu();
 		comp->BindBufferNonblocking(3, ibuf, cmdbuf);
 	}
 
-	//Bind output texture and bail if there's nothing there
-	auto& imgOut = channel->GetRasterizedWaveform();
-	if(imgOut.empty())
-		return;
-	comp->BindBufferNonblocking(0, imgOut, cmdbuf);
+	//Dispatch the shader
+	if(pyramidLevel >= 0)
+	{
+		//Start one block early so the block straddling the left edge of the window is drawn
+		int64_t blocksize = pyramid.GetBlockSize(pyramidLevel);
+		int64_t levelsize = pyramid.GetLevelSize(pyramidLevel);
+		int64_t firstBlock = max(offset_samples, (int64_t)0) / blocksize;
+		firstBlock = min(max(firstBlock - 1, (int64_t)0), levelsize);
+
+		PyramidRasterPushConstants pconfig;
+		pconfig.windowHeight = h;
+		pconfig.windowWidth = w;
+		pconfig.levelOffset = pyramid.GetLevelOffset(pyramidLevel);
+		pconfig.levelSize = levelsize;
+		pconfig.firstBlock = firstBlock;
+		pconfig.xstart = (firstBlock*blocksize - innerxoff) * xscale + config.xoff;
+		pconfig.blockWidth = blocksize * xscale;
+		pconfig.ybase = config.ybase;
+		pconfig.yscale = config.yscale;
+		pconfig.yoff = config.yoff;
+		comp->Dispatch(cmdbuf, pconfig, w, GetComputeBlockCount(h, RASTER_PYRAMID_TILE_HEIGHT), 1);
+	}
+	else if(tiled)
+	{
+		comp->Dispatch(
+			cmdbuf,
+			config,
+			GetComputeBlockCount(w, RASTER_TILE_COLS),
+			GetComputeBlockCount(h, RASTER_TILE_HEIGHT),
+			1);
+	}
+	else
+		comp->Dispatch(cmdbuf, config, w, 1, 1);
+	comp->AddComputeMemoryBarrier(cmdbuf);
+	imgOut.MarkModifiedFromGpu();
 
-	//Scale alpha by zoom.
-	//As we zoom out more, reduce alpha to get proper intensity grading
-	//TODO: make this constant, then apply a second alpha pass in tone mapping?
-	//This will eliminate the need for a (potentially heavy) re-render when adjusting the slider.
-	float alpha = m_parent->GetTraceAlpha();
-	auto end = data->size() - 1;
-	int64_t lastOff = GetOffsetScaled(sdata, udata, end);
-	float capture_len = lastOff;
-	float avg_sample_len = capture_len / data->size();
-	float samplesPerPixel = 1.0 / (pixelsPerX * avg_sample_len);
-	float alpha_scaled = alpha / sqrt(samplesPerPixel);
-	alpha_scaled = min(1.0f, alpha_scaled) * 2;
+	return true;
+}
+
+/**
+	@brief Gets the rasterizer configuration for drawing part of a waveform (also used by the CPU rasterizer)
+
+	@param stream		Stream being drawn
+	@param data			Waveform to draw
+	@param xAxisOffset	X axis position of the left edge of the image
+	@param w			Width of the image, in pixels
+	@param h			Height of the image, in pixels
+ */
+ConfigPushConstants WaveformArea::GetRasterConfig(
+	StreamDescriptor stream,
+	WaveformBase* data,
+	int64_t xAxisOffset,
+	size_t w,
+	size_t h)
+{
+	int64_t innerxoff = xAxisOffset / data->m_timescale;
+	int64_t fractional_offset = xAxisOffset % data->m_timescale;
+	int64_t offset_samples = (xAxisOffset - data->m_triggerPhase) / data->m_timescale;
+	double pixelsPerX = m_group->GetPixelsPerXUnit();
 
-	//Fill shader configuration
 	ConfigPushConstants config;
 	config.innerXoff = -innerxoff;
 	config.windowHeight = h;
 	config.windowWidth = w;
 	config.memDepth = data->size();
 	config.offset_samples = offset_samples - 2;
-	config.alpha = alpha_scaled;
 	config.xoff = (data->m_triggerPhase - fractional_offset) * pixelsPerX;
-	config.xscale = xscale;
-	if(sadata || uadata)	//analog
+	config.xscale = data->m_timescale * pixelsPerX;
+	if(dynamic_cast<SparseAnalogWaveform*>(data) || dynamic_cast<UniformAnalogWaveform*>(data))	//analog
 	{
 		config.yscale = m_pixelsPerYAxisUnit;
 		config.yoff = stream.GetOffset();
@@ -1406,62 +2126,374 @@ void WaveformArea::RasterizeAnalogOrDigitalWaveform(
 		config.yscale = m_channelButtonHeight - 1;
 		config.ybase = 0;
 	}
-	if(channel->IsPersistenceEnabled() && !clearPersistence)
-		config.persistScale = m_parent->GetPersistDecay();
-	else
-		config.persistScale = 0;
+	return config;
+}
 
-	//Dispatch the shader
-	comp->Dispatch(cmdbuf, config, w, 1, 1);
+/**
+	@brief Scrolls the rasterized image of a roll mode waveform, drawing only the columns which changed
+
+	The image is stored as a ring of columns (see ColumnRing). If the view moved right by a whole number of pixels, and
+	the roll buffer was only appended to, the columns still in view are already correct. The rest, plus the column
+	before the last sample drawn last time (so the trace joins up), are rasterized from a copy of just the samples they
+	need. The GPU copy of the roll buffer itself is left alone, so the cost scales with the new samples rather than
+	the length of the roll buffer.
+
+	@return True if the image was updated, false if it has to be rasterized from scratch
+ */
+bool WaveformArea::ScrollRollWaveform(
+	shared_ptr<DisplayedChannel> channel,
+	vk::raii::CommandBuffer& cmdbuf,
+	const RasterState& prev,
+	const RasterState& state,
+	bool clearPersistence)
+{
+	//Must be the same roll buffer as last time, at the same zoom, with nothing but appends since
+	auto& ring = channel->GetColumnRing();
+	auto data = dynamic_cast<UniformAnalogWaveform*>(state.m_data);
+	if(!ring.m_valid || (data == nullptr) || (ring.m_data != data) || !state.IsScrollOf(prev) )
+		return false;
+	uint64_t epoch;
+	if(!m_parent->GetSession().GetRollMode().IsRollWaveform(data, epoch) || (epoch != ring.m_epoch) )
+		return false;
+
+	//View must have moved right by a whole number of pixels, and not by the whole image
+	size_t w = state.m_width;
+	size_t h = state.m_height;
+	double pixelsPerX = state.m_pixelsPerXUnit;
+	double shift = (state.m_xAxisOffset - prev.m_xAxisOffset) * pixelsPerX;
+	int64_t nshift = llround(shift);
+	if( (nshift < 0) || (nshift >= (int64_t)w) || (fabs(shift - nshift) > 0.01) )
+		return false;
+
+	//Samples dropped off the start of the roll buffer must have scrolled out of view already
+	int64_t first = data->m_triggerPhase;
+	if( (first != ring.m_firstSample) && (first > state.m_xAxisOffset) )
+		return false;
+
+	//Redraw from the column before the last sample drawn, or the first column scrolled into view, to the right edge
+	int64_t lastCol = floor( (ring.m_drawnEnd - state.m_xAxisOffset) * pixelsPerX);
+	int64_t startCol = min(lastCol - 1, (int64_t)(w - nshift));
+	if(startCol <= 0)
+		return false;
+	size_t ncols = w - startCol;
+
+	//Copy the samples in those columns, plus a few either side so the trace runs off the edges
+	int64_t tstart = state.m_xAxisOffset + (int64_t)(startCol / pixelsPerX);
+	int64_t tend = state.m_xAxisOffset + (int64_t)(w / pixelsPerX);
+	int64_t len = data->size();
+	int64_t istart = max( (tstart - first) / data->m_timescale - 2, (int64_t)0);
+	int64_t iend = min( (tend - first) / data->m_timescale + 3, len);
+	if(iend - istart < 2)
+		return false;
+	size_t n = iend - istart;
+
+	auto& samples = ring.m_samples;
+	samples.m_timescale = data->m_timescale;
+	samples.m_triggerPhase = first + istart * data->m_timescale;
+	samples.m_samples.resize(n);
+	samples.m_samples.PrepareForCpuAccess();
+	data->m_samples.PrepareForCpuAccess();
+	memcpy(samples.m_samples.GetCpuPointer(), data->m_samples.GetCpuPointer() + istart, n * sizeof(float));
+	samples.m_samples.MarkModifiedFromCpu();
+
+	//Draw the new columns on their own
+	auto config = GetRasterConfig(channel->GetStream(), &samples, tstart, ncols, h);
+	auto comp = channel->GetUniformAnalogPipeline(state.m_tiled);
+	auto& columns = ring.m_columns;
+	columns.resize(ncols * h);
+	comp->BindBufferNonblocking(0, columns, cmdbuf, true);
+	comp->BindBufferNonblocking(1, samples.m_samples, cmdbuf);
+	if(state.m_tiled)
+	{
+		comp->Dispatch(
+			cmdbuf,
+			config,
+			GetComputeBlockCount(ncols, RASTER_TILE_COLS),
+			GetComputeBlockCount(h, RASTER_TILE_HEIGHT),
+			1);
+	}
+	else
+		comp->Dispatch(cmdbuf, config, ncols, 1, 1);
 	comp->AddComputeMemoryBarrier(cmdbuf);
+	columns.MarkModifiedFromGpu();
+
+	//Reuse the columns which scrolled out of view on the left for the new ones
+	ring.m_head = (ring.m_head + nshift) % w;
+
+	ColumnInsertPushConstants args;
+	args.width = w;
+	args.height = h;
+	args.ncols = ncols;
+	args.dstCol = (ring.m_head + startCol) % w;
+
+	auto& imgOut = channel->GetRasterizedWaveform();
+	auto pipe = channel->GetColumnInsertPipeline();
+	pipe->BindBufferNonblocking(0, columns, cmdbuf);
+	pipe->BindBufferNonblocking(1, imgOut, cmdbuf);
+	pipe->Dispatch(cmdbuf, args, GetComputeBlockCount(ncols, 64), h);
+	pipe->AddComputeMemoryBarrier(cmdbuf);
 	imgOut.MarkModifiedFromGpu();
+
+	ring.m_firstSample = first;
+	ring.m_drawnEnd = min(first + (len - 1) * data->m_timescale, tend);
+
+	//Zoom didn't change, so neither did the intensity scale
+	channel->SetRasterized(channel->GetRasterizedSamplesPerPixel(), clearPersistence);
+	return true;
 }
 
 /**
 	@brief Tone maps an analog or digital waveform by converting the internal fp32 buffer to RGBA
+
+	@return True if the waveform was tone mapped, false if it was skipped because nothing changed since last time
  */
-void WaveformArea::ToneMapAnalogOrDigitalWaveform(shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf)
+bool WaveformArea::ToneMapAnalogOrDigitalWaveform(shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf)
 {
-	auto tex = channel->GetTexture();
-	if(tex == nullptr)
-		return;
-
 	//Nothing to draw? Early out if we haven't processed the window resize yet or there's no data
 	auto width = channel->GetRasterizedX();
 	auto height = channel->GetRasterizedY();
 	if( (width == 0) || (height == 0) )
-		return;
+		return false;
+
+	//Scale intensity by zoom.
+	//As we zoom out more, reduce intensity to get proper intensity grading
+	float gain = m_parent->GetTraceAlpha() / sqrt(channel->GetRasterizedSamplesPerPixel());
+	gain = min(1.0f, gain) * 2;
+
+	//Skip if not re-rasterized and the color and intensity are unchanged
+	auto rawcolor = ColorFromString(channel->GetStream().m_channel->m_displaycolor);
+	if(!channel->UpdateToneMapState(rawcolor, gain))
+		return false;
+
+	//Write to a back buffer, the GUI picks it up once the pass completes.
+	//If there's no texture of the right size yet, try again once the GUI has made one.
+	auto textures = channel->GetTextures();
+	auto& rstate = channel->GetRasterState();
+	auto tex = textures->GetBackBuffer(width, height, rstate.m_xAxisOffset, rstate.m_pixelsPerXUnit);
+	if(tex == nullptr)
+	{
+		channel->SetToneMapPending();
+		return false;
+	}
+	auto& renderRing = m_parent->GetSession().GetRenderRing();
+	renderRing.AddToneMapOutput(textures);
+	renderRing.ClaimForPass(channel->GetLastRenderPass());
+
+	//Apply persistence decay here rather than in the rasterizer, so the previous frames are kept intact
+	auto persistMode = channel->PrepareToToneMap(width * height);
+	auto& rasterized = channel->GetRasterizedWaveform();
 
 	//Run the actual compute shader
-	auto& pipe = channel->GetToneMapPipeline();
-	pipe.BindBufferNonblocking(0, channel->GetRasterizedWaveform(), cmdbuf);
-	pipe.BindStorageImage(
+	//If persistence is off the shader never touches binding 2, but something still has to be bound there
+	auto pipe = channel->GetToneMapPipeline();
+	pipe->BindBufferNonblocking(0, rasterized, cmdbuf);
+	pipe->BindStorageImage(
 		1,
 		**m_parent->GetTextureManager()->GetSampler(),
 		tex->GetView(),
 		vk::ImageLayout::eGeneral);
-	auto color = ImGui::ColorConvertU32ToFloat4(ColorFromString(channel->GetStream().m_channel->m_displaycolor));
-	ToneMapArgs args(color, width, height);
-	pipe.Dispatch(cmdbuf, args, GetComputeBlockCount(width, 64), height);
+	if(persistMode == TONEMAP_PERSIST_OFF)
+		pipe->BindBufferNonblocking(2, rasterized, cmdbuf);
+	else
+	{
+		auto& persist = channel->GetPersistenceBuffer();
+		pipe->BindBufferNonblocking(2, persist, cmdbuf);
+		persist.MarkModifiedFromGpu();
+	}
+	auto color = ImGui::ColorConvertU32ToFloat4(rawcolor);
+	ToneMapArgs args(
+		color,
+		width,
+		height,
+		gain,
+		m_parent->GetPersistDecay(),
+		persistMode,
+		channel->GetColumnRing().m_head);
+	pipe->Dispatch(cmdbuf, args, GetComputeBlockCount(width, 64), height);
 
 	//Add a barrier before we read from the fragment shader
-	vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
-	vk::ImageMemoryBarrier barrier(
-		vk::AccessFlagBits::eShaderWrite,
-		vk::AccessFlagBits::eShaderRead,
-		vk::ImageLayout::eGeneral,
-		vk::ImageLayout::eGeneral,
-		VK_QUEUE_FAMILY_IGNORED,
-		VK_QUEUE_FAMILY_IGNORED,
-		tex->GetImage(),
-		range);
-	cmdbuf.pipelineBarrier(
-			vk::PipelineStageFlagBits::eComputeShader,
-			vk::PipelineStageFlagBits::eFragmentShader,
-			{},
-			{},
-			{},
-			barrier);
+	AddToneMapOutputBarrier(cmdbuf, tex);
+
+	return true;
+}
+
+/**
+	@brief Prepares an eye pattern, spectrogram, or waterfall for tone mapping
+
+	These are density maps already, so there's nothing to rasterize: the tone mapping shader reads the filter output
+	directly from GPU memory. Waterfalls first copy any rows the filter added since last time into the channel's history
+	ring.
+
+	@return True if the channel needs to be tone mapped again, false if it was skipped because nothing changed
+ */
+bool WaveformArea::UpdateDensityWaveform(shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf)
+{
+	auto stream = channel->GetStream();
+	auto data = dynamic_cast<DensityFunctionWaveform*>(stream.GetData());
+	if(data == nullptr)
+		return false;
+
+	//Skip if nothing changed since last time
+	RasterState state;
+	state.m_data = data;
+	state.m_generation = m_parent->GetSession().GetWaveformGeneration();
+	state.m_width = m_width;
+	state.m_height = m_height;
+	state.m_xAxisOffset = m_group->GetXAxisOffset();
+	state.m_pixelsPerXUnit = m_group->GetPixelsPerXUnit();
+	state.m_pixelsPerYAxisUnit = m_pixelsPerYAxisUnit;
+	state.m_yAxisOffset = m_yAxisOffset;
+	if(!channel->UpdateRasterState(state))
+		return false;
+	channel->SetToneMapPending();
+
+	if(stream.GetType() != Stream::STREAM_TYPE_WATERFALL)
+		return true;
+	m_parent->GetSession().GetRenderRing().ClaimForPass(channel->GetLastRenderPass());
+
+	size_t width = data->GetWidth();
+	size_t height = data->GetHeight();
+	if( (width == 0) || (height == 0) )
+		return true;
+
+	//The filter scrolls its whole output every time it's updated, with the newest row last.
+	//Copy only the rows added since last time into the ring, over the oldest ones, unless the ring needs to be rebuilt
+	//from scratch.
+	auto& ring = channel->GetWaterfallRing();
+	uint64_t updateCount = m_parent->GetSession().GetFilterUpdateCount();
+	WaterfallInsertPushConstants args;
+	args.width = width;
+	args.height = height;
+	bool rebuild = (ring.m_width != width) || (ring.m_height != height) || (ring.m_data != data) ||
+		(updateCount - ring.m_updateCount >= height);
+	if(rebuild)
+	{
+		ring.m_rows.resize(width * height);
+		ring.m_width = width;
+		ring.m_height = height;
+		ring.m_head = 0;
+
+		args.srcRow = 0;
+		args.dstRow = 0;
+		args.nrows = height;
+	}
+	else if(ring.m_updateCount != updateCount)
+	{
+		args.nrows = updateCount - ring.m_updateCount;
+		args.srcRow = height - args.nrows;
+		args.dstRow = ring.m_head;
+		ring.m_head = (ring.m_head + args.nrows) % height;
+	}
+	else
+		return true;
+	ring.m_data = data;
+	ring.m_updateCount = updateCount;
+
+	auto pipe = channel->GetWaterfallInsertPipeline();
+	m_parent->GetSession().GetRenderRing().AddWaveformInput(data);
+	pipe->BindBufferNonblocking(0, data->GetOutData(), cmdbuf);
+	pipe->BindBufferNonblocking(1, ring.m_rows, cmdbuf, rebuild);
+	pipe->Dispatch(cmdbuf, args, GetComputeBlockCount(width, 64), args.nrows);
+	pipe->AddComputeMemoryBarrier(cmdbuf);
+	ring.m_rows.MarkModifiedFromGpu();
+
+	return true;
+}
+
+/**
+	@brief Tone maps an eye pattern, spectrogram, or waterfall by looking up each density value in the color ramp
+
+	@return True if the waveform was tone mapped, false if it was skipped because nothing changed since last time
+ */
+bool WaveformArea::ToneMapDensityWaveform(shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf)
+{
+	auto stream = channel->GetStream();
+	auto data = dynamic_cast<DensityFunctionWaveform*>(stream.GetData());
+	if(data == nullptr)
+		return false;
+
+	size_t outwidth = channel->GetTextureX();
+	size_t outheight = channel->GetTextureY();
+	if( (outwidth == 0) || (outheight == 0) )
+		return false;
+
+	//Skip if nothing was updated and the color ramp is unchanged
+	if(!channel->UpdateDensityToneMapState(m_parent->GetSession().GetWaveformThreadSettings().m_eyeColorRamp))
+		return false;
+
+	//By default, stretch the whole density map over the plot
+	AcceleratorBuffer<float>* density = &data->GetOutData();
+	size_t width = data->GetWidth();
+	size_t height = data->GetHeight();
+	uint32_t rowOffset = 0;
+	float xoff = 0;
+	float xscale = width * 1.0f / outwidth;
+	float yoff = 0;
+	float yscale = height * 1.0f / outheight;
+
+	//Waterfalls are drawn from the history ring, oldest row at the bottom
+	if(stream.GetType() == Stream::STREAM_TYPE_WATERFALL)
+	{
+		auto& ring = channel->GetWaterfallRing();
+		density = &ring.m_rows;
+		width = ring.m_width;
+		height = ring.m_height;
+		rowOffset = ring.m_head;
+		xscale = width * 1.0f / outwidth;
+		yscale = height * 1.0f / outheight;
+	}
+
+	//Spectrograms follow the X and Y axes of the plot
+	//(columns span GetDuration() from GetStartTime(), rows span DC to GetMaxFrequency())
+	else if(stream.GetType() == Stream::STREAM_TYPE_SPECTROGRAM)
+	{
+		auto spec = dynamic_cast<SpectrogramWaveform*>(data);
+		if(spec)
+		{
+			double colsPerXUnit = width / spec->GetDuration();
+			xscale = colsPerXUnit / m_group->GetPixelsPerXUnit();
+			xoff = (m_group->GetXAxisOffset() - spec->GetStartTime()) * colsPerXUnit;
+
+			double rowsPerYUnit = height / spec->GetMaxFrequency();
+			yscale = rowsPerYUnit / m_pixelsPerYAxisUnit;
+			yoff = (PixelsToYAxisUnits(-m_height/2) - m_yAxisOffset) * rowsPerYUnit;
+		}
+	}
+
+	if( (width == 0) || (height == 0) || (density->size() < width*height) )
+		return false;
+
+	//Write to a back buffer, the GUI picks it up once the pass completes.
+	//If there's no texture of the right size yet, try again once the GUI has made one.
+	auto textures = channel->GetTextures();
+	auto tex = textures->GetBackBuffer(outwidth, outheight);
+	if(tex == nullptr)
+	{
+		channel->SetToneMapPending();
+		return false;
+	}
+	auto& renderRing = m_parent->GetSession().GetRenderRing();
+	renderRing.AddToneMapOutput(textures);
+	renderRing.ClaimForPass(channel->GetLastRenderPass());
+	if(density == &data->GetOutData())
+		renderRing.AddWaveformInput(data);
+
+	//Run the actual compute shader
+	auto pipe = channel->GetDensityToneMapPipeline();
+	pipe->BindBufferNonblocking(0, *density, cmdbuf);
+	pipe->BindStorageImage(
+		1,
+		**m_parent->GetTextureManager()->GetSampler(),
+		tex->GetView(),
+		vk::ImageLayout::eGeneral);
+	pipe->BindBufferNonblocking(2, m_parent->GetEyeColorRamp(), cmdbuf);
+	DensityToneMapArgs args(width, height, outwidth, outheight, rowOffset, xoff, xscale, yoff, yscale);
+	pipe->Dispatch(cmdbuf, args, GetComputeBlockCount(outwidth, 64), outheight);
+
+	//Add a barrier before we read from the fragment shader
+	AddToneMapOutputBarrier(cmdbuf, tex);
+
+	return true;
 }
 
 /**
@@ -2252,7 +3284,28 @@ void WaveformArea::ChannelButton(shared_ptr<DisplayedChannel> chan, size_t index
 		ImGui::Separator();
 		bool persist = chan->IsPersistenceEnabled();
 		if(ImGui::MenuItem("Persistence", nullptr, persist))
+		{
 			chan->SetPersistenceEnabled(!persist);
+			m_parent->SetNeedToneMap();
+		}
+		bool cpu = chan->IsCpuRasterizerEnabled();
+		if(ImGui::MenuItem("Rasterize on CPU", nullptr, cpu))
+		{
+			chan->SetCpuRasterizerEnabled(!cpu);
+			m_parent->SetNeedRender();
+		}
+		if(chan->GetStream().GetType() == Stream::STREAM_TYPE_ANALOG)
+		{
+			auto& stats = m_parent->GetSession().GetStatistics();
+			bool statsEnabled = stats.IsEnabled(chan->GetStream());
+			if(ImGui::MenuItem("Statistics", nullptr, statsEnabled))
+			{
+				if(statsEnabled)
+					stats.Disable(chan->GetStream());
+				else
+					stats.Enable(chan->GetStream());
+			}
+		}
 		ImGui::Separator();
 
 		FilterMenu(chan);
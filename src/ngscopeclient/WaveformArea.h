@@ -38,19 +38,46 @@
 class WaveformArea;
 class WaveformGroup;
 class MainWindow;
+class WaveformRenderRing;
 
 #include "TextureManager.h"
+#include "ToneMappedTexture.h"
 #include "Marker.h"
+#include "WaveformPyramid.h"
+#include "DigitalBatchRenderer.h"
+#include "ComputePipelinePool.h"
+
+std::shared_ptr<Texture> MakeWaveformTexture(size_t x, size_t y, MainWindow* top, const std::string& name);
+void AddToneMapOutputBarrier(vk::raii::CommandBuffer& cmdbuf, std::shared_ptr<Texture> tex);
+
+///@brief How the tone mapping shader uses the persistence buffer (must match WaveformToneMap.glsl)
+enum ToneMapPersistMode
+{
+	TONEMAP_PERSIST_OFF,
+	TONEMAP_PERSIST_RESET,
+	TONEMAP_PERSIST_ACCUMULATE,
+	TONEMAP_PERSIST_DISPLAY
+};
 
 class ToneMapArgs
 {
 public:
-	ToneMapArgs(ImVec4 channelColor, uint32_t w, uint32_t h)
+	ToneMapArgs(
+		ImVec4 channelColor,
+		uint32_t w, uint32_t h,
+		float gain,
+		float persistScale,
+		uint32_t persistMode,
+		uint32_t colOffset)
 	: m_red(channelColor.x)
 	, m_green(channelColor.y)
 	, m_blue(channelColor.z)
 	, m_width(w)
 	, m_height(h)
+	, m_gain(gain)
+	, m_persistScale(persistScale)
+	, m_persistMode(persistMode)
+	, m_colOffset(colOffset)
 	{}
 
 	float m_red;
@@ -58,6 +85,63 @@ public:
 	float m_blue;
 	uint32_t m_width;
 	uint32_t m_height;
+	float m_gain;
+	float m_persistScale;
+	uint32_t m_persistMode;
+	uint32_t m_colOffset;
+};
+
+/**
+	@brief Push constants for DensityToneMap.glsl
+
+	Each output pixel is colored from the density buffer pixel at (xoff + (x+0.5)*xscale, yoff + (y+0.5)*yscale).
+ */
+class DensityToneMapArgs
+{
+public:
+	DensityToneMapArgs(
+		uint32_t w, uint32_t h,
+		uint32_t outw, uint32_t outh,
+		uint32_t rowOffset,
+		float xoff, float xscale,
+		float yoff, float yscale)
+	: m_width(w)
+	, m_height(h)
+	, m_outWidth(outw)
+	, m_outHeight(outh)
+	, m_rowOffset(rowOffset)
+	, m_xoff(xoff)
+	, m_xscale(xscale)
+	, m_yoff(yoff)
+	, m_yscale(yscale)
+	{}
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_outWidth;
+	uint32_t m_outHeight;
+	uint32_t m_rowOffset;
+	float m_xoff;
+	float m_xscale;
+	float m_yoff;
+	float m_yscale;
+};
+
+struct WaterfallInsertPushConstants
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t srcRow;
+	uint32_t dstRow;
+	uint32_t nrows;
+};
+
+struct ColumnInsertPushConstants
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t ncols;
+	uint32_t dstCol;
 };
 
 struct ConfigPushConstants
@@ -67,13 +151,296 @@ struct ConfigPushConstants
 	uint32_t windowWidth;
 	uint32_t memDepth;
 	uint32_t offset_samples;
-	float alpha;
 	float xoff;
 	float xscale;
 	float ybase;
 	float yscale;
 	float yoff;
-	float persistScale;
+};
+
+struct PyramidRasterPushConstants
+{
+	uint32_t windowHeight;
+	uint32_t windowWidth;
+	uint32_t levelOffset;
+	uint32_t levelSize;
+	uint32_t firstBlock;
+	float xstart;
+	float blockWidth;
+	float ybase;
+	float yscale;
+	float yoff;
+};
+
+struct IndexSearchPushConstants
+{
+	int64_t offset_samples;
+	uint32_t memDepth;
+	uint32_t windowWidth;
+	int64_t columnTicks;		//width of a pixel column in X axis ticks, as 32.32 fixed point
+	uint32_t columnTicksFrac;	//(see GetColumnTicks())
+};
+
+/**
+	@brief Everything that affects the rasterized image of a DisplayedChannel
+
+	If none of this has changed since the last time a channel was rasterized, the previous output is still valid.
+ */
+class RasterState
+{
+public:
+	RasterState()
+	: m_data(nullptr)
+	, m_generation(0)
+	, m_width(0)
+	, m_height(0)
+	, m_xAxisOffset(0)
+	, m_pixelsPerXUnit(0)
+	, m_pixelsPerYAxisUnit(0)
+	, m_yAxisOffset(0)
+	, m_pyramid(false)
+	, m_tiled(false)
+	, m_cpu(false)
+	{}
+
+	bool operator==(const RasterState& rhs) const
+	{
+		return
+			(m_data == rhs.m_data) &&
+			(m_generation == rhs.m_generation) &&
+			(m_width == rhs.m_width) &&
+			(m_height == rhs.m_height) &&
+			(m_xAxisOffset == rhs.m_xAxisOffset) &&
+			(m_pixelsPerXUnit == rhs.m_pixelsPerXUnit) &&
+			(m_pixelsPerYAxisUnit == rhs.m_pixelsPerYAxisUnit) &&
+			(m_yAxisOffset == rhs.m_yAxisOffset) &&
+			(m_pyramid == rhs.m_pyramid) &&
+			(m_tiled == rhs.m_tiled) &&
+			(m_cpu == rhs.m_cpu);
+	}
+
+	/**
+		@brief Checks if everything but the X axis position and the waveform contents is the same
+	 */
+	bool IsScrollOf(const RasterState& rhs) const
+	{
+		RasterState tmp = rhs;
+		tmp.m_generation = m_generation;
+		tmp.m_xAxisOffset = m_xAxisOffset;
+		return (*this == tmp);
+	}
+
+	///@brief Waveform being drawn
+	WaveformBase* m_data;
+
+	///@brief Session waveform generation (changes when the contents of m_data may have changed)
+	uint64_t m_generation;
+
+	///@brief Size of the rasterized image
+	size_t m_width;
+	size_t m_height;
+
+	///@brief X axis transform
+	int64_t m_xAxisOffset;
+	double m_pixelsPerXUnit;
+
+	///@brief Y axis transform
+	float m_pixelsPerYAxisUnit;
+	float m_yAxisOffset;
+
+	///@brief Decimation pyramid enable flag
+	bool m_pyramid;
+
+	///@brief Tiled rasterizer enable flag
+	bool m_tiled;
+
+	///@brief CPU rasterizer enable flag
+	bool m_cpu;
+};
+
+/**
+	@brief Number of channels processed and skipped (because nothing had changed) during a render or tone map pass
+ */
+class RenderPassCounts
+{
+public:
+	RenderPassCounts()
+	: m_processed(0)
+	, m_skipped(0)
+	{}
+
+	size_t m_processed;
+	size_t m_skipped;
+};
+
+/**
+	@brief A plot to rasterize and tone map during a rendering pass
+ */
+class WaveformRenderJob
+{
+public:
+	WaveformRenderJob(std::shared_ptr<WaveformArea> area, bool clearPersistence)
+	: m_area(area)
+	, m_clearPersistence(clearPersistence)
+	{}
+
+	std::shared_ptr<WaveformArea> m_area;
+
+	///@brief True if the persistence buffers of the plot should be cleared
+	bool m_clearPersistence;
+};
+
+/**
+	@brief A single box of a protocol waveform overlay, ready to draw
+ */
+class ProtocolRenderSpan
+{
+public:
+	///@brief Left edge, in pixels from the start of the cached range
+	float m_xs;
+
+	///@brief Right edge, in pixels from the start of the cached range
+	float m_xe;
+
+	///@brief Outline color
+	ImU32 m_color;
+
+	///@brief Label with whitespace converted to spaces (empty if the box is too small for any text)
+	std::string m_text;
+
+	///@brief Size of m_text in the protocol font
+	ImVec2 m_textSize;
+};
+
+/**
+	@brief Render list for a protocol waveform overlay
+
+	Colors are resolved, sub-pixel samples merged and labels measured once, rather than every frame. The list covers the
+	visible part of the waveform plus one window width on either side, so small pans don't need a rebuild.
+ */
+class ProtocolRenderCache
+{
+public:
+	ProtocolRenderCache()
+	: m_data(nullptr)
+	, m_generation(0)
+	, m_pixelsPerXUnit(0)
+	, m_width(0)
+	, m_font(nullptr)
+	, m_bucket(0)
+	, m_origin(0)
+	{}
+
+	///@brief Waveform the list was built from
+	WaveformBase* m_data;
+
+	///@brief Session waveform generation the list was built from
+	uint64_t m_generation;
+
+	///@brief X axis scale the list was built for
+	double m_pixelsPerXUnit;
+
+	///@brief Plot width the list was built for
+	float m_width;
+
+	///@brief Font used to measure labels
+	ImFont* m_font;
+
+	///@brief Index of the window-width sized chunk of the X axis containing the left edge of the view
+	int64_t m_bucket;
+
+	///@brief X axis position corresponding to pixel 0 of the list
+	int64_t m_origin;
+
+	///@brief Boxes to draw, sorted left to right
+	std::vector<ProtocolRenderSpan> m_spans;
+};
+
+/**
+	@brief GPU-side history of a waterfall, stored as a ring of rows
+
+	Each new acquisition overwrites the oldest row with the newest row of the filter output, so only one row is copied
+	per acquisition no matter how tall the waterfall is.
+ */
+class WaterfallRing
+{
+public:
+	WaterfallRing()
+	: m_rows("WaterfallRing.m_rows")
+	, m_width(0)
+	, m_height(0)
+	, m_head(0)
+	, m_data(nullptr)
+	, m_updateCount(0)
+	{
+		//Only ever touched by shaders
+		m_rows.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_UNLIKELY);
+		m_rows.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+	}
+
+	///@brief Row data, oldest first starting at m_head
+	AcceleratorBuffer<float> m_rows;
+
+	///@brief Size of the waterfall
+	size_t m_width;
+	size_t m_height;
+
+	///@brief Index of the oldest row
+	size_t m_head;
+
+	///@brief Waveform the newest row was copied from
+	WaveformBase* m_data;
+
+	///@brief Filter update count (see Session::GetFilterUpdateCount()) the newest row was copied from
+	uint64_t m_updateCount;
+};
+
+/**
+	@brief Rasterized image of a roll mode waveform, stored as a ring buffer of columns
+
+	Scrolling the view right by N pixels moves the head forward by N columns, so only the columns which scrolled into
+	view need to be rasterized.
+ */
+class ColumnRing
+{
+public:
+	ColumnRing()
+	: m_columns("ColumnRing.m_columns")
+	, m_head(0)
+	, m_valid(false)
+	, m_data(nullptr)
+	, m_epoch(0)
+	, m_firstSample(0)
+	, m_drawnEnd(0)
+	{
+		//Only ever touched by shaders
+		m_columns.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_UNLIKELY);
+		m_columns.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+	}
+
+	///@brief Newly rasterized columns, before they're copied into the ring
+	AcceleratorBuffer<float> m_columns;
+
+	///@brief Copy of the samples needed to rasterize the new columns
+	UniformAnalogWaveform m_samples;
+
+	///@brief Index of the leftmost column in the rasterized image
+	size_t m_head;
+
+	///@brief True if the rasterized image is a roll mode waveform which can be scrolled
+	bool m_valid;
+
+	///@brief Roll buffer the image was rasterized from
+	WaveformBase* m_data;
+
+	///@brief Epoch of m_data as of the last rasterization
+	uint64_t m_epoch;
+
+	///@brief X axis position of the first sample of m_data as of the last rasterization
+	int64_t m_firstSample;
+
+	///@brief X axis position of the last sample drawn (or the right edge of the image, if that came first)
+	int64_t m_drawnEnd;
 };
 
 /**
@@ -130,15 +497,30 @@ public:
 	StreamDescriptor GetStream()
 	{ return m_stream; }
 
+	/**
+		@brief Returns the most recent completely tone mapped image of the waveform, for drawing
+	 */
 	std::shared_ptr<Texture> GetTexture()
-	{ return m_texture; }
+	{ return m_textures->GetFrontBuffer(); }
 
-	void SetTexture(std::shared_ptr<Texture> tex)
-	{ m_texture = tex; }
+	std::shared_ptr<ToneMappedTexture> GetTextures()
+	{ return m_textures; }
 
 	void PrepareToRasterize(size_t x, size_t y);
 
-	bool UpdateSize(ImVec2 newSize, MainWindow* top);
+	bool UpdateSize(ImVec2 newSize);
+
+	/**
+		@brief Return the X axis size of the texture
+	 */
+	size_t GetTextureX()
+	{ return m_cachedX; }
+
+	/**
+		@brief Return the Y axis size of the texture
+	 */
+	size_t GetTextureY()
+	{ return m_cachedY; }
 
 	AcceleratorBuffer<float>& GetRasterizedWaveform()
 	{ return m_rasterizedWaveform; }
@@ -157,91 +539,199 @@ public:
 
 	/**
 		@brief Gets the pipeline for drawing uniform analog waveforms, creating it if necessary
+
+		@param tiled	True to use the tiled rasterizer, which supports any plot height
+	*/
+	__attribute__((noinline))
+	std::shared_ptr<ComputePipeline> GetUniformAnalogPipeline(bool tiled)
+	{
+		std::string base = "shaders/waveform-compute.";
+		std::string suffix;
+		if(ZeroHoldFlagSet())
+			suffix += ".zerohold";
+		if(g_hasShaderInt64)
+			suffix += ".int64";
+		if(tiled)
+			suffix += ".tiled";
+		return GetRasterPipeline(ComputePipelineKey(
+			base + "analog" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants)));
+	}
+
+	/**
+		@brief Gets the pipeline for drawing sparse analog waveforms, creating it if necessary
+
+		@param tiled	True to use the tiled rasterizer, which supports any plot height
 	*/
 	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetUniformAnalogPipeline()
+	std::shared_ptr<ComputePipeline> GetSparseAnalogPipeline(bool tiled)
 	{
-		if(m_uniformAnalogComputePipeline == nullptr)
+		std::string base = "shaders/waveform-compute.";
+		std::string suffix;
+		int durationSSBOs = 0;
+		if(ZeroHoldFlagSet())
 		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			if(ZeroHoldFlagSet())
-				suffix += ".zerohold";
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_uniformAnalogComputePipeline = std::make_shared<ComputePipeline>(
-				base + "analog" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
+			suffix += ".zerohold";
+			durationSSBOs++;
 		}
+		if(g_hasShaderInt64)
+			suffix += ".int64";
+		if(tiled)
+			suffix += ".tiled";
+		return GetRasterPipeline(ComputePipelineKey(
+			base + "analog" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants)));
+	}
+
+	/**
+		@brief Gets the pipeline for drawing uniform digital waveforms, creating it if necessary
 
-		return m_uniformAnalogComputePipeline;
+		@param tiled	True to use the tiled rasterizer, which supports any plot height
+	*/
+	__attribute__((noinline))
+	std::shared_ptr<ComputePipeline> GetUniformDigitalPipeline(bool tiled)
+	{
+		std::string base = "shaders/waveform-compute.";
+		std::string suffix;
+		if(g_hasShaderInt64)
+			suffix += ".int64";
+		if(tiled)
+			suffix += ".tiled";
+		return GetRasterPipeline(ComputePipelineKey(
+			base + "digital" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants)));
 	}
 
 	/**
-		@brief Gets the pipeline for drawing sparse analog waveforms, creating it if necessary
+		@brief Gets the pipeline for drawing sparse digital waveforms, creating it if necessary
+
+		@param tiled	True to use the tiled rasterizer, which supports any plot height
 	*/
 	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetSparseAnalogPipeline()
+	std::shared_ptr<ComputePipeline> GetSparseDigitalPipeline(bool tiled)
 	{
-		if(m_sparseAnalogComputePipeline == nullptr)
+		std::string base = "shaders/waveform-compute.";
+		std::string suffix;
+		int durationSSBOs = 0;	//TODO: support gaps
+		if(g_hasShaderInt64)
+			suffix += ".int64";
+		if(tiled)
+			suffix += ".tiled";
+		return GetRasterPipeline(ComputePipelineKey(
+			base + "digital" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants)));
+	}
+
+	/**
+		@brief Gets one of our rasterizer pipelines, creating it if necessary
+
+		Only the variant in use is kept. Any other goes back to the pool, which doesn't hand it out again until the
+		rendering passes which may be using it have completed.
+	 */
+	std::shared_ptr<ComputePipeline> GetRasterPipeline(const ComputePipelineKey& key)
+	{
+		for(auto it = m_rasterComputePipelines.begin(); it != m_rasterComputePipelines.end(); )
 		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			int durationSSBOs = 0;
-			if(ZeroHoldFlagSet())
-			{
-				suffix += ".zerohold";
-				durationSSBOs++;
-			}
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_sparseAnalogComputePipeline = std::make_shared<ComputePipeline>(
-				base + "analog" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants));
+			if( (it->first < key) || (key < it->first) )
+				it = m_rasterComputePipelines.erase(it);
+			else
+				it++;
 		}
 
-		return m_sparseAnalogComputePipeline;
+		auto& pipe = m_rasterComputePipelines[key];
+		if(pipe == nullptr)
+			pipe = g_computePipelinePool.Get(key);
+		return pipe;
 	}
 
 	/**
-		@brief Gets the pipeline for drawing uniform digital waveforms, creating it if necessary
+		@brief Gets the pipeline for drawing uniform analog waveforms from a decimation pyramid, creating it if necessary
 	*/
 	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetUniformDigitalPipeline()
+	std::shared_ptr<ComputePipeline> GetPyramidRasterPipeline()
 	{
-		if(m_uniformDigitalComputePipeline == nullptr)
+		if(m_pyramidRasterComputePipeline == nullptr)
 		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_uniformDigitalComputePipeline = std::make_shared<ComputePipeline>(
-				base + "digital" + suffix + ".dense.spv", 2, sizeof(ConfigPushConstants));
+			m_pyramidRasterComputePipeline = g_computePipelinePool.Get(ComputePipelineKey(
+				"shaders/WaveformPyramidRaster.spv", 2, sizeof(PyramidRasterPushConstants)));
 		}
 
-		return m_uniformDigitalComputePipeline;
+		return m_pyramidRasterComputePipeline;
 	}
 
 	/**
-		@brief Gets the pipeline for drawing sparse digital waveforms, creating it if necessary
+		@brief Gets the pipeline for calculating X axis indexes of sparse waveforms, creating it if necessary
 	*/
 	__attribute__((noinline))
-	std::shared_ptr<ComputePipeline> GetSparseDigitalPipeline()
+	std::shared_ptr<ComputePipeline> GetIndexSearchPipeline()
 	{
-		if(m_sparseDigitalComputePipeline == nullptr)
+		if(m_indexSearchComputePipeline == nullptr)
 		{
-			std::string base = "shaders/waveform-compute.";
-			std::string suffix;
-			int durationSSBOs = 0;	//TODO: support gaps
+			std::string shader = "shaders/waveform-index";
 			if(g_hasShaderInt64)
-				suffix += ".int64";
-			m_sparseDigitalComputePipeline = std::make_shared<ComputePipeline>(
-				base + "digital" + suffix + ".spv", durationSSBOs + 4, sizeof(ConfigPushConstants));
+				shader += ".int64";
+			m_indexSearchComputePipeline = g_computePipelinePool.Get(ComputePipelineKey(
+				shader + ".spv", 2, sizeof(IndexSearchPushConstants)));
 		}
 
-		return m_sparseDigitalComputePipeline;
+		return m_indexSearchComputePipeline;
 	}
 
-	ComputePipeline& GetToneMapPipeline()
-	{ return m_toneMapPipe; }
+	/**
+		@brief Gets the pipeline for tone mapping eye patterns, spectrograms, and waterfalls, creating it if necessary
+	*/
+	__attribute__((noinline))
+	std::shared_ptr<ComputePipeline> GetDensityToneMapPipeline()
+	{
+		if(m_densityToneMapComputePipeline == nullptr)
+		{
+			m_densityToneMapComputePipeline = g_computePipelinePool.Get(ComputePipelineKey(
+				"shaders/DensityToneMap.spv", 2, sizeof(DensityToneMapArgs), 1));
+		}
+
+		return m_densityToneMapComputePipeline;
+	}
+
+	/**
+		@brief Gets the pipeline for copying new rows into m_waterfallRing, creating it if necessary
+	*/
+	__attribute__((noinline))
+	std::shared_ptr<ComputePipeline> GetWaterfallInsertPipeline()
+	{
+		if(m_waterfallInsertComputePipeline == nullptr)
+		{
+			m_waterfallInsertComputePipeline = g_computePipelinePool.Get(ComputePipelineKey(
+				"shaders/WaterfallRingInsert.spv", 2, sizeof(WaterfallInsertPushConstants)));
+		}
+
+		return m_waterfallInsertComputePipeline;
+	}
+
+	/**
+		@brief Gets the pipeline for copying new columns into m_columnRing, creating it if necessary
+	*/
+	__attribute__((noinline))
+	std::shared_ptr<ComputePipeline> GetColumnInsertPipeline()
+	{
+		if(m_columnInsertComputePipeline == nullptr)
+		{
+			m_columnInsertComputePipeline = g_computePipelinePool.Get(ComputePipelineKey(
+				"shaders/ColumnRingInsert.spv", 2, sizeof(ColumnInsertPushConstants)));
+		}
+
+		return m_columnInsertComputePipeline;
+	}
+
+	/**
+		@brief Gets the pipeline for tone mapping analog and digital waveforms, creating it if necessary
+	*/
+	__attribute__((noinline))
+	std::shared_ptr<ComputePipeline> GetToneMapPipeline()
+	{
+		if(m_toneMapComputePipeline == nullptr)
+		{
+			m_toneMapComputePipeline = g_computePipelinePool.Get(ComputePipelineKey(
+				"shaders/WaveformToneMap.spv", 2, sizeof(ToneMapArgs), 1));
+		}
+
+		return m_toneMapComputePipeline;
+	}
 
 	bool ZeroHoldFlagSet()
 	{
@@ -277,11 +767,171 @@ public:
 	{ return m_persistenceEnabled; }
 
 	void SetPersistenceEnabled(bool b)
-	{ m_persistenceEnabled = b; }
+	{
+		m_persistenceEnabled = b;
+		m_toneMapPending = true;
+	}
+
+	/**
+		@brief Returns true if this channel is rasterized on the CPU rather than by a compute shader
+	 */
+	bool IsCpuRasterizerEnabled()
+	{ return m_cpuRasterizerEnabled; }
+
+	void SetCpuRasterizerEnabled(bool b)
+	{ m_cpuRasterizerEnabled = b; }
 
 	AcceleratorBuffer<uint32_t>& GetIndexBuffer()
 	{ return m_indexBuffer; }
 
+	int64_t GetCaptureLength(WaveformBase* data, uint64_t generation, WaveformRenderRing& ring);
+
+	WaveformPyramid& GetPyramid()
+	{ return m_pyramid; }
+
+	ProtocolRenderCache& GetProtocolRenderCache()
+	{ return m_protocolRenderCache; }
+
+	WaterfallRing& GetWaterfallRing()
+	{ return m_waterfallRing; }
+
+	ColumnRing& GetColumnRing()
+	{ return m_columnRing; }
+
+	/**
+		@brief Sets the batch this channel is drawn as part of (if any), and its band within the batch output
+	 */
+	void SetDigitalBatch(std::shared_ptr<DigitalBatchRenderer> batch, size_t row)
+	{
+		m_digitalBatch = batch;
+		m_digitalBatchRow = row;
+	}
+
+	std::shared_ptr<DigitalBatchRenderer> GetDigitalBatch()
+	{ return m_digitalBatch; }
+
+	size_t GetDigitalBatchRow()
+	{ return m_digitalBatchRow; }
+
+	/**
+		@brief Checks if anything affecting the rasterized image changed since the last call, and records the new state
+
+		@return True if the channel needs to be rasterized again
+	 */
+	bool UpdateRasterState(const RasterState& state)
+	{
+		if(state == m_rasterState)
+			return false;
+		m_rasterState = state;
+		return true;
+	}
+
+	/**
+		@brief Returns the inputs to the last rasterization
+	 */
+	const RasterState& GetRasterState()
+	{ return m_rasterState; }
+
+	/**
+		@brief Forgets the inputs to the last rasterization, so the channel is always rasterized next time
+	 */
+	void InvalidateRasterState()
+	{ m_rasterState = RasterState(); }
+
+	/**
+		@brief Marks the rasterized image as out of date, so the next tone map pass will process it
+	 */
+	void SetToneMapPending()
+	{ m_toneMapPending = true; }
+
+	/**
+		@brief Records that a new frame was rasterized, so the next tone map pass will add it to the persistence buffer
+
+		@param samplesPerPixel		Average number of samples per X axis pixel, used to scale intensity
+		@param clearPersistence		True to discard the persistence buffer before adding the new frame
+	 */
+	void SetRasterized(float samplesPerPixel, bool clearPersistence)
+	{
+		m_samplesPerPixel = samplesPerPixel;
+		m_newFrame = true;
+		if(clearPersistence)
+			m_persistenceClearPending = true;
+		m_toneMapPending = true;
+	}
+
+	/**
+		@brief Discards the persistence buffer and starts over from the current frame at the next tone map pass
+	 */
+	void ResetPersistence()
+	{
+		m_newFrame = true;
+		m_persistenceClearPending = true;
+		m_toneMapPending = true;
+	}
+
+	/**
+		@brief Returns the average number of samples per X axis pixel as of the last rasterization
+	 */
+	float GetRasterizedSamplesPerPixel()
+	{ return m_samplesPerPixel; }
+
+	/**
+		@brief Checks if the channel needs to be tone mapped, and clears the pending flag
+
+		@param color	Display color of the channel
+		@param gain		Intensity scale applied to the rasterized image
+	 */
+	bool UpdateToneMapState(ImU32 color, float gain)
+	{
+		bool pending = m_toneMapPending.exchange(false);
+		if(!pending && (color == m_toneMapColor) && (gain == m_toneMapGain))
+			return false;
+		m_toneMapColor = color;
+		m_toneMapGain = gain;
+		return true;
+	}
+
+	/**
+		@brief Checks if an eye pattern, spectrogram, or waterfall needs to be tone mapped, and clears the pending flag
+
+		@param ramp		Color ramp the density map is drawn with
+	 */
+	bool UpdateDensityToneMapState(int64_t ramp)
+	{
+		bool pending = m_toneMapPending.exchange(false);
+		if(!pending && (ramp == m_toneMapRamp))
+			return false;
+		m_toneMapRamp = ramp;
+		return true;
+	}
+
+	ToneMapPersistMode PrepareToToneMap(size_t npixels);
+
+	/**
+		@brief Records the X axis a waterfall filter was last set up for
+
+		@return True if it changed since the last call
+	 */
+	bool UpdateWaterfallTimebase(double pixelsPerXUnit, int64_t xAxisOffset)
+	{
+		if( (pixelsPerXUnit == m_waterfallPixelsPerXUnit) && (xAxisOffset == m_waterfallXAxisOffset) )
+			return false;
+		m_waterfallPixelsPerXUnit = pixelsPerXUnit;
+		m_waterfallXAxisOffset = xAxisOffset;
+		return true;
+	}
+
+	AcceleratorBuffer<float>& GetPersistenceBuffer()
+	{ return m_persistenceBuffer; }
+
+	/**
+		@brief Sequence number of the last rendering pass which used this channel's buffers
+
+		See WaveformRenderRing::ClaimForPass().
+	 */
+	uint64_t& GetLastRenderPass()
+	{ return m_lastRenderPass; }
+
 	void SetYButtonPos(float y)
 	{ m_yButtonPos = y; }
 
@@ -297,6 +947,9 @@ protected:
 	///@brief Buffer storing our rasterized waveform, prior to tone mapping
 	AcceleratorBuffer<float> m_rasterizedWaveform;
 
+	///@brief Buffer storing accumulated hit density for persistence mode (only allocated while persistence is on)
+	AcceleratorBuffer<float> m_persistenceBuffer;
+
 	///@brief Buffer for X axis indexes (only used for sparse waveforms)
 	AcceleratorBuffer<uint32_t> m_indexBuffer;
 
@@ -306,8 +959,8 @@ protected:
 	///@brief Y axis size of rasterized waveform
 	size_t m_rasterizedY;
 
-	///@brief The texture storing our final rendered waveform
-	std::shared_ptr<Texture> m_texture;
+	///@brief The textures storing our final rendered waveform
+	std::shared_ptr<ToneMappedTexture> m_textures;
 
 	///@brief X axis size of the texture as of last UpdateSize() call
 	size_t m_cachedX;
@@ -318,23 +971,99 @@ protected:
 	///@brief Persistence enable flag
 	bool m_persistenceEnabled;
 
+	///@brief CPU rasterizer enable flag
+	bool m_cpuRasterizerEnabled;
+
 	///@brief Compute pipeline for tone mapping fp32 images to RGBA
-	ComputePipeline m_toneMapPipe;
+	std::shared_ptr<ComputePipeline> m_toneMapComputePipeline;
 
-	///@brief Compute pipeline for rendering uniform analog waveforms
-	std::shared_ptr<ComputePipeline> m_uniformAnalogComputePipeline;
+	///@brief Compute pipelines for rendering analog and digital waveforms, by variant
+	std::map<ComputePipelineKey, std::shared_ptr<ComputePipeline> > m_rasterComputePipelines;
 
-	///@brief Compute pipeline for rendering sparse analog waveforms
-	std::shared_ptr<ComputePipeline> m_sparseAnalogComputePipeline;
+	///@brief Compute pipeline for drawing uniform analog waveforms from m_pyramid
+	std::shared_ptr<ComputePipeline> m_pyramidRasterComputePipeline;
 
-	///@brief Compute pipeline for rendering uniform digital waveforms
-	std::shared_ptr<ComputePipeline> m_uniformDigitalComputePipeline;
+	///@brief Min/max decimation pyramid of the current waveform (only used for deep uniform analog waveforms)
+	WaveformPyramid m_pyramid;
 
-	///@brief Compute pipeline for rendering sparse digital waveforms
-	std::shared_ptr<ComputePipeline> m_sparseDigitalComputePipeline;
+	///@brief Compute pipeline for tone mapping eye patterns, spectrograms, and waterfalls
+	std::shared_ptr<ComputePipeline> m_densityToneMapComputePipeline;
+
+	///@brief Compute pipeline for copying new rows into m_waterfallRing
+	std::shared_ptr<ComputePipeline> m_waterfallInsertComputePipeline;
+
+	///@brief Compute pipeline for copying new columns into m_columnRing
+	std::shared_ptr<ComputePipeline> m_columnInsertComputePipeline;
+
+	///@brief Render list for protocol waveforms
+	ProtocolRenderCache m_protocolRenderCache;
+
+	///@brief History of waterfall waveforms
+	WaterfallRing m_waterfallRing;
+
+	///@brief Column order of m_rasterizedWaveform, and the state needed to scroll it in roll mode
+	ColumnRing m_columnRing;
+
+	///@brief Batch this channel is drawn as part of, if any.
+	///Also keeps the batch's buffers alive until rendering passes using this channel complete.
+	std::shared_ptr<DigitalBatchRenderer> m_digitalBatch;
+
+	///@brief Index of this channel's band within m_digitalBatch
+	size_t m_digitalBatchRow;
+
+	///@brief Compute pipeline for calculating X axis indexes of sparse waveforms
+	std::shared_ptr<ComputePipeline> m_indexSearchComputePipeline;
+
+	///@brief The waveform m_captureLength was calculated for
+	WaveformBase* m_captureLengthWaveform;
+
+	///@brief Session waveform generation m_captureLength was calculated for
+	uint64_t m_captureLengthGeneration;
+
+	///@brief Offset of the last sample in m_captureLengthWaveform, in X axis units
+	int64_t m_captureLength;
 
 	///@brief Y axis position of our button within the view
 	float m_yButtonPos;
+
+	///@brief X axis scale last given to our waterfall filter (GUI thread only)
+	double m_waterfallPixelsPerXUnit;
+
+	///@brief X axis offset last given to our waterfall filter (GUI thread only)
+	int64_t m_waterfallXAxisOffset;
+
+	///@brief Inputs to the last rasterization of this channel
+	RasterState m_rasterState;
+
+	///@brief True if the channel was rasterized (or the texture reallocated) since the last tone map
+	std::atomic<bool> m_toneMapPending;
+
+	///@brief Display color used for the last tone map
+	ImU32 m_toneMapColor;
+
+	///@brief Intensity scale used for the last tone map
+	float m_toneMapGain;
+
+	///@brief Color ramp used for the last tone map of a density map
+	int64_t m_toneMapRamp;
+
+	//The following are written by WaveformThread while recording a rendering pass and read by the GUI thread while
+	//tone mapping. Both happen with the WaveformRenderRing mutex held.
+
+	///@brief Average number of samples per X axis pixel as of the last rasterization
+	float m_samplesPerPixel;
+
+	///@brief True if a new frame was rasterized since the last tone map
+	bool m_newFrame;
+
+	///@brief True if the persistence buffer should be discarded at the next tone map
+	bool m_persistenceClearPending;
+
+	///@brief True if the persistence buffer contents are valid (persistence was on as of the last tone map)
+	bool m_persistenceActive;
+
+	///@brief Sequence number of the last rendering pass which used our buffers (zero if none)
+	uint64_t m_lastRenderPass;
 };
 
 /**
@@ -352,9 +1081,10 @@ public:
 	void RenderWaveformTextures(
 		vk::raii::CommandBuffer& cmdbuf,
 		std::vector<std::shared_ptr<DisplayedChannel> >& channels,
-		bool clearPersistence);
+		bool clearPersistence,
+		RenderPassCounts& counts);
 	void ReferenceWaveformTextures();
-	void ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf);
+	void ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf, RenderPassCounts& counts);
 
 	size_t GetStreamCount()
 	{ return m_displayedChannels.size(); }
@@ -384,7 +1114,31 @@ public:
 
 	TimePoint GetWaveformTimestamp();
 
+	/**
+		@brief Gets the lane of each rendering pass this plot is always recorded into
+
+		@param nlanes	Number of lanes in each rendering pass
+	 */
+	size_t GetRenderLane(size_t nlanes)
+	{ return m_renderLane % nlanes; }
+
+	///@brief Maximum plot height supported by the column-per-workgroup rasterizer (must match waveform-compute.glsl)
+	static const size_t RASTER_COLUMN_MAX_HEIGHT = 2048;
+
+	///@brief Rows drawn by each workgroup of the pyramid rasterizer (must match WaveformPyramidRaster.glsl)
+	static const size_t RASTER_PYRAMID_TILE_HEIGHT = 2048;
+
+	///@brief Columns drawn by each workgroup of the tiled rasterizer (must match waveform-compute.glsl)
+	static const size_t RASTER_TILE_COLS = 8;
+
+	///@brief Rows drawn by each workgroup of the tiled rasterizer (must match waveform-compute.glsl)
+	static const size_t RASTER_TILE_HEIGHT = 256;
+
+	///@brief Maximum width of the rasterized image, including render-ahead margins
+	static const size_t RASTER_MAX_WIDTH = 16384;
+
 protected:
+	void UpdateWaterfallTimebases();
 	void ChannelButton(std::shared_ptr<DisplayedChannel> chan, size_t index);
 	void RenderBackgroundGradient(ImVec2 start, ImVec2 size);
 	void RenderGrid(ImVec2 start, ImVec2 size, std::map<float, float>& gridmap, float& vbot, float& vtop);
@@ -397,19 +1151,44 @@ protected:
 	void RenderSpectrumPeaks(ImDrawList* list, std::shared_ptr<DisplayedChannel> channel);
 	void RenderDigitalWaveform(std::shared_ptr<DisplayedChannel> channel, ImVec2 start, ImVec2 size);
 	void RenderProtocolWaveform(std::shared_ptr<DisplayedChannel> channel, ImVec2 start, ImVec2 size);
+	void RenderDensityWaveform(std::shared_ptr<DisplayedChannel> channel, ImVec2 start, ImVec2 size);
+	void RenderToneMappedImage(
+		ImDrawList* list,
+		const ToneMapBuffer& buf,
+		ImVec2 start,
+		ImVec2 size,
+		float vtop = 1,
+		float vbot = 0);
+	void UpdateProtocolRenderCache(ProtocolRenderCache& cache, SparseWaveformBase* data, float width);
 	void RenderComplexSignal(
 		ImDrawList* list,
 		int visleft, int visright,
 		float xstart, float xend, float xoff,
 		float ybot, float ymid, float ytop,
-		std::string str,
+		const std::string& str,
+		ImVec2 textsize,
 		ImU32 color);
 	void MakePathSignalBody(ImDrawList* list, float xstart, float xend, float ybot, float ymid, float ytop);
-	void ToneMapAnalogOrDigitalWaveform(std::shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf);
-	void RasterizeAnalogOrDigitalWaveform(
+	void GetRasterWindow(size_t& width, int64_t& xAxisOffset);
+	bool ToneMapAnalogOrDigitalWaveform(std::shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf);
+	bool RasterizeAnalogOrDigitalWaveform(
 		std::shared_ptr<DisplayedChannel> channel,
 		vk::raii::CommandBuffer& cmdbuf,
 		bool clearPersistence);
+	bool ScrollRollWaveform(
+		std::shared_ptr<DisplayedChannel> channel,
+		vk::raii::CommandBuffer& cmdbuf,
+		const RasterState& prev,
+		const RasterState& state,
+		bool clearPersistence);
+	ConfigPushConstants GetRasterConfig(
+		StreamDescriptor stream,
+		WaveformBase* data,
+		int64_t xAxisOffset,
+		size_t w,
+		size_t h);
+	bool ToneMapDensityWaveform(std::shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf);
+	bool UpdateDensityWaveform(std::shared_ptr<DisplayedChannel> channel, vk::raii::CommandBuffer& cmdbuf);
 	void PlotContextMenu();
 
 	void DrawDropRangeMismatchMessage(
@@ -479,6 +1258,9 @@ protected:
 	 */
 	std::vector<std::shared_ptr<DisplayedChannel>> m_displayedChannels;
 
+	///@brief Renderer for drawing all of our uniform digital channels at once
+	std::shared_ptr<DigitalBatchRenderer> m_digitalBatch;
+
 	///@brief Waveform group containing us
 	std::shared_ptr<WaveformGroup> m_group;
 
@@ -515,6 +1297,9 @@ protected:
 	///@brief Offset, in pixels, from mouse to anchor point of peak being dragged
 	ImVec2 m_dragPeakAnchorOffset;
 
+	///@brief Sequence number used to spread plots across the lanes of each rendering pass
+	size_t m_renderLane;
+
 	ImVec2 ClosestPointOnLineSegment(ImVec2 lineA, ImVec2 lineB, ImVec2 pt);
 };
 
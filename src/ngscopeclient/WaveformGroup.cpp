@@ -54,6 +54,7 @@ WaveformGroup::WaveformGroup(MainWindow* parent, const string& title)
 	, m_dragMarker(nullptr)
 	, m_tLastMouseMove(GetTime())
 	, m_timelineHeight(0)
+	, m_rollNewest(0)
 	, m_xAxisCursorMode(X_CURSOR_NONE)
 {
 	m_xAxisCursorPositions[0] = 0;
@@ -120,32 +121,26 @@ StreamDescriptor WaveformGroup::GetChannelBeingDragged()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Rendering
 
-/**
-	@brief Run the tone-mapping shader on all of our waveforms
-
-	Called by MainWindow::ToneMapAllWaveforms() at the start of each frame if new data is ready to render
- */
-void WaveformGroup::ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf)
-{
-	for(auto a : m_areas)
-		a->ToneMapAllWaveforms(cmdbuf);
-}
-
 void WaveformGroup::ReferenceWaveformTextures()
 {
 	for(auto a : m_areas)
 		a->ReferenceWaveformTextures();
 }
 
-void WaveformGroup::RenderWaveformTextures(
-	vk::raii::CommandBuffer& cmdbuf,
-	vector<shared_ptr<DisplayedChannel> >& channels,
-	bool clearPersistence)
+/**
+	@brief Adds each of our plots to the list of work for its lane of a rendering pass
+
+	Called by MainWindow::RenderWaveformTextures() from WaveformThread
+
+	@param jobs				Plots to render in each lane
+	@param clearPersistence	True if persistence of all groups is being cleared
+ */
+void WaveformGroup::GetRenderJobs(vector< vector<WaveformRenderJob> >& jobs, bool clearPersistence)
 {
 	bool clearThisGroupOnly = m_clearPersistence.exchange(false);
 
 	for(auto a : m_areas)
-		a->RenderWaveformTextures(cmdbuf, channels, clearThisGroupOnly || clearPersistence);
+		jobs[a->GetRenderLane(jobs.size())].push_back(WaveformRenderJob(a, clearThisGroupOnly || clearPersistence));
 }
 
 bool WaveformGroup::Render()
@@ -172,6 +167,7 @@ bool WaveformGroup::Render()
 	clientArea.y -= m_timelineHeight;
 	float yAxisWidthSpaced = GetYAxisWidth() + GetSpacing();
 	float plotWidth = clientArea.x - yAxisWidthSpaced;
+	FollowRollMode(plotWidth);
 	RenderTimeline(plotWidth, m_timelineHeight);
 
 	//Close any areas that we destroyed last frame
@@ -211,6 +207,33 @@ bool WaveformGroup::Render()
 	return open;
 }
 
+/**
+	@brief Scrolls the view to keep the newest sample at the right edge in roll mode
+
+	Following stops if the user scrolls back far enough that the newest sample is off the right edge, and starts again
+	once it's back in view. The view only ever moves by whole pixels relative to time zero, so the rasterizer can keep
+	the columns which are still in view (see WaveformArea::ScrollRollWaveform()).
+ */
+void WaveformGroup::FollowRollMode(float plotWidth)
+{
+	auto& roll = m_parent->GetSession().GetRollMode();
+	int64_t newest = roll.GetNewestTime();
+	if(!roll.IsEnabled() || (newest == m_rollNewest) )
+		return;
+
+	//Follow if we haven't seen anything yet, roll mode started over, or the last newest sample is still in view
+	int64_t right = m_xAxisOffset + PixelsToXAxisUnits(plotWidth + 1);
+	bool follow = (m_rollNewest == 0) || (newest < m_rollNewest) ||
+		( (m_rollNewest >= m_xAxisOffset) && (m_rollNewest <= right) );
+	m_rollNewest = newest;
+	if(!follow)
+		return;
+
+	int64_t leftPixel = floor(newest * (double)m_pixelsPerXUnit) - (int64_t)plotWidth;
+	m_xAxisOffset = leftPixel / (double)m_pixelsPerXUnit;
+	ClearPersistence();
+}
+
 /**
 	@brief Run the popup window with cursor values
  */
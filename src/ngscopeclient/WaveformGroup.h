@@ -49,13 +49,9 @@ public:
 	void Clear();
 
 	bool Render();
-	void ToneMapAllWaveforms(vk::raii::CommandBuffer& cmdbuf);
 	void ReferenceWaveformTextures();
 
-	void RenderWaveformTextures(
-		vk::raii::CommandBuffer& cmdbuf,
-		std::vector<std::shared_ptr<DisplayedChannel> >& channels,
-		bool clearPersistence);
+	void GetRenderJobs(std::vector< std::vector<WaveformRenderJob> >& jobs, bool clearPersistence);
 
 	const std::string& GetTitle()
 	{ return m_title; }
@@ -127,6 +123,7 @@ protected:
 	void RenderXAxisCursors(ImVec2 pos, ImVec2 size);
 	void RenderMarkers(ImVec2 pos, ImVec2 size);
 	void DoCursorReadouts();
+	void FollowRollMode(float plotWidth);
 
 	enum DragState
 	{
@@ -184,6 +181,9 @@ protected:
 	///@brief True if clearing persistence
 	std::atomic<bool> m_clearPersistence;
 
+	///@brief End of the newest sample in roll mode, as of the last frame
+	int64_t m_rollNewest;
+
 public:
 
 	///@brief Type of X axis cursor we're displaying
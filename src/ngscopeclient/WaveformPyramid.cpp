@@ -0,0 +1,168 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of WaveformPyramid
+ */
+#include "ngscopeclient.h"
+#include "WaveformPyramid.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+WaveformPyramid::WaveformPyramid()
+	: m_buildPipeline("shaders/WaveformPyramidBuild.spv", 2, sizeof(PyramidBuildPushConstants))
+	, m_levels("WaveformPyramid.m_levels")
+	, m_waveform(nullptr)
+	, m_generation(0)
+{
+	//Pyramid is generated and consumed entirely on the GPU
+	m_levels.SetCpuAccessHint(AcceleratorBuffer<float>::HINT_UNLIKELY);
+	m_levels.SetGpuAccessHint(AcceleratorBuffer<float>::HINT_LIKELY);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Level selection
+
+/**
+	@brief Finds the coarsest pyramid level which still resolves individual pixel columns
+
+	@param depth			Number of samples in the waveform
+	@param samplesPerPixel	Number of samples in each pixel column at the current zoom level
+
+	@return	Level index, or -1 if the waveform should be rendered from the raw samples
+ */
+int WaveformPyramid::GetLevelForZoom(size_t depth, double samplesPerPixel)
+{
+	//Require at least two blocks per column so min/max peaks are still placed to within half a pixel
+	int level = -1;
+	size_t blocksize = BASE_BLOCK_SIZE;
+	for(int i=0; blocksize < depth; i++)
+	{
+		if( (blocksize * 2) > samplesPerPixel)
+			break;
+
+		level = i;
+		blocksize *= LEVEL_FACTOR;
+	}
+
+	return level;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pyramid generation
+
+/**
+	@brief Figures out how many levels a waveform needs and where each one lives in the buffer
+ */
+void WaveformPyramid::CalculateLayout(size_t depth)
+{
+	m_levelOffsets.clear();
+	m_levelSizes.clear();
+	m_blockSizes.clear();
+
+	size_t blocksize = BASE_BLOCK_SIZE;
+	size_t offset = 0;
+	while(blocksize < depth)
+	{
+		size_t len = (depth + blocksize - 1) / blocksize;
+
+		m_levelOffsets.push_back(offset);
+		m_levelSizes.push_back(len);
+		m_blockSizes.push_back(blocksize);
+
+		offset += len;
+		blocksize *= LEVEL_FACTOR;
+	}
+}
+
+/**
+	@brief Rebuilds the pyramid if the waveform has changed since the last call
+
+	@param cmdbuf		Command buffer to record the build commands into
+	@param data			The waveform to build the pyramid for
+	@param generation	Session waveform generation counter
+
+	@return True if the pyramid was rebuilt
+ */
+bool WaveformPyramid::Update(vk::raii::CommandBuffer& cmdbuf, UniformAnalogWaveform* data, uint64_t generation)
+{
+	if( (data == m_waveform) && (generation == m_generation) )
+		return false;
+	m_waveform = data;
+	m_generation = generation;
+
+	size_t depth = data->size();
+	CalculateLayout(depth);
+	if(m_levelSizes.empty())
+		return false;
+
+	size_t top = m_levelSizes.size() - 1;
+	m_levels.resize( (m_levelOffsets[top] + m_levelSizes[top]) * 4);
+
+	m_buildPipeline.BindBufferNonblocking(0, data->m_samples, cmdbuf);
+	m_buildPipeline.BindBufferNonblocking(1, m_levels, cmdbuf, true);
+
+	for(size_t i=0; i<m_levelSizes.size(); i++)
+	{
+		PyramidBuildPushConstants args;
+		if(i == 0)
+		{
+			args.inLen = depth;
+			args.inOffset = 0;
+			args.factor = BASE_BLOCK_SIZE;
+			args.fromSamples = 1;
+		}
+		else
+		{
+			args.inLen = m_levelSizes[i-1];
+			args.inOffset = m_levelOffsets[i-1];
+			args.factor = LEVEL_FACTOR;
+			args.fromSamples = 0;
+		}
+		args.outLen = m_levelSizes[i];
+		args.outOffset = m_levelOffsets[i];
+
+		//Split large levels across two dimensions to stay under the maximum work group count
+		const uint32_t maxGroupsX = 32768;
+		uint32_t groups = GetComputeBlockCount(args.outLen, 64);
+		uint32_t groupsX = min(groups, maxGroupsX);
+		uint32_t groupsY = (groups + groupsX - 1) / groupsX;
+
+		m_buildPipeline.Dispatch(cmdbuf, args, groupsX, groupsY);
+		m_buildPipeline.AddComputeMemoryBarrier(cmdbuf);
+	}
+
+	m_levels.MarkModifiedFromGpu();
+	return true;
+}
@@ -0,0 +1,129 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of WaveformPyramid
+ */
+#ifndef WaveformPyramid_h
+#define WaveformPyramid_h
+
+struct PyramidBuildPushConstants
+{
+	uint32_t inLen;
+	uint32_t inOffset;
+	uint32_t outLen;
+	uint32_t outOffset;
+	uint32_t factor;
+	uint32_t fromSamples;
+};
+
+/**
+	@brief A multi-resolution min/max decimation pyramid of a uniform analog waveform
+
+	Each level divides the waveform into fixed size blocks of samples. Every block stores four floats: the minimum and
+	maximum sample value, the number of samples, and the total vertical distance traveled by the trace within the block
+	(the sum of |v[i+1] - v[i]|). Level 0 uses blocks of BASE_BLOCK_SIZE samples, and each following level merges
+	LEVEL_FACTOR blocks of the previous level.
+
+	The pyramid is built on the GPU the first time it's needed for a given waveform, then reused until the waveform
+	changes. This lets zoomed-out rendering of deep waveforms scale with window width rather than memory depth.
+ */
+class WaveformPyramid
+{
+public:
+	WaveformPyramid();
+
+	bool Update(vk::raii::CommandBuffer& cmdbuf, UniformAnalogWaveform* data, uint64_t generation);
+
+	static int GetLevelForZoom(size_t depth, double samplesPerPixel);
+
+	/**
+		@brief Returns the number of levels in the pyramid
+	 */
+	size_t GetLevelCount()
+	{ return m_levelSizes.size(); }
+
+	/**
+		@brief Returns the index of the first block of a level within the buffer
+	 */
+	size_t GetLevelOffset(size_t level)
+	{ return m_levelOffsets[level]; }
+
+	/**
+		@brief Returns the number of blocks in a level
+	 */
+	size_t GetLevelSize(size_t level)
+	{ return m_levelSizes[level]; }
+
+	/**
+		@brief Returns the number of samples in each block of a level
+	 */
+	size_t GetBlockSize(size_t level)
+	{ return m_blockSizes[level]; }
+
+	/**
+		@brief Returns the buffer containing all levels of the pyramid (four floats per block)
+	 */
+	AcceleratorBuffer<float>& GetBuffer()
+	{ return m_levels; }
+
+	///@brief Number of samples in each level 0 block
+	static const size_t BASE_BLOCK_SIZE = 256;
+
+	///@brief Number of blocks from the previous level merged into each block of the next level
+	static const size_t LEVEL_FACTOR = 8;
+
+protected:
+	void CalculateLayout(size_t depth);
+
+	///@brief Compute pipeline for building the pyramid
+	ComputePipeline m_buildPipeline;
+
+	///@brief All levels of the pyramid, concatenated
+	AcceleratorBuffer<float> m_levels;
+
+	///@brief Index of the first block of each level within m_levels
+	std::vector<size_t> m_levelOffsets;
+
+	///@brief Number of blocks in each level
+	std::vector<size_t> m_levelSizes;
+
+	///@brief Number of samples in each block of each level
+	std::vector<size_t> m_blockSizes;
+
+	///@brief The waveform the pyramid was last built from
+	WaveformBase* m_waveform;
+
+	///@brief Session waveform generation the pyramid was last built from
+	uint64_t m_generation;
+};
+
+#endif
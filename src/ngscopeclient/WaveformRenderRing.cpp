@@ -0,0 +1,758 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of WaveformRenderRing
+ */
+#include "ngscopeclient.h"
+#include "WaveformRenderRing.h"
+#include "Session.h"
+#include "WaveformArea.h"
+#include "ToneMappedTexture.h"
+#include "pthread_compat.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// WaveformRenderLane
+
+WaveformRenderLane::WaveformRenderLane(vk::raii::CommandPool& pool, const string& name, bool timestamps)
+	: m_cmdbuf(move(vk::raii::CommandBuffers(
+		*g_vkComputeDevice,
+		vk::CommandBufferAllocateInfo(*pool, vk::CommandBufferLevel::ePrimary, 1)).front()))
+	, m_fence(*g_vkComputeDevice, vk::FenceCreateInfo())
+	, m_queryCount(0)
+{
+	if(timestamps)
+	{
+		vk::QueryPoolCreateInfo info({}, vk::QueryType::eTimestamp, WaveformRenderRing::MAX_TIMESTAMPS);
+		m_queryPool = make_unique<vk::raii::QueryPool>(*g_vkComputeDevice, info);
+	}
+
+	if(g_hasDebugUtils)
+	{
+		string bufname = name + ".cmdbuf";
+		string fencename = name + ".fence";
+		string poolname = name + ".queryPool";
+
+		g_vkComputeDevice->setDebugUtilsObjectNameEXT(
+			vk::DebugUtilsObjectNameInfoEXT(
+				vk::ObjectType::eCommandBuffer,
+				reinterpret_cast<int64_t>(static_cast<VkCommandBuffer>(*m_cmdbuf)),
+				bufname.c_str()));
+
+		g_vkComputeDevice->setDebugUtilsObjectNameEXT(
+			vk::DebugUtilsObjectNameInfoEXT(
+				vk::ObjectType::eFence,
+				reinterpret_cast<int64_t>(static_cast<VkFence>(*m_fence)),
+				fencename.c_str()));
+
+		if(m_queryPool)
+		{
+			g_vkComputeDevice->setDebugUtilsObjectNameEXT(
+				vk::DebugUtilsObjectNameInfoEXT(
+					vk::ObjectType::eQueryPool,
+					reinterpret_cast<int64_t>(static_cast<VkQueryPool>(**m_queryPool)),
+					poolname.c_str()));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// WaveformRenderSlot
+
+WaveformRenderSlot::WaveformRenderSlot(
+	vector< unique_ptr<vk::raii::CommandPool> >& pools,
+	size_t index,
+	vector<bool>& timestamps)
+	: m_inFlight(false)
+	, m_pass(0)
+	, m_tstart(0)
+{
+	for(size_t i=0; i<pools.size(); i++)
+	{
+		string name = string("WaveformThread.slot") + to_string(index) + ".lane" + to_string(i);
+		m_lanes.push_back(make_unique<WaveformRenderLane>(*pools[i], name, timestamps[i]));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+WaveformRenderRing::WaveformRenderRing()
+	: m_next(0)
+	, m_passCount(0)
+	, m_timestampPeriod(0)
+	, m_readbackBuffer("WaveformRenderRing.m_readbackBuffer")
+	, m_laneSerial(0)
+	, m_lanesRemaining(0)
+	, m_laneWorkersQuit(false)
+{
+	//Written by the shader, read back by us
+	m_readbackBuffer.SetCpuAccessHint(AcceleratorBuffer<int64_t>::HINT_LIKELY);
+	m_readbackBuffer.SetGpuAccessHint(AcceleratorBuffer<int64_t>::HINT_LIKELY);
+}
+
+WaveformRenderRing::~WaveformRenderRing()
+{
+	Clear();
+}
+
+/**
+	@brief Creates the command pools and slots, and starts the lane worker threads
+
+	Called by WaveformThread when it starts up.
+
+	@param queues	Queues to submit rendering passes to. Each slot gets one command buffer per queue.
+ */
+void WaveformRenderRing::Init(vector< shared_ptr<QueueHandle> >& queues)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_queues = queues;
+	m_timestampPeriod = g_vkComputePhysicalDevice->getProperties().limits.timestampPeriod;
+	auto families = g_vkComputePhysicalDevice->getQueueFamilyProperties();
+
+	vector<bool> timestamps;
+	for(size_t i=0; i<m_queues.size(); i++)
+	{
+		auto queue = m_queues[i];
+
+		vk::CommandPoolCreateInfo poolInfo(
+			vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+			queue->m_family );
+		m_pools.push_back(make_unique<vk::raii::CommandPool>(*g_vkComputeDevice, poolInfo));
+
+		if(g_hasDebugUtils)
+		{
+			string poolname = string("WaveformThread.pool") + to_string(i);
+			g_vkComputeDevice->setDebugUtilsObjectNameEXT(
+				vk::DebugUtilsObjectNameInfoEXT(
+					vk::ObjectType::eCommandPool,
+					reinterpret_cast<int64_t>(static_cast<VkCommandPool>(**m_pools[i])),
+					poolname.c_str()));
+		}
+
+		//Not every queue can write timestamps
+		m_timestampValidBits.push_back(families[queue->m_family].timestampValidBits);
+		timestamps.push_back( (m_timestampValidBits[i] != 0) && (m_timestampPeriod > 0) );
+		if(!timestamps[i])
+			LogDebug("Waveform rendering queue %zu does not support timestamps, GPU times will not be measured\n", i);
+	}
+
+	for(size_t i=0; i<RING_SIZE; i++)
+		m_slots.push_back(make_unique<WaveformRenderSlot>(m_pools, i, timestamps));
+	m_next = 0;
+
+	//Lane 0 is recorded by the caller of RecordLanes(), the rest each get a thread of their own
+	m_laneSerial = 0;
+	m_laneWorkersQuit = false;
+	for(size_t i=1; i<m_queues.size(); i++)
+		m_laneWorkers.push_back(thread(&WaveformRenderRing::LaneWorker, this, i));
+}
+
+/**
+	@brief Stops the lane worker threads, waits for all pending rendering to complete, then frees the Vulkan objects
+
+	Called by WaveformThread when it shuts down.
+ */
+void WaveformRenderRing::Clear()
+{
+	StopLaneWorkers();
+
+	lock_guard<mutex> lock(m_mutex);
+
+	for(size_t i=0; i<m_slots.size(); i++)
+		WaitForSlot(*m_slots[(m_next + i) % m_slots.size()]);
+
+	m_slots.clear();
+	m_pools.clear();
+	m_queues.clear();
+	m_timestampValidBits.clear();
+
+	lock_guard<mutex> lock2(m_readbackMutex);
+	m_readbackPipe = nullptr;
+	m_readbackCmdBuf = nullptr;
+	m_readbackPool = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Submission
+
+/**
+	@brief Prepares the next slot for recording a rendering pass
+
+	Blocks if the GPU is still working on the pass which last used this slot. The command buffers of the slot are then
+	in the reset state, ready to begin recording (see GetCommandBuffer()).
+
+	The ring stays locked until Submit() is called.
+ */
+void WaveformRenderRing::Acquire()
+{
+	m_recordLock = unique_lock<mutex>(m_mutex);
+
+	auto& slot = *m_slots[m_next];
+	WaitForSlot(slot);
+	for(auto& lane : slot.m_lanes)
+	{
+		lane->m_cmdbuf.reset();
+		lane->m_queryCount = 0;
+	}
+}
+
+/**
+	@brief Gets one command buffer of the pass being recorded
+
+	Must be called between Acquire() and Submit(). Different lanes may be recorded by different threads at once.
+ */
+vk::raii::CommandBuffer& WaveformRenderRing::GetCommandBuffer(size_t lane)
+{
+	//m_mutex is still held from Acquire()
+	return m_slots[m_next]->m_lanes[lane]->m_cmdbuf;
+}
+
+/**
+	@brief Records every lane of the pass being recorded, in parallel
+
+	Lane 0 is recorded on the calling thread and each other lane on its own worker thread, which is reused for every
+	pass rather than started each time. Returns once all lanes have been recorded.
+
+	Must be called between Acquire() and Submit().
+
+	@param record	Function recording the lane whose index it's given
+ */
+void WaveformRenderRing::RecordLanes(const function<void(size_t)>& record)
+{
+	{
+		lock_guard<mutex> lock(m_laneMutex);
+		m_laneRecord = record;
+		m_lanesRemaining = m_laneWorkers.size();
+		m_laneSerial ++;
+	}
+	m_laneStartCond.notify_all();
+
+	record(0);
+
+	unique_lock<mutex> lock(m_laneMutex);
+	m_laneDoneCond.wait(lock, [&]{ return m_lanesRemaining == 0; });
+	m_laneRecord = nullptr;
+}
+
+/**
+	@brief Thread recording one lane of each pass handed to it by RecordLanes()
+ */
+void WaveformRenderRing::LaneWorker(size_t lane)
+{
+	string name = string("RenderLane") + to_string(lane);
+	pthread_setname_np_compat(name.c_str());
+
+	uint64_t serial = 0;
+	while(true)
+	{
+		function<void(size_t)> record;
+		{
+			unique_lock<mutex> lock(m_laneMutex);
+			m_laneStartCond.wait(lock, [&]{ return m_laneWorkersQuit || (m_laneSerial != serial); });
+			if(m_laneWorkersQuit)
+				return;
+			serial = m_laneSerial;
+			record = m_laneRecord;
+		}
+
+		record(lane);
+
+		{
+			lock_guard<mutex> lock(m_laneMutex);
+			m_lanesRemaining --;
+		}
+		m_laneDoneCond.notify_one();
+	}
+}
+
+/**
+	@brief Tells the lane worker threads to exit, and waits for them to do so
+ */
+void WaveformRenderRing::StopLaneWorkers()
+{
+	{
+		lock_guard<mutex> lock(m_laneMutex);
+		m_laneWorkersQuit = true;
+	}
+	m_laneStartCond.notify_all();
+
+	for(auto& t : m_laneWorkers)
+		t.join();
+	m_laneWorkers.clear();
+}
+
+/**
+	@brief Finds which lane of the pass being recorded a command buffer belongs to
+
+	@return The lane index, or SIZE_MAX if it's not one of ours
+ */
+size_t WaveformRenderRing::GetLane(vk::raii::CommandBuffer& cmdbuf)
+{
+	auto& slot = *m_slots[m_next];
+	for(size_t i=0; i<slot.m_lanes.size(); i++)
+	{
+		if(&slot.m_lanes[i]->m_cmdbuf == &cmdbuf)
+			return i;
+	}
+
+	LogError("WaveformRenderRing::GetLane: command buffer is not part of the pass being recorded\n");
+	return SIZE_MAX;
+}
+
+/**
+	@brief Hands a texture to the GUI thread when the pass being recorded completes
+
+	Must be called between Acquire() and Submit(), once for each ToneMappedTexture::GetBackBuffer() call.
+ */
+void WaveformRenderRing::AddToneMapOutput(shared_ptr<ToneMappedTexture> tex)
+{
+	//m_mutex is still held from Acquire()
+	lock_guard<mutex> lock(m_recordOutputMutex);
+	m_slots[m_next]->m_toneMapped.push_back(tex);
+}
+
+/**
+	@brief Marks a waveform as read by the pass being recorded, so it isn't overwritten until the pass completes
+
+	Must be called between Acquire() and Submit(), when recording GPU work which reads any of the waveform's buffers.
+	Reading them on the CPU while recording doesn't count, since that's done before the pass is submitted.
+ */
+void WaveformRenderRing::AddWaveformInput(WaveformBase* wfm)
+{
+	//m_mutex is still held from Acquire()
+	lock_guard<mutex> lock(m_recordOutputMutex);
+	m_slots[m_next]->m_waveforms.push_back(wfm);
+}
+
+/**
+	@brief Writes a timestamp into a command buffer of the pass being recorded, once all previous compute work in that
+	command buffer has completed
+
+	Must be called between Acquire() and Submit(), while the command buffer is recording.
+
+	@return ID of the timestamp, or NO_TIMESTAMP if timestamps are not supported or the lane has used them all
+ */
+uint32_t WaveformRenderRing::WriteTimestamp(vk::raii::CommandBuffer& cmdbuf)
+{
+	//m_mutex is still held from Acquire(), and only one thread records into each lane
+	size_t nlane = GetLane(cmdbuf);
+	if(nlane == SIZE_MAX)
+		return NO_TIMESTAMP;
+	auto& lane = *m_slots[m_next]->m_lanes[nlane];
+	if(!lane.m_queryPool || (lane.m_queryCount >= MAX_TIMESTAMPS))
+		return NO_TIMESTAMP;
+
+	//Queries must be reset before they're written, do them all before the first one
+	if(lane.m_queryCount == 0)
+		cmdbuf.resetQueryPool(**lane.m_queryPool, 0, MAX_TIMESTAMPS);
+
+	cmdbuf.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, **lane.m_queryPool, lane.m_queryCount);
+	return nlane*MAX_TIMESTAMPS + (lane.m_queryCount ++);
+}
+
+/**
+	@brief Records the time between two timestamps as the GPU time of one phase of rendering a channel
+
+	Must be called between Acquire() and Submit(). The time is read back when the pass completes.
+
+	@param chan		The channel
+	@param phase	What the work between the timestamps was
+	@param start	Timestamp written before the work
+	@param end		Timestamp written after the work, in the same command buffer
+ */
+void WaveformRenderRing::AddGpuTimer(
+	shared_ptr<DisplayedChannel> chan,
+	GpuTimerPhase phase,
+	uint32_t start,
+	uint32_t end)
+{
+	//m_mutex is still held from Acquire()
+	if( (start == NO_TIMESTAMP) || (end == NO_TIMESTAMP) )
+		return;
+
+	lock_guard<mutex> lock(m_recordOutputMutex);
+	m_slots[m_next]->m_timers.push_back(GpuTimerRecord(chan, phase, start, end));
+}
+
+/**
+	@brief Submits the command buffers of the pass being recorded and advances to the next slot
+
+	Returns as soon as the work is queued, without waiting for it to execute.
+
+	@param channels	Channels used by the rendering pass. These references are held until the pass has completed.
+ */
+void WaveformRenderRing::Submit(vector< shared_ptr<DisplayedChannel> >& channels)
+{
+	//m_mutex is still held from Acquire()
+
+	auto& slot = *m_slots[m_next];
+	slot.m_channels.swap(channels);
+	slot.m_tstart = GetTime();
+
+	for(size_t i=0; i<slot.m_lanes.size(); i++)
+	{
+		auto& lane = *slot.m_lanes[i];
+		g_vkComputeDevice->resetFences({*lane.m_fence});
+
+		vk::SubmitInfo info({}, {}, *lane.m_cmdbuf);
+		QueueLock qlock(m_queues[i]);
+		(*qlock).submit(info, *lane.m_fence);
+	}
+	slot.m_inFlight = true;
+	slot.m_pass = ++m_passCount;
+	g_computePipelinePool.OnPassSubmitted(slot.m_pass);
+
+	m_next = (m_next + 1) % m_slots.size();
+
+	m_recordLock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Completion
+
+/**
+	@brief Retires any rendering passes which have completed, without blocking
+
+	Slots are retired oldest first (starting at the next one to be reused), stopping at the first one still in flight,
+	so tone mapped textures reach the GUI in the order they were rendered.
+
+	Called by both WaveformThread and the GUI thread. If a pass is being recorded, returns immediately rather than
+	waiting for it.
+ */
+void WaveformRenderRing::Poll()
+{
+	unique_lock<mutex> lock(m_mutex, try_to_lock);
+	if(!lock.owns_lock())
+		return;
+
+	for(size_t i=0; i<m_slots.size(); i++)
+	{
+		auto& slot = *m_slots[(m_next + i) % m_slots.size()];
+		if(!slot.m_inFlight)
+			continue;
+
+		bool done = true;
+		for(auto& lane : slot.m_lanes)
+		{
+			if(lane->m_fence.getStatus() != vk::Result::eSuccess)
+				done = false;
+		}
+		if(!done)
+			break;
+
+		RetireSlot(slot);
+	}
+}
+
+/**
+	@brief Checks if all submitted rendering passes have completed, without blocking
+
+	Completed passes are retired as in Poll().
+ */
+bool WaveformRenderRing::IsIdle()
+{
+	Poll();
+
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& slot : m_slots)
+	{
+		if(slot->m_inFlight)
+			return false;
+	}
+	return true;
+}
+
+/**
+	@brief Blocks until all submitted rendering passes have completed
+ */
+void WaveformRenderRing::WaitIdle()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	for(size_t i=0; i<m_slots.size(); i++)
+		WaitForSlot(*m_slots[(m_next + i) % m_slots.size()]);
+}
+
+/**
+	@brief Blocks until every submitted rendering pass reading any of some waveforms has completed
+
+	Passes are retired oldest first, up to and including the newest one reading the waveforms. Passes which don't read
+	them (and everything submitted after the last one which does) are left running, so the waveforms can be
+	overwritten while the GPU is still drawing others.
+
+	Must not be called between Acquire() and Submit().
+
+	@param waveforms	The waveforms about to be overwritten
+ */
+void WaveformRenderRing::WaitForWaveforms(const set<WaveformBase*>& waveforms)
+{
+	lock_guard<mutex> lock(m_mutex);
+	if(waveforms.empty())
+		return;
+
+	//Find the newest pass still in flight which reads any of them
+	size_t count = 0;
+	for(size_t i=0; i<m_slots.size(); i++)
+	{
+		auto& slot = *m_slots[(m_next + i) % m_slots.size()];
+		if(!slot.m_inFlight)
+			continue;
+
+		for(auto w : slot.m_waveforms)
+		{
+			if(waveforms.find(w) != waveforms.end())
+			{
+				count = i + 1;
+				break;
+			}
+		}
+	}
+
+	//Slots are retired in order, so wait for it and everything older
+	for(size_t i=0; i<count; i++)
+		WaitForSlot(*m_slots[(m_next + i) % m_slots.size()]);
+}
+
+/**
+	@brief Blocks until an earlier pass has completed, if it's still in flight
+
+	Must be called between Acquire() and Submit(), before touching a buffer which that pass used. Returns immediately
+	for the pass being recorded, passes which already completed, and zero.
+
+	Lanes are recorded in parallel and may call this at the same time, so this only waits on the fences. The slot is
+	retired as usual by Poll() or Acquire().
+
+	@param pass	Sequence number of the pass, as returned by GetRecordingPass() while it was recorded
+ */
+void WaveformRenderRing::WaitForPass(uint64_t pass)
+{
+	//m_mutex is still held from Acquire(), so no slot changes state under us
+	if( (pass == 0) || (pass > m_passCount) )
+		return;
+
+	for(auto& pslot : m_slots)
+	{
+		auto& slot = *pslot;
+		if(!slot.m_inFlight || (slot.m_pass != pass) )
+			continue;
+
+		vector<vk::Fence> fences;
+		for(auto& lane : slot.m_lanes)
+			fences.push_back(*lane->m_fence);
+		(void)g_vkComputeDevice->waitForFences(fences, VK_TRUE, UINT64_MAX);
+		return;
+	}
+}
+
+/**
+	@brief Waits for the last pass which used some buffers, then marks them as used by the pass being recorded
+
+	Must be called between Acquire() and Submit(), before changing the buffers from the CPU or recording GPU work which
+	touches them.
+
+	@param lastPass	Sequence number of the last pass which used the buffers (zero if none), updated to the current pass
+ */
+void WaveformRenderRing::ClaimForPass(uint64_t& lastPass)
+{
+	WaitForPass(lastPass);
+	lastPass = GetRecordingPass();
+}
+
+/**
+	@brief Waits for a slot's pass to complete (if it's in flight) and retires it
+
+	Must be called with m_mutex held.
+ */
+void WaveformRenderRing::WaitForSlot(WaveformRenderSlot& slot)
+{
+	if(!slot.m_inFlight)
+		return;
+
+	vector<vk::Fence> fences;
+	for(auto& lane : slot.m_lanes)
+		fences.push_back(*lane->m_fence);
+	(void)g_vkComputeDevice->waitForFences(fences, VK_TRUE, UINT64_MAX);
+	RetireSlot(slot);
+}
+
+/**
+	@brief Releases everything held by a completed pass
+
+	Must be called with m_mutex held.
+ */
+void WaveformRenderRing::RetireSlot(WaveformRenderSlot& slot)
+{
+	g_lastWaveformRenderTime = (GetTime() - slot.m_tstart) * FS_PER_SECOND;
+
+	//The pass is complete, so its timestamps are available without waiting
+	if(!slot.m_timers.empty())
+	{
+		vector< vector<uint64_t> > timestamps;
+		for(auto& lane : slot.m_lanes)
+		{
+			timestamps.push_back(vector<uint64_t>());
+			if(lane->m_queryCount == 0)
+				continue;
+
+			auto results = lane->m_queryPool->getResults<uint64_t>(
+				0,
+				lane->m_queryCount,
+				lane->m_queryCount * sizeof(uint64_t),
+				sizeof(uint64_t),
+				vk::QueryResultFlagBits::e64);
+			if(results.first == vk::Result::eSuccess)
+				timestamps.back().swap(results.second);
+		}
+
+		lock_guard<mutex> lock(m_gpuTimesMutex);
+		for(auto& rec : slot.m_timers)
+		{
+			//Both timestamps of a timer are always in the same lane
+			size_t nlane = rec.m_start / MAX_TIMESTAMPS;
+			auto& lanestamps = timestamps[nlane];
+			if(lanestamps.empty())
+				continue;
+
+			uint64_t mask = UINT64_MAX;
+			if(m_timestampValidBits[nlane] < 64)
+				mask = (1ULL << m_timestampValidBits[nlane]) - 1;
+			uint64_t ticks =
+				(lanestamps[rec.m_end % MAX_TIMESTAMPS] - lanestamps[rec.m_start % MAX_TIMESTAMPS]) & mask;
+			int64_t t = ticks * m_timestampPeriod * (FS_PER_SECOND / 1e9);
+
+			//Start over if this is a new channel that happens to be at the address of a deleted one
+			auto& times = m_gpuTimes[rec.m_channel.get()];
+			if(times.m_channel.lock() != rec.m_channel)
+			{
+				times = ChannelGpuTimes();
+				times.m_channel = rec.m_channel;
+			}
+			times.m_name = rec.m_channel->GetName();
+			times.m_average[rec.m_phase].Add(t);
+			times.m_last[rec.m_phase] = t;
+		}
+	}
+	slot.m_timers.clear();
+
+	for(auto& tex : slot.m_toneMapped)
+		tex->OnToneMapComplete();
+	slot.m_toneMapped.clear();
+
+	slot.m_waveforms.clear();
+
+	//Releasing the channels may return pipelines to the pool, which can hand them out again once this pass is done
+	slot.m_channels.clear();
+	slot.m_inFlight = false;
+	g_computePipelinePool.OnPassRetired(slot.m_pass);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Readback
+
+/**
+	@brief Reads one element of a buffer which is only current on the GPU, without copying the rest of it to the CPU
+
+	Blocks until the copy completes. It's submitted on its own, so this may be called while a pass is being recorded,
+	including from several lanes at once.
+
+	@param buf	The buffer
+	@param i	Index of the element to read
+ */
+int64_t WaveformRenderRing::ReadBackElement(AcceleratorBuffer<int64_t>& buf, size_t i)
+{
+	lock_guard<mutex> lock(m_readbackMutex);
+
+	//Nothing to copy if the CPU already has it
+	if(!buf.IsCpuBufferStale())
+		return buf[i];
+
+	if(!m_readbackCmdBuf)
+	{
+		vk::CommandPoolCreateInfo poolInfo(
+			vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+			m_queues[0]->m_family );
+		m_readbackPool = make_unique<vk::raii::CommandPool>(*g_vkComputeDevice, poolInfo);
+
+		vk::CommandBufferAllocateInfo bufinfo(**m_readbackPool, vk::CommandBufferLevel::ePrimary, 1);
+		m_readbackCmdBuf = make_unique<vk::raii::CommandBuffer>(
+			move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+		m_readbackPipe = make_unique<ComputePipeline>(
+			"shaders/ElementReadback.spv", 2, sizeof(ElementReadbackPushConstants));
+	}
+
+	ElementReadbackPushConstants args;
+	args.index = i;
+
+	m_readbackBuffer.resize(1);
+	m_readbackCmdBuf->begin({});
+	m_readbackPipe->BindBufferNonblocking(0, buf, *m_readbackCmdBuf);
+	m_readbackPipe->BindBufferNonblocking(1, m_readbackBuffer, *m_readbackCmdBuf, true);
+	m_readbackPipe->Dispatch(*m_readbackCmdBuf, args, 1);
+	m_readbackCmdBuf->end();
+	m_queues[0]->SubmitAndBlock(*m_readbackCmdBuf);
+
+	m_readbackBuffer.MarkModifiedFromGpu();
+	m_readbackBuffer.PrepareForCpuAccess();
+	return m_readbackBuffer[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Statistics
+
+/**
+	@brief Gets the GPU execution times of every channel which still exists, sorted by name
+ */
+vector<ChannelGpuTimes> WaveformRenderRing::GetGpuTimes()
+{
+	lock_guard<mutex> lock(m_gpuTimesMutex);
+
+	vector<ChannelGpuTimes> ret;
+	for(auto it = m_gpuTimes.begin(); it != m_gpuTimes.end(); )
+	{
+		if(it->second.m_channel.expired())
+			it = m_gpuTimes.erase(it);
+		else
+		{
+			ret.push_back(it->second);
+			it++;
+		}
+	}
+
+	sort(ret.begin(), ret.end(),
+		[](const ChannelGpuTimes& a, const ChannelGpuTimes& b)
+		{ return a.m_name < b.m_name; });
+	return ret;
+}
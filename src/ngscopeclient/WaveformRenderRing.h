@@ -0,0 +1,368 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of WaveformRenderRing
+ */
+#ifndef WaveformRenderRing_h
+#define WaveformRenderRing_h
+
+class DisplayedChannel;
+class ToneMappedTexture;
+
+struct ElementReadbackPushConstants
+{
+	uint32_t index;
+};
+
+///@brief The part of a rendering pass a GPU timer measures
+enum GpuTimerPhase
+{
+	GPU_TIMER_RASTERIZE,
+	GPU_TIMER_TONE_MAP,
+
+	GPU_TIMER_PHASE_COUNT
+};
+
+/**
+	@brief A pair of timestamp queries measuring one phase of rendering one channel
+ */
+class GpuTimerRecord
+{
+public:
+	GpuTimerRecord(std::shared_ptr<DisplayedChannel> chan, GpuTimerPhase phase, uint32_t start, uint32_t end)
+	: m_channel(chan)
+	, m_phase(phase)
+	, m_start(start)
+	, m_end(end)
+	{}
+
+	std::shared_ptr<DisplayedChannel> m_channel;
+	GpuTimerPhase m_phase;
+
+	///@brief Timestamps before and after the work, as returned by WaveformRenderRing::WriteTimestamp()
+	uint32_t m_start;
+	uint32_t m_end;
+};
+
+/**
+	@brief Average of the most recent samples of a measurement
+ */
+class RollingAverage
+{
+public:
+	RollingAverage()
+	: m_next(0)
+	, m_total(0)
+	{}
+
+	/**
+		@brief Adds a sample, replacing the oldest one once the window is full
+	 */
+	void Add(int64_t value)
+	{
+		if(m_samples.size() < WINDOW_SIZE)
+			m_samples.push_back(value);
+		else
+		{
+			m_total -= m_samples[m_next];
+			m_samples[m_next] = value;
+			m_next = (m_next + 1) % WINDOW_SIZE;
+		}
+		m_total += value;
+	}
+
+	/**
+		@brief Returns the average of the samples in the window, or zero if there are none
+	 */
+	int64_t Get() const
+	{
+		if(m_samples.empty())
+			return 0;
+		return m_total / (int64_t)m_samples.size();
+	}
+
+	///@brief Number of samples averaged
+	static const size_t WINDOW_SIZE = 32;
+
+protected:
+	std::vector<int64_t> m_samples;
+	size_t m_next;
+	int64_t m_total;
+};
+
+/**
+	@brief GPU execution times of one channel
+ */
+class ChannelGpuTimes
+{
+public:
+	ChannelGpuTimes()
+	{
+		for(size_t i=0; i<GPU_TIMER_PHASE_COUNT; i++)
+			m_last[i] = 0;
+	}
+
+	///@brief The channel (weak, so entries for deleted channels can be dropped)
+	std::weak_ptr<DisplayedChannel> m_channel;
+
+	///@brief Name of the channel
+	std::string m_name;
+
+	///@brief Rolling average time of each phase, in fs
+	RollingAverage m_average[GPU_TIMER_PHASE_COUNT];
+
+	///@brief Most recent time of each phase, in fs
+	int64_t m_last[GPU_TIMER_PHASE_COUNT];
+};
+
+/**
+	@brief The part of one slot of a WaveformRenderRing which is submitted to one queue
+ */
+class WaveformRenderLane
+{
+public:
+	WaveformRenderLane(vk::raii::CommandPool& pool, const std::string& name, bool timestamps);
+
+	///@brief Command buffer for this lane's share of the rendering pass
+	vk::raii::CommandBuffer m_cmdbuf;
+
+	///@brief Fence signaled when the command buffer completes
+	vk::raii::Fence m_fence;
+
+	///@brief Timestamp queries written by the command buffer (null if timestamps are not supported)
+	std::unique_ptr<vk::raii::QueryPool> m_queryPool;
+
+	///@brief Number of timestamp queries written by the command buffer
+	uint32_t m_queryCount;
+};
+
+/**
+	@brief One slot of a WaveformRenderRing
+ */
+class WaveformRenderSlot
+{
+public:
+	WaveformRenderSlot(
+		std::vector< std::unique_ptr<vk::raii::CommandPool> >& pools,
+		size_t index,
+		std::vector<bool>& timestamps);
+
+	///@brief Command buffers for the rendering pass, one per queue
+	std::vector< std::unique_ptr<WaveformRenderLane> > m_lanes;
+
+	///@brief True if the command buffers were submitted and have not yet been retired
+	bool m_inFlight;
+
+	///@brief Sequence number of the pass last submitted from this slot (see WaveformRenderRing::GetRecordingPass())
+	uint64_t m_pass;
+
+	///@brief Timestamp of the submission
+	double m_tstart;
+
+	///@brief Channels which must stay alive until the rendering pass completes
+	std::vector< std::shared_ptr<DisplayedChannel> > m_channels;
+
+	///@brief Textures tone mapped by the rendering pass, to be handed to the GUI when it completes
+	std::vector< std::shared_ptr<ToneMappedTexture> > m_toneMapped;
+
+	///@brief Channel timings to resolve when the rendering pass completes
+	std::vector<GpuTimerRecord> m_timers;
+
+	///@brief Waveforms whose buffers the rendering pass reads (see WaveformRenderRing::AddWaveformInput())
+	std::vector<WaveformBase*> m_waveforms;
+};
+
+/**
+	@brief A small ring of command buffers for submitting waveform rendering without blocking
+
+	WaveformThread records each rendering pass into the next free slot and submits it with a fence, then goes back to
+	downloading and processing waveforms while the GPU works. A slot is retired (and the channels it references are
+	released) once its fences have signaled.
+
+	Each slot has one command buffer ("lane") per queue the ring was given. Every WaveformArea always records into the
+	same lane (see WaveformArea::GetRenderLane()), so the work for any one channel stays in submission order on one
+	queue, while different plots are recorded in parallel and may execute in parallel. The ring owns one worker thread
+	for each lane after the first, which live as long as the ring does (see RecordLanes()).
+
+	Each pass rasterizes and then tone maps. Slots are retired in the order they were submitted, and retiring a slot
+	hands the textures it tone mapped to the GUI thread (see ToneMappedTexture), so the GUI never waits on a pass.
+
+	Anything which overwrites waveform data the shaders might still be reading must wait for the passes in flight to
+	complete first. Each pass keeps a list of the waveforms it reads (see AddWaveformInput()), so WaitForWaveforms()
+	only waits for the passes reading the waveforms about to be overwritten. The ring's mutex is also held while a pass
+	is being recorded, so per-channel state written by the rasterizer is never seen half updated.
+
+	Buffers owned by a channel (index buffers, rasterized output, persistence, etc.) exist only once, but the last few
+	passes may still be using them. Before changing such a buffer from the CPU, or recording GPU work that writes it,
+	the rasterizer waits for the last pass which used it, then records the pass being recorded as its new last user
+	(see ClaimForPass()).
+
+	Rendering passes may also write timestamp queries around the work for each channel. These are read back when the
+	slot is retired, so measuring GPU time never stalls anything.
+ */
+class WaveformRenderRing
+{
+public:
+	WaveformRenderRing();
+	~WaveformRenderRing();
+
+	void Init(std::vector< std::shared_ptr<QueueHandle> >& queues);
+	void Clear();
+
+	/**
+		@brief Returns the number of command buffers in each rendering pass
+	 */
+	size_t GetLaneCount()
+	{ return m_queues.size(); }
+
+	void Acquire();
+	vk::raii::CommandBuffer& GetCommandBuffer(size_t lane);
+	void RecordLanes(const std::function<void(size_t)>& record);
+	void AddToneMapOutput(std::shared_ptr<ToneMappedTexture> tex);
+	void AddWaveformInput(WaveformBase* wfm);
+	void Submit(std::vector< std::shared_ptr<DisplayedChannel> >& channels);
+
+	/**
+		@brief Returns the sequence number of the pass being recorded
+
+		Must be called between Acquire() and Submit(). Sequence numbers start at 1, so zero means "never used".
+	 */
+	uint64_t GetRecordingPass()
+	{ return m_passCount + 1; }
+
+	void WaitForPass(uint64_t pass);
+	void ClaimForPass(uint64_t& lastPass);
+
+	void Poll();
+	bool IsIdle();
+	void WaitIdle();
+	void WaitForWaveforms(const std::set<WaveformBase*>& waveforms);
+
+	int64_t ReadBackElement(AcceleratorBuffer<int64_t>& buf, size_t i);
+
+	uint32_t WriteTimestamp(vk::raii::CommandBuffer& cmdbuf);
+	void AddGpuTimer(std::shared_ptr<DisplayedChannel> chan, GpuTimerPhase phase, uint32_t start, uint32_t end);
+	std::vector<ChannelGpuTimes> GetGpuTimes();
+
+	///@brief Number of rendering passes which may be in flight at once
+	static const size_t RING_SIZE = 3;
+
+	///@brief Maximum number of timestamp queries in one lane of a rendering pass
+	static const uint32_t MAX_TIMESTAMPS = 512;
+
+	///@brief Returned by WriteTimestamp() if no timestamp was written
+	static const uint32_t NO_TIMESTAMP = 0xffffffff;
+
+protected:
+	size_t GetLane(vk::raii::CommandBuffer& cmdbuf);
+	void WaitForSlot(WaveformRenderSlot& slot);
+	void RetireSlot(WaveformRenderSlot& slot);
+	void LaneWorker(size_t lane);
+	void StopLaneWorkers();
+
+	///@brief Mutex protecting the slots and submissions
+	std::mutex m_mutex;
+
+	///@brief Lock on m_mutex held from Acquire() until Submit(), so nobody sees a half recorded pass
+	std::unique_lock<std::mutex> m_recordLock;
+
+	///@brief Mutex protecting the lists of outputs of the pass being recorded, since lanes are recorded in parallel
+	std::mutex m_recordOutputMutex;
+
+	///@brief Queue each lane is submitted to
+	std::vector< std::shared_ptr<QueueHandle> > m_queues;
+
+	///@brief Command pool for each lane, so lanes can be recorded in parallel
+	std::vector< std::unique_ptr<vk::raii::CommandPool> > m_pools;
+
+	///@brief The slots
+	std::vector< std::unique_ptr<WaveformRenderSlot> > m_slots;
+
+	///@brief Index of the next slot to record into
+	size_t m_next;
+
+	///@brief Number of passes submitted so far
+	uint64_t m_passCount;
+
+	///@brief Number of valid bits in timestamps written by each lane's queue (zero if it can't write timestamps)
+	std::vector<uint32_t> m_timestampValidBits;
+
+	///@brief Nanoseconds per timestamp tick
+	float m_timestampPeriod;
+
+	///@brief Mutex protecting the readback objects, since lanes recorded in parallel may read back at once
+	std::mutex m_readbackMutex;
+
+	///@brief Command pool for m_readbackCmdBuf
+	std::unique_ptr<vk::raii::CommandPool> m_readbackPool;
+
+	///@brief Command buffer for single element readbacks, submitted on its own rather than as part of a pass
+	std::unique_ptr<vk::raii::CommandBuffer> m_readbackCmdBuf;
+
+	///@brief Compute pipeline copying the element to read back into m_readbackBuffer
+	std::unique_ptr<ComputePipeline> m_readbackPipe;
+
+	///@brief The element being read back
+	AcceleratorBuffer<int64_t> m_readbackBuffer;
+
+	///@brief Threads recording lanes 1 and up (lane 0 is recorded by the thread calling RecordLanes())
+	std::vector<std::thread> m_laneWorkers;
+
+	///@brief Mutex protecting the lane worker state below
+	std::mutex m_laneMutex;
+
+	///@brief Signaled when the lane workers have a new pass to record, or should quit
+	std::condition_variable m_laneStartCond;
+
+	///@brief Signaled when a lane worker finishes recording
+	std::condition_variable m_laneDoneCond;
+
+	///@brief Function recording one lane of the current pass
+	std::function<void(size_t)> m_laneRecord;
+
+	///@brief Incremented each time RecordLanes() hands the workers a new pass
+	uint64_t m_laneSerial;
+
+	///@brief Number of lane workers which haven't finished recording the current pass yet
+	size_t m_lanesRemaining;
+
+	///@brief True if the lane workers should exit
+	bool m_laneWorkersQuit;
+
+	///@brief Mutex protecting m_gpuTimes
+	std::mutex m_gpuTimesMutex;
+
+	///@brief GPU execution times of each channel measured so far
+	std::map<DisplayedChannel*, ChannelGpuTimes> m_gpuTimes;
+};
+
+#endif
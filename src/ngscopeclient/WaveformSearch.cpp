@@ -0,0 +1,254 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of WaveformSearch
+ */
+#include "ngscopeclient.h"
+#include "WaveformSearch.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+WaveformSearch::WaveformSearch()
+	: m_queue(g_vkQueueManager->GetComputeQueue("WaveformSearch.queue"))
+	, m_pipeline("shaders/WaveformSearch.spv", 2, sizeof(SearchTransitionsPushConstants))
+	, m_gpuTransitions("WaveformSearch.m_gpuTransitions")
+{
+	vk::CommandPoolCreateInfo poolInfo(
+		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		m_queue->m_family );
+	m_pool = make_unique<vk::raii::CommandPool>(*g_vkComputeDevice, poolInfo);
+
+	vk::CommandBufferAllocateInfo bufinfo(**m_pool, vk::CommandBufferLevel::ePrimary, 1);
+	m_cmdbuf = make_unique<vk::raii::CommandBuffer>(
+		move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+
+	//Written by the shader, read back by us
+	m_gpuTransitions.SetCpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_LIKELY);
+	m_gpuTransitions.SetGpuAccessHint(AcceleratorBuffer<uint32_t>::HINT_LIKELY);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transition finding on the GPU (the CPU kernels are in WaveformSearch_Kernels.cpp)
+
+/**
+	@brief Finds transitions with a compute shader, for waveforms whose samples are only up to date on the GPU
+
+	@return False if there were too many transitions to return, in which case the caller should search on the CPU
+ */
+bool WaveformSearch::FindTransitionsGPU(
+	AcceleratorBuffer<float>& samples, MatchMode mode, float lo, float hi, vector<uint32_t>& transitions)
+{
+	size_t len = samples.size();
+	size_t maxTransitions = min(len, MAX_GPU_TRANSITIONS);
+
+	//First word is the transition count, which the shader increments atomically
+	m_gpuTransitions.resize(maxTransitions + 1);
+	m_gpuTransitions.PrepareForCpuAccess();
+	m_gpuTransitions[0] = 0;
+	m_gpuTransitions.MarkModifiedFromCpu();
+
+	SearchTransitionsPushConstants args;
+	args.len = len;
+	args.maxTransitions = maxTransitions;
+	args.mode = mode;
+	args.lo = lo;
+	args.hi = hi;
+
+	//Split large waveforms across two dimensions to stay under the maximum work group count
+	const uint32_t maxGroupsX = 32768;
+	uint32_t groups = GetComputeBlockCount(len, 64);
+	uint32_t groupsX = min(groups, maxGroupsX);
+	uint32_t groupsY = (groups + groupsX - 1) / groupsX;
+
+	m_cmdbuf->begin({});
+	m_pipeline.BindBufferNonblocking(0, samples, *m_cmdbuf);
+	m_pipeline.BindBufferNonblocking(1, m_gpuTransitions, *m_cmdbuf, true);
+	m_pipeline.Dispatch(*m_cmdbuf, args, groupsX, groupsY);
+	m_cmdbuf->end();
+	m_queue->SubmitAndBlock(*m_cmdbuf);
+
+	m_gpuTransitions.MarkModifiedFromGpu();
+	m_gpuTransitions.PrepareForCpuAccess();
+
+	size_t count = m_gpuTransitions[0];
+	if(count > maxTransitions)
+		return false;
+
+	//Work items finish in no particular order
+	transitions.assign(m_gpuTransitions.GetCpuPointer() + 1, m_gpuTransitions.GetCpuPointer() + 1 + count);
+	sort(transitions.begin(), transitions.end());
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Searching
+
+/**
+	@brief Finds events in a stream's current waveform which match a condition
+
+	Must be called with the waveform data mutex held.
+
+	@param stream	The stream to search (must be analog)
+	@param cond		The condition to look for
+	@param lo		Level for single-level conditions, lower level for windows
+	@param hi		Upper level for windows
+	@param width	Pulse width threshold, in X axis units, for pulse width conditions
+	@param hits		Matches, in ascending order of time
+	@param maxHits	Stop after this many matches
+ */
+void WaveformSearch::Search(
+	StreamDescriptor stream,
+	SearchCondition cond,
+	float lo,
+	float hi,
+	int64_t width,
+	vector<SearchHit>& hits,
+	size_t maxHits)
+{
+	hits.clear();
+
+	auto data = stream.GetData();
+	auto uadata = dynamic_cast<UniformAnalogWaveform*>(data);
+	auto sadata = dynamic_cast<SparseAnalogWaveform*>(data);
+	auto udata = dynamic_cast<UniformWaveformBase*>(data);
+	auto sdata = dynamic_cast<SparseWaveformBase*>(data);
+	if(!uadata && !sadata)
+		return;
+	auto& samples = uadata ? uadata->m_samples : sadata->m_samples;
+	size_t len = samples.size();
+	if(len == 0)
+		return;
+
+	//Windows are easier to use if the levels can be entered either way around
+	if( (cond == SEARCH_INSIDE_WINDOW) || (cond == SEARCH_OUTSIDE_WINDOW) )
+	{
+		if(lo > hi)
+			swap(lo, hi);
+	}
+
+	MatchMode mode;
+	switch(cond)
+	{
+		case SEARCH_BELOW:
+			mode = MATCH_BELOW;
+			break;
+
+		case SEARCH_INSIDE_WINDOW:
+			mode = MATCH_INSIDE;
+			break;
+
+		case SEARCH_OUTSIDE_WINDOW:
+			mode = MATCH_OUTSIDE;
+			break;
+
+		default:
+			mode = MATCH_ABOVE;
+			break;
+	}
+
+	//Each hit needs at most one run (two transitions), plus one more run for a rising edge since a run starting at
+	//sample 0 doesn't count. Pulse widths need every run. The cap is even so the last run is never cut in half.
+	size_t maxTransitions = SIZE_MAX;
+	bool pulse = (cond == SEARCH_PULSE_WIDER) || (cond == SEARCH_PULSE_NARROWER);
+	if(!pulse && (maxHits < SIZE_MAX/2 - 1))
+		maxTransitions = 2 * (maxHits + 1);
+
+	//Don't pull the waveform back to the CPU just to search it
+	vector<uint32_t> transitions;
+	bool found = false;
+	if(samples.IsCpuBufferStale())
+	{
+		shared_lock<shared_mutex> lock(g_vulkanActivityMutex);
+		found = FindTransitionsGPU(samples, mode, lo, hi, transitions);
+	}
+	if(!found)
+	{
+		transitions.clear();
+		samples.PrepareForCpuAccess();
+		FindTransitions(samples.GetCpuPointer(), len, mode, lo, hi, maxTransitions, transitions);
+	}
+	if(transitions.empty())
+		return;
+
+	if(sdata)
+	{
+		sdata->m_offsets.PrepareForCpuAccess();
+		sdata->m_durations.PrepareForCpuAccess();
+	}
+
+	//Transitions alternate between the start and end of a run of matching samples.
+	//An odd count means the last run extends to the end of the waveform.
+	for(size_t i=0; (i<transitions.size()) && (hits.size() < maxHits); i+=2)
+	{
+		size_t start = transitions[i];
+		int64_t tstart = ::GetOffsetScaled(sdata, udata, start);
+		int64_t tend;
+		if(i+1 < transitions.size())
+			tend = ::GetOffsetScaled(sdata, udata, transitions[i+1]);
+		else
+			tend = ::GetOffsetScaled(sdata, udata, len-1) + ::GetDurationScaled(sdata, udata, len-1);
+		int64_t duration = tend - tstart;
+
+		//Runs cut off by either end of the waveform don't have a meaningful width
+		bool complete = (start > 0) && (i+1 < transitions.size());
+
+		switch(cond)
+		{
+			case SEARCH_RISING_EDGE:
+				if(start > 0)
+					hits.push_back(SearchHit(start, tstart, 0));
+				break;
+
+			case SEARCH_FALLING_EDGE:
+				if(i+1 < transitions.size())
+					hits.push_back(SearchHit(transitions[i+1], tend, 0));
+				break;
+
+			case SEARCH_PULSE_WIDER:
+				if(complete && (duration > width))
+					hits.push_back(SearchHit(start, tstart, duration));
+				break;
+
+			case SEARCH_PULSE_NARROWER:
+				if(complete && (duration < width))
+					hits.push_back(SearchHit(start, tstart, duration));
+				break;
+
+			default:
+				hits.push_back(SearchHit(start, tstart, duration));
+				break;
+		}
+	}
+}
@@ -0,0 +1,152 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of WaveformSearch
+ */
+#ifndef WaveformSearch_h
+#define WaveformSearch_h
+
+/**
+	@brief Kinds of event a waveform search can look for
+ */
+enum SearchCondition
+{
+	SEARCH_ABOVE,				//Samples above a level
+	SEARCH_BELOW,				//Samples below a level
+	SEARCH_INSIDE_WINDOW,		//Samples between two levels
+	SEARCH_OUTSIDE_WINDOW,		//Samples outside two levels
+	SEARCH_RISING_EDGE,			//Rising crossings of a level
+	SEARCH_FALLING_EDGE,		//Falling crossings of a level
+	SEARCH_PULSE_WIDER,			//Pulses above a level which are wider than a given width
+	SEARCH_PULSE_NARROWER		//Pulses above a level which are narrower than a given width
+};
+
+/**
+	@brief One match found by a waveform search
+
+	Consecutive matching samples are reported as a single hit, so a level search on a noisy signal returns one hit per
+	excursion rather than one per sample.
+ */
+class SearchHit
+{
+public:
+	SearchHit(size_t index, int64_t timestamp, int64_t duration)
+		: m_index(index)
+		, m_timestamp(timestamp)
+		, m_duration(duration)
+	{}
+
+	///@brief Index of the first matching sample
+	size_t m_index;
+
+	///@brief X axis position of the first matching sample
+	int64_t m_timestamp;
+
+	///@brief Length of the run of matching samples, in X axis units (zero for edges)
+	int64_t m_duration;
+};
+
+struct SearchTransitionsPushConstants
+{
+	uint32_t len;
+	uint32_t maxTransitions;
+	uint32_t mode;
+	float lo;
+	float hi;
+};
+
+/**
+	@brief Finds events matching a condition in an analog waveform
+
+	Every condition reduces to a per-sample predicate, and the search itself finds the transitions of that predicate.
+	Transitions are found with AVX2 or AVX-512 kernels for data in CPU memory, or by a compute shader when the
+	waveform's only up-to-date copy is on the GPU, so searching a filter output doesn't pull the whole waveform back.
+	Runs between transitions are then filtered and turned into hits on the CPU.
+ */
+class WaveformSearch
+{
+public:
+	WaveformSearch();
+
+	void Search(
+		StreamDescriptor stream,
+		SearchCondition cond,
+		float lo,
+		float hi,
+		int64_t width,
+		std::vector<SearchHit>& hits,
+		size_t maxHits = SIZE_MAX);
+
+	/**
+		@brief Per-sample predicates the conditions are built from
+	 */
+	enum MatchMode
+	{
+		MATCH_ABOVE,
+		MATCH_BELOW,
+		MATCH_INSIDE,
+		MATCH_OUTSIDE
+	};
+
+	static void FindTransitions(
+		const float* samples,
+		size_t len,
+		MatchMode mode,
+		float lo,
+		float hi,
+		size_t maxTransitions,
+		std::vector<uint32_t>& transitions);
+
+protected:
+	bool FindTransitionsGPU(
+		AcceleratorBuffer<float>& samples, MatchMode mode, float lo, float hi, std::vector<uint32_t>& transitions);
+
+	///@brief Largest number of transitions the GPU path can return before we fall back to the CPU
+	static const size_t MAX_GPU_TRANSITIONS = 1024 * 1024;
+
+	///@brief Queue for GPU searches
+	std::shared_ptr<QueueHandle> m_queue;
+
+	///@brief Command pool for GPU searches
+	std::unique_ptr<vk::raii::CommandPool> m_pool;
+
+	///@brief Command buffer for GPU searches
+	std::unique_ptr<vk::raii::CommandBuffer> m_cmdbuf;
+
+	///@brief Compute pipeline finding transitions on the GPU
+	ComputePipeline m_pipeline;
+
+	///@brief Output of the GPU search: transition count followed by the transitions, unordered
+	AcceleratorBuffer<uint32_t> m_gpuTransitions;
+};
+
+#endif
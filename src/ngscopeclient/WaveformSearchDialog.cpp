@@ -0,0 +1,293 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of WaveformSearchDialog
+ */
+
+#include "ngscopeclient.h"
+#include "WaveformSearchDialog.h"
+#include "MainWindow.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+WaveformSearchDialog::WaveformSearchDialog(Session& session, MainWindow& wnd)
+	: Dialog("Search", ImVec2(400, 350))
+	, m_session(session)
+	, m_parent(wnd)
+	, m_stream(nullptr, 0)
+	, m_condition(SEARCH_ABOVE)
+	, m_lo(0)
+	, m_hi(0)
+	, m_width(0)
+	, m_currentHit(SIZE_MAX)
+	, m_searchedWaveform(0, 0)
+	, m_needToScrollToCurrentHit(false)
+{
+	m_widthText = Unit(Unit::UNIT_FS).PrettyPrint(m_width);
+}
+
+WaveformSearchDialog::~WaveformSearchDialog()
+{
+	SelectStream(StreamDescriptor(nullptr, 0));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rendering
+
+/**
+	@brief Renders the dialog and handles UI events
+
+	@return		True if we should continue showing the dialog
+				False if it's been closed
+ */
+bool WaveformSearchDialog::DoRender()
+{
+	float width = ImGui::GetFontSize();
+
+	//Find every analog stream we could search
+	vector<StreamDescriptor> streams;
+	auto& scopes = m_session.GetScopes();
+	for(auto scope : scopes)
+	{
+		for(size_t i=0; i<scope->GetChannelCount(); i++)
+		{
+			auto chan = scope->GetChannel(i);
+			for(size_t j=0; j<chan->GetStreamCount(); j++)
+			{
+				if(chan->GetType(j) == Stream::STREAM_TYPE_ANALOG)
+					streams.push_back(StreamDescriptor(chan, j));
+			}
+		}
+	}
+	auto filters = Filter::GetAllInstances();
+	for(auto f : filters)
+	{
+		for(size_t j=0; j<f->GetStreamCount(); j++)
+		{
+			if(f->GetType(j) == Stream::STREAM_TYPE_ANALOG)
+				streams.push_back(StreamDescriptor(f, j));
+		}
+	}
+
+	vector<string> names;
+	int sel = -1;
+	for(auto& s : streams)
+	{
+		if(s == m_stream)
+			sel = names.size();
+		names.push_back(s.GetName());
+	}
+	ImGui::SetNextItemWidth(10 * width);
+	if(Combo("Channel", names, sel))
+		SelectStream(streams[sel]);
+
+	ImGui::SetNextItemWidth(10 * width);
+	ImGui::Combo(
+		"Condition",
+		&m_condition,
+		"Above level\0Below level\0Inside window\0Outside window\0Rising edge\0Falling edge\0"
+		"Pulse wider than\0Pulse narrower than\0");
+
+	Unit yunit = m_stream ? m_stream.GetYAxisUnits() : Unit(Unit::UNIT_VOLTS);
+	bool window = (m_condition == SEARCH_INSIDE_WINDOW) || (m_condition == SEARCH_OUTSIDE_WINDOW);
+	bool pulse = (m_condition == SEARCH_PULSE_WIDER) || (m_condition == SEARCH_PULSE_NARROWER);
+
+	if(m_loText.empty())
+		m_loText = yunit.PrettyPrint(m_lo);
+	if(m_hiText.empty())
+		m_hiText = yunit.PrettyPrint(m_hi);
+
+	ImGui::SetNextItemWidth(10 * width);
+	UnitInputWithImplicitApply(window ? "Lower level" : "Level", m_loText, m_lo, yunit);
+	if(window)
+	{
+		ImGui::SetNextItemWidth(10 * width);
+		UnitInputWithImplicitApply("Upper level", m_hiText, m_hi, yunit);
+	}
+	if(pulse)
+	{
+		ImGui::SetNextItemWidth(10 * width);
+		UnitInputWithImplicitApply("Width", m_widthText, m_width, Unit(Unit::UNIT_FS));
+	}
+
+	if(!m_stream)
+		ImGui::BeginDisabled();
+	if(ImGui::Button("Search"))
+		RunSearch();
+	if(!m_stream)
+		ImGui::EndDisabled();
+
+	if(m_hits.empty())
+	{
+		if(m_searchedWaveform != TimePoint(0, 0))
+			ImGui::TextUnformatted("No matches");
+		return true;
+	}
+
+	//Step through the results
+	ImGui::SameLine();
+	if(ImGui::Button("<"))
+		GoToHit( (m_currentHit == 0 || m_currentHit == SIZE_MAX) ? m_hits.size() - 1 : m_currentHit - 1);
+	Dialog::Tooltip("Previous match");
+	ImGui::SameLine();
+	if(ImGui::Button(">"))
+		GoToHit( (m_currentHit + 1 >= m_hits.size()) ? 0 : m_currentHit + 1);
+	Dialog::Tooltip("Next match");
+	ImGui::SameLine();
+	if(m_currentHit == SIZE_MAX)
+		ImGui::Text("%zu matches", m_hits.size());
+	else
+		ImGui::Text("Match %zu of %zu", m_currentHit + 1, m_hits.size());
+
+	ImGui::TextUnformatted((string("In waveform ") + m_searchedWaveform.PrettyPrint()).c_str());
+
+	static ImGuiTableFlags flags =
+		ImGuiTableFlags_Resizable |
+		ImGuiTableFlags_BordersOuter |
+		ImGuiTableFlags_BordersV |
+		ImGuiTableFlags_ScrollY |
+		ImGuiTableFlags_RowBg |
+		ImGuiTableFlags_SizingFixedFit;
+
+	Unit fs(Unit::UNIT_FS);
+	if(ImGui::BeginTable("hits", 2, flags))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Time", ImGuiTableColumnFlags_WidthFixed, 8*width);
+		ImGui::TableSetupColumn("Duration", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableHeadersRow();
+
+		//Rows aren't all submitted, so scroll by position rather than with SetScrollHereY()
+		float rowHeight = ImGui::GetTextLineHeight() + 2*ImGui::GetStyle().CellPadding.y;
+		if(m_needToScrollToCurrentHit && (m_currentHit != SIZE_MAX))
+		{
+			m_needToScrollToCurrentHit = false;
+			ImGui::SetScrollY(m_currentHit * rowHeight - ImGui::GetWindowHeight()/2);
+		}
+
+		//Searches can return a lot of hits, only draw the visible ones
+		ImGuiListClipper clipper;
+		clipper.Begin(m_hits.size(), rowHeight);
+		while(clipper.Step())
+		{
+			for(int i=clipper.DisplayStart; i<clipper.DisplayEnd; i++)
+			{
+				auto& hit = m_hits[i];
+
+				ImGui::PushID(i);
+				ImGui::TableNextRow();
+
+				ImGui::TableSetColumnIndex(0);
+				bool selected = (m_currentHit == (size_t)i);
+				if(ImGui::Selectable(
+					fs.PrettyPrint(hit.m_timestamp).c_str(),
+					selected,
+					ImGuiSelectableFlags_SpanAllColumns))
+				{
+					GoToHit(i);
+					m_needToScrollToCurrentHit = false;
+				}
+
+				ImGui::TableSetColumnIndex(1);
+				if(hit.m_duration > 0)
+					ImGui::TextUnformatted(fs.PrettyPrint(hit.m_duration).c_str());
+
+				ImGui::PopID();
+			}
+		}
+
+		ImGui::EndTable();
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// UI event handlers
+
+/**
+	@brief Changes the stream being searched, holding a reference to it so it doesn't disappear on us
+ */
+void WaveformSearchDialog::SelectStream(StreamDescriptor stream)
+{
+	if(stream == m_stream)
+		return;
+
+	if(stream.m_channel)
+		stream.m_channel->AddRef();
+	if(m_stream.m_channel)
+		m_stream.m_channel->Release();
+	m_stream = stream;
+
+	//Results and levels were for the old stream
+	m_hits.clear();
+	m_currentHit = SIZE_MAX;
+	m_searchedWaveform = TimePoint(0, 0);
+	if(m_stream)
+	{
+		m_loText = m_stream.GetYAxisUnits().PrettyPrint(m_lo);
+		m_hiText = m_stream.GetYAxisUnits().PrettyPrint(m_hi);
+	}
+}
+
+/**
+	@brief Searches the current waveform of the selected stream
+ */
+void WaveformSearchDialog::RunSearch()
+{
+	lock_guard<recursive_mutex> lock(m_session.GetWaveformDataMutex());
+
+	m_currentHit = SIZE_MAX;
+	m_search.Search(m_stream, static_cast<SearchCondition>(m_condition), m_lo, m_hi, m_width, m_hits);
+
+	auto data = m_stream.GetData();
+	if(data)
+		m_searchedWaveform = TimePoint(data->m_startTimestamp, data->m_startFemtoseconds);
+
+	if(!m_hits.empty())
+		GoToHit(0);
+}
+
+/**
+	@brief Scrolls the waveform view to a search result
+ */
+void WaveformSearchDialog::GoToHit(size_t i)
+{
+	m_currentHit = i;
+	m_needToScrollToCurrentHit = true;
+
+	auto& hit = m_hits[i];
+	m_parent.NavigateToTimestamp(hit.m_timestamp, hit.m_duration, m_stream);
+}
@@ -0,0 +1,93 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of WaveformSearchDialog
+ */
+#ifndef WaveformSearchDialog_h
+#define WaveformSearchDialog_h
+
+#include "Dialog.h"
+#include "WaveformSearch.h"
+
+class MainWindow;
+
+class WaveformSearchDialog : public Dialog
+{
+public:
+	WaveformSearchDialog(Session& session, MainWindow& wnd);
+	virtual ~WaveformSearchDialog();
+
+	virtual bool DoRender();
+
+protected:
+	void SelectStream(StreamDescriptor stream);
+	void RunSearch();
+	void GoToHit(size_t i);
+
+	Session& m_session;
+	MainWindow& m_parent;
+
+	///@brief The stream being searched (we hold a reference to its channel)
+	StreamDescriptor m_stream;
+
+	///@brief The condition to search for
+	int m_condition;
+
+	///@brief Level, or lower level of a window
+	std::string m_loText;
+	double m_lo;
+
+	///@brief Upper level of a window
+	std::string m_hiText;
+	double m_hi;
+
+	///@brief Pulse width threshold
+	std::string m_widthText;
+	double m_width;
+
+	///@brief Engine doing the actual search
+	WaveformSearch m_search;
+
+	///@brief Results of the last search
+	std::vector<SearchHit> m_hits;
+
+	///@brief Index of the hit we last navigated to, or SIZE_MAX if none
+	size_t m_currentHit;
+
+	///@brief Timestamp of the waveform the results came from
+	TimePoint m_searchedWaveform;
+
+	///@brief True if the list should be scrolled to the current hit
+	bool m_needToScrollToCurrentHit;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* glscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg                                                                          *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief CPU kernels for WaveformSearch
+
+	Kept apart from the GPU path so they can be built and tested without Vulkan.
+ */
+#include "ngscopeclient.h"
+#include "WaveformSearch.h"
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transition finding kernels
+
+/**
+	@brief Evaluates the match predicate for one sample
+ */
+template<WaveformSearch::MatchMode mode>
+static inline bool Match(float v, float lo, float hi)
+{
+	switch(mode)
+	{
+		case WaveformSearch::MATCH_ABOVE:
+			return v > lo;
+
+		case WaveformSearch::MATCH_BELOW:
+			return v < lo;
+
+		case WaveformSearch::MATCH_INSIDE:
+			return (v >= lo) && (v <= hi);
+
+		case WaveformSearch::MATCH_OUTSIDE:
+		default:
+			return (v < lo) || (v > hi);
+	}
+}
+
+/**
+	@brief Finds transitions of the predicate in samples [start, end), given the predicate of sample start-1
+ */
+template<WaveformSearch::MatchMode mode>
+static void FindTransitionsScalar(
+	const float* samples,
+	size_t start,
+	size_t end,
+	bool prev,
+	float lo,
+	float hi,
+	size_t maxTransitions,
+	vector<uint32_t>& transitions)
+{
+	for(size_t i=start; (i<end) && (transitions.size() < maxTransitions); i++)
+	{
+		bool m = Match<mode>(samples[i], lo, hi);
+		if(m != prev)
+			transitions.push_back(i);
+		prev = m;
+	}
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+/**
+	@brief Appends the index of every set bit in a transition mask
+ */
+static inline void EmitTransitions(uint32_t edges, size_t base, vector<uint32_t>& transitions)
+{
+	while(edges)
+	{
+		transitions.push_back(base + __builtin_ctz(edges));
+		edges &= edges - 1;
+	}
+}
+
+/**
+	@brief AVX2 version of FindTransitionsScalar(), eight samples per iteration
+
+	The predicate of each block becomes a bitmask, and XORing it with itself shifted by one sample (carrying in the last
+	bit of the previous block) leaves a bit set at each transition. Blocks with no transitions cost a compare and a
+	movemask and never touch the output.
+ */
+template<WaveformSearch::MatchMode mode>
+__attribute__((target("avx2")))
+static void FindTransitionsAVX2(
+	const float* samples, size_t len, float lo, float hi, size_t maxTransitions, vector<uint32_t>& transitions)
+{
+	__m256 vlo = _mm256_set1_ps(lo);
+	__m256 vhi = _mm256_set1_ps(hi);
+
+	uint32_t prev = 0;
+	size_t end = len - (len % 8);
+	for(size_t i=0; i<end; i+=8)
+	{
+		__m256 v = _mm256_loadu_ps(samples + i);
+
+		__m256 m;
+		switch(mode)
+		{
+			case WaveformSearch::MATCH_ABOVE:
+				m = _mm256_cmp_ps(v, vlo, _CMP_GT_OQ);
+				break;
+
+			case WaveformSearch::MATCH_BELOW:
+				m = _mm256_cmp_ps(v, vlo, _CMP_LT_OQ);
+				break;
+
+			case WaveformSearch::MATCH_INSIDE:
+				m = _mm256_and_ps(_mm256_cmp_ps(v, vlo, _CMP_GE_OQ), _mm256_cmp_ps(v, vhi, _CMP_LE_OQ));
+				break;
+
+			case WaveformSearch::MATCH_OUTSIDE:
+			default:
+				m = _mm256_or_ps(_mm256_cmp_ps(v, vlo, _CMP_LT_OQ), _mm256_cmp_ps(v, vhi, _CMP_GT_OQ));
+				break;
+		}
+
+		uint32_t bits = _mm256_movemask_ps(m);
+		uint32_t edges = (bits ^ ((bits << 1) | prev)) & 0xff;
+		prev = bits >> 7;
+
+		if(edges)
+		{
+			EmitTransitions(edges, i, transitions);
+			if(transitions.size() >= maxTransitions)
+			{
+				transitions.resize(maxTransitions);
+				return;
+			}
+		}
+	}
+
+	FindTransitionsScalar<mode>(samples, end, len, prev != 0, lo, hi, maxTransitions, transitions);
+}
+
+/**
+	@brief AVX-512 version of FindTransitionsScalar(), sixteen samples per iteration
+ */
+template<WaveformSearch::MatchMode mode>
+__attribute__((target("avx512f")))
+static void FindTransitionsAVX512F(
+	const float* samples, size_t len, float lo, float hi, size_t maxTransitions, vector<uint32_t>& transitions)
+{
+	__m512 vlo = _mm512_set1_ps(lo);
+	__m512 vhi = _mm512_set1_ps(hi);
+
+	uint32_t prev = 0;
+	size_t end = len - (len % 16);
+	for(size_t i=0; i<end; i+=16)
+	{
+		__m512 v = _mm512_loadu_ps(samples + i);
+
+		__mmask16 m;
+		switch(mode)
+		{
+			case WaveformSearch::MATCH_ABOVE:
+				m = _mm512_cmp_ps_mask(v, vlo, _CMP_GT_OQ);
+				break;
+
+			case WaveformSearch::MATCH_BELOW:
+				m = _mm512_cmp_ps_mask(v, vlo, _CMP_LT_OQ);
+				break;
+
+			case WaveformSearch::MATCH_INSIDE:
+				m = _mm512_cmp_ps_mask(v, vlo, _CMP_GE_OQ) & _mm512_cmp_ps_mask(v, vhi, _CMP_LE_OQ);
+				break;
+
+			case WaveformSearch::MATCH_OUTSIDE:
+			default:
+				m = _mm512_cmp_ps_mask(v, vlo, _CMP_LT_OQ) | _mm512_cmp_ps_mask(v, vhi, _CMP_GT_OQ);
+				break;
+		}
+
+		uint32_t bits = m;
+		uint32_t edges = (bits ^ ((bits << 1) | prev)) & 0xffff;
+		prev = bits >> 15;
+
+		if(edges)
+		{
+			EmitTransitions(edges, i, transitions);
+			if(transitions.size() >= maxTransitions)
+			{
+				transitions.resize(maxTransitions);
+				return;
+			}
+		}
+	}
+
+	FindTransitionsScalar<mode>(samples, end, len, prev != 0, lo, hi, maxTransitions, transitions);
+}
+#endif /* __x86_64__ && !__clang__ */
+
+template<WaveformSearch::MatchMode mode>
+static void FindTransitionsForMode(
+	const float* samples, size_t len, float lo, float hi, size_t maxTransitions, vector<uint32_t>& transitions)
+{
+	#if defined(__x86_64__) && !defined(__clang__)
+		if(g_hasAvx512F)
+		{
+			FindTransitionsAVX512F<mode>(samples, len, lo, hi, maxTransitions, transitions);
+			return;
+		}
+		if(g_hasAvx2)
+		{
+			FindTransitionsAVX2<mode>(samples, len, lo, hi, maxTransitions, transitions);
+			return;
+		}
+	#endif
+	FindTransitionsScalar<mode>(samples, 0, len, false, lo, hi, maxTransitions, transitions);
+}
+
+/**
+	@brief Finds every sample where the match predicate differs from the previous sample's
+
+	Sample -1 is considered not to match, so a waveform starting inside a match begins with a transition at index 0.
+
+	@param samples		Sample data (in CPU memory)
+	@param len			Number of samples
+	@param mode			The predicate to evaluate
+	@param lo			Level for single-level predicates, lower level for windows
+	@param hi			Upper level for windows
+	@param maxTransitions	Stop once this many transitions have been found
+	@param transitions	Indexes of the transitions, in ascending order, are appended here
+ */
+void WaveformSearch::FindTransitions(
+	const float* samples,
+	size_t len,
+	MatchMode mode,
+	float lo,
+	float hi,
+	size_t maxTransitions,
+	vector<uint32_t>& transitions)
+{
+	switch(mode)
+	{
+		case MATCH_ABOVE:
+			FindTransitionsForMode<MATCH_ABOVE>(samples, len, lo, hi, maxTransitions, transitions);
+			break;
+
+		case MATCH_BELOW:
+			FindTransitionsForMode<MATCH_BELOW>(samples, len, lo, hi, maxTransitions, transitions);
+			break;
+
+		case MATCH_INSIDE:
+			FindTransitionsForMode<MATCH_INSIDE>(samples, len, lo, hi, maxTransitions, transitions);
+			break;
+
+		case MATCH_OUTSIDE:
+			FindTransitionsForMode<MATCH_OUTSIDE>(samples, len, lo, hi, maxTransitions, transitions);
+			break;
+	}
+}
@@ -51,7 +51,7 @@ Event g_waveformProcessedEvent;
 ///@brief Time spent on the last cycle of waveform rendering shaders
 atomic<int64_t> g_lastWaveformRenderTime;
 
-void RenderAllWaveforms(vk::raii::CommandBuffer& cmdbuf, Session* session, shared_ptr<QueueHandle> queue);
+void RenderAllWaveforms(WaveformRenderRing& ring, Session* session);
 
 /**
 	@brief Mutex for controlling access to background Vulkan activity
@@ -60,49 +60,45 @@ void RenderAllWaveforms(vk::raii::CommandBuffer& cmdbuf, Session* session, share
  */
 std::shared_mutex g_vulkanActivityMutex;
 
-void WaveformThread(Session* session, atomic<bool>* shuttingDown)
+void WaveformThread(Session* session, atomic<bool>* shuttingDown, int64_t nqueues)
 {
 	pthread_setname_np_compat("WaveformThread");
 
 	LogTrace("Starting\n");
 
-	//Create a queue and command buffer for this thread's accelerated processing
-	shared_ptr<QueueHandle> queue(g_vkQueueManager->GetComputeQueue("WaveformThread.queue"));
-	vk::CommandPoolCreateInfo poolInfo(
-		vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
-		queue->m_family );
-	vk::raii::CommandPool pool(*g_vkComputeDevice, poolInfo);
+	//Create queues and a ring of command buffers for this thread's accelerated processing.
+	//Rendering passes end by tone mapping into textures the GUI samples from its fragment shaders, so the queues have
+	//to come from the render family. If the device has fewer queues than we ask for, some of them will be shared, which
+	//is still correct but means the lanes only record in parallel and don't execute in parallel.
+	//The requested queue count comes from the GUI thread (see Session::StartWaveformThreadIfNeeded()).
+	nqueues = max((int64_t)1, min(nqueues, (int64_t)8));
+	vector< shared_ptr<QueueHandle> > queues;
+	for(int64_t i=0; i<nqueues; i++)
+		queues.push_back(g_vkQueueManager->GetRenderQueue(string("WaveformThread.queue") + to_string(i)));
+	auto& ring = session->GetRenderRing();
+	ring.Init(queues);
 
-	vk::CommandBufferAllocateInfo bufinfo(*pool, vk::CommandBufferLevel::ePrimary, 1);
-	vk::raii::CommandBuffer cmdbuf(move(vk::raii::CommandBuffers(*g_vkComputeDevice, bufinfo).front()));
+	//True if we've given the GUI a waveform in frame skip mode which it hasn't picked up yet
+	bool displayPending = false;
 
-	if(g_hasDebugUtils)
-	{
-		string prefix = "WaveformThread";
-		string poolname = prefix + ".pool";
-		string bufname = prefix + ".cmdbuf";
-
-		g_vkComputeDevice->setDebugUtilsObjectNameEXT(
-			vk::DebugUtilsObjectNameInfoEXT(
-				vk::ObjectType::eCommandPool,
-				reinterpret_cast<int64_t>(static_cast<VkCommandPool>(*pool)),
-				poolname.c_str()));
-
-		g_vkComputeDevice->setDebugUtilsObjectNameEXT(
-			vk::DebugUtilsObjectNameInfoEXT(
-				vk::ObjectType::eCommandBuffer,
-				reinterpret_cast<int64_t>(static_cast<VkCommandBuffer>(*cmdbuf)),
-				bufname.c_str()));
-	}
+	//True if the most recent waveform wasn't given to the GUI in frame skip mode
+	bool newestSkipped = false;
 
 	while(!*shuttingDown)
 	{
+		//Release channels held by rendering passes that have finished
+		ring.Poll();
+
+		//Pick up any preference changes. The settings then stay the same for the rest of the pass.
+		session->UpdateWaveformThreadSettings();
+
 		//If re-running the filter graph was requested, do that (and re-render)
 		if(g_refilterRequestedEvent.Peek())
 		{
 			LogTrace("WaveformThread: re-running filter graph and re-rendering\n");
+			ring.WaitForWaveforms(session->GetFilterOutputs());
 			session->RefreshAllFilters();
-			RenderAllWaveforms(cmdbuf, session, queue);
+			RenderAllWaveforms(ring, session);
 			g_refilterDoneEvent.Signal();
 			continue;
 		}
@@ -111,7 +107,7 @@ void WaveformThread(Session* session, atomic<bool>* shuttingDown)
 		if(g_rerenderRequestedEvent.Peek())
 		{
 			LogTrace("WaveformThread: re-rendering\n");
-			RenderAllWaveforms(cmdbuf, session, queue);
+			RenderAllWaveforms(ring, session);
 			g_rerenderDoneEvent.Signal();
 			continue;
 		}
@@ -119,28 +115,138 @@ void WaveformThread(Session* session, atomic<bool>* shuttingDown)
 		//Wait for data to be available from all scopes
 		if(!session->CheckForPendingWaveforms())
 		{
+			//If we skipped drawing the newest waveform in frame skip mode, draw it once the GUI is ready,
+			//so the display doesn't end up stuck on an older one when acquisition stops
+			if(newestSkipped)
+			{
+				if(displayPending && g_waveformProcessedEvent.Peek())
+					displayPending = false;
+
+				if(!displayPending)
+				{
+					RenderAllWaveforms(ring, session);
+					g_waveformReadyEvent.Signal();
+					displayPending = true;
+					newestSkipped = false;
+				}
+			}
+
 			this_thread::sleep_for(chrono::milliseconds(1));
 			continue;
 		}
 
-		//We've got data. Download it, then run the filter graph
-		session->DownloadWaveforms();
-		session->RefreshAllFilters();
+		//We've got data. Download it, then run the filter graph.
+		//Filters overwrite their output waveforms in place, so the rendering passes reading them have to be done
+		//before we can start. Passes which only read instrument waveforms can keep running, and downloading doesn't
+		//touch anything the shaders use, so both overlap with rendering.
+		//In roll mode, each acquisition is filtered on its own, then appended to the roll buffers (in place), which
+		//likewise waits only for the passes reading the roll buffers.
+		//In batch mode, everything the instruments have queued (e.g. a whole segmented capture) is handled in this
+		//pass. Every segment is checked against the halt conditions, added to the statistics and added to history, but
+		//only the last one goes to the GUI. Earlier segments are only filtered if something needs their filter outputs
+		//(see Session::SegmentNeedsFilterGraph()), and only drawn if the user wants to see every segment overlaid.
+		size_t nsegments = session->GetBatchSegmentCount();
+		for(size_t i=0; i<nsegments; i++)
+		{
+			bool last = (i+1 == nsegments);
+
+			session->DownloadWaveforms();
+
+			//In multi-scope free-run mode, get the instruments capturing the next waveform while we process this one
+			if(last)
+				session->RearmIfFreeRunning(Session::REARM_AFTER_DOWNLOAD);
+
+			bool filtered = false;
+			if(last || session->SegmentNeedsFilterGraph())
+			{
+				ring.WaitForWaveforms(session->GetFilterOutputs());
+				session->RefreshAllFilters();
+				filtered = true;
+			}
+			else
+				session->UpdateStatistics();
+
+			//If this acquisition has the event we're waiting for, stop before any more come in behind it.
+			//Stopping discards the rest of the batch, so the matching segment is the one the GUI gets, and it needs
+			//its filter outputs even if the conditions only looked at instrument channels.
+			if(session->CheckHaltConditions())
+			{
+				last = true;
+				if(!filtered)
+				{
+					ring.WaitForWaveforms(session->GetFilterOutputs());
+					session->RefreshAllFilters();
+				}
+			}
+			if(last)
+				session->RearmIfFreeRunning(Session::REARM_AFTER_FILTERS);
+			if(session->GetRollMode().IsActive())
+			{
+				ring.WaitForWaveforms(session->GetRollMode().GetRollWaveforms());
+				session->AppendToRollBuffers();
+			}
 
-		//Rerun the heavyweight rendering shaders
-		RenderAllWaveforms(cmdbuf, session, queue);
+			//Every waveform goes in history, whether or not it's displayed
+			session->SaveSegmentToHistory();
+			if(last)
+				break;
+
+			if(session->GetWaveformThreadSettings().m_overlaySegments)
+				RenderAllWaveforms(ring, session);
+		}
+
+		//In frame skip mode, keep acquiring at full speed and only draw when the GUI has picked up the last waveform
+		//we gave it. Skipped waveforms can still be drawn so they add to persistence, but only when the GPU has nothing
+		//else in flight, so they never hold up acquisition.
+		if(session->GetWaveformThreadSettings().m_frameSkip)
+		{
+			if(displayPending && g_waveformProcessedEvent.Peek())
+				displayPending = false;
+
+			newestSkipped = displayPending;
+			if(!displayPending)
+			{
+				RenderAllWaveforms(ring, session);
+				g_waveformReadyEvent.Signal();
+				displayPending = true;
+			}
+			else if(session->GetWaveformThreadSettings().m_skippedPersistence && ring.IsIdle())
+				RenderAllWaveforms(ring, session);
+			continue;
+		}
+
+		//Coming out of frame skip mode, the last waveform we displayed has to be acknowledged first
+		if(displayPending)
+		{
+			g_waveformProcessedEvent.Block();
+			displayPending = false;
+		}
+		newestSkipped = false;
+
+		//Rerun the heavyweight rendering shaders, then tone map.
+		//This returns once the work is submitted, the GUI thread picks up the new textures when it completes.
+		RenderAllWaveforms(ring, session);
 
 		//Unblock the UI threads, then wait for acknowledgement that it's processed
 		g_waveformReadyEvent.Signal();
 		g_waveformProcessedEvent.Block();
 	}
 
+	//Don't free the command buffers until the GPU is done with them
+	ring.Clear();
+
 	LogTrace("Shutting down\n");
 }
 
-void RenderAllWaveforms(vk::raii::CommandBuffer& cmdbuf, Session* session, shared_ptr<QueueHandle> queue)
+/**
+	@brief Records a rendering and tone mapping pass for all waveforms into the next slot of the ring and submits it
+
+	Does not wait for the pass to complete.
+ */
+void RenderAllWaveforms(WaveformRenderRing& ring, Session* session)
 {
-	double tstart = GetTime();
+	//Wait for free command buffers before grabbing any other locks
+	ring.Acquire();
 
 	//Must lock mutexes in this order to avoid deadlock
 	lock_guard<recursive_mutex> lock1(session->GetWaveformDataMutex());
@@ -149,10 +255,6 @@ void RenderAllWaveforms(vk::raii::CommandBuffer& cmdbuf, Session* session, share
 	//Keep references to all displayed channels open until the rendering finishes
 	//This prevents problems if we close a WaveformArea or remove a channel from it before the shader completes
 	vector< shared_ptr<DisplayedChannel> > channels;
-	cmdbuf.begin({});
-	session->RenderWaveformTextures(cmdbuf, channels);
-	cmdbuf.end();
-	queue->SubmitAndBlock(cmdbuf);
-
-	g_lastWaveformRenderTime = (GetTime() - tstart) * FS_PER_SECOND;
+	session->RenderWaveformTextures(ring, channels);
+	ring.Submit(channels);
 }
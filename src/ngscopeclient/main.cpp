@@ -34,6 +34,7 @@
  */
 #include "ngscopeclient.h"
 #include "MainWindow.h"
+#include "RasterBenchmark.h"
 #include "../scopeprotocols/scopeprotocols.h"
 
 using namespace std;
@@ -50,6 +51,7 @@ int main(int argc, char* argv[])
 {
 	//Global settings
 	Severity console_verbosity = Severity::NOTICE;
+	bool benchmarkRaster = false;
 
 	for(int i=1; i<argc; i++)
 	{
@@ -59,6 +61,10 @@ int main(int argc, char* argv[])
 		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
 			continue;
 
+		//Compare the rasterizer kernels instead of launching the GUI
+		else if(s == "--benchmark-raster")
+			benchmarkRaster = true;
+
 		//TODO: other arguments
 
 	}
@@ -106,6 +112,14 @@ int main(int argc, char* argv[])
 	ScopeProtocolStaticInit();
 	InitializePlugins();
 
+	if(benchmarkRaster)
+	{
+		bool ok = RunRasterBenchmark();
+		g_computePipelinePool.Clear();
+		ScopehalStaticCleanup();
+		return ok ? 0 : 1;
+	}
+
 	{
 		//Make the top level window
 		shared_ptr<QueueHandle> queue(g_vkQueueManager->GetRenderQueue("g_mainWindow.render"));
@@ -130,6 +144,7 @@ int main(int argc, char* argv[])
 
 	//Done, clean up
 	g_mainWindow = nullptr;
+	g_computePipelinePool.Clear();
 	ScopehalStaticCleanup();
 	return 0;
 }
@@ -100,7 +100,7 @@ void ScopeThread(Oscilloscope* scope, std::atomic<bool>* shuttingDown);
 void PowerSupplyThread(PowerSupplyThreadArgs args);
 void MultimeterThread(MultimeterThreadArgs args);
 void RFSignalGeneratorThread(RFSignalGeneratorThreadArgs args);
-void WaveformThread(Session* session, std::atomic<bool>* shuttingDown);
+void WaveformThread(Session* session, std::atomic<bool>* shuttingDown, int64_t nqueues);
 
 ImU32 ColorFromString(const std::string& str, unsigned int alpha = 255);
 
@@ -117,4 +117,16 @@ enum GuiTheme
 	THEME_CLASSIC = 2
 };
 
+///@brief Color ramps for eye patterns, spectrograms, and waterfalls
+enum EyeColorRamp
+{
+	EYE_RAMP_CRT,
+	EYE_RAMP_IRONBOW,
+	EYE_RAMP_RAINBOW,
+	EYE_RAMP_REVERSE_RAINBOW,
+	EYE_RAMP_VIRIDIS,
+	EYE_RAMP_GRAYSCALE,
+	EYE_RAMP_KRAIN
+};
+
 #endif
@@ -0,0 +1,91 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+
+#version 430
+#pragma shader_stage(compute)
+
+//Normalized density (0-1) from an eye pattern, spectrogram, or waterfall filter
+layout(std430, binding=0) restrict readonly buffer buf_density
+{
+	float density[];
+};
+
+layout(binding=1, rgba32f) uniform image2D outputTex;
+
+//Color ramp, 256 RGBA entries
+layout(std430, binding=2) restrict readonly buffer buf_ramp
+{
+	vec4 ramp[];
+};
+
+layout(std430, push_constant) uniform constants
+{
+	uint width;			//Size of the density buffer
+	uint height;
+	uint outWidth;		//Size of the output texture
+	uint outHeight;
+	uint rowOffset;		//Rotation applied to density buffer rows (for ring buffers)
+	float xoff;			//Density buffer position of the left edge of the output, in pixels
+	float xscale;		//Density buffer pixels per output pixel
+	float yoff;
+	float yscale;
+};
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+void main()
+{
+	if(gl_GlobalInvocationID.x >= outWidth)
+		return;
+	if(gl_GlobalInvocationID.y >= outHeight)
+		return;
+
+	//Find the density buffer pixel under the center of this output pixel
+	float fx = floor(xoff + (gl_GlobalInvocationID.x + 0.5) * xscale);
+	float fy = floor(yoff + (gl_GlobalInvocationID.y + 0.5) * yscale);
+
+	//Transparent if off the end of the data
+	vec4 colorOut = vec4(0, 0, 0, 0);
+	if( (fx >= 0) && (fx < width) && (fy >= 0) && (fy < height) )
+	{
+		uint row = (uint(fy) + rowOffset) % height;
+		float y = density[row*width + uint(fx)];
+
+		//Look up the color, leaving empty pixels transparent
+		y = min(y, 0.99);
+		if(y >= 0.001)
+			colorOut = ramp[uint(y * 256)];
+	}
+
+	imageStore(
+		outputTex,
+		ivec2(gl_GlobalInvocationID.x, gl_GlobalInvocationID.y),
+		colorOut);
+}
@@ -0,0 +1,134 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@brief Waveform rendering shader for drawing many uniform digital waveforms in a single dispatch
+
+	Samples are bit packed, 32 per word, and each channel gets its own band of rows in a shared output buffer. Every
+	thread handles one pixel column of one channel. Rather than walking samples one by one it counts, a word at a time,
+	how many of the line segments crossing the column stay low, stay high, or transition.
+ */
+
+#version 430
+#pragma shader_stage(compute)
+
+//Per-channel configuration
+struct ChannelConfig
+{
+	uint wordOffset;	//Index of the first word of this channel's samples within the packed buffer
+	uint memDepth;		//Number of samples
+	int startSample;	//Reference sample index
+	float x0;			//X position of startSample, in pixels
+	float xscale;		//Pixels per sample
+};
+
+layout(std430, push_constant) uniform constants
+{
+	uint windowWidth;
+	uint channelHeight;
+	uint channelCount;
+};
+
+//The output texture data, one band of channelHeight rows per channel
+layout(std430, binding=0) restrict writeonly buffer outputTex
+{
+	float outval[];
+};
+
+//Bit packed samples for all channels, LSB first
+layout(std430, binding=1) restrict readonly buffer buf_samples
+{
+	uint samples[];
+};
+
+layout(std430, binding=2) restrict readonly buffer buf_config
+{
+	ChannelConfig config[];
+};
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+//Get 32 consecutive samples starting at an arbitrary sample index
+uint GetBits(uint base, uint i)
+{
+	uint word = base + (i / 32);
+	uint shift = i % 32;
+	if(shift == 0)
+		return samples[word];
+	return (samples[word] >> shift) | (samples[word + 1] << (32 - shift));
+}
+
+void main()
+{
+	uint x = gl_GlobalInvocationID.x;
+	uint nchan = gl_GlobalInvocationID.y;
+	if( (x >= windowWidth) || (nchan >= channelCount) )
+		return;
+
+	ChannelConfig cfg = config[nchan];
+
+	//Find the line segments (from sample i to sample i+1) which overlap this column
+	int first = cfg.startSample + int(floor((float(x) - cfg.x0) / cfg.xscale));
+	int last = cfg.startSample + int(floor((float(x + 1) - cfg.x0) / cfg.xscale));
+	first = max(first, 0);
+	last = min(last, int(cfg.memDepth) - 2);
+
+	//Count segments that stay low, stay high, or transition
+	uint nlow = 0;
+	uint nhigh = 0;
+	uint ntrans = 0;
+	for(int i=first; i<=last; i += 32)
+	{
+		uint n = uint(min(32, last - i + 1));
+		uint mask = (n == 32) ? 0xffffffff : ((1u << n) - 1);
+
+		//Packed buffer has a spare word at the end of each channel, so reading one past the last sample is OK
+		uint cur = GetBits(cfg.wordOffset, uint(i));
+		uint next = GetBits(cfg.wordOffset, uint(i + 1));
+
+		uint trans = bitCount( (cur ^ next) & mask);
+		uint high = bitCount(cur & next & mask);
+		ntrans += trans;
+		nhigh += high;
+		nlow += n - trans - high;
+	}
+
+	//Write the column: low level in the bottom row, high level in the top row, transitions fill the whole column
+	uint base = nchan * channelHeight;
+	for(uint y=0; y<channelHeight; y++)
+	{
+		float hits = ntrans;
+		if(y == 0)
+			hits += nlow;
+		if(y == channelHeight - 1)
+			hits += nhigh;
+		outval[(base + y) * windowWidth + x] = hits;
+	}
+}
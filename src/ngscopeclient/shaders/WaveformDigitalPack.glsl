@@ -0,0 +1,83 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@brief Bit packs one uniform digital waveform for WaveformDigitalBatch
+
+	Each thread reads 32 one-byte samples and writes them as one word, with the first sample in the LSB.
+ */
+
+#version 430
+#pragma shader_stage(compute)
+
+//Input samples, boolean 0/1 for 4 samples per word
+layout(std430, binding=0) restrict readonly buffer buf_samples
+{
+	uint samples[];
+};
+
+//Bit packed samples for all channels of the batch
+layout(std430, binding=1) restrict writeonly buffer buf_packed
+{
+	uint packed[];
+};
+
+layout(std430, push_constant) uniform constants
+{
+	uint memDepth;		//Number of input samples
+	uint nwords;		//Number of words to write, including any spare words past the last sample
+	uint wordOffset;	//Index of the first word of this channel within the packed buffer
+};
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+void main()
+{
+	uint j = gl_GlobalInvocationID.x;
+	if(j >= nwords)
+		return;
+
+	uint base = j*32;
+	uint word = 0;
+	for(uint k=0; k<8; k++)
+	{
+		uint first = base + k*4;
+		if(first >= memDepth)
+			break;
+
+		uint block = samples[first / 4];
+		for(uint b=0; b<4; b++)
+		{
+			if( (first + b < memDepth) && ( ( (block >> (8*b)) & 0xff) != 0) )
+				word |= (1u << (k*4 + b));
+		}
+	}
+	packed[wordOffset + j] = word;
+}
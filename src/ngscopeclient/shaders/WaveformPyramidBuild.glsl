@@ -0,0 +1,107 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@brief Builds one level of a min/max decimation pyramid
+
+	Each output block is a vec4 of (min, max, sample count, total vertical travel). Level 0 is built from the raw
+	samples, subsequent levels from the previous level in the same buffer.
+ */
+
+#version 430
+#pragma shader_stage(compute)
+
+layout(std430, binding=0) restrict readonly buffer buf_samples
+{
+	float samples[];
+};
+
+layout(std430, binding=1) buffer buf_levels
+{
+	vec4 levels[];
+};
+
+layout(std430, push_constant) uniform constants
+{
+	uint inLen;
+	uint inOffset;
+	uint outLen;
+	uint outOffset;
+	uint factor;
+	uint fromSamples;
+};
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+void main()
+{
+	//Large levels are split across two dimensions of work groups
+	uint i = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+	if(i >= outLen)
+		return;
+
+	uint start = i * factor;
+	uint end = min(start + factor, inLen);
+
+	if(fromSamples != 0)
+	{
+		float prev = samples[start];
+		float vmin = prev;
+		float vmax = prev;
+		float travel = 0;
+
+		//Include the first sample of the next block, so the line segment connecting the two is covered
+		uint last = min(end + 1, inLen);
+		for(uint j=start+1; j<last; j++)
+		{
+			float v = samples[j];
+			vmin = min(vmin, v);
+			vmax = max(vmax, v);
+			travel += abs(v - prev);
+			prev = v;
+		}
+
+		levels[outOffset + i] = vec4(vmin, vmax, float(end - start), travel);
+	}
+
+	else
+	{
+		vec4 acc = levels[inOffset + start];
+		for(uint j=start+1; j<end; j++)
+		{
+			vec4 block = levels[inOffset + j];
+			acc.x = min(acc.x, block.x);
+			acc.y = max(acc.y, block.y);
+			acc.zw += block.zw;
+		}
+
+		levels[outOffset + i] = acc;
+	}
+}
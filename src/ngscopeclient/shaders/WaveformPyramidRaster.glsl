@@ -0,0 +1,202 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@brief Waveform rendering shader for drawing uniform analog waveforms from a min/max decimation pyramid
+
+	Same structure as waveform-compute.glsl, but each iteration draws one pyramid block (a vertical span from the min
+	to the max of the block) rather than one line segment. Each block's intensity is spread evenly over its span, and
+	scaled so the total matches what drawing every line segment within the block would have produced.
+ */
+
+#version 430
+#pragma shader_stage(compute)
+
+//Number of rows drawn by each workgroup. Taller plots are split into several tiles, one per workgroup Y index.
+//(must match WaveformArea::RASTER_PYRAMID_TILE_HEIGHT)
+#define TILE_HEIGHT		2048
+
+//Number of threads per column of pixels
+#define ROWS_PER_BLOCK	64
+
+//Shared buffer for the local working buffer (8 kB)
+shared float g_workingBuffer[TILE_HEIGHT];
+
+//Min/max and intensity for the current block
+shared int g_blockmin[ROWS_PER_BLOCK];
+shared int g_blockmax[ROWS_PER_BLOCK];
+shared float g_blockweight[ROWS_PER_BLOCK];
+shared bool g_done;
+shared bool g_updating[ROWS_PER_BLOCK];
+
+layout(local_size_x=1, local_size_y=ROWS_PER_BLOCK, local_size_z=1) in;
+
+layout(std430, push_constant) uniform constants
+{
+	uint windowHeight;
+	uint windowWidth;
+	uint levelOffset;
+	uint levelSize;
+	uint firstBlock;
+	float xstart;		//X position of the left edge of firstBlock, in pixels
+	float blockWidth;	//Width of one block, in pixels
+	float ybase;
+	float yscale;
+	float yoff;
+};
+
+//The output texture data
+layout(std430, binding=0) buffer outputTex
+{
+	float outval[];
+};
+
+//Pyramid blocks: (min, max, sample count, total vertical travel)
+layout(std430, binding=1) restrict readonly buffer buf_levels
+{
+	vec4 levels[];
+};
+
+void main()
+{
+	//Abort if we're off the end of the window
+	uint tileBase = gl_WorkGroupID.y * TILE_HEIGHT;
+	if(gl_GlobalInvocationID.x >= windowWidth)
+		return;
+	if(tileBase >= windowHeight)
+		return;
+	uint tileRows = min(windowHeight - tileBase, TILE_HEIGHT);
+
+	//Clear working buffer
+	//(persistence is handled during tone mapping)
+	for(uint y=gl_LocalInvocationID.y; y < tileRows; y += ROWS_PER_BLOCK)
+		g_workingBuffer[y] = 0;
+
+	//Setup for main loop
+	if(gl_LocalInvocationID.y == 0)
+		g_done = false;
+
+	float left_edge = gl_GlobalInvocationID.x;
+	float right_edge = left_edge + 1;
+	uint istart = firstBlock + uint(max(0, floor((left_edge - xstart) / blockWidth)));
+	uint i = istart + gl_LocalInvocationID.y;
+
+	//Main loop
+	while(true)
+	{
+		if(i < levelSize)
+		{
+			float left = xstart + float(i - firstBlock) * blockWidth;
+			float right = left + blockWidth;
+
+			//Past the end of our column, stop
+			if(left > right_edge)
+			{
+				g_done = true;
+				g_updating[gl_LocalInvocationID.y] = false;
+			}
+
+			//Skip offscreen blocks
+			else if(right < left_edge)
+				g_updating[gl_LocalInvocationID.y] = false;
+
+			else
+			{
+				vec4 block = levels[levelOffset + i];
+				float y0 = (block.x + yoff)*yscale + ybase;
+				float y1 = (block.y + yoff)*yscale + ybase;
+				float starty = min(y0, y1);
+				float endy = max(y0, y1);
+
+				//Drawing every segment would have hit one pixel per sample plus one per pixel of vertical travel.
+				//Spread that over the span, scaled by how much of the block falls within our column.
+				float overlap = (min(right, right_edge) - max(left, left_edge)) / blockWidth;
+				float hits = block.z + block.w * abs(yscale);
+				float rows = floor(endy) - floor(starty) + 1;
+				g_blockweight[gl_LocalInvocationID.y] = hits * overlap / rows;
+
+				//If start and end are both outside our tile, nothing to draw
+				float tileBottom = tileBase;
+				float tileTop = tileBase + tileRows;
+				if( (endy < tileBottom) || (starty >= tileTop) )
+					g_updating[gl_LocalInvocationID.y] = false;
+
+				//Something is visible. Clip to tile in case anything is partially outside
+				else
+				{
+					g_updating[gl_LocalInvocationID.y] = true;
+					g_blockmin[gl_LocalInvocationID.y] = int(max(starty, tileBottom)) - int(tileBase);
+					g_blockmax[gl_LocalInvocationID.y] = int(min(endy, tileTop - 1)) - int(tileBase);
+				}
+
+				//Check if we're at the end of the pixel
+				if(right > right_edge)
+					g_done = true;
+			}
+		}
+
+		else
+		{
+			g_done = true;
+			g_updating[gl_LocalInvocationID.y] = false;
+		}
+
+		i += ROWS_PER_BLOCK;
+
+		//Only update if we need to
+		for(int y = 0; y<ROWS_PER_BLOCK; y++)
+		{
+			barrier();
+			memoryBarrierShared();
+
+			if(g_updating[y])
+			{
+				//Parallel fill
+				int ymin = g_blockmin[y];
+				int len = g_blockmax[y] - ymin;
+				float weight = g_blockweight[y];
+				for(uint y=gl_LocalInvocationID.y; y <= len; y += ROWS_PER_BLOCK)
+					g_workingBuffer[ymin + y] += weight;
+			}
+		}
+
+		if(g_done)
+			break;
+	}
+
+	barrier();
+	memoryBarrierShared();
+
+	//Copy working buffer to float[] output
+	for(uint y=gl_LocalInvocationID.y; y<tileRows; y+= ROWS_PER_BLOCK)
+	{
+		outval[(windowWidth * (tileBase + y)) + gl_GlobalInvocationID.x] = g_workingBuffer[y];
+	}
+}
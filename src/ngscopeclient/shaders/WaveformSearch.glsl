@@ -0,0 +1,98 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+
+/**
+	@file
+	@brief Finds the transitions of a per-sample match predicate for WaveformSearch
+
+	Each work item compares the predicate of its sample with that of the previous one, and appends its index to the
+	output if they differ. Output order is arbitrary; the CPU sorts it.
+ */
+
+#version 430
+#pragma shader_stage(compute)
+
+layout(std430, binding=0) restrict readonly buffer buf_samples
+{
+	float samples[];
+};
+
+layout(std430, binding=1) buffer buf_transitions
+{
+	uint count;
+	uint transitions[];
+};
+
+layout(std430, push_constant) uniform constants
+{
+	uint len;
+	uint maxTransitions;
+	uint mode;
+	float lo;
+	float hi;
+};
+
+#define MATCH_ABOVE		0
+#define MATCH_BELOW		1
+#define MATCH_INSIDE	2
+#define MATCH_OUTSIDE	3
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+bool Match(float v)
+{
+	if(mode == MATCH_ABOVE)
+		return v > lo;
+	else if(mode == MATCH_BELOW)
+		return v < lo;
+	else if(mode == MATCH_INSIDE)
+		return (v >= lo) && (v <= hi);
+	else
+		return (v < lo) || (v > hi);
+}
+
+void main()
+{
+	//Large waveforms are split across two dimensions of work groups
+	uint i = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+	if(i >= len)
+		return;
+
+	//Sample -1 never matches
+	bool prev = false;
+	if(i > 0)
+		prev = Match(samples[i-1]);
+
+	if(Match(samples[i]) != prev)
+	{
+		//Keep counting past the end of the buffer so the CPU knows how many it missed
+		uint slot = atomicAdd(count, 1);
+		if(slot < maxTransitions)
+			transitions[slot] = i;
+	}
+}
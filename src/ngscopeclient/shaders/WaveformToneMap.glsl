@@ -30,6 +30,14 @@
 #version 430
 #pragma shader_stage(compute)
 
+//Persistence modes
+#define PERSIST_OFF			0	//Display the current frame only
+#define PERSIST_RESET		1	//Discard the persistence buffer and start over from the current frame
+#define PERSIST_ACCUMULATE	2	//Decay the persistence buffer and add the current frame to it
+#define PERSIST_DISPLAY		3	//Redisplay the persistence buffer without adding anything
+
+//Raw hit density from the rasterizer.
+//Columns are stored as a ring, starting with the leftmost at colOffset (zero unless drawn in roll mode)
 layout(std430, binding=0) restrict readonly buffer buf_pixels
 {
 	float pixels[];
@@ -37,6 +45,12 @@ layout(std430, binding=0) restrict readonly buffer buf_pixels
 
 layout(binding=1, rgba32f) uniform image2D outputTex;
 
+//Accumulated hit density for persistence mode
+layout(std430, binding=2) buffer buf_persist
+{
+	float persist[];
+};
+
 layout(std430, push_constant) uniform constants
 {
 	float channelRed;
@@ -44,6 +58,10 @@ layout(std430, push_constant) uniform constants
 	float channelBlue;
 	uint width;
 	uint height;
+	float gain;
+	float persistScale;
+	uint persistMode;
+	uint colOffset;
 };
 
 layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
@@ -55,9 +73,23 @@ void main()
 	if(gl_GlobalInvocationID.y >= height)
 		return;
 
-	//Intensity graded grayscale input
+	//Raw hit density
 	uint npixel = gl_GlobalInvocationID.y*width + gl_GlobalInvocationID.x;
-	float pixval = pixels[npixel];
+	float density = pixels[gl_GlobalInvocationID.y*width + (gl_GlobalInvocationID.x + colOffset) % width];
+
+	//Apply persistence
+	if(persistMode == PERSIST_RESET)
+		persist[npixel] = density;
+	else if(persistMode == PERSIST_ACCUMULATE)
+	{
+		density += persist[npixel] * persistScale;
+		persist[npixel] = density;
+	}
+	else if(persistMode == PERSIST_DISPLAY)
+		density = persist[npixel];
+
+	//Intensity graded grayscale
+	float pixval = density * gain;
 
 	//Logarithmic shading
 	float y = pow(pixval, 1.0 / 4);
@@ -41,23 +41,46 @@
 #extension GL_ARB_gpu_shader_int64 : require
 #endif
 
-//Maximum height of a single waveform, in pixels.
-//This is enough for a nearly fullscreen 4K window so should be plenty.
-#define MAX_HEIGHT		2048
+#ifdef TILED
 
-//Number of threads per column of pixels
-#define ROWS_PER_BLOCK	64
+	//Each workgroup draws a tile of several adjacent columns and up to TILE_HEIGHT rows, so plots can be any height.
+	//The threads of each column take consecutive samples, so their reads of the input coalesce (neighboring columns
+	//read samples one column's worth apart). Output is staged in shared memory, then written with neighboring threads
+	//writing neighboring pixels.
+	//(must match WaveformArea::RASTER_TILE_COLS and WaveformArea::RASTER_TILE_HEIGHT)
+	#define COLS_PER_BLOCK		8
+	#define THREADS_PER_COL		8
+	#define TILE_HEIGHT			256
 
-//Shared buffer for the local working buffer (8 kB)
-shared float g_workingBuffer[MAX_HEIGHT];
+	//Number of samples processed per column if the column is entirely before the waveform
+	#define EMPTY_COLUMN_SAMPLES	64
 
-//Min/max for the current sample
-shared int g_blockmin[ROWS_PER_BLOCK];
-shared int g_blockmax[ROWS_PER_BLOCK];
-shared bool g_done;
-shared bool g_updating[ROWS_PER_BLOCK];
+	//Hit counts for the tile, row major (8 kB)
+	shared uint g_tile[TILE_HEIGHT * COLS_PER_BLOCK];
 
-layout(local_size_x=1, local_size_y=ROWS_PER_BLOCK, local_size_z=1) in;
+	layout(local_size_x=COLS_PER_BLOCK, local_size_y=THREADS_PER_COL, local_size_z=1) in;
+
+#else
+
+	//Maximum height of a single waveform, in pixels.
+	//This is enough for a nearly fullscreen 4K window. Taller plots use the tiled variant.
+	#define MAX_HEIGHT		2048
+
+	//Number of threads per column of pixels
+	#define ROWS_PER_BLOCK	64
+
+	//Shared buffer for the local working buffer (8 kB)
+	shared float g_workingBuffer[MAX_HEIGHT];
+
+	//Min/max for the current sample
+	shared int g_blockmin[ROWS_PER_BLOCK];
+	shared int g_blockmax[ROWS_PER_BLOCK];
+	shared bool g_done;
+	shared bool g_updating[ROWS_PER_BLOCK];
+
+	layout(local_size_x=1, local_size_y=ROWS_PER_BLOCK, local_size_z=1) in;
+
+#endif
 
 //Global configuration for the run
 layout(std430, push_constant) uniform constants
@@ -72,13 +95,11 @@ layout(std430, push_constant) uniform constants
 	uint windowWidth;
 	uint memDepth;
 	uint offset_samples;
-	float alpha;
 	float xoff;
 	float xscale;
 	float ybase;
 	float yscale;
 	float yoff;
-	float persistScale;
 };
 
 //The output texture data
@@ -212,6 +233,176 @@ float InterpolateY(vec2 left, vec2 right, float slope, float x)
 	return left.y + ( (x - left.x) * slope );
 }
 
+/**
+	@brief Calculates the vertical span drawn by sample i within the pixel column starting at x
+
+	@param i		Index of the sample
+	@param x		Left edge of the column
+	@param starty	Y position of the start of the span, unclipped
+	@param endy		Y position of the end of the span, unclipped
+	@param last		Set if the sample extends past the right edge of the column, so no later sample can touch it
+
+	@return True if the sample touches the column
+ */
+bool GetSampleSpan(uint i, float x, out float starty, out float endy, out bool last)
+{
+	//Fetch coordinates
+	#ifdef ANALOG_PATH
+		vec2 left = vec2(FetchX(i) * xscale + xoff, (voltage[i] + yoff)*yscale + ybase);
+
+		#ifdef USE_NEXT_COORDS
+			vec2 right = vec2(FetchX(i+1) * xscale + xoff, (voltage[i+1] + yoff)*yscale + ybase);
+		#else
+			vec2 right = left;
+			right.x += FETCH_DURATION(i) * xscale;
+		#endif
+	#endif
+
+	#ifdef DIGITAL_PATH
+		vec2 left = vec2(FetchX(i) * xscale + xoff, GetBoolean(i)*yscale + ybase);
+
+		#ifdef USE_NEXT_COORDS
+			vec2 right = vec2(FetchX(i+1)*xscale + xoff, GetBoolean(i+1)*yscale + ybase);
+		#else
+			vec2 right = left;
+			right.x += FETCH_DURATION(i) * xscale;
+		#endif
+	#endif
+
+	//Check if we're at the end of the pixel
+	last = (right.x > x + 1);
+
+	//Skip offscreen samples
+	starty = 0;
+	endy = 0;
+	if( (right.x < x) || (left.x > x + 1) )
+		return false;
+
+	//To start, assume we're drawing the entire segment
+	starty = left.y;
+	endy = right.y;
+
+	#ifdef ANALOG_PATH
+
+		#ifndef NO_INTERPOLATION
+
+			//Interpolate analog signals if either end is outside our column
+			float slope = (right.y - left.y) / (right.x - left.x);
+			if(left.x < x)
+				starty = InterpolateY(left, right, slope, x);
+			if(right.x > x + 1)
+				endy = InterpolateY(left, right, slope, x + 1);
+
+		#endif
+
+	#endif
+
+	#ifdef DIGITAL_PATH
+
+		//If we are very near the right edge, draw vertical line
+		starty = left.y;
+		if(abs(right.x - x) <= 1)
+			endy = right.y;
+
+		//otherwise draw a single pixel
+		else
+			endy = left.y;
+
+	#endif
+
+	#ifdef HISTOGRAM_PATH
+		starty = 0;
+		endy = left.y;
+	#endif
+
+	return true;
+}
+
+#ifdef TILED
+
+void main()
+{
+	uint col = gl_LocalInvocationID.x;
+	uint lane = gl_LocalInvocationID.y;
+	uint tid = lane*COLS_PER_BLOCK + col;
+	uint x = gl_GlobalInvocationID.x;
+	uint tileBase = gl_WorkGroupID.y * TILE_HEIGHT;
+
+	//Clear the tile
+	//(persistence is handled during tone mapping)
+	for(uint j=tid; j < TILE_HEIGHT*COLS_PER_BLOCK; j += COLS_PER_BLOCK*THREADS_PER_COL)
+		g_tile[j] = 0;
+
+	barrier();
+	memoryBarrierShared();
+
+	//Threads off the end of the window still have to reach the barriers, so don't return early
+	if( (x < windowWidth) && (tileBase < windowHeight) && (memDepth >= (1 + ADDTL_NEEDED_SAMPLES)) )
+	{
+		int tileTop = int(min(tileBase + TILE_HEIGHT, windowHeight)) - 1;
+
+		#ifdef DENSE_PACK
+			uint istart = uint(floor(x / xscale)) + offset_samples;
+			uint iend = uint(floor((x + 1) / xscale)) + offset_samples;
+			bool empty = (iend <= 0);
+		#else
+			uint istart = xind[x];
+			bool empty = false;
+			if( (x + 1) < windowWidth)
+				empty = (xind[x + 1] <= 0);
+		#endif
+		uint ilimit = memDepth - ADDTL_NEEDED_SAMPLES;
+		if(empty)
+			ilimit = min(ilimit, istart + EMPTY_COLUMN_SAMPLES);
+
+		//Each thread takes every THREADS_PER_COL'th sample of the column, in order
+		for(uint i = istart + lane; i < ilimit; i += THREADS_PER_COL)
+		{
+			float starty;
+			float endy;
+			bool last;
+			if(GetSampleSpan(i, x, starty, endy, last))
+			{
+				//If start and end are both off screen, nothing to draw
+				float ymin = min(starty, endy);
+				float ymax = max(starty, endy);
+				if( (ymax >= 0) && (ymin < windowHeight) )
+				{
+					//Clip to window size, then to our tile
+					int y0 = max(int(max(ymin, 0)), int(tileBase));
+					int y1 = min(int(min(ymax, windowHeight - 1)), tileTop);
+
+					for(int y = y0; y <= y1; y++)
+					{
+						#ifdef HISTOGRAM_PATH
+							g_tile[(y - tileBase)*COLS_PER_BLOCK + col] = 1;
+						#else
+							atomicAdd(g_tile[(y - tileBase)*COLS_PER_BLOCK + col], 1u);
+						#endif
+					}
+				}
+			}
+
+			if(last)
+				break;
+		}
+	}
+
+	barrier();
+	memoryBarrierShared();
+
+	//Copy tile to float[] output, neighboring threads writing neighboring pixels
+	for(uint j=tid; j < TILE_HEIGHT*COLS_PER_BLOCK; j += COLS_PER_BLOCK*THREADS_PER_COL)
+	{
+		uint ox = gl_WorkGroupID.x*COLS_PER_BLOCK + (j % COLS_PER_BLOCK);
+		uint oy = tileBase + (j / COLS_PER_BLOCK);
+		if( (ox < windowWidth) && (oy < windowHeight) )
+			outval[(windowWidth * oy) + ox] = float(g_tile[j]);
+	}
+}
+
+#else
+
 void main()
 {
 	//Abort if window height is too big, or if we're off the end of the window
@@ -222,17 +413,10 @@ void main()
 	if(memDepth < (1 + ADDTL_NEEDED_SAMPLES))
 		return;
 
-	//Clear (or persistence load) working buffer
+	//Clear working buffer
+	//(persistence is handled during tone mapping)
 	for(uint y=gl_LocalInvocationID.y; y < windowHeight; y += ROWS_PER_BLOCK)
-	{
-		if(persistScale == 0)
-			g_workingBuffer[y] = 0;
-		else
-		{
-			g_workingBuffer[y] =
-				outval[(windowWidth * y) + gl_GlobalInvocationID.x] * persistScale;
-		}
-	}
+		g_workingBuffer[y] = 0;
 
 	//Setup for main loop
 	if(gl_LocalInvocationID.y == 0)
@@ -259,69 +443,11 @@ void main()
 	{
 		if(i < (memDepth - ADDTL_NEEDED_SAMPLES) )
 		{
-			//Fetch coordinates
-			#ifdef ANALOG_PATH
-				vec2 left = vec2(FetchX(i) * xscale + xoff, (voltage[i] + yoff)*yscale + ybase);
-
-				#ifdef USE_NEXT_COORDS
-					vec2 right = vec2(FetchX(i+1) * xscale + xoff, (voltage[i+1] + yoff)*yscale + ybase);
-				#else
-					vec2 right = left;
-					right.x += FETCH_DURATION(i) * xscale;
-				#endif
-			#endif
-
-			#ifdef DIGITAL_PATH
-				vec2 left = vec2(FetchX(i) * xscale + xoff, GetBoolean(i)*yscale + ybase);
-
-				#ifdef USE_NEXT_COORDS
-					vec2 right = vec2(FetchX(i+1)*xscale + xoff, GetBoolean(i+1)*yscale + ybase);
-				#else
-					vec2 right = left;
-					right.x += FETCH_DURATION(i) * xscale;
-				#endif
-			#endif
-
-			//Skip offscreen samples
-			if( (right.x >= gl_GlobalInvocationID.x) && (left.x <= gl_GlobalInvocationID.x + 1) )
+			float starty;
+			float endy;
+			bool last;
+			if(GetSampleSpan(i, gl_GlobalInvocationID.x, starty, endy, last))
 			{
-				//To start, assume we're drawing the entire segment
-				float starty = left.y;
-				float endy = right.y;
-
-				#ifdef ANALOG_PATH
-
-					#ifndef NO_INTERPOLATION
-
-						//Interpolate analog signals if either end is outside our column
-						float slope = (right.y - left.y) / (right.x - left.x);
-						if(left.x < gl_GlobalInvocationID.x)
-							starty = InterpolateY(left, right, slope, gl_GlobalInvocationID.x);
-						if(right.x > gl_GlobalInvocationID.x + 1)
-							endy = InterpolateY(left, right, slope, gl_GlobalInvocationID.x + 1);
-
-					#endif
-
-				#endif
-
-				#ifdef DIGITAL_PATH
-
-					//If we are very near the right edge, draw vertical line
-					starty = left.y;
-					if(abs(right.x - gl_GlobalInvocationID.x) <= 1)
-						endy = right.y;
-
-					//otherwise draw a single pixel
-					else
-						endy = left.y;
-
-				#endif
-
-				#ifdef HISTOGRAM_PATH
-					starty = 0;
-					endy = left.y;
-				#endif
-
 				//If start and end are both off screen, nothing to draw
 				if( ( (starty < 0) && (endy < 0) ) ||
 					( (starty >= windowHeight) && (endy >= windowHeight) ) )
@@ -345,7 +471,7 @@ void main()
 				}
 
 				//Check if we're at the end of the pixel
-				if(right.x > gl_GlobalInvocationID.x + 1)
+				if(last)
 					g_done = true;
 			}
 			else
@@ -374,9 +500,9 @@ void main()
 				for(uint y=gl_LocalInvocationID.y; y <= len; y += ROWS_PER_BLOCK)
 				{
 					#ifdef HISTOGRAM_PATH
-						g_workingBuffer[ymin + y] = alpha;
+						g_workingBuffer[ymin + y] = 1;
 					#else
-						g_workingBuffer[ymin + y] += alpha;
+						g_workingBuffer[ymin + y] += 1;
 					#endif
 				}
 			}
@@ -395,3 +521,5 @@ void main()
 		outval[(windowWidth * y) + gl_GlobalInvocationID.x] = g_workingBuffer[y];
 	}
 }
+
+#endif
@@ -0,0 +1,181 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* ngscopeclient                                                                                                        *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@brief Calculates the index of the first sample in each pixel column of a sparse waveform
+
+	One thread per column. Each thread binary searches the offset array for the last sample starting at or before the
+	left edge of its column (or 0 / memDepth if the column is entirely before / after the waveform).
+ */
+
+#version 430
+#pragma shader_stage(compute)
+
+#extension GL_ARB_compute_shader : require
+#extension GL_ARB_shader_storage_buffer_object : require
+#ifdef HAS_INT64
+#extension GL_ARB_gpu_shader_int64 : require
+#endif
+
+layout(std430, push_constant) uniform constants
+{
+#ifdef HAS_INT64
+	int64_t offset_samples;
+#else
+	uint offset_samples_lo;	//actually a 64-bit little endian signed int
+	uint offset_samples_hi;
+#endif
+	uint memDepth;
+	uint windowWidth;
+#ifdef HAS_INT64
+	int64_t columnTicks;	//width of a pixel column in time ticks, as 32.32 fixed point
+#else
+	uint columnTicks_lo;	//actually a 64-bit little endian signed int
+	uint columnTicks_hi;
+#endif
+	uint columnTicksFrac;
+};
+
+layout(std430, binding=0) restrict readonly buffer waveform_x
+{
+#ifdef HAS_INT64
+	int64_t xpos[];		//x position, in time ticks
+#else
+	uint xpos[];		//x position, in time ticks
+						//actually 64-bit little endian signed ints
+#endif
+};
+
+layout(std430, binding=1) restrict writeonly buffer index
+{
+	uint xind[];
+};
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+#ifdef HAS_INT64
+	#define TARGET_TYPE int64_t
+
+	//Compare xpos[i] against the target, returning -1, 0, or 1
+	int CompareOffset(uint i, int64_t target)
+	{
+		int64_t x = xpos[i];
+		if(x < target)
+			return -1;
+		else if(x > target)
+			return 1;
+		return 0;
+	}
+#else
+	#define TARGET_TYPE uvec2
+
+	//Signed 64-bit comparison of xpos[i] against target (x = low half, y = high half)
+	int CompareOffset(uint i, uvec2 target)
+	{
+		int xhi = int(xpos[i*2 + 1]);
+		int thi = int(target.y);
+		if(xhi != thi)
+			return (xhi < thi) ? -1 : 1;
+
+		uint xlo = xpos[i*2];
+		if(xlo < target.x)
+			return -1;
+		else if(xlo > target.x)
+			return 1;
+		return 0;
+	}
+#endif
+
+void main()
+{
+	if(gl_GlobalInvocationID.x >= windowWidth)
+		return;
+	if(memDepth == 0)
+	{
+		xind[gl_GlobalInvocationID.x] = 0;
+		return;
+	}
+
+	//Timestamp of the left edge of our column, relative to the start of the waveform.
+	//This is always positive. It's calculated in integer math so it stays exact far from the start of the waveform,
+	//and matches the CPU implementation (CalculateSparseIndexes() in WaveformArea.cpp).
+	uint col = gl_GlobalInvocationID.x;
+
+	#ifdef HAS_INT64
+		int64_t relpos = int64_t(col) * columnTicks + int64_t( (uint64_t(col) * uint64_t(columnTicksFrac)) >> 32);
+		TARGET_TYPE target = relpos + offset_samples;
+	#else
+		//col * columnTicks, then add the integer part of col * columnTicksFrac
+		uint rel_lo;
+		uint rel_hi;
+		umulExtended(col, columnTicks_lo, rel_hi, rel_lo);
+		rel_hi += col * columnTicks_hi;
+
+		uint frac_lo;
+		uint frac_hi;
+		umulExtended(col, columnTicksFrac, frac_hi, frac_lo);
+
+		uint carry;
+		rel_lo = uaddCarry(rel_lo, frac_hi, carry);
+		rel_hi += carry;
+
+		//Add the signed offset
+		TARGET_TYPE target;
+		target.x = uaddCarry(rel_lo, offset_samples_lo, carry);
+		target.y = rel_hi + offset_samples_hi + carry;
+	#endif
+
+	//Clip if out of range
+	if(CompareOffset(0, target) >= 0)
+	{
+		xind[gl_GlobalInvocationID.x] = 0;
+		return;
+	}
+	if(CompareOffset(memDepth - 1, target) < 0)
+	{
+		xind[gl_GlobalInvocationID.x] = memDepth;
+		return;
+	}
+
+	//Find the last sample starting at or before the target.
+	//xpos[lo] is always <= target, xpos[hi] is always > target (or off the end)
+	uint lo = 0;
+	uint hi = memDepth;
+	while( (hi - lo) > 1)
+	{
+		uint mid = lo + (hi - lo) / 2;
+		if(CompareOffset(mid, target) <= 0)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	xind[gl_GlobalInvocationID.x] = lo;
+}
@@ -0,0 +1,128 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* libscopehal v0.1                                                                                                     *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for CpuRasterizer
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Client.h"
+#include "../../src/ngscopeclient/WaveformArea.h"
+#include "../../src/ngscopeclient/CpuRasterizer.h"
+
+using namespace std;
+
+TEST_CASE("Client_CpuRasterizer")
+{
+	#ifdef __x86_64__
+	bool reallyHasAvx2 = g_hasAvx2;
+	#endif
+
+	const size_t width = 1024;
+	const size_t height = 512;
+	const size_t depth = 1024 * 1024;
+
+	UniformAnalogWaveform wfm;
+	wfm.m_timescale = 1000;
+	wfm.m_triggerPhase = 0;
+	wfm.m_samples.resize(depth);
+
+	vector<float> golden(width * height);
+	vector<float> out(width * height);
+
+	normal_distribution<float> noise(0, 0.05);
+	uniform_real_distribution<float> zoomdesc(0.25, 64);
+	uniform_int_distribution<uint32_t> pandesc(0, depth / 2);
+
+	const size_t niter = 8;
+	for(size_t i=0; i<niter; i++)
+	{
+		SECTION(string("Iteration ") + to_string(i))
+		{
+			LogVerbose("Iteration %zu\n", i);
+			LogIndenter li;
+
+			//Noisy sine, drawn at a random zoom level (in samples per pixel) and pan position
+			wfm.m_samples.PrepareForCpuAccess();
+			for(size_t j=0; j<depth; j++)
+				wfm.m_samples[j] = sin(j * 2 * M_PI / 65536) + noise(g_rng);
+			wfm.m_samples.MarkModifiedFromCpu();
+
+			uint32_t pan = pandesc(g_rng);
+			ConfigPushConstants config;
+			config.innerXoff = -int64_t(pan);
+			config.windowHeight = height;
+			config.windowWidth = width;
+			config.memDepth = depth;
+			config.offset_samples = pan;
+			config.xoff = 0;
+			config.xscale = 1.0f / zoomdesc(g_rng);
+			config.ybase = height * 0.5f;
+			config.yscale = height / 2.5f;
+			config.yoff = 0;
+
+			//Baseline with the generic implementation
+			#ifdef __x86_64__
+				g_hasAvx2 = false;
+			#endif
+			double start = GetTime();
+			CpuRasterizer::Rasterize(&golden[0], config, &wfm, nullptr, false, true);
+			double tbase = GetTime() - start;
+			LogVerbose("CPU (no AVX)  : %6.2f ms\n", tbase * 1000);
+
+			//The AVX2 version has to match to within rounding
+			#ifdef __x86_64__
+			if(reallyHasAvx2)
+			{
+				g_hasAvx2 = true;
+
+				start = GetTime();
+				CpuRasterizer::Rasterize(&out[0], config, &wfm, nullptr, false, true);
+				double dt = GetTime() - start;
+
+				size_t mismatches;
+				bool ok = CpuRasterizer::IsWithinTolerance(&out[0], &golden[0], width * height, mismatches);
+				LogVerbose("CPU (AVX2)    : %6.2f ms, %.2fx speedup, %zu pixels differ\n",
+					dt * 1000, tbase / dt, mismatches);
+				REQUIRE(ok);
+			}
+			#endif
+		}
+	}
+
+	#ifdef __x86_64__
+		g_hasAvx2 = reallyHasAvx2;
+	#endif
+}
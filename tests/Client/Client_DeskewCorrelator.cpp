@@ -0,0 +1,108 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* libscopehal v0.1                                                                                                     *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for DeskewCorrelator
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Client.h"
+#include "../../src/common/DeskewCorrelator.h"
+
+using namespace std;
+
+TEST_CASE("Client_DeskewCorrelator")
+{
+	const int64_t timescale = 1000;
+	const size_t depth = 100000;
+	const size_t smoothing = 16;
+
+	normal_distribution<float> noise(0, 1);
+	uniform_int_distribution<int64_t> skewdesc(-200 * timescale, 200 * timescale);
+
+	UniformAnalogWaveform primary;
+	primary.m_timescale = timescale;
+	primary.m_triggerPhase = 0;
+	primary.m_samples.resize(depth);
+
+	UniformAnalogWaveform secondary;
+	secondary.m_timescale = timescale;
+	secondary.m_samples.resize(depth);
+
+	DeskewCorrelator correlator;
+
+	const size_t niter = 8;
+	for(size_t i=0; i<niter; i++)
+	{
+		SECTION(string("Iteration ") + to_string(i))
+		{
+			LogVerbose("Iteration %zu\n", i);
+			LogIndenter li;
+
+			//Low pass filtered noise, so the correlation has a single peak a few samples wide
+			vector<float> white(depth + smoothing);
+			for(auto& v : white)
+				v = noise(g_rng);
+			primary.m_samples.PrepareForCpuAccess();
+			for(size_t j=0; j<depth; j++)
+			{
+				float sum = 0;
+				for(size_t k=0; k<smoothing; k++)
+					sum += white[j + k];
+				primary.m_samples[j] = sum / smoothing;
+			}
+			primary.m_samples.MarkModifiedFromCpu();
+
+			//Same samples, captured at a random (not necessarily whole sample) offset
+			int64_t expected = skewdesc(g_rng);
+			secondary.m_samples.PrepareForCpuAccess();
+			for(size_t j=0; j<depth; j++)
+				secondary.m_samples[j] = primary.m_samples[j];
+			secondary.m_samples.MarkModifiedFromCpu();
+			secondary.m_triggerPhase = expected;
+
+			int64_t skew;
+			double peak;
+			REQUIRE(correlator.Correlate(&primary, &secondary, 1000 * timescale, skew, peak));
+			LogVerbose("Expected %s, measured %s, peak %.3f\n",
+				Unit(Unit::UNIT_FS).PrettyPrint(expected).c_str(),
+				Unit(Unit::UNIT_FS).PrettyPrint(skew).c_str(),
+				peak);
+
+			REQUIRE(llabs(skew - expected) <= timescale / 4);
+			REQUIRE(peak > 0.9);
+		}
+	}
+}
@@ -0,0 +1,171 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* libscopehal v0.1                                                                                                     *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for RollModeEngine
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Client.h"
+#include "../../src/ngscopeclient/RollModeEngine.h"
+
+using namespace std;
+
+/**
+	@brief Gives the test access to RollModeEngine::Append() and RollModeEngine::PrependTail()
+ */
+class TestRollModeEngine : public RollModeEngine
+{
+public:
+	using RollModeEngine::Append;
+	using RollModeEngine::PrependTail;
+};
+
+TEST_CASE("Client_RollModeEngine")
+{
+	const int64_t timescale = 1000;
+
+	uniform_int_distribution<size_t> depthdesc(1000, 100000);
+	uniform_int_distribution<size_t> chunkdesc(1, 5000);
+	uniform_int_distribution<int> modedesc(0, 9);
+	uniform_int_distribution<size_t> gapdesc(1, 100);
+	uniform_int_distribution<int64_t> jitterdesc(-timescale/2 + 1, timescale/2 - 1);
+	uniform_real_distribution<float> sampledesc(-1, 1);
+
+	const size_t niter = 8;
+	for(size_t i=0; i<niter; i++)
+	{
+		SECTION(string("Iteration ") + to_string(i))
+		{
+			LogVerbose("Iteration %zu\n", i);
+			LogIndenter li;
+
+			TestRollModeEngine engine;
+			RollStream rs;
+			rs.m_wfm = new UniformAnalogWaveform;
+			rs.m_wfm->m_timescale = timescale;
+			rs.m_wfm->m_triggerPhase = 0;
+
+			UniformAnalogWaveform chunk;
+			chunk.m_timescale = timescale;
+
+			//Append chunks of random length, overlap and spacing. The reference is every sample the buffer should
+			//have ever held, starting at sample refBase of the time axis.
+			size_t depth = depthdesc(g_rng);
+			vector<float> ref;
+			int64_t refBase = 0;
+			for(size_t j=0; j<200; j++)
+			{
+				size_t n = min(chunkdesc(g_rng), depth);
+				chunk.m_samples.resize(n);
+				chunk.m_samples.PrepareForCpuAccess();
+				for(size_t k=0; k<n; k++)
+					chunk.m_samples[k] = sampledesc(g_rng);
+				chunk.m_samples.MarkModifiedFromCpu();
+				chunk.m_startTimestamp = j;
+				chunk.m_startFemtoseconds = 0;
+
+				int64_t end = refBase + ref.size();
+				int mode = ref.empty() ? 0 : modedesc(g_rng);
+				if(j % 50 == 49)
+				{
+					//Gap too long to fill: the buffer starts over at the chunk
+					int64_t start = end + depth + gapdesc(g_rng);
+					chunk.m_triggerPhase = start * timescale;
+					ref.clear();
+					refBase = start;
+				}
+				else if(mode < 6)
+				{
+					//Contiguous, up to half a sample off
+					chunk.m_triggerPhase = end * timescale;
+					if(!ref.empty())
+						chunk.m_triggerPhase += jitterdesc(g_rng);
+				}
+				else if(mode == 6)
+				{
+					//The end of the previous chunk put in front, as Prepare() does for the filter graph
+					chunk.m_triggerPhase = end * timescale;
+					size_t tail = min(n, ref.size());
+					engine.PrependTail(rs, &chunk, tail);
+					REQUIRE(chunk.size() == n + tail);
+					REQUIRE(chunk.m_triggerPhase == (end - (int64_t)tail) * timescale);
+					chunk.m_samples.PrepareForCpuAccess();
+					REQUIRE(equal(ref.end() - tail, ref.end(), chunk.m_samples.GetCpuPointer()));
+				}
+				else if(mode < 9)
+				{
+					//Overlapping what's already there, which must not change
+					size_t overlap = min(n, ref.size());
+					chunk.m_triggerPhase = (end - (int64_t)overlap) * timescale + jitterdesc(g_rng);
+				}
+				else
+				{
+					//Short gap, filled by holding the last sample
+					size_t gap = gapdesc(g_rng);
+					chunk.m_triggerPhase = (end + gap) * timescale;
+					ref.insert(ref.end(), gap, ref.back());
+				}
+
+				//Everything past the end of the reference is new
+				int64_t start = (chunk.m_triggerPhase + timescale/2) / timescale;
+				int64_t skip = refBase + (int64_t)ref.size() - start;
+				chunk.m_samples.PrepareForCpuAccess();
+				for(size_t k=max(skip, (int64_t)0); k<chunk.size(); k++)
+					ref.push_back(chunk.m_samples[k]);
+
+				engine.Append(rs, &chunk, depth);
+
+				//At least the last depth samples are kept, and never more than twice that
+				auto wfm = rs.m_wfm;
+				size_t len = wfm->size();
+				REQUIRE(len <= 2*depth);
+				REQUIRE(len >= min(ref.size(), depth));
+
+				//The buffer holds the newest samples, and the X axis moved forward past the ones dropped
+				size_t dropped = ref.size() - len;
+				REQUIRE(wfm->m_triggerPhase == (refBase + (int64_t)dropped) * timescale);
+				wfm->m_samples.PrepareForCpuAccess();
+				REQUIRE(equal(ref.begin() + dropped, ref.end(), wfm->m_samples.GetCpuPointer()));
+
+				//The buffer takes the timestamp of the newest chunk
+				REQUIRE(wfm->m_startTimestamp == (time_t)j);
+			}
+
+			LogVerbose("Depth %zu: %zu samples kept\n", depth, rs.m_wfm->size());
+			delete rs.m_wfm;
+		}
+	}
+}
@@ -0,0 +1,109 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* libscopehal v0.1                                                                                                     *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for StreamingHistogram
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Client.h"
+#include "../../src/ngscopeclient/StatisticsEngine.h"
+
+using namespace std;
+
+TEST_CASE("Client_StreamingHistogram")
+{
+	const size_t nbins = StreamingHistogram::NUM_BINS;
+
+	uniform_real_distribution<double> centerdesc(-100, 100);
+	uniform_real_distribution<double> growdesc(1, 1.5);
+	uniform_int_distribution<size_t> countdesc(1, 10000);
+
+	const size_t niter = 8;
+	for(size_t i=0; i<niter; i++)
+	{
+		SECTION(string("Iteration ") + to_string(i))
+		{
+			LogVerbose("Iteration %zu\n", i);
+			LogIndenter li;
+
+			//Blocks of values whose range keeps growing, in either direction, so the histogram has to keep extending
+			StreamingHistogram hist;
+			vector<double> all;
+			double center = centerdesc(g_rng);
+			double range = 1e-3;
+			for(size_t j=0; j<50; j++)
+			{
+				uniform_real_distribution<double> valuedesc(center - range, center + range);
+				size_t n = countdesc(g_rng);
+				vector<double> block(n);
+				for(size_t k=0; k<n; k++)
+					block[k] = valuedesc(g_rng);
+
+				auto mm = minmax_element(block.begin(), block.end());
+				hist.Extend(*mm.first, *mm.second);
+				for(auto v : block)
+					hist.Add(v);
+
+				all.insert(all.end(), block.begin(), block.end());
+				center += centerdesc(g_rng) * range / 100;
+				range *= growdesc(g_rng);
+			}
+
+			//Nothing lost, and the final range covers everything
+			uint64_t total = 0;
+			for(size_t j=0; j<nbins; j++)
+				total += hist.m_bins[j];
+			REQUIRE(total == all.size());
+
+			auto mm = minmax_element(all.begin(), all.end());
+			REQUIRE(hist.m_min <= *mm.first);
+			REQUIRE(hist.m_min + hist.m_binWidth*nbins > *mm.second);
+
+			//Merging bins must give the same counts as histogramming everything at the final bin size, except for the
+			//odd value within rounding error of a bin edge
+			vector<uint64_t> golden(nbins, 0);
+			for(auto v : all)
+				golden[min( (size_t)((v - hist.m_min) / hist.m_binWidth), nbins - 1)] ++;
+
+			uint64_t misplaced = 0;
+			for(size_t j=0; j<nbins; j++)
+				misplaced += llabs( (int64_t)golden[j] - (int64_t)hist.m_bins[j]);
+			LogVerbose("%zu values in [%f, %f], %zu misplaced\n",
+				all.size(), hist.m_min, hist.m_min + hist.m_binWidth*nbins, (size_t)misplaced / 2);
+			REQUIRE(misplaced <= all.size() / 1000);
+		}
+	}
+}
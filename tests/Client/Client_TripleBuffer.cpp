@@ -0,0 +1,123 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* libscopehal v0.1                                                                                                     *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for TripleBuffer
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Client.h"
+#include "../../src/ngscopeclient/TripleBuffer.h"
+
+using namespace std;
+
+/**
+	@brief Value published through the buffer: every element is the sequence number, so a torn read shows up
+ */
+class TripleBufferTestValue
+{
+public:
+	TripleBufferTestValue()
+	{
+		for(auto& v : m_data)
+			v = 0;
+	}
+
+	uint64_t m_data[64];
+};
+
+TEST_CASE("Client_TripleBuffer")
+{
+	const uint64_t count = 1000000;
+
+	const size_t niter = 4;
+	for(size_t i=0; i<niter; i++)
+	{
+		SECTION(string("Iteration ") + to_string(i))
+		{
+			LogVerbose("Iteration %zu\n", i);
+			LogIndenter li;
+
+			TripleBuffer<TripleBufferTestValue> buf;
+			atomic<bool> done(false);
+
+			thread writer([&]()
+			{
+				for(uint64_t seq=1; seq<=count; seq++)
+				{
+					auto& back = buf.GetBackBuffer();
+					for(auto& v : back.m_data)
+						v = seq;
+					buf.Publish();
+				}
+				done = true;
+			});
+
+			//The reader must only ever see whole buffers, in the order they were published
+			uint64_t last = 0;
+			uint64_t updates = 0;
+			bool ok = true;
+			while(true)
+			{
+				bool finished = done;
+				if(buf.Update())
+				{
+					auto& front = buf.GetFrontBuffer();
+					uint64_t seq = front.m_data[0];
+					for(auto v : front.m_data)
+					{
+						if(v != seq)
+							ok = false;
+					}
+					if(seq <= last)
+						ok = false;
+					last = seq;
+					updates ++;
+					continue;
+				}
+
+				//Nothing new since the writer finished, so the last value published must have been picked up
+				if(finished)
+					break;
+			}
+			writer.join();
+
+			LogVerbose("%zu of %zu values seen\n", (size_t)updates, (size_t)count);
+			REQUIRE(ok);
+			REQUIRE(last == count);
+			REQUIRE(!buf.Update());
+		}
+	}
+}
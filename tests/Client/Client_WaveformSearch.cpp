@@ -0,0 +1,177 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* libscopehal v0.1                                                                                                     *
+*                                                                                                                      *
+* Copyright (c) 2012-2022 Andrew D. Zonenberg and contributors                                                         *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Unit test for WaveformSearch::FindTransitions
+ */
+#ifdef _CATCH2_V3
+#include <catch2/catch_all.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include "Client.h"
+#include "../../src/ngscopeclient/WaveformSearch.h"
+
+using namespace std;
+
+/**
+	@brief Finds transitions one sample at a time, the obvious way
+ */
+static void FindTransitionsReference(
+	const vector<float>& samples, WaveformSearch::MatchMode mode, float lo, float hi, vector<uint32_t>& transitions)
+{
+	bool prev = false;
+	for(size_t i=0; i<samples.size(); i++)
+	{
+		float v = samples[i];
+		bool m;
+		switch(mode)
+		{
+			case WaveformSearch::MATCH_ABOVE:
+				m = v > lo;
+				break;
+
+			case WaveformSearch::MATCH_BELOW:
+				m = v < lo;
+				break;
+
+			case WaveformSearch::MATCH_INSIDE:
+				m = (v >= lo) && (v <= hi);
+				break;
+
+			case WaveformSearch::MATCH_OUTSIDE:
+			default:
+				m = (v < lo) || (v > hi);
+				break;
+		}
+
+		if(m != prev)
+			transitions.push_back(i);
+		prev = m;
+	}
+}
+
+TEST_CASE("Client_WaveformSearch")
+{
+	#ifdef __x86_64__
+	bool reallyHasAvx2 = g_hasAvx2;
+	bool reallyHasAvx512F = g_hasAvx512F;
+	#endif
+
+	normal_distribution<float> noise(0, 0.1);
+	uniform_int_distribution<size_t> lendesc(100000, 200000);
+	uniform_real_distribution<float> leveldesc(-0.8, 0.8);
+	uniform_int_distribution<size_t> capdesc(1, 500);
+
+	const WaveformSearch::MatchMode modes[] =
+	{
+		WaveformSearch::MATCH_ABOVE,
+		WaveformSearch::MATCH_BELOW,
+		WaveformSearch::MATCH_INSIDE,
+		WaveformSearch::MATCH_OUTSIDE
+	};
+
+	const size_t niter = 8;
+	for(size_t i=0; i<niter; i++)
+	{
+		SECTION(string("Iteration ") + to_string(i))
+		{
+			LogVerbose("Iteration %zu\n", i);
+			LogIndenter li;
+
+			//Noisy sine, with a length that isn't a multiple of any vector width so the tails get tested too
+			size_t len = lendesc(g_rng) | 1;
+			vector<float> samples(len);
+			for(size_t j=0; j<len; j++)
+				samples[j] = sin(j * 2 * M_PI / 4096) + noise(g_rng);
+
+			float lo = leveldesc(g_rng);
+			float hi = leveldesc(g_rng);
+			if(lo > hi)
+				swap(lo, hi);
+
+			for(auto mode : modes)
+			{
+				vector<uint32_t> golden;
+				FindTransitionsReference(samples, mode, lo, hi, golden);
+
+				//Every implementation has to find exactly the same transitions, and stop at the same place
+				size_t cap = capdesc(g_rng);
+				vector<uint32_t> goldenCapped(golden.begin(), golden.begin() + min(cap, golden.size()));
+
+				vector<uint32_t> out;
+				vector<uint32_t> outCapped;
+
+				#ifdef __x86_64__
+					g_hasAvx2 = false;
+					g_hasAvx512F = false;
+				#endif
+				WaveformSearch::FindTransitions(&samples[0], len, mode, lo, hi, SIZE_MAX, out);
+				WaveformSearch::FindTransitions(&samples[0], len, mode, lo, hi, cap, outCapped);
+				LogVerbose("Mode %d: %zu transitions\n", mode, golden.size());
+				REQUIRE(out == golden);
+				REQUIRE(outCapped == goldenCapped);
+
+				#ifdef __x86_64__
+				if(reallyHasAvx2)
+				{
+					g_hasAvx2 = true;
+
+					out.clear();
+					outCapped.clear();
+					WaveformSearch::FindTransitions(&samples[0], len, mode, lo, hi, SIZE_MAX, out);
+					WaveformSearch::FindTransitions(&samples[0], len, mode, lo, hi, cap, outCapped);
+					REQUIRE(out == golden);
+					REQUIRE(outCapped == goldenCapped);
+				}
+
+				if(reallyHasAvx512F)
+				{
+					g_hasAvx512F = true;
+
+					out.clear();
+					outCapped.clear();
+					WaveformSearch::FindTransitions(&samples[0], len, mode, lo, hi, SIZE_MAX, out);
+					WaveformSearch::FindTransitions(&samples[0], len, mode, lo, hi, cap, outCapped);
+					REQUIRE(out == golden);
+					REQUIRE(outCapped == goldenCapped);
+				}
+				#endif
+			}
+		}
+	}
+
+	#ifdef __x86_64__
+		g_hasAvx2 = reallyHasAvx2;
+		g_hasAvx512F = reallyHasAvx512F;
+	#endif
+}